@@ -0,0 +1,135 @@
+#include "cull.h"
+
+static void setPlane(Frustum *frustum, int i, float nx, float ny, float nz, float d)
+{
+	float len = sqrtf(nx * nx + ny * ny + nz * nz);
+	frustum->nx[i] = nx / len;
+	frustum->ny[i] = ny / len;
+	frustum->nz[i] = nz / len;
+	frustum->d[i] = d / len;
+}
+
+static void repeatPlanes(Frustum *frustum)
+{
+	for (int i = 6; i < 8; ++i)
+	{
+		frustum->nx[i] = frustum->nx[i - 6];
+		frustum->ny[i] = frustum->ny[i - 6];
+		frustum->nz[i] = frustum->nz[i - 6];
+		frustum->d[i] = frustum->d[i - 6];
+	}
+}
+
+// Gribb/Hartmann: the planes are the sums and differences of the last row of
+// the matrix with the other rows
+void frustumFromMatrix(Frustum *frustum, mat4x4 M)
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		int row = i / 2;
+		float sign = i % 2 ? -1.f : 1.f;
+		setPlane(frustum, i,
+			M[0][3] + sign * M[0][row],
+			M[1][3] + sign * M[1][row],
+			M[2][3] + sign * M[2][row],
+			M[3][3] + sign * M[3][row]);
+	}
+	repeatPlanes(frustum);
+}
+
+// World space corners of the frustum of a view-projection matrix
+static void frustumCorners(vec4 corners[8], mat4x4 viewProjection)
+{
+	mat4x4 inverse;
+	mat4x4_invert(inverse, viewProjection);
+	for (int i = 0; i < 8; ++i)
+	{
+		vec4 ndc = {i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, i & 4 ? 1.f : -1.f, 1.f};
+		mat4x4_mul_vec4(corners[i], inverse, ndc);
+		vec4_scale(corners[i], corners[i], 1.f / corners[i][3]);
+	}
+}
+
+// Plane orientations come from the eyes, then each plane is pushed out until
+// all corners of both frusta are on its inner side. The result contains the
+// convex hull of both frusta, and so everything either eye can see.
+void frustumCombineStereo(Frustum *frustum, mat4x4 leftViewProjection, mat4x4 rightViewProjection)
+{
+	Frustum left, right;
+	frustumFromMatrix(&left, leftViewProjection);
+	frustumFromMatrix(&right, rightViewProjection);
+
+	vec4 corners[16];
+	frustumCorners(corners, leftViewProjection);
+	frustumCorners(corners + 8, rightViewProjection);
+
+	for (int i = 0; i < 6; ++i)
+	{
+		float nx, ny, nz;
+		if (i == 0)
+		{
+			nx = left.nx[i], ny = left.ny[i], nz = left.nz[i];
+		}
+		else if (i == 1)
+		{
+			nx = right.nx[i], ny = right.ny[i], nz = right.nz[i];
+		}
+		else
+		{
+			nx = left.nx[i] + right.nx[i];
+			ny = left.ny[i] + right.ny[i];
+			nz = left.nz[i] + right.nz[i];
+		}
+
+		float d = 0.f;
+		for (int c = 0; c < 16; ++c)
+		{
+			float cd = -(nx * corners[c][0] + ny * corners[c][1] + nz * corners[c][2]);
+			if (c == 0 || cd > d)
+				d = cd;
+		}
+		setPlane(frustum, i, nx, ny, nz, d);
+	}
+	repeatPlanes(frustum);
+}
+
+int cullSpheres(const Frustum *frustum, const vec3 *center, const float *radius, const float *scale,
+	int first, int count, int *visible)
+{
+	int n = 0;
+
+#if LINMATH_SIMD
+	lm4 nx0 = LM4_LOAD(frustum->nx), nx1 = LM4_LOAD(frustum->nx + 4);
+	lm4 ny0 = LM4_LOAD(frustum->ny), ny1 = LM4_LOAD(frustum->ny + 4);
+	lm4 nz0 = LM4_LOAD(frustum->nz), nz1 = LM4_LOAD(frustum->nz + 4);
+	lm4 d0 = LM4_LOAD(frustum->d), d1 = LM4_LOAD(frustum->d + 4);
+
+	// One sphere against four planes at a time
+	for (int i = first; i < first + count; ++i)
+	{
+		lm4 x = LM4_SPLAT(center[i][0]);
+		lm4 y = LM4_SPLAT(center[i][1]);
+		lm4 z = LM4_SPLAT(center[i][2]);
+		lm4 r = LM4_SPLAT(-radius[i] * scale[i]);
+		lm4 dist0 = LM4_ADD(LM4_ADD(LM4_ADD(LM4_MUL(nx0, x), LM4_MUL(ny0, y)), LM4_MUL(nz0, z)), d0);
+		lm4 dist1 = LM4_ADD(LM4_ADD(LM4_ADD(LM4_MUL(nx1, x), LM4_MUL(ny1, y)), LM4_MUL(nz1, z)), d1);
+		visible[n] = i;
+		n += !LM4_ANY(LM4_OR(LM4_CMPLT(dist0, r), LM4_CMPLT(dist1, r)));
+	}
+#else
+	for (int i = first; i < first + count; ++i)
+	{
+		float r = -radius[i] * scale[i];
+		int inside = 1;
+		for (int p = 0; p < 6; ++p)
+		{
+			float dist = frustum->nx[p] * center[i][0] + frustum->ny[p] * center[i][1] + frustum->nz[p] * center[i][2] + frustum->d[p];
+			inside &= !(dist < r);
+		}
+		visible[n] = i;
+		n += inside;
+	}
+#endif
+
+	return n;
+}
@@ -0,0 +1,33 @@
+// View frustum culling of bounding spheres.
+//
+// For stereo, frustumCombineStereo builds a single frustum that contains the
+// frusta of both eyes, so every object is tested once per frame and both eyes
+// draw the same visible set. It is conservative: an object visible to either
+// eye is never culled, one just outside both may be kept.
+#ifndef CULL_H
+#define CULL_H
+
+#include "linmath.h"
+
+// Planes are (normal, d) with unit normals pointing inwards, a point p is
+// inside when dot(normal, p) + d >= 0 for all of them. Planes 6 and 7 repeat
+// 0 and 1, so the vector path can test four planes at a time.
+typedef struct Frustum
+{
+	float nx[8], ny[8], nz[8], d[8];
+} Frustum;
+
+// Frustum of a view-projection matrix (left, right, bottom, top, near, far)
+void frustumFromMatrix(Frustum *frustum, mat4x4 viewProjection);
+
+// Smallest frustum with the left eye's left plane, the right eye's right
+// plane and the averaged other planes that contains both eyes' frusta
+void frustumCombineStereo(Frustum *frustum, mat4x4 leftViewProjection, mat4x4 rightViewProjection);
+
+// Tests the spheres of objects [first, first + count), centered at center[i]
+// with radius radius[i] * scale[i], and writes the indices of those that are
+// at least partly inside to visible. Returns the number written.
+int cullSpheres(const Frustum *frustum, const vec3 *center, const float *radius, const float *scale,
+	int first, int count, int *visible);
+
+#endif
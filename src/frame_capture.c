@@ -0,0 +1,333 @@
+#include "frame_capture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define HEADER_WORDS 4 // magic, version, two reserved
+#define POSE_WORDS 20
+#define FRAME_DATA_WORDS (1 + 2 + POSE_WORDS + 32)
+#define CLICK_WORDS (1 + 2 + 10 + 2)
+
+int frameCaptureInit(FrameCapture *capture, size_t bytes)
+{
+	memset(capture, 0, sizeof(*capture));
+	capture->capacity = bytes / 4 > HEADER_WORDS ? bytes / 4 : HEADER_WORDS;
+	capture->words = malloc(capture->capacity * 4);
+	if (!capture->words)
+		return 0;
+	capture->words[0] = FRAME_CAPTURE_MAGIC;
+	capture->words[1] = FRAME_CAPTURE_VERSION;
+	capture->words[2] = capture->words[3] = 0;
+	capture->used = capture->frameStart = HEADER_WORDS;
+	return 1;
+}
+
+void frameCaptureFree(FrameCapture *capture)
+{
+	free(capture->words);
+	memset(capture, 0, sizeof(*capture));
+}
+
+size_t frameCaptureSize(const FrameCapture *capture)
+{
+	return capture->used * 4;
+}
+
+// Room for a record of the given words, or NULL when not capturing or full.
+// A full log is cut back to the end of the last complete frame.
+static uint32_t *beginRecord(FrameCapture *capture, FrameCaptureRecord type, size_t words)
+{
+	if (!capture->words || capture->full)
+		return NULL;
+	if (capture->used + words > capture->capacity)
+	{
+		capture->full = 1;
+		capture->used = capture->frameStart;
+		return NULL;
+	}
+	uint32_t *w = capture->words + capture->used;
+	capture->used += words;
+	w[0] = FRAME_CAPTURE_HEADER(type, words);
+	return w;
+}
+
+static void putDouble(uint32_t *w, double d)
+{
+	memcpy(w, &d, sizeof(d));
+}
+
+static double getDouble(const uint32_t *w)
+{
+	double d;
+	memcpy(&d, w, sizeof(d));
+	return d;
+}
+
+void frameCaptureBeginFrame(FrameCapture *capture, double now, int vr)
+{
+	if (!capture->words || capture->full)
+		return;
+	capture->frameStart = capture->used;
+	uint32_t *w = beginRecord(capture, FRAME_CAPTURE_FRAME, 4);
+	if (!w)
+		return;
+	putDouble(w + 1, now);
+	w[3] = (uint32_t)vr;
+	++capture->frames;
+}
+
+void frameCaptureFrameData(FrameCapture *capture, const VRFrameData *data)
+{
+	if (!capture->words)
+		return;
+
+	float projection[32];
+	memcpy(projection, data->leftProjectionMatrix, 16 * sizeof(float));
+	memcpy(projection + 16, data->rightProjectionMatrix, 16 * sizeof(float));
+	if (!capture->hasProjection || memcmp(projection, capture->projection, sizeof(projection)))
+	{
+		uint32_t *w = beginRecord(capture, FRAME_CAPTURE_PROJECTIONS, 33);
+		if (!w)
+			return;
+		memcpy(w + 1, projection, sizeof(projection));
+		memcpy(capture->projection, projection, sizeof(projection));
+		capture->hasProjection = 1;
+	}
+
+	uint32_t *w = beginRecord(capture, FRAME_CAPTURE_FRAME_DATA, FRAME_DATA_WORDS);
+	if (!w)
+		return;
+	putDouble(w + 1, data->timestamp);
+	const VRPose *pose = &data->pose;
+	float fields[POSE_WORDS - 1] =
+	{
+		pose->position.x, pose->position.y, pose->position.z,
+		pose->linearVelocity.x, pose->linearVelocity.y, pose->linearVelocity.z,
+		pose->linearAcceleration.x, pose->linearAcceleration.y, pose->linearAcceleration.z,
+		pose->orientation.x, pose->orientation.y, pose->orientation.z, pose->orientation.w,
+		pose->angularVelocity.x, pose->angularVelocity.y, pose->angularVelocity.z,
+		pose->angularAcceleration.x, pose->angularAcceleration.y, pose->angularAcceleration.z,
+	};
+	memcpy(w + 3, fields, sizeof(fields));
+	w[3 + POSE_WORDS - 1] = (uint32_t)pose->poseFlags;
+	memcpy(w + 3 + POSE_WORDS, data->leftViewMatrix, 16 * sizeof(float));
+	memcpy(w + 3 + POSE_WORDS + 16, data->rightViewMatrix, 16 * sizeof(float));
+}
+
+void frameCaptureEyeParameters(FrameCapture *capture, VREye eye, const VREyeParameters *parameters)
+{
+	uint32_t *w = beginRecord(capture, FRAME_CAPTURE_EYE_PARAMETERS, 7);
+	if (!w)
+		return;
+	w[1] = (uint32_t)eye;
+	memcpy(w + 2, &parameters->offset.x, sizeof(float));
+	memcpy(w + 3, &parameters->offset.y, sizeof(float));
+	memcpy(w + 4, &parameters->offset.z, sizeof(float));
+	w[5] = (uint32_t)parameters->renderWidth;
+	w[6] = (uint32_t)parameters->renderHeight;
+}
+
+void frameCaptureCanvasSize(FrameCapture *capture, int width, int height)
+{
+	if (width == capture->canvasWidth && height == capture->canvasHeight)
+		return;
+	uint32_t *w = beginRecord(capture, FRAME_CAPTURE_CANVAS_SIZE, 3);
+	if (!w)
+		return;
+	w[1] = (uint32_t)width;
+	w[2] = (uint32_t)height;
+	capture->canvasWidth = width;
+	capture->canvasHeight = height;
+}
+
+void frameCaptureClick(FrameCapture *capture, const EmscriptenMouseEvent *event)
+{
+	uint32_t *w = beginRecord(capture, FRAME_CAPTURE_CLICK, CLICK_WORDS);
+	if (!w)
+		return;
+	putDouble(w + 1, event->timestamp);
+	long fields[10] =
+	{
+		event->screenX, event->screenY, event->clientX, event->clientY, event->targetX, event->targetY,
+		event->canvasX, event->canvasY, event->movementX, event->movementY
+	};
+	for (int i = 0; i < 10; ++i)
+		w[3 + i] = (uint32_t)(int32_t)fields[i];
+	w[13] = (uint32_t)event->button | (uint32_t)event->buttons << 16;
+	w[14] = (event->ctrlKey ? 1u : 0u) | (event->shiftKey ? 2u : 0u) | (event->altKey ? 4u : 0u) | (event->metaKey ? 8u : 0u);
+}
+
+void frameCapturePresenting(FrameCapture *capture, int presenting)
+{
+	presenting = presenting != 0;
+	if (presenting == capture->presenting)
+		return;
+	uint32_t *w = beginRecord(capture, FRAME_CAPTURE_PRESENTING, 2);
+	if (!w)
+		return;
+	w[1] = (uint32_t)presenting;
+	capture->presenting = presenting;
+}
+
+void frameCapturePresentResolved(FrameCapture *capture)
+{
+	beginRecord(capture, FRAME_CAPTURE_PRESENT_RESOLVED, 1);
+}
+
+int frameCaptureReaderInit(FrameCaptureReader *reader, const void *data, size_t size)
+{
+	memset(reader, 0, sizeof(*reader));
+	if (size < HEADER_WORDS * 4 || size % 4)
+		return 0;
+	reader->words = data;
+	reader->count = size / 4;
+	reader->position = HEADER_WORDS;
+	return reader->words[0] == FRAME_CAPTURE_MAGIC && reader->words[1] == FRAME_CAPTURE_VERSION;
+}
+
+// Expected size of each record type, 0 for none
+static const size_t gRecordWords[FRAME_CAPTURE_RECORD_COUNT] =
+{
+	[FRAME_CAPTURE_FRAME] = 4,
+	[FRAME_CAPTURE_FRAME_DATA] = FRAME_DATA_WORDS,
+	[FRAME_CAPTURE_PROJECTIONS] = 33,
+	[FRAME_CAPTURE_EYE_PARAMETERS] = 7,
+	[FRAME_CAPTURE_CANVAS_SIZE] = 3,
+	[FRAME_CAPTURE_CLICK] = CLICK_WORDS,
+	[FRAME_CAPTURE_PRESENTING] = 2,
+	[FRAME_CAPTURE_PRESENT_RESOLVED] = 1,
+};
+
+FrameCaptureRecord frameCapturePeek(const FrameCaptureReader *reader)
+{
+	if (reader->position >= reader->count)
+		return 0;
+	uint32_t header = reader->words[reader->position];
+	FrameCaptureRecord type = FRAME_CAPTURE_TYPE(header);
+	size_t words = FRAME_CAPTURE_WORDS(header);
+	if (type <= 0 || type >= FRAME_CAPTURE_RECORD_COUNT || words != gRecordWords[type]
+		|| words > reader->count - reader->position)
+		return 0;
+	return type;
+}
+
+// The next record's words if it has the type, consuming it
+static const uint32_t *readRecord(FrameCaptureReader *reader, FrameCaptureRecord type)
+{
+	if (frameCapturePeek(reader) != type)
+		return NULL;
+	const uint32_t *w = reader->words + reader->position;
+	reader->position += gRecordWords[type];
+	return w;
+}
+
+int frameCaptureReadFrame(FrameCaptureReader *reader, double *now, int *vr)
+{
+	const uint32_t *w = readRecord(reader, FRAME_CAPTURE_FRAME);
+	if (!w)
+		return 0;
+	*now = getDouble(w + 1);
+	*vr = (int)w[3];
+	return 1;
+}
+
+int frameCaptureReadFrameData(FrameCaptureReader *reader, VRFrameData *data)
+{
+	const uint32_t *w = readRecord(reader, FRAME_CAPTURE_PROJECTIONS);
+	if (w)
+		memcpy(reader->projection, w + 1, sizeof(reader->projection));
+	w = readRecord(reader, FRAME_CAPTURE_FRAME_DATA);
+	if (!w)
+		return 0;
+
+	memset(data, 0, sizeof(*data));
+	data->timestamp = getDouble(w + 1);
+	float fields[POSE_WORDS - 1];
+	memcpy(fields, w + 3, sizeof(fields));
+	VRPose *pose = &data->pose;
+	VRVector3 *vectors[] = {&pose->position, &pose->linearVelocity, &pose->linearAcceleration};
+	for (int i = 0; i < 3; ++i)
+	{
+		vectors[i]->x = fields[3 * i];
+		vectors[i]->y = fields[3 * i + 1];
+		vectors[i]->z = fields[3 * i + 2];
+	}
+	pose->orientation.x = fields[9];
+	pose->orientation.y = fields[10];
+	pose->orientation.z = fields[11];
+	pose->orientation.w = fields[12];
+	VRVector3 *angular[] = {&pose->angularVelocity, &pose->angularAcceleration};
+	for (int i = 0; i < 2; ++i)
+	{
+		angular[i]->x = fields[13 + 3 * i];
+		angular[i]->y = fields[14 + 3 * i];
+		angular[i]->z = fields[15 + 3 * i];
+	}
+	pose->poseFlags = (int)w[3 + POSE_WORDS - 1];
+	memcpy(data->leftViewMatrix, w + 3 + POSE_WORDS, 16 * sizeof(float));
+	memcpy(data->rightViewMatrix, w + 3 + POSE_WORDS + 16, 16 * sizeof(float));
+	memcpy(data->leftProjectionMatrix, reader->projection, 16 * sizeof(float));
+	memcpy(data->rightProjectionMatrix, reader->projection + 16, 16 * sizeof(float));
+	return 1;
+}
+
+int frameCaptureReadEyeParameters(FrameCaptureReader *reader, VREye *eye, VREyeParameters *parameters)
+{
+	const uint32_t *w = readRecord(reader, FRAME_CAPTURE_EYE_PARAMETERS);
+	if (!w)
+		return 0;
+	*eye = (VREye)w[1];
+	memcpy(&parameters->offset.x, w + 2, sizeof(float));
+	memcpy(&parameters->offset.y, w + 3, sizeof(float));
+	memcpy(&parameters->offset.z, w + 4, sizeof(float));
+	parameters->renderWidth = w[5];
+	parameters->renderHeight = w[6];
+	return 1;
+}
+
+int frameCaptureReadCanvasSize(FrameCaptureReader *reader, int *width, int *height)
+{
+	const uint32_t *w = readRecord(reader, FRAME_CAPTURE_CANVAS_SIZE);
+	if (!w)
+		return 0;
+	*width = (int)w[1];
+	*height = (int)w[2];
+	return 1;
+}
+
+int frameCaptureReadClick(FrameCaptureReader *reader, EmscriptenMouseEvent *event)
+{
+	const uint32_t *w = readRecord(reader, FRAME_CAPTURE_CLICK);
+	if (!w)
+		return 0;
+	memset(event, 0, sizeof(*event));
+	event->timestamp = getDouble(w + 1);
+	long *fields[10] =
+	{
+		&event->screenX, &event->screenY, &event->clientX, &event->clientY, &event->targetX, &event->targetY,
+		&event->canvasX, &event->canvasY, &event->movementX, &event->movementY
+	};
+	for (int i = 0; i < 10; ++i)
+		*fields[i] = (int32_t)w[3 + i];
+	event->button = (unsigned short)(w[13] & 0xffff);
+	event->buttons = (unsigned short)(w[13] >> 16);
+	event->ctrlKey = (w[14] & 1) != 0;
+	event->shiftKey = (w[14] & 2) != 0;
+	event->altKey = (w[14] & 4) != 0;
+	event->metaKey = (w[14] & 8) != 0;
+	return 1;
+}
+
+int frameCaptureReadPresenting(FrameCaptureReader *reader, int *presenting)
+{
+	const uint32_t *w = readRecord(reader, FRAME_CAPTURE_PRESENTING);
+	if (!w)
+		return 0;
+	*presenting = (int)w[1];
+	return 1;
+}
+
+int frameCaptureReadPresentResolved(FrameCaptureReader *reader)
+{
+	return readRecord(reader, FRAME_CAPTURE_PRESENT_RESOLVED) != NULL;
+}
@@ -0,0 +1,102 @@
+// Capture of everything a session feeds into the frame loops, for replay.
+//
+// With CAPTURE_FRAMES the app appends to a log every input it reads from the
+// browser, at the moment it reads it: the start and clock of every frame, the
+// VR frame data, eye parameters, canvas size, clicks and changes of the
+// display's presenting state. The native platform replays such a log
+// (NATIVE_REPLAY): each of those calls is answered with the next record
+// instead of the scripted display, so a session from a headset runs again
+// headless, as fast as possible or at its recorded pacing, and takes the same
+// decisions each time.
+//
+// The log is a header and then records of 32-bit words in the style of the GL
+// command buffer: a header word, (total words << 8) | type, followed by the
+// fields. Doubles take two words. Projection matrices rarely change and are
+// only written when they do, which keeps a VR frame at about 240 bytes.
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <emscripten/html5.h>
+#include <emscripten/vr.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_CAPTURE_MAGIC 0x50435256 // "VRCP"
+#define FRAME_CAPTURE_VERSION 1
+
+typedef enum FrameCaptureRecord
+{
+	FRAME_CAPTURE_FRAME = 1,          // clock (2 words), vr
+	FRAME_CAPTURE_FRAME_DATA,         // timestamp (2 words), pose (19 floats, flags), left and right view
+	FRAME_CAPTURE_PROJECTIONS,        // left and right projection, before the frame data they apply to
+	FRAME_CAPTURE_EYE_PARAMETERS,     // eye, offset (3 floats), render width, render height
+	FRAME_CAPTURE_CANVAS_SIZE,        // width, height
+	FRAME_CAPTURE_CLICK,              // timestamp (2 words), screen, client, target, canvas and movement x and y, buttons, keys
+	FRAME_CAPTURE_PRESENTING,         // presenting
+	FRAME_CAPTURE_PRESENT_RESOLVED,   // the request to present completed
+	FRAME_CAPTURE_RECORD_COUNT
+} FrameCaptureRecord;
+
+#define FRAME_CAPTURE_HEADER(type, words) ((uint32_t)(words) << 8 | (uint32_t)(type))
+#define FRAME_CAPTURE_TYPE(header) ((FrameCaptureRecord)((header) & 0xff))
+#define FRAME_CAPTURE_WORDS(header) ((size_t)((header) >> 8))
+
+typedef struct FrameCapture
+{
+	uint32_t *words; // NULL when not capturing
+	size_t capacity, used; // In words
+	size_t frameStart; // Where the current frame's records start
+	int full; // Set once a record did not fit, the log then ends before that frame
+	unsigned long frames;
+
+	// What was last written, for the records only written on change
+	int canvasWidth, canvasHeight, presenting;
+	float projection[32];
+	int hasProjection;
+} FrameCapture;
+
+// Allocates room for bytes of log up front, so capturing does not allocate
+// per frame. Returns 0 when out of memory.
+int frameCaptureInit(FrameCapture *capture, size_t bytes);
+void frameCaptureFree(FrameCapture *capture);
+
+// Log size in bytes so far
+size_t frameCaptureSize(const FrameCapture *capture);
+
+void frameCaptureBeginFrame(FrameCapture *capture, double now, int vr);
+void frameCaptureFrameData(FrameCapture *capture, const VRFrameData *data);
+void frameCaptureEyeParameters(FrameCapture *capture, VREye eye, const VREyeParameters *parameters);
+void frameCaptureCanvasSize(FrameCapture *capture, int width, int height);
+void frameCaptureClick(FrameCapture *capture, const EmscriptenMouseEvent *event);
+void frameCapturePresenting(FrameCapture *capture, int presenting);
+void frameCapturePresentResolved(FrameCapture *capture);
+
+// Hands the log to the platform to keep: a file download in the browser
+// (frame_capture.js), a file natively (NATIVE_CAPTURE).
+void frameCaptureSave(const void *data, size_t size);
+
+// Reads a log back record by record. Each read consumes the next record and
+// returns 1 if it is of the requested type, and returns 0 otherwise.
+typedef struct FrameCaptureReader
+{
+	const uint32_t *words;
+	size_t count, position;
+	float projection[32];
+} FrameCaptureReader;
+
+// Returns 0 if data is not a capture of this version
+int frameCaptureReaderInit(FrameCaptureReader *reader, const void *data, size_t size);
+
+// Type of the next record, 0 at the end of the log or at a malformed record
+FrameCaptureRecord frameCapturePeek(const FrameCaptureReader *reader);
+
+int frameCaptureReadFrame(FrameCaptureReader *reader, double *now, int *vr);
+// Also reads the projections written before the frame data, if any
+int frameCaptureReadFrameData(FrameCaptureReader *reader, VRFrameData *data);
+int frameCaptureReadEyeParameters(FrameCaptureReader *reader, VREye *eye, VREyeParameters *parameters);
+int frameCaptureReadCanvasSize(FrameCaptureReader *reader, int *width, int *height);
+int frameCaptureReadClick(FrameCaptureReader *reader, EmscriptenMouseEvent *event);
+int frameCaptureReadPresenting(FrameCaptureReader *reader, int *presenting);
+int frameCaptureReadPresentResolved(FrameCaptureReader *reader);
+
+#endif
@@ -0,0 +1,16 @@
+// JavaScript side of frame capture (frame_capture.h), linked in with
+// --js-library. frameCaptureSave offers the log as a file download, to be
+// replayed natively with NATIVE_REPLAY.
+mergeInto(LibraryManager.library, {
+	frameCaptureSave: function(data, size) {
+		// Copied out of the heap, which may grow or be reused after this call
+		var blob = new Blob([HEAPU8.slice(data, data + size)], {type: 'application/octet-stream'});
+		var link = document.createElement('a');
+		link.href = URL.createObjectURL(blob);
+		link.download = 'session-' + new Date().toISOString().replace(/[:.]/g, '-') + '.vrcap';
+		document.body.appendChild(link);
+		link.click();
+		document.body.removeChild(link);
+		setTimeout(function() { URL.revokeObjectURL(link.href); }, 0);
+	}
+});
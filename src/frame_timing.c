@@ -0,0 +1,227 @@
+#include "frame_timing.h"
+
+#ifdef FRAME_TIMING
+
+#include <emscripten/emscripten.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Power of two, so the frame counter can wrap around
+#define FRAME_TIMING_CAPACITY 512
+
+typedef struct FrameSample
+{
+	float ms[FRAME_PHASE_COUNT]; // Negative when the phase did not run that frame
+} FrameSample;
+
+static FrameSample gSamples[FRAME_TIMING_CAPACITY];
+static FrameSample gGpuSamples[FRAME_TIMING_CAPACITY];
+static FrameSample gCurrent;
+static double gPhaseStart[FRAME_PHASE_COUNT];
+static double gFrameStart, gLastFrameStart;
+static double gBudgetMs = 1000.0 / 60.0;
+
+static atomic_uint gFrameCount;
+static atomic_uint gGpuFrameCount;
+static atomic_uint gDroppedFrames;
+static atomic_uint gOverBudgetFrames;
+
+static const char *gPhaseNames[FRAME_PHASE_COUNT] =
+{
+	"frame",
+	"poll displays",
+	"get frame data",
+	"clear",
+	"update scene",
+	"cull",
+	"draw",
+	"draw left",
+	"draw right",
+	"draw stereo",
+	"submit"
+};
+
+void frameTimingBeginFrame(void)
+{
+	double now = emscripten_get_now();
+
+	if (gLastFrameStart > 0.0)
+	{
+		double interval = now - gLastFrameStart;
+		if (interval > 1.5 * gBudgetMs)
+			atomic_fetch_add_explicit(&gDroppedFrames, (unsigned)(interval / gBudgetMs + 0.5) - 1, memory_order_relaxed);
+	}
+	gLastFrameStart = gFrameStart = now;
+
+	for (int i = 0; i < FRAME_PHASE_COUNT; ++i)
+		gCurrent.ms[i] = -1.0f;
+}
+
+void frameTimingEndFrame(void)
+{
+	float ms = (float)(emscripten_get_now() - gFrameStart);
+	gCurrent.ms[FRAME_PHASE_FRAME] = ms;
+	if (ms > gBudgetMs)
+		atomic_fetch_add_explicit(&gOverBudgetFrames, 1, memory_order_relaxed);
+
+	unsigned count = atomic_load_explicit(&gFrameCount, memory_order_relaxed);
+	gSamples[count % FRAME_TIMING_CAPACITY] = gCurrent;
+	atomic_store_explicit(&gFrameCount, count + 1, memory_order_release);
+}
+
+void frameTimingAddGpuFrame(const float *ms)
+{
+	unsigned count = atomic_load_explicit(&gGpuFrameCount, memory_order_relaxed);
+	memcpy(gGpuSamples[count % FRAME_TIMING_CAPACITY].ms, ms, sizeof(gGpuSamples[0].ms));
+	atomic_store_explicit(&gGpuFrameCount, count + 1, memory_order_release);
+}
+
+void frameTimingBegin(FrameTimingPhase phase)
+{
+	gPhaseStart[phase] = emscripten_get_now();
+}
+
+void frameTimingEnd(FrameTimingPhase phase)
+{
+	gCurrent.ms[phase] = (float)(emscripten_get_now() - gPhaseStart[phase]);
+}
+
+void frameTimingSetBudget(double ms)
+{
+	gBudgetMs = ms;
+}
+
+static int compareFloat(const void *a, const void *b)
+{
+	float x = *(const float *)a, y = *(const float *)b;
+	return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted values
+static float percentileOf(const float *sorted, unsigned n, float percentile)
+{
+	unsigned rank = (unsigned)(percentile / 100.0f * n + 0.999f);
+	if (rank < 1)
+		rank = 1;
+	if (rank > n)
+		rank = n;
+	return sorted[rank - 1];
+}
+
+// Copies the phase's samples from the most recent frames of a ring into
+// values, sorted
+static unsigned collectSorted(const FrameSample *samples, atomic_uint *frameCount, FrameTimingPhase phase,
+	float *values, double *sum)
+{
+	unsigned n = 0;
+	*sum = 0.0;
+
+	// Skip the slot the writer fills next, it may be half written
+	unsigned count = atomic_load_explicit(frameCount, memory_order_acquire);
+	unsigned window = count < FRAME_TIMING_CAPACITY - 1 ? count : FRAME_TIMING_CAPACITY - 1;
+	for (unsigned i = count - window; i != count; ++i)
+	{
+		float ms = samples[i % FRAME_TIMING_CAPACITY].ms[phase];
+		if (ms >= 0.0f)
+		{
+			values[n++] = ms;
+			*sum += ms;
+		}
+	}
+
+	qsort(values, n, sizeof(values[0]), compareFloat);
+	return n;
+}
+
+static int getStats(const FrameSample *samples, atomic_uint *frameCount, FrameTimingPhase phase,
+	FrameTimingStats *stats)
+{
+	float values[FRAME_TIMING_CAPACITY];
+	double sum;
+	unsigned n = collectSorted(samples, frameCount, phase, values, &sum);
+
+	memset(stats, 0, sizeof(*stats));
+	if (n == 0)
+		return 0;
+
+	stats->samples = n;
+	stats->mean = (float)(sum / n);
+	stats->p50 = percentileOf(values, n, 50.0f);
+	stats->p95 = percentileOf(values, n, 95.0f);
+	stats->p99 = percentileOf(values, n, 99.0f);
+	stats->max = values[n - 1];
+	return 1;
+}
+
+EMSCRIPTEN_KEEPALIVE int frameTimingGetStats(FrameTimingPhase phase, FrameTimingStats *stats)
+{
+	return getStats(gSamples, &gFrameCount, phase, stats);
+}
+
+EMSCRIPTEN_KEEPALIVE int frameTimingGetGpuStats(FrameTimingPhase phase, FrameTimingStats *stats)
+{
+	return getStats(gGpuSamples, &gGpuFrameCount, phase, stats);
+}
+
+EMSCRIPTEN_KEEPALIVE float frameTimingPercentile(FrameTimingPhase phase, float percentile)
+{
+	float values[FRAME_TIMING_CAPACITY];
+	double sum;
+	unsigned n = collectSorted(gSamples, &gFrameCount, phase, values, &sum);
+	return n ? percentileOf(values, n, percentile) : 0.0f;
+}
+
+EMSCRIPTEN_KEEPALIVE unsigned frameTimingFrameCount(void)
+{
+	return atomic_load_explicit(&gFrameCount, memory_order_acquire);
+}
+
+EMSCRIPTEN_KEEPALIVE unsigned frameTimingGpuFrameCount(void)
+{
+	return atomic_load_explicit(&gGpuFrameCount, memory_order_acquire);
+}
+
+EMSCRIPTEN_KEEPALIVE unsigned frameTimingDroppedFrames(void)
+{
+	return atomic_load_explicit(&gDroppedFrames, memory_order_relaxed);
+}
+
+EMSCRIPTEN_KEEPALIVE unsigned frameTimingOverBudgetFrames(void)
+{
+	return atomic_load_explicit(&gOverBudgetFrames, memory_order_relaxed);
+}
+
+EMSCRIPTEN_KEEPALIVE const char *frameTimingPhaseName(FrameTimingPhase phase)
+{
+	return phase < FRAME_PHASE_COUNT ? gPhaseNames[phase] : "";
+}
+
+EMSCRIPTEN_KEEPALIVE const char *frameTimingReport(void)
+{
+	static char report[2048];
+	size_t len = 0;
+
+	// CPU rows, then GPU rows for the phases that were timed there
+	len += snprintf(report + len, sizeof(report) - len, "%-19s %7s %7s %7s %7s\n", "ms", "p50", "p95", "p99", "max");
+	for (int gpu = 0; gpu < 2; ++gpu)
+	{
+		for (int i = 0; i < FRAME_PHASE_COUNT; ++i)
+		{
+			FrameTimingStats stats;
+			if (!(gpu ? frameTimingGetGpuStats : frameTimingGetStats)((FrameTimingPhase)i, &stats))
+				continue;
+			len += snprintf(report + len, sizeof(report) - len, "%s%-*s %7.3f %7.3f %7.3f %7.3f\n",
+				gpu ? "gpu " : "", gpu ? 15 : 19, gPhaseNames[i], stats.p50, stats.p95, stats.p99, stats.max);
+			if (len >= sizeof(report))
+				return report;
+		}
+	}
+	len += snprintf(report + len, sizeof(report) - len, "frames %u, dropped %u, over %.1f ms budget %u\n",
+		frameTimingFrameCount(), frameTimingDroppedFrames(), gBudgetMs, frameTimingOverBudgetFrames());
+	if (len < sizeof(report) && frameTimingGpuFrameCount())
+		snprintf(report + len, sizeof(report) - len, "gpu frames %u\n", frameTimingGpuFrameCount());
+	return report;
+}
+
+#endif
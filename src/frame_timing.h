@@ -0,0 +1,92 @@
+// Per-phase CPU frame timing for the render loops.
+//
+// Build with -DFRAME_TIMING (make TIMING=1) to enable it. Without it the
+// FRAME_TIMING_* macros expand to nothing and frame_timing.c is empty, so
+// production builds pay nothing.
+//
+// GPU times of the same phases, measured with timer queries (gpu_timer.h),
+// are kept next to the CPU ones in a ring of their own. They arrive a few
+// frames late and not for every frame, so they are not matched up with the
+// CPU samples of their frame.
+//
+// Samples go into a fixed ring buffer that is written by the render loop only
+// and published with an atomic frame counter, so the query functions can be
+// called from any thread (or from JS) without locking. A reader that falls a
+// whole ring behind the writer sees a mix of old and new frames, which is fine
+// for statistics.
+#ifndef FRAME_TIMING_H
+#define FRAME_TIMING_H
+
+#include <stdio.h>
+
+typedef enum FrameTimingPhase
+{
+	FRAME_PHASE_FRAME,          // Whole loop callback
+	FRAME_PHASE_POLL_DISPLAYS,  // Non-VR: looking for a VR display
+	FRAME_PHASE_GET_FRAME_DATA, // VR: emscripten_vr_get_frame_data
+	FRAME_PHASE_CLEAR,          // Viewport setup and clear
+	FRAME_PHASE_UPDATE_SCENE,   // Animation and world matrices
+	FRAME_PHASE_CULL,           // Frustum culling, once for both eyes in VR
+	FRAME_PHASE_DRAW,           // Non-VR: the single view
+	FRAME_PHASE_DRAW_LEFT,      // VR: left eye
+	FRAME_PHASE_DRAW_RIGHT,     // VR: right eye
+	FRAME_PHASE_DRAW_STEREO,    // VR: both eyes in a single pass
+	FRAME_PHASE_SUBMIT,         // VR: emscripten_vr_submit_frame
+	FRAME_PHASE_COUNT
+} FrameTimingPhase;
+
+typedef struct FrameTimingStats
+{
+	unsigned samples; // Frames in the window that measured this phase
+	float mean, p50, p95, p99, max; // Milliseconds
+} FrameTimingStats;
+
+#ifdef FRAME_TIMING
+
+#define FRAME_TIMING_BEGIN_FRAME() frameTimingBeginFrame()
+#define FRAME_TIMING_END_FRAME() frameTimingEndFrame()
+#define FRAME_TIMING_BEGIN(phase) frameTimingBegin(phase)
+#define FRAME_TIMING_END(phase) frameTimingEnd(phase)
+#define FRAME_TIMING_SET_BUDGET(ms) frameTimingSetBudget(ms)
+
+// Recording, called from the render loop only. A frame that is begun but not
+// ended (e.g. an early return) is discarded by the next begin.
+void frameTimingBeginFrame(void);
+void frameTimingEndFrame(void);
+void frameTimingBegin(FrameTimingPhase phase);
+void frameTimingEnd(FrameTimingPhase phase);
+
+// Frame budget in milliseconds, i.e. the display refresh interval. Frames whose
+// CPU time exceeds it count as over budget, and gaps between frame starts
+// longer than 1.5 budgets count the missed refreshes as dropped frames.
+void frameTimingSetBudget(double ms);
+
+// Adds the GPU times of one frame, in milliseconds by phase, negative for the
+// phases that were not timed. FRAME_PHASE_FRAME is the sum of the others.
+void frameTimingAddGpuFrame(const float *ms);
+
+// Queries over the most recent frames, callable from any thread
+int frameTimingGetStats(FrameTimingPhase phase, FrameTimingStats *stats);
+int frameTimingGetGpuStats(FrameTimingPhase phase, FrameTimingStats *stats);
+float frameTimingPercentile(FrameTimingPhase phase, float percentile);
+unsigned frameTimingFrameCount(void);
+unsigned frameTimingGpuFrameCount(void);
+unsigned frameTimingDroppedFrames(void);
+unsigned frameTimingOverBudgetFrames(void);
+const char *frameTimingPhaseName(FrameTimingPhase phase);
+
+// Human readable summary of all phases, for the page overlay and native runs.
+// Returns a static buffer overwritten by the next call.
+const char *frameTimingReport(void);
+
+#else
+
+#define FRAME_TIMING_BEGIN_FRAME() ((void)0)
+#define FRAME_TIMING_END_FRAME() ((void)0)
+#define FRAME_TIMING_BEGIN(phase) ((void)0)
+#define FRAME_TIMING_END(phase) ((void)0)
+#define FRAME_TIMING_SET_BUDGET(ms) ((void)0)
+
+#endif
+
+#endif
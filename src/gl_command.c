@@ -0,0 +1,225 @@
+#include "gl_command.h"
+
+#ifdef GL_COMMAND_BUFFER
+
+#include <stdint.h>
+#include <string.h>
+
+#define CAPACITY (GL_COMMAND_BUFFER_SIZE / 4)
+
+static uint32_t gCommands[CAPACITY];
+static int gUsed; // Words
+static GLCmdStats gStats;
+
+static uint32_t floatBits(float f)
+{
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+// Returns room for a command of the given number of arguments and data bytes,
+// flushing first if the buffer is too full, or NULL if the command can never
+// fit. The header is filled in, the data words are zero padded.
+static uint32_t *record(GLCmdOp op, int args, long dataBytes)
+{
+	long words = 1 + args + (dataBytes + 3) / 4;
+	if (words > CAPACITY)
+	{
+		glCmdFlush();
+		++gStats.direct;
+		return NULL;
+	}
+	if (gUsed + words > CAPACITY)
+		glCmdFlush();
+
+	uint32_t *command = gCommands + gUsed;
+	command[0] = GL_CMD_HEADER(op, words);
+	if (dataBytes & 3)
+		command[words - 1] = 0;
+	gUsed += (int)words;
+	++gStats.commands;
+	return command;
+}
+
+void glCmdFlush(void)
+{
+	if (!gUsed)
+		return;
+	int bytes = gUsed * 4;
+	// Reset first, so the replay could record again
+	gUsed = 0;
+	++gStats.flushes;
+	gStats.bytes += bytes;
+	glCmdReplay(gCommands, bytes);
+}
+
+void glCmdStats(GLCmdStats *stats)
+{
+	*stats = gStats;
+}
+
+void glCmdUseProgram(GLuint program)
+{
+	uint32_t *c = record(GL_CMD_USE_PROGRAM, 1, 0);
+	c[1] = program;
+}
+
+void glCmdBindBuffer(GLenum target, GLuint buffer)
+{
+	uint32_t *c = record(GL_CMD_BIND_BUFFER, 2, 0);
+	c[1] = target;
+	c[2] = buffer;
+}
+
+void glCmdBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+	uint32_t *c = record(GL_CMD_BUFFER_DATA, 4, data ? size : 0);
+	if (!c)
+	{
+		glBufferData(target, size, data, usage);
+		return;
+	}
+	c[1] = target;
+	c[2] = (uint32_t)size;
+	c[3] = usage;
+	c[4] = data != NULL;
+	if (data)
+		memcpy(c + 5, data, size);
+}
+
+void glCmdBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+{
+	uint32_t *c = record(GL_CMD_BUFFER_SUB_DATA, 3, size);
+	if (!c)
+	{
+		glBufferSubData(target, offset, size, data);
+		return;
+	}
+	c[1] = target;
+	c[2] = (uint32_t)offset;
+	c[3] = (uint32_t)size;
+	memcpy(c + 4, data, size);
+}
+
+void glCmdClear(GLbitfield mask)
+{
+	uint32_t *c = record(GL_CMD_CLEAR, 1, 0);
+	c[1] = mask;
+}
+
+void glCmdClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	uint32_t *c = record(GL_CMD_CLEAR_COLOR, 4, 0);
+	c[1] = floatBits(red);
+	c[2] = floatBits(green);
+	c[3] = floatBits(blue);
+	c[4] = floatBits(alpha);
+}
+
+void glCmdViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	uint32_t *c = record(GL_CMD_VIEWPORT, 4, 0);
+	c[1] = (uint32_t)x;
+	c[2] = (uint32_t)y;
+	c[3] = (uint32_t)width;
+	c[4] = (uint32_t)height;
+}
+
+void glCmdEnableVertexAttribArray(GLuint index)
+{
+	uint32_t *c = record(GL_CMD_ENABLE_VERTEX_ATTRIB_ARRAY, 1, 0);
+	c[1] = index;
+}
+
+void glCmdDisableVertexAttribArray(GLuint index)
+{
+	uint32_t *c = record(GL_CMD_DISABLE_VERTEX_ATTRIB_ARRAY, 1, 0);
+	c[1] = index;
+}
+
+void glCmdVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer)
+{
+	uint32_t *c = record(GL_CMD_VERTEX_ATTRIB_POINTER, 6, 0);
+	c[1] = index;
+	c[2] = (uint32_t)size;
+	c[3] = type;
+	c[4] = normalized;
+	c[5] = (uint32_t)stride;
+	c[6] = (uint32_t)(uintptr_t)pointer;
+}
+
+void glCmdVertexAttribDivisor(GLuint index, GLuint divisor)
+{
+	uint32_t *c = record(GL_CMD_VERTEX_ATTRIB_DIVISOR, 2, 0);
+	c[1] = index;
+	c[2] = divisor;
+}
+
+void glCmdUniform2fv(GLint location, GLsizei count, const GLfloat *value)
+{
+	uint32_t *c = record(GL_CMD_UNIFORM_2FV, 2, 2 * count * sizeof(GLfloat));
+	if (!c)
+	{
+		glUniform2fv(location, count, value);
+		return;
+	}
+	c[1] = (uint32_t)location;
+	c[2] = (uint32_t)count;
+	memcpy(c + 3, value, 2 * count * sizeof(GLfloat));
+}
+
+void glCmdUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+	uint32_t *c = record(GL_CMD_UNIFORM_MATRIX_4FV, 3, 16 * count * sizeof(GLfloat));
+	if (!c)
+	{
+		glUniformMatrix4fv(location, count, transpose, value);
+		return;
+	}
+	c[1] = (uint32_t)location;
+	c[2] = (uint32_t)count;
+	c[3] = transpose;
+	memcpy(c + 4, value, 16 * count * sizeof(GLfloat));
+}
+
+void glCmdDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	uint32_t *c = record(GL_CMD_DRAW_ARRAYS, 3, 0);
+	c[1] = mode;
+	c[2] = (uint32_t)first;
+	c[3] = (uint32_t)count;
+}
+
+void glCmdDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei primcount)
+{
+	uint32_t *c = record(GL_CMD_DRAW_ARRAYS_INSTANCED, 4, 0);
+	c[1] = mode;
+	c[2] = (uint32_t)first;
+	c[3] = (uint32_t)count;
+	c[4] = (uint32_t)primcount;
+}
+
+void glCmdDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+{
+	uint32_t *c = record(GL_CMD_DRAW_ELEMENTS, 4, 0);
+	c[1] = mode;
+	c[2] = (uint32_t)count;
+	c[3] = type;
+	c[4] = (uint32_t)(uintptr_t)indices;
+}
+
+void glCmdBeginQuery(GLenum target, GLuint id)
+{
+	uint32_t *c = record(GL_CMD_BEGIN_QUERY, 2, 0);
+	c[1] = target;
+	c[2] = id;
+}
+
+void glCmdEndQuery(GLenum target)
+{
+	uint32_t *c = record(GL_CMD_END_QUERY, 1, 0);
+	c[1] = target;
+}
+
+#endif
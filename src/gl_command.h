@@ -0,0 +1,129 @@
+// GL command buffer.
+//
+// With GL_COMMAND_BUFFER defined (make COMMAND_BUFFER=1) the per-frame GL
+// calls are not made one by one: each glCmd* call appends a compact command
+// to a linear buffer in wasm memory, and glCmdFlush hands the whole buffer to
+// a decoder on the JavaScript side (gl_command.js) in a single call. Under
+// emscripten every GL call is a trampoline from wasm into JavaScript, so a
+// frame of thousands of draws crosses the boundary a handful of times instead
+// of thousands. Without GL_COMMAND_BUFFER the glCmd* names are the plain GL
+// calls and nothing is recorded.
+//
+// Only calls without results are recorded. Object creation, queries and
+// shader building stay direct; they do not depend on recorded state, except
+// for deletions, which flush first. Timer queries are begun and ended in the
+// buffer, around the draws they time, and their results read directly.
+// Everything recorded has to be flushed before the frame ends, the frame
+// loops flush once per eye.
+#ifndef GL_COMMAND_H
+#define GL_COMMAND_H
+
+#include <GLES2/gl2.h>
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GLES2/gl2ext.h>
+
+// Every command is a header word, (total words << 8) | opcode, followed by
+// its arguments as 32-bit words. Data arguments (buffer contents, uniform
+// values) are copied inline, padded to whole words. Keep the opcodes in sync
+// with gl_command.js.
+typedef enum GLCmdOp
+{
+	GL_CMD_USE_PROGRAM = 1,                // program
+	GL_CMD_BIND_BUFFER,                    // target, buffer
+	GL_CMD_BUFFER_DATA,                    // target, size, usage, has data, data
+	GL_CMD_BUFFER_SUB_DATA,                // target, offset, size, data
+	GL_CMD_CLEAR,                          // mask
+	GL_CMD_CLEAR_COLOR,                    // red, green, blue, alpha
+	GL_CMD_VIEWPORT,                       // x, y, width, height
+	GL_CMD_ENABLE_VERTEX_ATTRIB_ARRAY,     // index
+	GL_CMD_DISABLE_VERTEX_ATTRIB_ARRAY,    // index
+	GL_CMD_VERTEX_ATTRIB_POINTER,          // index, size, type, normalized, stride, offset
+	GL_CMD_VERTEX_ATTRIB_DIVISOR,          // index, divisor
+	GL_CMD_UNIFORM_2FV,                    // location, count, values
+	GL_CMD_UNIFORM_MATRIX_4FV,             // location, count, transpose, values
+	GL_CMD_DRAW_ARRAYS,                    // mode, first, count
+	GL_CMD_DRAW_ARRAYS_INSTANCED,          // mode, first, count, primcount
+	GL_CMD_DRAW_ELEMENTS,                  // mode, count, type, offset
+	GL_CMD_BEGIN_QUERY,                    // target, query
+	GL_CMD_END_QUERY,                      // target
+	GL_CMD_OP_COUNT
+} GLCmdOp;
+
+#define GL_CMD_HEADER(op, words) ((unsigned)(words) << 8 | (unsigned)(op))
+#define GL_CMD_OP(header) ((GLCmdOp)((header) & 0xff))
+#define GL_CMD_WORDS(header) ((int)((header) >> 8))
+
+// Bytes recorded before the buffer is flushed on its own. Commands bigger
+// than that (large buffer uploads) are made directly after a flush.
+#ifndef GL_COMMAND_BUFFER_SIZE
+#define GL_COMMAND_BUFFER_SIZE (256 * 1024)
+#endif
+
+typedef struct GLCmdStats
+{
+	unsigned long commands; // Recorded
+	unsigned long direct;   // Too big to record, made directly
+	unsigned long flushes;  // Non-empty flushes, each one call into the decoder
+	unsigned long long bytes;
+} GLCmdStats;
+
+// Decodes and executes size bytes of commands. Implemented by the platform:
+// gl_command.js under emscripten, the GL stub in the native build.
+void glCmdReplay(const void *commands, int size);
+
+#ifdef GL_COMMAND_BUFFER
+
+// Executes and empties the buffer
+void glCmdFlush(void);
+
+void glCmdStats(GLCmdStats *stats);
+
+void glCmdUseProgram(GLuint program);
+void glCmdBindBuffer(GLenum target, GLuint buffer);
+void glCmdBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+void glCmdBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data);
+void glCmdClear(GLbitfield mask);
+void glCmdClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+void glCmdViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void glCmdEnableVertexAttribArray(GLuint index);
+void glCmdDisableVertexAttribArray(GLuint index);
+// pointer is an offset into the bound array buffer, client arrays are not supported
+void glCmdVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+void glCmdVertexAttribDivisor(GLuint index, GLuint divisor);
+void glCmdUniform2fv(GLint location, GLsizei count, const GLfloat *value);
+void glCmdUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
+void glCmdDrawArrays(GLenum mode, GLint first, GLsizei count);
+void glCmdDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei primcount);
+// indices is an offset into the bound element array buffer, client arrays are not supported
+void glCmdDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices);
+void glCmdBeginQuery(GLenum target, GLuint id);
+void glCmdEndQuery(GLenum target);
+
+#else
+
+#define glCmdFlush() ((void)0)
+
+#define glCmdUseProgram glUseProgram
+#define glCmdBindBuffer glBindBuffer
+#define glCmdBufferData glBufferData
+#define glCmdBufferSubData glBufferSubData
+#define glCmdClear glClear
+#define glCmdClearColor glClearColor
+#define glCmdViewport glViewport
+#define glCmdEnableVertexAttribArray glEnableVertexAttribArray
+#define glCmdDisableVertexAttribArray glDisableVertexAttribArray
+#define glCmdVertexAttribPointer glVertexAttribPointer
+#define glCmdVertexAttribDivisor glVertexAttribDivisorANGLE
+#define glCmdUniform2fv glUniform2fv
+#define glCmdUniformMatrix4fv glUniformMatrix4fv
+#define glCmdDrawArrays glDrawArrays
+#define glCmdDrawArraysInstanced glDrawArraysInstancedANGLE
+#define glCmdDrawElements glDrawElements
+#define glCmdBeginQuery glBeginQueryEXT
+#define glCmdEndQuery glEndQueryEXT
+
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+// JavaScript side of the GL command buffer (gl_command.h), linked in with
+// --js-library. glCmdReplay walks the recorded commands in wasm memory and
+// makes each GL call from JavaScript, through emscripten's own GL bindings so
+// object names and uniform locations are translated as usual. Inline data is
+// passed by address, the bindings read it straight from the heap.
+//
+// The opcodes have to match GLCmdOp in gl_command.h.
+mergeInto(LibraryManager.library, {
+	glCmdReplay__deps: ['glUseProgram', 'glBindBuffer', 'glBufferData', 'glBufferSubData', 'glClear', 'glClearColor',
+		'glViewport', 'glEnableVertexAttribArray', 'glDisableVertexAttribArray', 'glVertexAttribPointer',
+		'glVertexAttribDivisorANGLE', 'glUniform2fv', 'glUniformMatrix4fv', 'glDrawArrays', 'glDrawArraysInstancedANGLE',
+		'glDrawElements', 'glBeginQueryEXT', 'glEndQueryEXT'],
+	glCmdReplay: function(commands, size) {
+		var p = commands >> 2;
+		var end = p + (size >> 2);
+		while (p < end) {
+			var header = HEAPU32[p];
+			switch (header & 0xff) {
+			case 1: _glUseProgram(HEAPU32[p + 1]); break;
+			case 2: _glBindBuffer(HEAPU32[p + 1], HEAPU32[p + 2]); break;
+			case 3: _glBufferData(HEAPU32[p + 1], HEAPU32[p + 2], HEAPU32[p + 4] ? (p + 5) << 2 : 0, HEAPU32[p + 3]); break;
+			case 4: _glBufferSubData(HEAPU32[p + 1], HEAPU32[p + 2], HEAPU32[p + 3], (p + 4) << 2); break;
+			case 5: _glClear(HEAPU32[p + 1]); break;
+			case 6: _glClearColor(HEAPF32[p + 1], HEAPF32[p + 2], HEAPF32[p + 3], HEAPF32[p + 4]); break;
+			case 7: _glViewport(HEAP32[p + 1], HEAP32[p + 2], HEAP32[p + 3], HEAP32[p + 4]); break;
+			case 8: _glEnableVertexAttribArray(HEAPU32[p + 1]); break;
+			case 9: _glDisableVertexAttribArray(HEAPU32[p + 1]); break;
+			case 10: _glVertexAttribPointer(HEAPU32[p + 1], HEAP32[p + 2], HEAPU32[p + 3], HEAPU32[p + 4], HEAP32[p + 5], HEAPU32[p + 6]); break;
+			case 11: _glVertexAttribDivisorANGLE(HEAPU32[p + 1], HEAPU32[p + 2]); break;
+			case 12: _glUniform2fv(HEAP32[p + 1], HEAP32[p + 2], (p + 3) << 2); break;
+			case 13: _glUniformMatrix4fv(HEAP32[p + 1], HEAP32[p + 2], HEAPU32[p + 3], (p + 4) << 2); break;
+			case 14: _glDrawArrays(HEAPU32[p + 1], HEAP32[p + 2], HEAP32[p + 3]); break;
+			case 15: _glDrawArraysInstancedANGLE(HEAPU32[p + 1], HEAP32[p + 2], HEAP32[p + 3], HEAP32[p + 4]); break;
+			case 16: _glDrawElements(HEAPU32[p + 1], HEAP32[p + 2], HEAPU32[p + 3], HEAPU32[p + 4]); break;
+			case 17: _glBeginQueryEXT(HEAPU32[p + 1], HEAPU32[p + 2]); break;
+			case 18: _glEndQueryEXT(HEAPU32[p + 1]); break;
+			default: throw 'Malformed GL command buffer at byte ' + ((p << 2) - commands);
+			}
+			p += header >>> 8;
+		}
+	}
+});
@@ -0,0 +1,270 @@
+#include "gl_state.h"
+
+#include "gl_command.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define MAX_ATTRIBS 16
+#define MAX_UNIFORMS 32
+#define MAX_UNIFORM_FLOATS 16
+
+typedef struct AttribState
+{
+	int enabledValid, enabled;
+	int divisorValid;
+	GLuint divisor;
+	int pointerValid;
+	GLuint buffer;
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	GLsizei stride;
+	const void *pointer;
+} AttribState;
+
+typedef struct UniformState
+{
+	GLuint program;
+	GLint location;
+	GLenum kind; // GL_FLOAT_VEC2 or GL_FLOAT_MAT4
+	int floats;
+	GLfloat value[MAX_UNIFORM_FLOATS];
+} UniformState;
+
+static struct
+{
+	int programValid;
+	GLuint program;
+	int arrayBufferValid, elementBufferValid;
+	GLuint arrayBuffer, elementBuffer;
+	int viewportValid;
+	GLint viewport[4];
+	int clearColorValid;
+	GLfloat clearColor[4];
+	AttribState attribs[MAX_ATTRIBS];
+	UniformState uniforms[MAX_UNIFORMS];
+	int uniformCount;
+} gState;
+
+static GLStateStats gFrame, gLastFrame, gTotal;
+
+// Counts the call and returns whether it has to be issued
+static int issue(int redundant)
+{
+	if (redundant)
+	{
+		++gFrame.elided;
+		++gTotal.elided;
+		return 0;
+	}
+	++gFrame.issued;
+	++gTotal.issued;
+	return 1;
+}
+
+void glStateReset(void)
+{
+	memset(&gState, 0, sizeof(gState));
+}
+
+void glStateBeginFrame(void)
+{
+	gLastFrame = gFrame;
+	memset(&gFrame, 0, sizeof(gFrame));
+}
+
+void glStateFrameStats(GLStateStats *stats)
+{
+	*stats = gLastFrame;
+}
+
+void glStateTotalStats(GLStateStats *stats)
+{
+	*stats = gTotal;
+}
+
+void glStateUseProgram(GLuint program)
+{
+	if (!issue(gState.programValid && gState.program == program))
+		return;
+	gState.programValid = 1;
+	gState.program = program;
+	glCmdUseProgram(program);
+}
+
+void glStateBindBuffer(GLenum target, GLuint buffer)
+{
+	int *valid = target == GL_ARRAY_BUFFER ? &gState.arrayBufferValid : &gState.elementBufferValid;
+	GLuint *bound = target == GL_ARRAY_BUFFER ? &gState.arrayBuffer : &gState.elementBuffer;
+	if (!issue(*valid && *bound == buffer))
+		return;
+	*valid = 1;
+	*bound = buffer;
+	glCmdBindBuffer(target, buffer);
+}
+
+void glStateViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint viewport[4] = {x, y, width, height};
+	if (!issue(gState.viewportValid && memcmp(gState.viewport, viewport, sizeof(viewport)) == 0))
+		return;
+	gState.viewportValid = 1;
+	memcpy(gState.viewport, viewport, sizeof(viewport));
+	glCmdViewport(x, y, width, height);
+}
+
+void glStateClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	GLfloat color[4] = {red, green, blue, alpha};
+	if (!issue(gState.clearColorValid && memcmp(gState.clearColor, color, sizeof(color)) == 0))
+		return;
+	gState.clearColorValid = 1;
+	memcpy(gState.clearColor, color, sizeof(color));
+	glCmdClearColor(red, green, blue, alpha);
+}
+
+static void setAttribEnabled(GLuint index, int enabled)
+{
+	AttribState *a = index < MAX_ATTRIBS ? &gState.attribs[index] : NULL;
+	if (!issue(a && a->enabledValid && a->enabled == enabled))
+		return;
+	if (a)
+	{
+		a->enabledValid = 1;
+		a->enabled = enabled;
+	}
+	if (enabled)
+		glCmdEnableVertexAttribArray(index);
+	else
+		glCmdDisableVertexAttribArray(index);
+}
+
+void glStateEnableVertexAttribArray(GLuint index)
+{
+	setAttribEnabled(index, 1);
+}
+
+void glStateDisableVertexAttribArray(GLuint index)
+{
+	setAttribEnabled(index, 0);
+}
+
+void glStateVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer)
+{
+	AttribState *a = index < MAX_ATTRIBS ? &gState.attribs[index] : NULL;
+	// An unknown array buffer binding makes the pointer unknown too
+	int known = a && gState.arrayBufferValid;
+	if (!issue(known && a->pointerValid && a->buffer == gState.arrayBuffer && a->size == size && a->type == type
+		&& a->normalized == normalized && a->stride == stride && a->pointer == pointer))
+		return;
+	if (a)
+	{
+		a->pointerValid = known;
+		a->buffer = gState.arrayBuffer;
+		a->size = size;
+		a->type = type;
+		a->normalized = normalized;
+		a->stride = stride;
+		a->pointer = pointer;
+	}
+	glCmdVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void glStateVertexAttribDivisor(GLuint index, GLuint divisor)
+{
+	AttribState *a = index < MAX_ATTRIBS ? &gState.attribs[index] : NULL;
+	if (!issue(a && a->divisorValid && a->divisor == divisor))
+		return;
+	if (a)
+	{
+		a->divisorValid = 1;
+		a->divisor = divisor;
+	}
+	glCmdVertexAttribDivisor(index, divisor);
+}
+
+// Returns 1 if the uniform of the current program already holds value,
+// otherwise remembers value for it (if there is room) and returns 0
+static int uniformUnchanged(GLint location, GLenum kind, int floats, const GLfloat *value)
+{
+	if (!gState.programValid || floats > MAX_UNIFORM_FLOATS)
+		return 0;
+
+	UniformState *u = NULL;
+	for (int i = 0; i < gState.uniformCount; ++i)
+	{
+		if (gState.uniforms[i].program == gState.program && gState.uniforms[i].location == location)
+		{
+			u = &gState.uniforms[i];
+			break;
+		}
+	}
+	if (u && u->kind == kind && u->floats == floats && memcmp(u->value, value, floats * sizeof(GLfloat)) == 0)
+		return 1;
+
+	if (!u)
+	{
+		if (gState.uniformCount == MAX_UNIFORMS)
+			return 0;
+		u = &gState.uniforms[gState.uniformCount++];
+		u->program = gState.program;
+		u->location = location;
+	}
+	u->kind = kind;
+	u->floats = floats;
+	memcpy(u->value, value, floats * sizeof(GLfloat));
+	return 0;
+}
+
+void glStateUniform2fv(GLint location, GLsizei count, const GLfloat *value)
+{
+	// Location -1 is silently ignored by GL
+	if (!issue(location == -1 || uniformUnchanged(location, GL_FLOAT_VEC2, 2 * count, value)))
+		return;
+	glCmdUniform2fv(location, count, value);
+}
+
+void glStateUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+	// The cache only compares values, so a transposed upload would look the same
+	assert(transpose == GL_FALSE);
+	if (!issue(location == -1 || uniformUnchanged(location, GL_FLOAT_MAT4, 16 * count, value)))
+		return;
+	glCmdUniformMatrix4fv(location, count, transpose, value);
+}
+
+void glStateDeleteBuffers(GLsizei n, const GLuint *buffers)
+{
+	for (GLsizei i = 0; i < n; ++i)
+	{
+		// Deleted names can be handed out again, so nothing cached may
+		// refer to them
+		if (gState.arrayBuffer == buffers[i])
+			gState.arrayBufferValid = 0;
+		if (gState.elementBuffer == buffers[i])
+			gState.elementBufferValid = 0;
+		for (int a = 0; a < MAX_ATTRIBS; ++a)
+		{
+			if (gState.attribs[a].buffer == buffers[i])
+				gState.attribs[a].pointerValid = 0;
+		}
+	}
+	glCmdFlush();
+	glDeleteBuffers(n, buffers);
+}
+
+void glStateDeleteProgram(GLuint program)
+{
+	int kept = 0;
+	for (int i = 0; i < gState.uniformCount; ++i)
+	{
+		if (gState.uniforms[i].program != program)
+			gState.uniforms[kept++] = gState.uniforms[i];
+	}
+	gState.uniformCount = kept;
+	if (gState.program == program)
+		gState.programValid = 0;
+	glCmdFlush();
+	glDeleteProgram(program);
+}
@@ -0,0 +1,51 @@
+// GL state cache.
+//
+// Drop-in wrappers for the state setting GL calls of the render loop that
+// remember what was last set and skip calls that would not change anything.
+// Under emscripten every GL call crosses from wasm into JavaScript and WebGL
+// validates it, so a call that is not made is the cheapest one.
+//
+// The cache only knows about state set through it: code that changes the
+// same state with plain GL calls has to call glStateReset afterwards.
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <GLES2/gl2.h>
+
+typedef struct GLStateStats
+{
+	unsigned long issued, elided;
+} GLStateStats;
+
+// Forgets all cached state, so the next call of each kind is issued
+void glStateReset(void);
+
+// Starts a new frame for the per-frame counters
+void glStateBeginFrame(void);
+
+// Calls issued to GL and elided in the last complete frame, or since startup
+void glStateFrameStats(GLStateStats *stats);
+void glStateTotalStats(GLStateStats *stats);
+
+void glStateUseProgram(GLuint program);
+void glStateBindBuffer(GLenum target, GLuint buffer);
+void glStateViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void glStateClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+
+void glStateEnableVertexAttribArray(GLuint index);
+void glStateDisableVertexAttribArray(GLuint index);
+// The pointer is cached together with the GL_ARRAY_BUFFER bound at the time
+void glStateVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+// glVertexAttribDivisorANGLE
+void glStateVertexAttribDivisor(GLuint index, GLuint divisor);
+
+// Uniform values are cached per program and location. Matrices have to be
+// passed with transpose GL_FALSE, the only value WebGL1 accepts.
+void glStateUniform2fv(GLint location, GLsizei count, const GLfloat *value);
+void glStateUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
+
+// Delete objects and drop them from the cache, their names may be reused
+void glStateDeleteBuffers(GLsizei n, const GLuint *buffers);
+void glStateDeleteProgram(GLuint program);
+
+#endif
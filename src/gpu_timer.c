@@ -0,0 +1,156 @@
+#include "gpu_timer.h"
+
+#ifdef GPU_TIMING
+
+#include "gl_command.h"
+
+#include <string.h>
+
+typedef struct GpuTimerFrame
+{
+	GLuint queries[FRAME_PHASE_COUNT];
+	unsigned char ended[FRAME_PHASE_COUNT];
+	unsigned long begun; // Frame number, for the latency
+} GpuTimerFrame;
+
+static GpuTimerFrame gFrames[GPU_TIMER_FRAMES];
+static unsigned long gHead, gTail; // Frames begun and frames done with, gTail <= gHead
+static unsigned long gFrameNumber;
+static int gEnabled;
+static int gTiming; // The current frame is timed
+static int gActive = -1; // Phase whose query is running
+static double gFrameMs = -1.0;
+static GpuTimerStats gStats;
+
+void gpuTimerInit(int available)
+{
+	gEnabled = available;
+	if (!gEnabled)
+		return;
+	for (int i = 0; i < GPU_TIMER_FRAMES; ++i)
+		glGenQueriesEXT(FRAME_PHASE_COUNT, gFrames[i].queries);
+}
+
+void gpuTimerFree(void)
+{
+	if (!gEnabled)
+		return;
+	// Nothing may be running when a query is deleted
+	if (gActive >= 0)
+		gpuTimerEnd((FrameTimingPhase)gActive);
+	glCmdFlush();
+	for (int i = 0; i < GPU_TIMER_FRAMES; ++i)
+		glDeleteQueriesEXT(FRAME_PHASE_COUNT, gFrames[i].queries);
+	gEnabled = gTiming = 0;
+	gHead = gTail = 0;
+}
+
+// Returns 1 once every query the frame ended has its result
+static int available(const GpuTimerFrame *frame)
+{
+	for (int i = 0; i < FRAME_PHASE_COUNT; ++i)
+	{
+		if (!frame->ended[i])
+			continue;
+		GLuint done = 0;
+		glGetQueryObjectuivEXT(frame->queries[i], GL_QUERY_RESULT_AVAILABLE_EXT, &done);
+		if (!done)
+			return 0;
+	}
+	return 1;
+}
+
+static void readBack(const GpuTimerFrame *frame)
+{
+	float ms[FRAME_PHASE_COUNT];
+	double total = 0.0;
+	int timed = 0;
+	for (int i = 0; i < FRAME_PHASE_COUNT; ++i)
+	{
+		ms[i] = -1.0f;
+		if (!frame->ended[i] || i == FRAME_PHASE_FRAME)
+			continue;
+		GLuint64 ns = 0;
+		glGetQueryObjectui64vEXT(frame->queries[i], GL_QUERY_RESULT_EXT, &ns);
+		ms[i] = (float)(ns / 1e6);
+		total += ms[i];
+		timed = 1;
+	}
+	// A frame that drew nothing, like one that returned early
+	if (!timed)
+		return;
+
+	ms[FRAME_PHASE_FRAME] = (float)total;
+	frameTimingAddGpuFrame(ms);
+	gFrameMs = total;
+	++gStats.frames;
+	gStats.latencyFrames += gFrameNumber - frame->begun;
+}
+
+void gpuTimerBeginFrame(void)
+{
+	++gFrameNumber;
+	if (!gEnabled)
+		return;
+	if (gActive >= 0)
+		gpuTimerEnd((FrameTimingPhase)gActive);
+
+	// Availability first: the disjoint flag then also covers whatever became
+	// available in the meantime
+	unsigned long ready = gTail;
+	while (ready != gHead && available(&gFrames[ready % GPU_TIMER_FRAMES]))
+		++ready;
+
+	GLint disjoint = 0;
+	glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+	if (disjoint)
+	{
+		gStats.disjointFrames += gHead - gTail;
+		gTail = gHead;
+	}
+	for (; gTail < ready && gTail < gHead; ++gTail)
+		readBack(&gFrames[gTail % GPU_TIMER_FRAMES]);
+
+	gTiming = gHead - gTail < GPU_TIMER_FRAMES;
+	if (!gTiming)
+	{
+		++gStats.skippedFrames;
+		return;
+	}
+	GpuTimerFrame *frame = &gFrames[gHead++ % GPU_TIMER_FRAMES];
+	memset(frame->ended, 0, sizeof(frame->ended));
+	frame->begun = gFrameNumber;
+}
+
+void gpuTimerBegin(FrameTimingPhase phase)
+{
+	if (!gTiming || gActive >= 0)
+		return;
+	GpuTimerFrame *frame = &gFrames[(gHead - 1) % GPU_TIMER_FRAMES];
+	if (frame->ended[phase])
+		return;
+	glCmdBeginQuery(GL_TIME_ELAPSED_EXT, frame->queries[phase]);
+	gActive = phase;
+}
+
+void gpuTimerEnd(FrameTimingPhase phase)
+{
+	if (gActive != (int)phase)
+		return;
+	glCmdEndQuery(GL_TIME_ELAPSED_EXT);
+	gFrames[(gHead - 1) % GPU_TIMER_FRAMES].ended[phase] = 1;
+	gActive = -1;
+	++gStats.queries;
+}
+
+double gpuTimerFrameMs(void)
+{
+	return gFrameMs;
+}
+
+void gpuTimerStats(GpuTimerStats *stats)
+{
+	*stats = gStats;
+}
+
+#endif
@@ -0,0 +1,77 @@
+// GPU time of the render passes, from EXT_disjoint_timer_query.
+//
+// Build with -DGPU_TIMING (make GPU_TIMING=1, which also builds in the CPU
+// timers of frame_timing.h) to enable it. Without it the GPU_TIMING_* macros
+// expand to nothing and gpu_timer.c is empty.
+//
+// Every phase the loops wrap in GPU_TIMING_BEGIN/END (the clear and the draw
+// passes, one per eye without single pass stereo) is a GL_TIME_ELAPSED_EXT
+// query. The query objects are created once, a set per frame for a ring of
+// GPU_TIMER_FRAMES frames. Results are only looked at when a new frame
+// begins, oldest frame first, and only read once GL_QUERY_RESULT_AVAILABLE_EXT
+// reports them, so the CPU never waits for the GPU: they come in a few frames
+// late. If the oldest frame is still pending when the ring is full, the new
+// frame goes untimed. When GL_GPU_DISJOINT_EXT reports that the GPU timer was
+// disturbed (a clock change, a context switch), all results not read yet are
+// dropped.
+//
+// Complete frames are handed to frame_timing (frameTimingAddGpuFrame), so
+// their statistics come from the same API as the CPU ones and show up in its
+// report.
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "frame_timing.h"
+
+// Frames in flight, 1 being timed and up to 3 waiting for the GPU
+#define GPU_TIMER_FRAMES 4
+
+typedef struct GpuTimerStats
+{
+	unsigned long queries;        // Ended
+	unsigned long frames;         // Timed and read back
+	unsigned long skippedFrames;  // Not timed, the ring was full of pending frames
+	unsigned long disjointFrames; // Dropped by a disjoint
+	unsigned long latencyFrames;  // Sum over the frames read back of the frames they took
+} GpuTimerStats;
+
+#ifdef GPU_TIMING
+
+#ifndef FRAME_TIMING
+#error "GPU_TIMING needs FRAME_TIMING"
+#endif
+
+#define GPU_TIMING_BEGIN_FRAME() gpuTimerBeginFrame()
+#define GPU_TIMING_BEGIN(phase) gpuTimerBegin(phase)
+#define GPU_TIMING_END(phase) gpuTimerEnd(phase)
+#define GPU_TIMING_FRAME_MS() gpuTimerFrameMs()
+
+// Creates the queries if available, the result of enabling
+// EXT_disjoint_timer_query. Otherwise nothing is ever timed.
+void gpuTimerInit(int available);
+void gpuTimerFree(void);
+
+// Reads back what the GPU has finished and starts timing a new frame
+void gpuTimerBeginFrame(void);
+
+// Times a phase, recorded through gl_command.h like the draws it wraps.
+// Phases cannot nest and each is timed at most once per frame.
+void gpuTimerBegin(FrameTimingPhase phase);
+void gpuTimerEnd(FrameTimingPhase phase);
+
+// GPU time of the most recent frame read back, summed over its phases, or a
+// negative value before the first one
+double gpuTimerFrameMs(void);
+
+void gpuTimerStats(GpuTimerStats *stats);
+
+#else
+
+#define GPU_TIMING_BEGIN_FRAME() ((void)0)
+#define GPU_TIMING_BEGIN(phase) ((void)0)
+#define GPU_TIMING_END(phase) ((void)0)
+#define GPU_TIMING_FRAME_MS() (-1.0)
+
+#endif
+
+#endif
@@ -0,0 +1,236 @@
+#include "jobs.h"
+
+#ifdef JOBS_THREADS
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+#ifdef __EMSCRIPTEN__
+#include <emscripten/threading.h>
+#endif
+
+// Upper bound for worker threads besides the calling thread. Under emscripten
+// keep it at or below PTHREAD_POOL_SIZE, or thread creation blocks.
+#ifndef JOBS_MAX_WORKERS
+#define JOBS_MAX_WORKERS 63
+#endif
+
+// Per-thread deque capacity, a power of two
+#define JOBS_QUEUE_SIZE 256
+
+typedef struct Job
+{
+	JobRangeFunc func;
+	void *userData;
+	int first, count;
+} Job;
+
+// Each thread owns a deque: the owner pushes and pops at the bottom, other
+// threads steal from the top. A mutex per deque keeps this simple; contention
+// is low since each deque is mostly touched by its owner.
+typedef struct JobQueue
+{
+	pthread_mutex_t lock;
+	unsigned top, bottom;
+	Job jobs[JOBS_QUEUE_SIZE];
+} JobQueue;
+
+static JobQueue gQueues[JOBS_MAX_WORKERS + 1]; // Index 0 belongs to the calling thread
+static pthread_t gThreads[JOBS_MAX_WORKERS];
+static int gThreadCount = 1;
+
+// Sleeping workers wait for gQueued to change
+static pthread_mutex_t gWakeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gWake = PTHREAD_COND_INITIALIZER;
+static atomic_int gQueued;    // Jobs pushed and not yet taken
+static atomic_int gRemaining; // Jobs of the running parallel-for not yet finished
+static atomic_int gShutdown;
+
+static int push(JobQueue *q, const Job *job)
+{
+	pthread_mutex_lock(&q->lock);
+	int ok = q->bottom - q->top < JOBS_QUEUE_SIZE;
+	if (ok)
+		q->jobs[q->bottom++ % JOBS_QUEUE_SIZE] = *job;
+	pthread_mutex_unlock(&q->lock);
+	return ok;
+}
+
+static int popBottom(JobQueue *q, Job *job)
+{
+	pthread_mutex_lock(&q->lock);
+	int ok = q->bottom != q->top;
+	if (ok)
+		*job = q->jobs[--q->bottom % JOBS_QUEUE_SIZE];
+	pthread_mutex_unlock(&q->lock);
+	return ok;
+}
+
+static int stealTop(JobQueue *q, Job *job)
+{
+	pthread_mutex_lock(&q->lock);
+	int ok = q->bottom != q->top;
+	if (ok)
+		*job = q->jobs[q->top++ % JOBS_QUEUE_SIZE];
+	pthread_mutex_unlock(&q->lock);
+	return ok;
+}
+
+// Takes a job from the thread's own deque, or steals one from another thread
+static int take(int self, Job *job)
+{
+	if (atomic_load_explicit(&gQueued, memory_order_acquire) == 0)
+		return 0;
+
+	int ok = popBottom(&gQueues[self], job);
+	for (int i = 1; !ok && i < gThreadCount; ++i)
+		ok = stealTop(&gQueues[(self + i) % gThreadCount], job);
+
+	if (ok)
+		atomic_fetch_sub_explicit(&gQueued, 1, memory_order_relaxed);
+	return ok;
+}
+
+static void run(const Job *job)
+{
+	job->func(job->userData, job->first, job->count);
+	atomic_fetch_sub_explicit(&gRemaining, 1, memory_order_release);
+}
+
+static void *workerMain(void *arg)
+{
+	int self = (int)(long)arg;
+	Job job;
+
+	while (!atomic_load(&gShutdown))
+	{
+		if (take(self, &job))
+		{
+			run(&job);
+			continue;
+		}
+
+		pthread_mutex_lock(&gWakeLock);
+		while (atomic_load(&gQueued) == 0 && !atomic_load(&gShutdown))
+			pthread_cond_wait(&gWake, &gWakeLock);
+		pthread_mutex_unlock(&gWakeLock);
+	}
+
+	return NULL;
+}
+
+int jobsInit(int threadCount)
+{
+	if (threadCount <= 0)
+	{
+#ifdef __EMSCRIPTEN__
+		threadCount = emscripten_num_logical_cores();
+#else
+		threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	}
+	if (threadCount > JOBS_MAX_WORKERS + 1)
+		threadCount = JOBS_MAX_WORKERS + 1;
+
+	for (int i = 0; i < threadCount; ++i)
+		pthread_mutex_init(&gQueues[i].lock, NULL);
+
+	gThreadCount = 1;
+	for (int i = 1; i < threadCount; ++i)
+	{
+		if (pthread_create(&gThreads[i - 1], NULL, workerMain, (void *)(long)i) != 0)
+		{
+			fprintf(stderr, "Could only start %d of %d job threads\n", i - 1, threadCount - 1);
+			break;
+		}
+		gThreadCount = i + 1;
+	}
+
+	return gThreadCount;
+}
+
+void jobsShutdown(void)
+{
+	pthread_mutex_lock(&gWakeLock);
+	atomic_store(&gShutdown, 1);
+	pthread_cond_broadcast(&gWake);
+	pthread_mutex_unlock(&gWakeLock);
+
+	for (int i = 1; i < gThreadCount; ++i)
+		pthread_join(gThreads[i - 1], NULL);
+	gThreadCount = 1;
+	atomic_store(&gShutdown, 0);
+}
+
+int jobsThreadCount(void)
+{
+	return gThreadCount;
+}
+
+void jobsParallelFor(int count, int grain, JobRangeFunc func, void *userData)
+{
+	if (count <= 0)
+		return;
+	if (grain < 1)
+		grain = 1;
+
+	// Not worth waking anybody for a single chunk
+	if (gThreadCount == 1 || count <= grain)
+	{
+		func(userData, 0, count);
+		return;
+	}
+
+	// Deal the chunks out round robin; chunks that do not fit anywhere are run
+	// right away by the calling thread
+	int chunks = (count + grain - 1) / grain;
+	atomic_store_explicit(&gRemaining, chunks, memory_order_relaxed);
+	for (int c = 0; c < chunks; ++c)
+	{
+		Job job = {func, userData, c * grain, c + 1 < chunks ? grain : count - c * grain};
+		if (push(&gQueues[c % gThreadCount], &job))
+			atomic_fetch_add_explicit(&gQueued, 1, memory_order_release);
+		else
+			run(&job);
+	}
+
+	pthread_mutex_lock(&gWakeLock);
+	pthread_cond_broadcast(&gWake);
+	pthread_mutex_unlock(&gWakeLock);
+
+	// Help out until everything is taken, then wait for the stragglers
+	Job job;
+	while (atomic_load_explicit(&gRemaining, memory_order_acquire) > 0)
+	{
+		if (take(0, &job))
+			run(&job);
+		else
+			sched_yield();
+	}
+}
+
+#else
+
+int jobsInit(int threadCount)
+{
+	return 1;
+}
+
+void jobsShutdown(void)
+{
+}
+
+int jobsThreadCount(void)
+{
+	return 1;
+}
+
+void jobsParallelFor(int count, int grain, JobRangeFunc func, void *userData)
+{
+	if (count > 0)
+		func(userData, 0, count);
+}
+
+#endif
@@ -0,0 +1,29 @@
+// Work-stealing job system for splitting per-frame CPU work across cores.
+//
+// Built with -DJOBS_THREADS (make THREADS=1) it runs a pool of pthreads, which
+// under emscripten needs -s USE_PTHREADS=1 and a SharedArrayBuffer capable
+// page. Without it jobsParallelFor simply runs the whole range on the calling
+// thread, so callers do not need to care which build they are in.
+//
+// Jobs only do CPU work on data they are given; all GL calls stay on the
+// thread that calls jobsParallelFor.
+#ifndef JOBS_H
+#define JOBS_H
+
+// Processes the items [first, first + count)
+typedef void (*JobRangeFunc)(void *userData, int first, int count);
+
+// Starts the worker threads. threadCount includes the calling thread; 0 picks
+// one per logical core. Returns the number of threads that will share work.
+int jobsInit(int threadCount);
+void jobsShutdown(void);
+
+// Number of threads sharing work, including the calling thread
+int jobsThreadCount(void);
+
+// Calls func on chunks of about grain items covering [0, count), spread over
+// all threads, and returns when every chunk is done. The calling thread works
+// on chunks too. Not reentrant: func must not call jobsParallelFor.
+void jobsParallelFor(int count, int grain, JobRangeFunc func, void *userData);
+
+#endif
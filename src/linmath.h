@@ -1,12 +1,88 @@
 #ifndef LINMATH_H
 #define LINMATH_H
 
+#include <assert.h>
 #include <math.h>
 
 #ifdef _MSC_VER
 #define inline __inline
 #endif
 
+/* 128-bit SIMD versions of mat4x4_mul, mat4x4_mul_affine, mat4x4_mul_vec4,
+ * mat4x4_transpose and mat4x4_invert: wasm_simd128 when emcc is given
+ * -msimd128, SSE2 on x86.
+ * Define LINMATH_NO_SIMD to force the scalar loops everywhere.
+ *
+ * The vector kernels perform the same IEEE operations in the same order as
+ * the scalar code, so results are bit-identical (0 ULP), with one exception:
+ * mat4x4_mul and mat4x4_mul_vec4 do not seed their sums with +0.f, so an
+ * exact zero element may come out as -0.f. This holds as long as the compiler
+ * does not contract the scalar code into FMAs (neither SSE2 nor simd128 have
+ * them, so only -mfma builds are affected). */
+#if !defined(LINMATH_NO_SIMD) && defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define LINMATH_SIMD 1
+typedef v128_t lm4;
+#define LM4_LOAD(p) wasm_v128_load(p)
+#define LM4_STORE(p, v) wasm_v128_store((p), (v))
+#define LM4_SET(x, y, z, w) wasm_f32x4_make((x), (y), (z), (w))
+#define LM4_SPLAT(s) wasm_f32x4_splat(s)
+#define LM4_ADD(a, b) wasm_f32x4_add((a), (b))
+#define LM4_SUB(a, b) wasm_f32x4_sub((a), (b))
+#define LM4_MUL(a, b) wasm_f32x4_mul((a), (b))
+#define LM4_DIV(a, b) wasm_f32x4_div((a), (b))
+#define LM4_MIN(a, b) wasm_f32x4_pmin((a), (b))
+#define LM4_MAX(a, b) wasm_f32x4_pmax((a), (b))
+#define LM4_UNPACKLO(a, b) wasm_i32x4_shuffle((a), (b), 0, 4, 1, 5)
+#define LM4_UNPACKHI(a, b) wasm_i32x4_shuffle((a), (b), 2, 6, 3, 7)
+#define LM4_MOVELH(a, b) wasm_i32x4_shuffle((a), (b), 0, 1, 4, 5)
+#define LM4_MOVEHL(a, b) wasm_i32x4_shuffle((b), (a), 2, 3, 6, 7)
+#define LM4_SWAP_PAIRS(v) wasm_i32x4_shuffle((v), (v), 1, 0, 3, 2)
+#define LM4_CMPLT(a, b) wasm_f32x4_lt((a), (b))
+#define LM4_OR(a, b) wasm_v128_or((a), (b))
+#define LM4_ANDNOT(mask, v) wasm_v128_andnot((v), (mask))
+#define LM4_ANY(mask) wasm_v128_any_true(mask)
+#elif !defined(LINMATH_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define LINMATH_SIMD 1
+typedef __m128 lm4;
+#define LM4_LOAD(p) _mm_loadu_ps(p)
+#define LM4_STORE(p, v) _mm_storeu_ps((p), (v))
+#define LM4_SET(x, y, z, w) _mm_setr_ps((x), (y), (z), (w))
+#define LM4_SPLAT(s) _mm_set1_ps(s)
+#define LM4_ADD(a, b) _mm_add_ps((a), (b))
+#define LM4_SUB(a, b) _mm_sub_ps((a), (b))
+#define LM4_MUL(a, b) _mm_mul_ps((a), (b))
+#define LM4_DIV(a, b) _mm_div_ps((a), (b))
+#define LM4_MIN(a, b) _mm_min_ps((a), (b))
+#define LM4_MAX(a, b) _mm_max_ps((a), (b))
+#define LM4_UNPACKLO(a, b) _mm_unpacklo_ps((a), (b))
+#define LM4_UNPACKHI(a, b) _mm_unpackhi_ps((a), (b))
+#define LM4_MOVELH(a, b) _mm_movelh_ps((a), (b))
+#define LM4_MOVEHL(a, b) _mm_movehl_ps((a), (b))
+#define LM4_SWAP_PAIRS(v) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(2, 3, 0, 1))
+#define LM4_CMPLT(a, b) _mm_cmplt_ps((a), (b))
+#define LM4_OR(a, b) _mm_or_ps((a), (b))
+#define LM4_ANDNOT(mask, v) _mm_andnot_ps((mask), (v))
+#define LM4_ANY(mask) _mm_movemask_ps(mask)
+#else
+#define LINMATH_SIMD 0
+#endif
+
+#if LINMATH_SIMD
+/* Transposes the four registers in place, like _MM_TRANSPOSE4_PS. */
+#define LM4_TRANSPOSE(r0, r1, r2, r3) do { \
+	lm4 t0_ = LM4_UNPACKLO(r0, r1); \
+	lm4 t1_ = LM4_UNPACKHI(r0, r1); \
+	lm4 t2_ = LM4_UNPACKLO(r2, r3); \
+	lm4 t3_ = LM4_UNPACKHI(r2, r3); \
+	(r0) = LM4_MOVELH(t0_, t2_); \
+	(r1) = LM4_MOVEHL(t2_, t0_); \
+	(r2) = LM4_MOVELH(t1_, t3_); \
+	(r3) = LM4_MOVEHL(t3_, t1_); \
+} while(0)
+#endif
+
 #define LINMATH_H_DEFINE_VEC(n) \
 typedef float vec##n[n]; \
 static inline void vec##n##_add(vec##n r, vec##n const a, vec##n const b) \
@@ -109,10 +185,22 @@ static inline void mat4x4_col(vec4 r, mat4x4 M, int i)
 }
 static inline void mat4x4_transpose(mat4x4 M, mat4x4 N)
 {
+#if LINMATH_SIMD
+	lm4 c0 = LM4_LOAD(N[0]);
+	lm4 c1 = LM4_LOAD(N[1]);
+	lm4 c2 = LM4_LOAD(N[2]);
+	lm4 c3 = LM4_LOAD(N[3]);
+	LM4_TRANSPOSE(c0, c1, c2, c3);
+	LM4_STORE(M[0], c0);
+	LM4_STORE(M[1], c1);
+	LM4_STORE(M[2], c2);
+	LM4_STORE(M[3], c3);
+#else
 	int i, j;
 	for(j=0; j<4; ++j)
 		for(i=0; i<4; ++i)
 			M[i][j] = N[j][i];
+#endif
 }
 static inline void mat4x4_add(mat4x4 M, mat4x4 a, mat4x4 b)
 {
@@ -144,6 +232,23 @@ static inline void mat4x4_scale_aniso(mat4x4 M, mat4x4 a, float x, float y, floa
 }
 static inline void mat4x4_mul(mat4x4 M, mat4x4 a, mat4x4 b)
 {
+#if LINMATH_SIMD
+	/* All inputs are loaded before the first store, so M may alias a or b */
+	lm4 a0 = LM4_LOAD(a[0]);
+	lm4 a1 = LM4_LOAD(a[1]);
+	lm4 a2 = LM4_LOAD(a[2]);
+	lm4 a3 = LM4_LOAD(a[3]);
+	lm4 r[4];
+	int c;
+	for(c=0; c<4; ++c) {
+		lm4 t = LM4_MUL(a0, LM4_SPLAT(b[c][0]));
+		t = LM4_ADD(t, LM4_MUL(a1, LM4_SPLAT(b[c][1])));
+		t = LM4_ADD(t, LM4_MUL(a2, LM4_SPLAT(b[c][2])));
+		r[c] = LM4_ADD(t, LM4_MUL(a3, LM4_SPLAT(b[c][3])));
+	}
+	for(c=0; c<4; ++c)
+		LM4_STORE(M[c], r[c]);
+#else
 	mat4x4 temp;
 	int k, r, c;
 	for(c=0; c<4; ++c) for(r=0; r<4; ++r) {
@@ -152,15 +257,78 @@ static inline void mat4x4_mul(mat4x4 M, mat4x4 a, mat4x4 b)
 			temp[c][r] += a[k][r] * b[c][k];
 	}
 	mat4x4_dup(M, temp);
+#endif
+}
+/* Affine matrices have (0, 0, 0, 1) as their last row, as model and view
+ * matrices do; projections do not. The tolerance allows for a last row that
+ * came out of a general inverse. Meant for assertions. */
+static inline int mat4x4_is_affine(mat4x4 M)
+{
+	return fabsf(M[0][3]) < 1e-5f && fabsf(M[1][3]) < 1e-5f && fabsf(M[2][3]) < 1e-5f
+		&& fabsf(M[3][3] - 1.f) < 1e-5f;
+}
+/* Affine with an orthonormal upper 3x3: a rotation and a translation */
+static inline int mat4x4_is_rigid(mat4x4 M)
+{
+	int i, j;
+	if(!mat4x4_is_affine(M))
+		return 0;
+	for(i=0; i<3; ++i)
+		for(j=0; j<3; ++j)
+			if(fabsf(vec3_mul_inner(M[i], M[j]) - (i==j ? 1.f : 0.f)) > 1e-3f)
+				return 0;
+	return 1;
+}
+/* M = a * b for an affine b, with 48 instead of 64 multiplies. a may be any
+ * matrix, such as a projection. Gives the same result as mat4x4_mul, up to
+ * the sign of zeros, and M may alias a or b in the same way. */
+static inline void mat4x4_mul_affine(mat4x4 M, mat4x4 a, mat4x4 b)
+{
+	assert(mat4x4_is_affine(b));
+#if LINMATH_SIMD
+	lm4 a0 = LM4_LOAD(a[0]);
+	lm4 a1 = LM4_LOAD(a[1]);
+	lm4 a2 = LM4_LOAD(a[2]);
+	lm4 a3 = LM4_LOAD(a[3]);
+	lm4 r[4];
+	int c;
+	for(c=0; c<4; ++c) {
+		lm4 t = LM4_MUL(a0, LM4_SPLAT(b[c][0]));
+		t = LM4_ADD(t, LM4_MUL(a1, LM4_SPLAT(b[c][1])));
+		r[c] = LM4_ADD(t, LM4_MUL(a2, LM4_SPLAT(b[c][2])));
+	}
+	r[3] = LM4_ADD(r[3], a3);
+	for(c=0; c<4; ++c)
+		LM4_STORE(M[c], r[c]);
+#else
+	mat4x4 temp;
+	int k, r, c;
+	for(c=0; c<4; ++c) for(r=0; r<4; ++r) {
+		temp[c][r] = 0.f;
+		for(k=0; k<3; ++k)
+			temp[c][r] += a[k][r] * b[c][k];
+	}
+	for(r=0; r<4; ++r)
+		temp[3][r] += a[3][r];
+	mat4x4_dup(M, temp);
+#endif
 }
 static inline void mat4x4_mul_vec4(vec4 r, mat4x4 M, vec4 v)
 {
+#if LINMATH_SIMD
+	lm4 t = LM4_MUL(LM4_LOAD(M[0]), LM4_SPLAT(v[0]));
+	t = LM4_ADD(t, LM4_MUL(LM4_LOAD(M[1]), LM4_SPLAT(v[1])));
+	t = LM4_ADD(t, LM4_MUL(LM4_LOAD(M[2]), LM4_SPLAT(v[2])));
+	t = LM4_ADD(t, LM4_MUL(LM4_LOAD(M[3]), LM4_SPLAT(v[3])));
+	LM4_STORE(r, t);
+#else
 	int i, j;
 	for(j=0; j<4; ++j) {
 		r[j] = 0.f;
 		for(i=0; i<4; ++i)
 			r[j] += M[i][j] * v[i];
 	}
+#endif
 }
 static inline void mat4x4_translate(mat4x4 T, float x, float y, float z)
 {
@@ -237,9 +405,9 @@ static inline void mat4x4_rotate_Y(mat4x4 Q, mat4x4 M, float angle)
 	float s = sinf(angle);
 	float c = cosf(angle);
 	mat4x4 R = {
-		{   c, 0.f,   s, 0.f},
+		{   c, 0.f,  -s, 0.f},
 		{ 0.f, 1.f, 0.f, 0.f},
-		{  -s, 0.f,   c, 0.f},
+		{   s, 0.f,   c, 0.f},
 		{ 0.f, 0.f, 0.f, 1.f}
 	};
 	mat4x4_mul(Q, M, R);
@@ -278,6 +446,47 @@ static inline void mat4x4_invert(mat4x4 T, mat4x4 M)
 	/* Assumes it is invertible */
 	idet = 1.0f/( s[0]*c[5]-s[1]*c[4]+s[2]*c[3]+s[3]*c[2]-s[4]*c[1]+s[5]*c[0] );
 
+#if LINMATH_SIMD
+	{
+		/* Each output column is the scalar expression below evaluated on four
+		 * lanes at once. Odd lanes are the negated even-lane expression, which
+		 * rounds identically, so the sign is folded into the idet factor.
+		 * B<j> holds row j of M as (M[1][j], M[0][j], M[3][j], M[2][j]). */
+		lm4 b0 = LM4_LOAD(M[0]);
+		lm4 b1 = LM4_LOAD(M[1]);
+		lm4 b2 = LM4_LOAD(M[2]);
+		lm4 b3 = LM4_LOAD(M[3]);
+		lm4 k0, k1, k2, k3, k4, k5;
+		lm4 pos = LM4_SET(idet, -idet, idet, -idet);
+		lm4 neg = LM4_SET(-idet, idet, -idet, idet);
+		lm4 t0, t1, t2, t3;
+		LM4_TRANSPOSE(b0, b1, b2, b3);
+		b0 = LM4_SWAP_PAIRS(b0);
+		b1 = LM4_SWAP_PAIRS(b1);
+		b2 = LM4_SWAP_PAIRS(b2);
+		b3 = LM4_SWAP_PAIRS(b3);
+		k0 = LM4_SET(c[0], c[0], s[0], s[0]);
+		k1 = LM4_SET(c[1], c[1], s[1], s[1]);
+		k2 = LM4_SET(c[2], c[2], s[2], s[2]);
+		k3 = LM4_SET(c[3], c[3], s[3], s[3]);
+		k4 = LM4_SET(c[4], c[4], s[4], s[4]);
+		k5 = LM4_SET(c[5], c[5], s[5], s[5]);
+
+		t0 = LM4_SUB(LM4_MUL(b1, k5), LM4_MUL(b2, k4));
+		t0 = LM4_MUL(LM4_ADD(t0, LM4_MUL(b3, k3)), pos);
+		t1 = LM4_SUB(LM4_MUL(b0, k5), LM4_MUL(b2, k2));
+		t1 = LM4_MUL(LM4_ADD(t1, LM4_MUL(b3, k1)), neg);
+		t2 = LM4_SUB(LM4_MUL(b0, k4), LM4_MUL(b1, k2));
+		t2 = LM4_MUL(LM4_ADD(t2, LM4_MUL(b3, k0)), pos);
+		t3 = LM4_SUB(LM4_MUL(b0, k3), LM4_MUL(b1, k1));
+		t3 = LM4_MUL(LM4_ADD(t3, LM4_MUL(b2, k0)), neg);
+
+		LM4_STORE(T[0], t0);
+		LM4_STORE(T[1], t1);
+		LM4_STORE(T[2], t2);
+		LM4_STORE(T[3], t3);
+	}
+#else
 	T[0][0] = ( M[1][1] * c[5] - M[1][2] * c[4] + M[1][3] * c[3]) * idet;
 	T[0][1] = (-M[0][1] * c[5] + M[0][2] * c[4] - M[0][3] * c[3]) * idet;
 	T[0][2] = ( M[3][1] * s[5] - M[3][2] * s[4] + M[3][3] * s[3]) * idet;
@@ -297,6 +506,60 @@ static inline void mat4x4_invert(mat4x4 T, mat4x4 M)
 	T[3][1] = ( M[0][0] * c[3] - M[0][1] * c[1] + M[0][2] * c[0]) * idet;
 	T[3][2] = (-M[3][0] * s[3] + M[3][1] * s[1] - M[3][2] * s[0]) * idet;
 	T[3][3] = ( M[2][0] * s[3] - M[2][1] * s[1] + M[2][2] * s[0]) * idet;
+#endif
+}
+/* Inverse of an affine M: the upper 3x3 inverted through cross products of
+ * its columns, and the translation brought back through it. About half the
+ * work of mat4x4_invert. */
+static inline void mat4x4_invert_affine(mat4x4 T, mat4x4 M)
+{
+	float r00, r01, r02, r10, r11, r12, r20, r21, r22, idet;
+	float tx = M[3][0], ty = M[3][1], tz = M[3][2];
+	assert(mat4x4_is_affine(M));
+
+	/* Rows of the inverse times the determinant: M[1] x M[2], M[2] x M[0]
+	 * and M[0] x M[1] */
+	r00 = M[1][1]*M[2][2] - M[1][2]*M[2][1];
+	r01 = M[1][2]*M[2][0] - M[1][0]*M[2][2];
+	r02 = M[1][0]*M[2][1] - M[1][1]*M[2][0];
+	r10 = M[2][1]*M[0][2] - M[2][2]*M[0][1];
+	r11 = M[2][2]*M[0][0] - M[2][0]*M[0][2];
+	r12 = M[2][0]*M[0][1] - M[2][1]*M[0][0];
+	r20 = M[0][1]*M[1][2] - M[0][2]*M[1][1];
+	r21 = M[0][2]*M[1][0] - M[0][0]*M[1][2];
+	r22 = M[0][0]*M[1][1] - M[0][1]*M[1][0];
+
+	/* Assumes it is invertible */
+	idet = 1.f / (M[0][0]*r00 + M[0][1]*r01 + M[0][2]*r02);
+	r00 *= idet; r01 *= idet; r02 *= idet;
+	r10 *= idet; r11 *= idet; r12 *= idet;
+	r20 *= idet; r21 *= idet; r22 *= idet;
+
+	T[0][0] = r00; T[0][1] = r10; T[0][2] = r20; T[0][3] = 0.f;
+	T[1][0] = r01; T[1][1] = r11; T[1][2] = r21; T[1][3] = 0.f;
+	T[2][0] = r02; T[2][1] = r12; T[2][2] = r22; T[2][3] = 0.f;
+	T[3][0] = -(r00*tx + r01*ty + r02*tz);
+	T[3][1] = -(r10*tx + r11*ty + r12*tz);
+	T[3][2] = -(r20*tx + r21*ty + r22*tz);
+	T[3][3] = 1.f;
+}
+/* Inverse of a rigid M, a rotation and a translation: the transposed
+ * rotation, and the translation brought back through it. T may alias M. */
+static inline void mat4x4_invert_rigid(mat4x4 T, mat4x4 M)
+{
+	float m00 = M[0][0], m01 = M[0][1], m02 = M[0][2];
+	float m10 = M[1][0], m11 = M[1][1], m12 = M[1][2];
+	float m20 = M[2][0], m21 = M[2][1], m22 = M[2][2];
+	float tx = M[3][0], ty = M[3][1], tz = M[3][2];
+	assert(mat4x4_is_rigid(M));
+
+	T[0][0] = m00; T[0][1] = m10; T[0][2] = m20; T[0][3] = 0.f;
+	T[1][0] = m01; T[1][1] = m11; T[1][2] = m21; T[1][3] = 0.f;
+	T[2][0] = m02; T[2][1] = m12; T[2][2] = m22; T[2][3] = 0.f;
+	T[3][0] = -(m00*tx + m01*ty + m02*tz);
+	T[3][1] = -(m10*tx + m11*ty + m12*tz);
+	T[3][2] = -(m20*tx + m21*ty + m22*tz);
+	T[3][3] = 1.f;
 }
 static inline void mat4x4_orthonormalize(mat4x4 R, mat4x4 M)
 {
@@ -309,12 +572,11 @@ static inline void mat4x4_orthonormalize(mat4x4 R, mat4x4 M)
 	s = vec3_mul_inner(R[1], R[2]);
 	vec3_scale(h, R[2], s);
 	vec3_sub(R[1], R[1], h);
-	vec3_norm(R[2], R[2]);
+	vec3_norm(R[1], R[1]);
 
-	s = vec3_mul_inner(R[1], R[2]);
+	s = vec3_mul_inner(R[0], R[2]);
 	vec3_scale(h, R[2], s);
-	vec3_sub(R[1], R[1], h);
-	vec3_norm(R[1], R[1]);
+	vec3_sub(R[0], R[0], h);
 
 	s = vec3_mul_inner(R[0], R[1]);
 	vec3_scale(h, R[1], s);
@@ -488,13 +750,14 @@ static inline void quat_mul_vec3(vec3 r, quat q, vec3 v)
 t = 2 * cross(q.xyz, v)
 v' = v + q.w * t + cross(q.xyz, t)
  */
-	vec3 t = {q[0], q[1], q[2]};
-	vec3 u = {q[0], q[1], q[2]};
+	/* vec3_mul_cross does not allow r to alias an input */
+	vec3 t;
+	vec3 u;
 
-	vec3_mul_cross(t, t, v);
+	vec3_mul_cross(t, q, v);
 	vec3_scale(t, t, 2);
 
-	vec3_mul_cross(u, u, t);
+	vec3_mul_cross(u, q, t);
 	vec3_scale(t, t, q[3]);
 
 	vec3_add(r, v, t);
@@ -538,37 +801,40 @@ static inline void mat4x4o_mul_quat(mat4x4 R, mat4x4 M, quat q)
 	quat_mul_vec3(R[1], q, M[1]);
 	quat_mul_vec3(R[2], q, M[2]);
 
+	R[0][3] = M[0][3];
+	R[1][3] = M[1][3];
+	R[2][3] = M[2][3];
 	R[3][0] = R[3][1] = R[3][2] = 0.f;
-	R[3][3] = 1.f;
+	R[3][3] = M[3][3];
 }
 static inline void quat_from_mat4x4(quat q, mat4x4 M)
 {
-	float r=0.f;
-	int i;
-
-	int perm[] = { 0, 1, 2, 0, 1 };
-	int *p = perm;
-
-	for(i = 0; i<3; i++) {
-		float m = M[i][i];
-		if( m < r )
-			continue;
-		m = r;
-		p = &perm[i];
-	}
-
-	r = (float) sqrt(1.f + M[p[0]][p[0]] - M[p[1]][p[1]] - M[p[2]][p[2]] );
-
-	if(r < 1e-6) {
-		q[0] = 1.f;
-		q[1] = q[2] = q[3] = 0.f;
+	/* Solves for the largest of w, x, y and z first and divides by it, so
+	 * the result stays accurate for any rotation */
+	float t = M[0][0] + M[1][1] + M[2][2];
+	float r;
+	int i, j, k;
+
+	if(t > 0.f) {
+		r = (float) sqrt(1.f + t);
+		q[3] = r/2.f;
+		q[0] = (M[1][2] - M[2][1])/(2.f*r);
+		q[1] = (M[2][0] - M[0][2])/(2.f*r);
+		q[2] = (M[0][1] - M[1][0])/(2.f*r);
 		return;
 	}
 
-	q[0] = r/2.f;
-	q[1] = (M[p[0]][p[1]] - M[p[1]][p[0]])/(2.f*r);
-	q[2] = (M[p[2]][p[0]] - M[p[0]][p[2]])/(2.f*r);
-	q[3] = (M[p[2]][p[1]] - M[p[1]][p[2]])/(2.f*r);
+	i = M[1][1] > M[0][0] ? 1 : 0;
+	if(M[2][2] > M[i][i])
+		i = 2;
+	j = (i+1) % 3;
+	k = (i+2) % 3;
+
+	r = (float) sqrt(1.f + M[i][i] - M[j][j] - M[k][k]);
+	q[i] = r/2.f;
+	q[j] = (M[i][j] + M[j][i])/(2.f*r);
+	q[k] = (M[i][k] + M[k][i])/(2.f*r);
+	q[3] = (M[j][k] - M[k][j])/(2.f*r);
 }
 
 #endif
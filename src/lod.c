@@ -0,0 +1,96 @@
+#include "lod.h"
+
+#include <math.h>
+#include <string.h>
+
+void lodViewInit(LodView *view, float pixelError)
+{
+	memset(view, 0, sizeof(*view));
+	view->pixelError = pixelError;
+	view->hysteresis = LOD_HYSTERESIS;
+}
+
+void lodViewAddEye(LodView *view, mat4x4 projection, mat4x4 viewMatrix, int width, int height)
+{
+	// Eye position -R^T t of the rigid view matrix, averaged over the eyes
+	float weight = 1.0f / (float)(view->eyes + 1);
+	for (int i = 0; i < 3; ++i)
+	{
+		float p = -vec3_mul_inner(viewMatrix[i], viewMatrix[3]);
+		view->eye[i] += (p - view->eye[i]) * weight;
+	}
+	++view->eyes;
+
+	float pixels = 0.5f * fmaxf(projection[0][0] * width, projection[1][1] * height);
+	if (pixels > view->pixelsPerUnit)
+		view->pixelsPerUnit = pixels;
+}
+
+int lodSelect(const LodMesh *mesh, const LodView *view, const vec3 *position, const float *radius,
+	const float *scale, const int *visible, int count, unsigned char *level)
+{
+	int last = mesh->levelCount - 1;
+	// An error within limit / distance pixels of the level's error is on screen
+	float limit = view->pixelError / view->pixelsPerUnit;
+	float coarserLimit = limit * (1.0f - view->hysteresis);
+	int changes = 0;
+
+	for (int v = 0; v < count; ++v)
+	{
+		int i = visible[v];
+		vec3 d;
+		vec3_sub(d, position[i], view->eye);
+		float distance = vec3_len(d) - radius[i] * scale[i];
+		if (distance < LOD_MIN_DISTANCE)
+			distance = LOD_MIN_DISTANCE;
+		// Error allowed in model units
+		float allowed = limit * distance / scale[i];
+		float coarserAllowed = coarserLimit * distance / scale[i];
+
+		if (level[i] == LOD_NO_LEVEL)
+		{
+			// Nothing to pop from yet
+			int l = 0;
+			while (l < last && mesh->levels[l + 1].error <= allowed)
+				++l;
+			level[i] = (unsigned char)l;
+			continue;
+		}
+
+		int current = level[i] > last ? last : level[i];
+		int l = current;
+		// Finer right away when over the limit, coarser only with margin
+		while (l > 0 && mesh->levels[l].error > allowed)
+			--l;
+		if (l == current)
+		{
+			while (l < last && mesh->levels[l + 1].error <= coarserAllowed)
+				++l;
+		}
+		if (l != level[i])
+		{
+			level[i] = (unsigned char)l;
+			++changes;
+		}
+	}
+	return changes;
+}
+
+void lodGroup(const int *visible, int count, const unsigned char *level, int levelCount, int *grouped, int *start)
+{
+	int next[LOD_MAX_LEVELS] = {0};
+	for (int v = 0; v < count; ++v)
+		++next[level[visible[v]]];
+
+	int first = 0;
+	for (int l = 0; l < levelCount; ++l)
+	{
+		start[l] = first;
+		first += next[l];
+		next[l] = start[l];
+	}
+	start[levelCount] = first;
+
+	for (int v = 0; v < count; ++v)
+		grouped[next[level[visible[v]]]++] = visible[v];
+}
@@ -0,0 +1,70 @@
+// Level of detail selection by screen-space error.
+//
+// A mesh lists its levels from the finest (0) to the coarsest, each with its
+// geometric error: how far, in model units, its surface can be from the full
+// detail one. Once per frame every visible object gets the coarsest level
+// whose error, projected to pixels, stays within the view's pixel error.
+//
+// In VR the error is projected from a single center eye between the two eyes,
+// with the pixel density of the denser one, so both eyes draw every object at
+// the same level and never disagree. The distance is to the nearest point of
+// the object's bounding sphere, which keeps the estimate conservative for
+// large objects.
+//
+// An object moves to a coarser level only once that level's error is a
+// hysteresis margin below the limit, but to a finer one as soon as its current
+// level is over the limit, so objects sitting at a switching distance do not
+// pop back and forth with every small head movement.
+#ifndef LOD_H
+#define LOD_H
+
+#include "linmath.h"
+
+#define LOD_MAX_LEVELS 4
+#define LOD_PIXEL_ERROR 1.0f // Default error allowed on screen, in pixels
+#define LOD_HYSTERESIS 0.25f // Fraction of the limit a coarser level has to stay under
+#define LOD_MIN_DISTANCE 0.01f // Distances are clamped to this, for viewers inside a bounding sphere
+#define LOD_NO_LEVEL 0xff // Level of an object that has none yet
+
+typedef struct LodLevel
+{
+	int first, count; // Vertices of the level in the mesh's vertex buffer
+	int triangles;
+	float error; // Geometric error in model units, increasing with the level
+} LodLevel;
+
+typedef struct LodMesh
+{
+	int levelCount;
+	LodLevel levels[LOD_MAX_LEVELS];
+} LodMesh;
+
+// Where the error is projected from for a frame
+typedef struct LodView
+{
+	vec3 eye; // Center of the eyes added, in world space
+	float pixelsPerUnit; // Pixels covered by a unit length at a distance of 1, densest eye
+	float pixelError, hysteresis;
+	int eyes;
+} LodView;
+
+// Starts a view with the given pixel error and LOD_HYSTERESIS
+void lodViewInit(LodView *view, float pixelError);
+
+// Adds an eye of the frame, drawn with a rigid world to eye matrix and a
+// perspective projection into width x height pixels
+void lodViewAddEye(LodView *view, mat4x4 projection, mat4x4 viewMatrix, int width, int height);
+
+// Picks the level of the objects visible[0 .. count), centered at
+// position[i] with bounding radius radius[i] * scale[i]. level[i] holds each
+// object's previous level, or LOD_NO_LEVEL, and is updated in place. Returns
+// the number of objects whose level changed, not counting the first pick.
+int lodSelect(const LodMesh *mesh, const LodView *view, const vec3 *position, const float *radius,
+	const float *scale, const int *visible, int count, unsigned char *level);
+
+// Orders visible by level into grouped, keeping the order within a level.
+// Objects at level l end up in grouped[start[l] .. start[l + 1]), start has
+// levelCount + 1 entries.
+void lodGroup(const int *visible, int count, const unsigned char *level, int levelCount, int *grouped, int *start);
+
+#endif
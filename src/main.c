@@ -1,11 +1,154 @@
+#include "cull.h"
+#include "frame_capture.h"
+#include "frame_timing.h"
+#include "gl_command.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
+#include "jobs.h"
 #include "linmath.h"
+#include "lod.h"
+#include "mesh_stream.h"
+#include "occlusion.h"
+#include "pose_predict.h"
+#include "resolution.h"
+#include "scene.h"
+#include "shader_cache.h"
+#include "sim_clock.h"
+#include "static_batch.h"
+#include "transform.h"
+#include "vertex_format.h"
+#include "vertex_stream.h"
 
 #include <emscripten/emscripten.h>
 #include <emscripten/html5.h>
 #include <emscripten/vr.h>
 #include <GLES2/gl2.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2ext.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// Draw both eyes with one instanced draw call when ANGLE_instanced_arrays is
+// available. Define as 0 to always render one pass per eye.
+#ifndef SINGLE_PASS_STEREO
+#define SINGLE_PASS_STEREO 1
+#endif
+
+// Number of objects in the scene. The first is the spinning triangle in front
+// of the viewer, the others are smaller copies on a grid further back.
+#ifndef SCENE_OBJECTS
+#define SCENE_OBJECTS 1
+#endif
+
+// Late latching: right before an eye is drawn its view matrix is re-derived
+// for the head pose predicted at the expected scanout time, which is assumed to
+// be POSE_SCANOUT_LEAD_MS after the draw. Runtimes that already predict the
+// frame data pose to scanout want a lead of 0. Define POSE_PREDICTION as 0 to
+// render with the frame data views as they are.
+#ifndef POSE_PREDICTION
+#define POSE_PREDICTION 1
+#endif
+#ifndef POSE_SCANOUT_LEAD_MS
+#define POSE_SCANOUT_LEAD_MS (1000.0 / 90.0)
+#endif
+
+// Upload the triangle with positions as normalized 16-bit integers and colors
+// as normalized bytes (vertex_format.h), 8 bytes per vertex instead of 20.
+// Define as 0 to upload 32-bit floats.
+#ifndef COMPACT_VERTICES
+#define COMPACT_VERTICES 1
+#endif
+
+// Number of static floor tiles below the scene. They never move, so they are
+// merged into shared buffers once (static_batch.h) and drawn with one
+// glDrawElements per view for every STATIC_BATCH_MAX_VERTICES vertices.
+#ifndef STATIC_OBJECTS
+#define STATIC_OBJECTS 0
+#endif
+
+// Draw the objects as discs with LOD_MAX_LEVELS levels of detail instead of
+// the triangle. Every frame each visible object is drawn at the coarsest level
+// whose error stays within LOD_PIXEL_ERROR pixels, the same in both eyes
+// (lod.h), with one draw per level and view.
+#ifndef LOD
+#define LOD 0
+#endif
+
+// Draw the bounding circle of every visible object as debug lines, streamed
+// to the GPU anew for every view
+#ifndef DEBUG_BOUNDS
+#define DEBUG_BOUNDS 0
+#endif
+
+// Path or URL of a mesh file (mesh_file.h) to stream in and draw with the
+// scene, chunk by chunk as it arrives. Undefined to draw none.
+#ifdef MESH_FILE
+#define MESH_STREAMING 1
+#else
+#define MESH_STREAMING 0
+#endif
+
+// Log every input the frame loops read from the browser (frame_capture.h),
+// to replay the session natively with NATIVE_REPLAY. The log is downloaded
+// each time VR presentation ends, and written at exit natively. It holds
+// CAPTURE_BYTES, about 12 minutes of VR at 90 Hz, and stops when full.
+#ifndef CAPTURE_FRAMES
+#define CAPTURE_FRAMES 0
+#endif
+#define CAPTURE_BYTES (16 << 20)
+
+// Two wall panels between the viewer and the objects, with a doorway between
+// them, drawn with the static batches. They are the occluders of a CPU depth
+// buffer (occlusion.h) rendered from the center eye once per frame: objects in
+// the frustum are tested against it, and those hidden from both eyes are
+// neither drawn nor given a level.
+#ifndef OCCLUSION
+#define OCCLUSION 0
+#endif
+
+// Whether there is static geometry to batch, see initStaticObjects
+#define STATIC_BATCHES (STATIC_OBJECTS || OCCLUSION)
+
+// Whether anything is drawn one view at a time after the scene, see drawViewExtras
+#define VIEW_EXTRAS (STATIC_BATCHES || DEBUG_BOUNDS || MESH_STREAMING)
+
+// Dynamic resolution: the VR canvas is resized between MIN_RENDER_SCALE and
+// MAX_RENDER_SCALE times the display's recommended size to keep frames within
+// the refresh budget (resolution.h). The layer bounds are fractions of the
+// canvas, so the compositor stretches it back over the full eye. Define
+// DYNAMIC_RESOLUTION as 0 to always render at MAX_RENDER_SCALE.
+#ifndef DYNAMIC_RESOLUTION
+#define DYNAMIC_RESOLUTION 1
+#endif
+#ifndef MIN_RENDER_SCALE
+#define MIN_RENDER_SCALE 0.5f
+#endif
+#ifndef MAX_RENDER_SCALE
+#define MAX_RENDER_SCALE 1.0f
+#endif
+
+// Fixed simulation step, independent of the frame rate. Frames interpolate
+// between the last two ticks. A frame runs at most SIM_MAX_TICKS ticks, time
+// beyond that (a hidden tab, a debugger stop) is skipped.
+#ifndef SIM_STEP_MS
+#define SIM_STEP_MS (1000.0 / 60.0)
+#endif
+#define SIM_MAX_TICKS 8
+
+// Bytes in each of the vertex stream's buffers
+#define STREAM_BUFFER_SIZE (256 * 1024)
+
+// Objects per job when per-object work is split across threads
+#define JOB_GRAIN 1024
+
+// Fixed attribute locations shared by all programs. iMVP is a mat4 and takes
+// four consecutive locations.
+#define VPOS_LOCATION 0
+#define VCOL_LOCATION 1
+#define VEYE_LOCATION 2
+#define IMVP_LOCATION 3
 
 // Forward declarations
 static void nonVrLoop();
@@ -14,75 +157,236 @@ static void vrLoop();
 VRDisplayHandle gDisplay = -1;
 VREyeParameters gEyeLeft, gEyeRight;
 
-GLuint vertex_buffer, vertex_shader, fragment_shader, program;
-GLint mvp_location, vpos_location, vcol_location;
+// Eye render size at the current render scale
+ResolutionController gResolution;
+int gRenderWidth[2], gRenderHeight;
+double gVrFrameStart, gVrFrameCpuMs; // Start and CPU time of the last VR frame, 0 before the first
+
+PosePredictor gPosePredictor;
+
+VertexStream gStream;
+
+SimClock gSimClock;
+Scene gScene;
+mat4x4 *gMvp; // Per-object MVPs, all of the left eye (or only view) followed by all of the right eye
+
+// Objects that passed culling this frame, drawn by every view
+int *gVisible, gVisibleCount;
+int *gChunkVisible; // Visible count of each JOB_GRAIN sized chunk while culling
+unsigned long gCullPasses;
+unsigned long long gCullTested, gCullVisible;
+
+GLuint vertex_buffer, program;
+GLint mvp_location;
 
-static const struct
+// Layout of the object mesh in vertex_buffer. Its dequantization is part of
+// every object's world matrix.
+VertexFormat gObjectFormat;
+VertexDequantization gObjectDequantization;
+
+// Levels of the object mesh, a single one without LOD. Every visible object
+// has a level, gVisible is grouped by it: the objects at level l are
+// gVisible[gLevelStart[l] .. gLevelStart[l + 1]).
+LodMesh gObjectMesh;
+unsigned char *gLevel; // Level of every object, kept across frames for the hysteresis, or LOD_NO_LEVEL
+int *gGroupedVisible; // Where gVisible is grouped into, then swapped with it
+int *gChunkLevelChanges; // Level changes of each JOB_GRAIN sized chunk
+int gLevelStart[LOD_MAX_LEVELS + 1];
+unsigned long long gTrianglesDrawn, gFullDetailTriangles, gLevelObjects[LOD_MAX_LEVELS], gLevelChanges;
+
+// Instanced drawing with per-instance MVPs, used while gInstancing is set
+int gInstancing;
+GLuint mvp_buffer, instanced_program;
+
+StaticBatcher gStaticBatcher;
+
+// Occlusion culling of the visible objects, with what it took
+OcclusionBuffer gOcclusion;
+unsigned long long gOcclusionTested, gOcclusionHidden;
+double gOcclusionRasterizeMs, gOcclusionTestMs;
+
+// Streamed meshes, and when streaming started, the first chunk was drawn and
+// the last one was uploaded (0 until then)
+MeshStream gMeshStream;
+double gMeshStreamStart, gMeshFirstDrawTime, gMeshLoadedTime;
+
+FrameCapture gCapture; // Only allocated with CAPTURE_FRAMES
+
+// Single-pass stereo resources, used while gSinglePassStereo is set
+int gSinglePassStereo;
+GLuint eye_buffer, stereo_program;
+GLint stereo_eye_rect_location;
+
+typedef struct ObjectVertex
 {
 	float x, y;
 	float r, g, b;
-} vertices[3] =
+} ObjectVertex;
+
+#if LOD
+// Segments of each level of the disc, as a list of triangles around the center
+#define DISC_RADIUS 0.6f
+static const int gDiscSegments[LOD_MAX_LEVELS] = {64, 24, 8, 3};
+#define OBJECT_VERTICES (3 * (64 + 24 + 8 + 3))
+#else
+static const ObjectVertex vertices[3] =
 {
 	{-0.6f, -0.4f, 1.f, 0.f, 0.f},
 	{0.6f, -0.4f, 0.f, 1.f, 0.f},
 	{0.f, 0.6f, 0.f, 0.f, 1.f}
 };
+#define OBJECT_VERTICES 3
+#endif
+
+// The object mesh with all its levels, as uploaded to vertex_buffer
+static ObjectVertex gObjectVertices[OBJECT_VERTICES];
+
+#if STATIC_OBJECTS
+// Floor tile, flat in the xz plane, in two shades for a checkerboard
+#define TILE_PITCH 0.5f
+#define TILE_HALF_SIZE 0.22f
+
+static const BatchVertex gTileVertices[2][4] =
+{
+	{
+		{-TILE_HALF_SIZE, 0.f, -TILE_HALF_SIZE, 0.5f, 0.5f, 0.5f},
+		{TILE_HALF_SIZE, 0.f, -TILE_HALF_SIZE, 0.5f, 0.5f, 0.5f},
+		{TILE_HALF_SIZE, 0.f, TILE_HALF_SIZE, 0.6f, 0.6f, 0.6f},
+		{-TILE_HALF_SIZE, 0.f, TILE_HALF_SIZE, 0.6f, 0.6f, 0.6f}
+	},
+	{
+		{-TILE_HALF_SIZE, 0.f, -TILE_HALF_SIZE, 0.2f, 0.2f, 0.3f},
+		{TILE_HALF_SIZE, 0.f, -TILE_HALF_SIZE, 0.2f, 0.2f, 0.3f},
+		{TILE_HALF_SIZE, 0.f, TILE_HALF_SIZE, 0.25f, 0.25f, 0.35f},
+		{-TILE_HALF_SIZE, 0.f, TILE_HALF_SIZE, 0.25f, 0.25f, 0.35f}
+	}
+};
+static const unsigned short gTileIndices[6] = {0, 1, 2, 0, 2, 3};
+static const BatchMesh gTileMeshes[2] =
+{
+	{gTileVertices[0], gTileIndices, 4, 6},
+	{gTileVertices[1], gTileIndices, 4, 6}
+};
+#endif
+
+// Walls of OCCLUSION, none without it
+#define WALL_COUNT (OCCLUSION ? 2 : 0)
+
+#if OCCLUSION
+// Wall panel, upright in the xy plane, that both draws and occludes
+#define WALL_HALF_WIDTH 1.25f
+#define WALL_HALF_HEIGHT 1.5f
+
+static const BatchVertex gWallVertices[4] =
+{
+	{-WALL_HALF_WIDTH, -WALL_HALF_HEIGHT, 0.f, 0.45f, 0.35f, 0.3f},
+	{WALL_HALF_WIDTH, -WALL_HALF_HEIGHT, 0.f, 0.45f, 0.35f, 0.3f},
+	{WALL_HALF_WIDTH, WALL_HALF_HEIGHT, 0.f, 0.55f, 0.45f, 0.4f},
+	{-WALL_HALF_WIDTH, WALL_HALF_HEIGHT, 0.f, 0.55f, 0.45f, 0.4f}
+};
+static const unsigned short gWallIndices[6] = {0, 1, 2, 0, 2, 3};
+static const BatchMesh gWallMesh = {gWallVertices, gWallIndices, 4, 6};
+static OccluderMesh gWallOccluder;
+static mat4x4 gWallWorld[WALL_COUNT];
+#endif
+
+#if DEBUG_BOUNDS
+// Streamed line vertices, in world space
+typedef struct DebugVertex
+{
+	float x, y, z;
+	float r, g, b;
+} DebugVertex;
+
+#define DEBUG_CIRCLE_SEGMENTS 16
+#define DEBUG_BATCH_OBJECTS (STREAM_BUFFER_SIZE / (DEBUG_CIRCLE_SEGMENTS * 2 * sizeof(DebugVertex)))
+
+static float gCircle[DEBUG_CIRCLE_SEGMENTS + 1][2];
+static DebugVertex gDebugVertices[DEBUG_BATCH_OBJECTS * DEBUG_CIRCLE_SEGMENTS * 2];
+#endif
+
+// One source for all programs, variants are selected with #defines:
+// INSTANCED takes the MVP from a per-instance attribute instead of a uniform,
+// one instance per object.
+// STEREO draws both eyes in one instanced draw: the first half of the instances
+// are the objects seen by the left eye, the second half by the right eye; vEye
+// advances once per half. Each instance is squeezed into its eye's half of the
+// viewport in clip space (EyeRect is x scale and offset), and fragments that
+// spill across the seam into the other eye are discarded, standing in for
+// per-eye viewport clipping. Eyes are assumed to have the same render height.
 static const char *vertex_shader_text =
 	"#version 100\n"
+	"#ifdef INSTANCED\n"
+	"attribute mat4 iMVP;\n"
+	"#else\n"
 	"uniform mat4 MVP;\n"
+	"#endif\n"
+	"#ifdef STEREO\n"
+	"uniform vec2 EyeRect[2];\n"
+	"attribute mediump float vEye;\n"
+	"varying mediump float i_edge;\n"
+	"#endif\n"
 	"attribute lowp vec3 vCol;\n"
-	"attribute lowp vec2 vPos;\n"
+	"attribute vec3 vPos;\n"
 	"varying lowp vec3 i_color;\n"
 	"void main()\n"
 	"{\n"
-	"    gl_Position = MVP * vec4(vPos, 0.0, 1.0);\n"
+	"#ifdef INSTANCED\n"
+	"    vec4 p = iMVP * vec4(vPos, 1.0);\n"
+	"#else\n"
+	"    vec4 p = MVP * vec4(vPos, 1.0);\n"
+	"#endif\n"
+	"#ifdef STEREO\n"
+	"    int eye = int(vEye);\n"
+	"    i_edge = eye == 0 ? p.w - p.x : p.w + p.x;\n"
+	"    p.x = p.x * EyeRect[eye].x + EyeRect[eye].y * p.w;\n"
+	"#endif\n"
+	"    gl_Position = p;\n"
 	"    i_color = vCol;\n"
 	"}\n";
 static const char *fragment_shader_text =
 	"#version 100\n"
 	"varying lowp vec3 i_color;\n"
+	"#ifdef STEREO\n"
+	"varying mediump float i_edge;\n"
+	"#endif\n"
 	"void main()\n"
 	"{\n"
+	"#ifdef STEREO\n"
+	"    if (i_edge < 0.0)\n"
+	"        discard;\n"
+	"#endif\n"
 	"    gl_FragColor = vec4(i_color, 1.0);\n"
 	"}\n";
+static const float eye_indices[2] = {0.f, 1.f};
 
-static int checkShaderCompiled(shader)
-{
-	GLint success = 0;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-
-	if (success == GL_FALSE)
-	{
-		GLint max_len = 0;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &max_len);
-
-		GLchar err_log[max_len];
-		glGetShaderInfoLog(shader, max_len, &max_len, &err_log[0]);
-		glDeleteShader(shader);
-
-		fprintf(stderr, "Shader compilation failed: %s\n", err_log);
-	}
+// Set once every program has finished linking and its uniforms are looked up
+int gProgramsReady;
 
-	return success;
+// Whether the display is presenting, as captured
+static int displayPresenting()
+{
+	int presenting = emscripten_vr_display_presenting(gDisplay);
+	frameCapturePresenting(&gCapture, presenting);
+	return presenting;
 }
 
-static int checkShaderProgramLinked(program)
+// Hand the log captured so far to the platform
+static void saveCapture()
 {
-	GLint success = 0;
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
-
-	if (success == GL_FALSE)
-	{
-		GLint max_len = 0;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &max_len);
-
-		GLchar err_log[max_len];
-		glGetProgramInfoLog(program, max_len, &max_len, &err_log[0]);
-
-		fprintf(stderr, "Program linking failed: %s\n", err_log);
-	}
+	if (!gCapture.frames)
+		return;
+	frameCaptureSave(gCapture.words, frameCaptureSize(&gCapture));
+	printf("Saved a capture of %lu frames, %.1f KB%s\n", gCapture.frames, frameCaptureSize(&gCapture) / 1024.0,
+		gCapture.full ? ", cut short when the buffer filled up" : "");
+}
 
-	return success;
+// Point the vertex attributes at the object mesh. Its positions are 2D, the
+// shaders' vec3 vPos gets z = 0.
+static void bindObjectVertices()
+{
+	glStateBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	vertexFormatBind(&gObjectFormat, VPOS_LOCATION, VCOL_LOCATION, 0);
 }
 
 // Init GL context and resources
@@ -98,62 +402,853 @@ static void initGL()
 	attr.minorVersion = 0;
 	EMSCRIPTEN_WEBGL_CONTEXT_HANDLE ctx = emscripten_webgl_create_context(0, &attr);
 	emscripten_webgl_make_context_current(ctx);
+	glStateReset();
+
+	// Programs are compiled in the background where possible and only waited
+	// for once the render loop needs them, see programsReady
+	shaderCacheInit(emscripten_webgl_enable_extension(ctx, "KHR_parallel_shader_compile"));
+	shaderCacheBindAttrib(VPOS_LOCATION, "vPos");
+	shaderCacheBindAttrib(VCOL_LOCATION, "vCol");
+	shaderCacheBindAttrib(VEYE_LOCATION, "vEye");
+	shaderCacheBindAttrib(IMVP_LOCATION, "iMVP");
+
+#ifdef GPU_TIMING
+	gpuTimerInit(emscripten_webgl_enable_extension(ctx, "EXT_disjoint_timer_query"));
+#endif
+
+	gInstancing = emscripten_webgl_enable_extension(ctx, "ANGLE_instanced_arrays");
+	if (gInstancing)
+	{
+		// Room for the MVPs of both eyes, refilled every frame
+		glGenBuffers(1, &mvp_buffer);
+		glStateBindBuffer(GL_ARRAY_BUFFER, mvp_buffer);
+		glCmdBufferData(GL_ARRAY_BUFFER, 2 * gScene.capacity * sizeof(mat4x4), NULL, GL_DYNAMIC_DRAW);
+
+		instanced_program = shaderCacheProgram(vertex_shader_text, "#define INSTANCED\n", fragment_shader_text, NULL);
 
+		for (int c = 0; c < 4; ++c)
+		{
+			glStateEnableVertexAttribArray(IMVP_LOCATION + c);
+			glStateVertexAttribDivisor(IMVP_LOCATION + c, 1);
+		}
+	}
+
+	gSinglePassStereo = SINGLE_PASS_STEREO && gInstancing;
+	if (gSinglePassStereo)
+	{
+		glGenBuffers(1, &eye_buffer);
+		glStateBindBuffer(GL_ARRAY_BUFFER, eye_buffer);
+		glCmdBufferData(GL_ARRAY_BUFFER, sizeof(eye_indices), eye_indices, GL_STATIC_DRAW);
+
+		stereo_program = shaderCacheProgram(vertex_shader_text, "#define INSTANCED\n#define STEREO\n",
+			fragment_shader_text, "#define STEREO\n");
+
+		// The eye index advances once per scene worth of instances
+		glStateEnableVertexAttribArray(VEYE_LOCATION);
+		glStateVertexAttribPointer(VEYE_LOCATION, 1, GL_FLOAT, GL_FALSE, 0, (void *)0);
+		glStateVertexAttribDivisor(VEYE_LOCATION, gScene.count);
+	}
+
+	// Encoded for upload in the format initScene picked, floats are the largest
+	unsigned char encoded[sizeof(gObjectVertices)];
+	vertexFormatEncode(&gObjectFormat, &gObjectDequantization, encoded, &gObjectVertices[0].x, 5, OBJECT_VERTICES);
 	glGenBuffers(1, &vertex_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glStateBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	glCmdBufferData(GL_ARRAY_BUFFER, OBJECT_VERTICES * gObjectFormat.stride, encoded, GL_STATIC_DRAW);
 
-	vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex_shader, 1, &vertex_shader_text, NULL);
-	glCompileShader(vertex_shader);
-	checkShaderCompiled(vertex_shader);
+	program = shaderCacheProgram(vertex_shader_text, NULL, fragment_shader_text, NULL);
 
-	fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment_shader, 1, &fragment_shader_text, NULL);
-	glCompileShader(fragment_shader);
-	checkShaderCompiled(fragment_shader);
+	glStateEnableVertexAttribArray(VPOS_LOCATION);
+	glStateEnableVertexAttribArray(VCOL_LOCATION);
+	bindObjectVertices();
 
-	program = glCreateProgram();
-	glAttachShader(program, vertex_shader);
-	glAttachShader(program, fragment_shader);
-	glLinkProgram(program);
-	checkShaderProgramLinked(program);
+	vertexStreamInit(&gStream, STREAM_BUFFER_SIZE);
+	glCmdFlush();
+#if DEBUG_BOUNDS
+	for (int i = 0; i <= DEBUG_CIRCLE_SEGMENTS; ++i)
+	{
+		gCircle[i][0] = cosf(2.0f * (float)M_PI * i / DEBUG_CIRCLE_SEGMENTS);
+		gCircle[i][1] = sinf(2.0f * (float)M_PI * i / DEBUG_CIRCLE_SEGMENTS);
+	}
+#endif
+}
+
+// Upload where each eye's half of the canvas lies in clip space
+static void uploadEyeRect()
+{
+	float width = (float)(gRenderWidth[0] + gRenderWidth[1]);
+	float left = gRenderWidth[0] / width;
+	float right = gRenderWidth[1] / width;
+	float eyeRect[2][2] =
+	{
+		{left, left - 1.0f},
+		{right, 1.0f - right}
+	};
+	glStateUseProgram(stereo_program);
+	glStateUniform2fv(stereo_eye_rect_location, 2, &eyeRect[0][0]);
+}
+
+// Returns 1 once all programs are linked, looking up their uniforms the first
+// time. Until then frames are only cleared, without waiting for the compiler.
+static int programsReady()
+{
+	if (gProgramsReady)
+		return 1;
+
+	GLuint programs[3] = {program, instanced_program, stereo_program};
+	for (int i = 0; i < 3; ++i)
+	{
+		if (programs[i] && !shaderCacheProgramReady(programs[i]))
+			return 0;
+	}
+	for (int i = 0; i < 3; ++i)
+	{
+		if (programs[i])
+			shaderCacheCheckProgram(programs[i]);
+	}
 
 	mvp_location = glGetUniformLocation(program, "MVP");
-	vpos_location = glGetAttribLocation(program, "vPos");
-	vcol_location = glGetAttribLocation(program, "vCol");
-	glEnableVertexAttribArray(vpos_location);
-	glVertexAttribPointer(vpos_location, 2, GL_FLOAT, GL_FALSE,
-						  sizeof(float) * 5, (void *)0);
-	glEnableVertexAttribArray(vcol_location);
-	glVertexAttribPointer(vcol_location, 3, GL_FLOAT, GL_FALSE,
-						  sizeof(float) * 5, (void *)(sizeof(float) * 2));
+	if (gSinglePassStereo)
+	{
+		stereo_eye_rect_location = glGetUniformLocation(stereo_program, "EyeRect");
+		if (displayPresenting())
+			uploadEyeRect();
+	}
+
+	ShaderCacheStats stats;
+	shaderCacheGetStats(&stats);
+	printf("Shader programs ready: %u shaders compiled (%u reused), %u programs linked\n",
+		stats.shadersCompiled, stats.shaderHits, stats.programsLinked);
+
+	gProgramsReady = 1;
+	return 1;
+}
+
+// Fill gObjectVertices and gObjectMesh: the triangle, or with LOD the levels
+// of the disc, finest first. A level's error is how far its edge is inside
+// the circle.
+static void initObjectMesh()
+{
+#if LOD
+	int first = 0;
+	gObjectMesh.levelCount = LOD_MAX_LEVELS;
+	for (int l = 0; l < LOD_MAX_LEVELS; ++l)
+	{
+		int n = gDiscSegments[l];
+		LodLevel *level = &gObjectMesh.levels[l];
+		level->first = first;
+		level->count = 3 * n;
+		level->triangles = n;
+		level->error = DISC_RADIUS * (1.0f - cosf((float)M_PI / n));
+		for (int i = 0; i < n; ++i)
+		{
+			ObjectVertex *v = &gObjectVertices[first + 3 * i];
+			v[0] = (ObjectVertex){0.f, 0.f, 1.f, 1.f, 1.f};
+			for (int k = 1; k < 3; ++k)
+			{
+				float a = 2.0f * (float)M_PI * (i + k - 1) / n;
+				v[k].x = DISC_RADIUS * cosf(a);
+				v[k].y = DISC_RADIUS * sinf(a);
+				v[k].r = 0.5f + 0.5f * cosf(a);
+				v[k].g = 0.5f + 0.5f * cosf(a - 2.0f * (float)M_PI / 3.0f);
+				v[k].b = 0.5f + 0.5f * cosf(a + 2.0f * (float)M_PI / 3.0f);
+			}
+		}
+		first += 3 * n;
+	}
+#else
+	memcpy(gObjectVertices, vertices, sizeof(vertices));
+	gObjectMesh.levelCount = 1;
+	gObjectMesh.levels[0] = (LodLevel){0, 3, 1, 0.0f};
+#endif
+}
+
+// Build the scene, before GL resources are sized from it
+static int initScene()
+{
+	int chunks = (SCENE_OBJECTS + JOB_GRAIN - 1) / JOB_GRAIN;
+	if (!sceneInit(&gScene, SCENE_OBJECTS) || !(gMvp = malloc(2 * SCENE_OBJECTS * sizeof(mat4x4)))
+		|| !(gVisible = malloc(SCENE_OBJECTS * sizeof(int)))
+		|| !(gChunkVisible = malloc(chunks * sizeof(int)))
+		|| !(gGroupedVisible = malloc(SCENE_OBJECTS * sizeof(int)))
+		|| !(gLevel = malloc(SCENE_OBJECTS))
+		|| !(gChunkLevelChanges = malloc(chunks * sizeof(int)))
+		|| (OCCLUSION && !occlusionInit(&gOcclusion, OCCLUSION_WIDTH, OCCLUSION_HEIGHT)))
+	{
+		fprintf(stderr, "Out of memory for %d scene objects\n", SCENE_OBJECTS);
+		return 0;
+	}
+
+	// Every object is the same mesh, spinning around its origin
+	initObjectMesh();
+	memset(gLevel, LOD_NO_LEVEL, SCENE_OBJECTS);
+	float radius = 0.0f;
+	for (int i = 0; i < OBJECT_VERTICES; ++i)
+	{
+		const ObjectVertex *v = &gObjectVertices[i];
+		radius = fmaxf(radius, sqrtf(v->x * v->x + v->y * v->y));
+	}
+
+#if COMPACT_VERTICES
+	vertexFormatInit(&gObjectFormat, GL_UNSIGNED_SHORT, 2, GL_UNSIGNED_BYTE, 3);
+#else
+	vertexFormatInit(&gObjectFormat, GL_FLOAT, 2, GL_FLOAT, 3);
+#endif
+	vertexDequantizationFromBounds(&gObjectDequantization, &gObjectFormat, &gObjectVertices[0].x, 5, OBJECT_VERTICES);
+	sceneSetMeshDequantization(&gScene, gObjectDequantization.scale, gObjectDequantization.offset);
+
+	quat q;
+	quat_identity(q);
+	vec3 p = {0.0f, 0.0f, -1.0f};
+	sceneAdd(&gScene, p, q, 1.0f, radius);
+
+	int side = (int)ceilf(sqrtf((float)SCENE_OBJECTS));
+	for (int i = 1; i < SCENE_OBJECTS; ++i)
+	{
+		p[0] = ((i % side) - side * 0.5f) * 0.2f;
+		p[1] = ((i / side) - side * 0.5f) * 0.2f;
+		p[2] = -4.0f;
+		sceneAdd(&gScene, p, q, 0.1f, radius);
+	}
+
+	return 1;
+}
+
+// Simulation ticks of a frame, and where to interpolate the world matrices
+typedef struct UpdateJob
+{
+	unsigned long long firstTick;
+	int ticks;
+	float alpha;
+} UpdateJob;
+
+// Objects only depend on themselves, so a range runs all ticks of the frame
+// and then interpolates, in a single pass
+static void updateSceneRange(void *userData, int first, int count)
+{
+	const UpdateJob *job = userData;
+	vec3 axis = {0.0f, 0.0f, 1.0f};
+	for (int tick = 0; tick < job->ticks; ++tick)
+	{
+		double t = simClockTickTime(&gSimClock, job->firstTick + tick);
+		for (int i = first; i < first + count; ++i)
+		{
+			memcpy(gScene.previousRotation[i], gScene.rotation[i], sizeof(quat));
+			quat_rotate(gScene.rotation[i], (float)fmod(t * (1.0 + 0.1 * (i % 8)), 2.0 * M_PI), axis);
+		}
+	}
+
+	sceneUpdateWorldInterpolated(&gScene, job->alpha, first, count);
+}
+
+// Advance the simulation clock to now, spinning every object around its Z
+// axis once per tick, and update the world matrices. Called once per frame,
+// so all views of a frame see the same state.
+static void updateScene()
+{
+	UpdateJob job;
+	job.firstTick = gSimClock.ticks + 1;
+	job.ticks = simClockAdvance(&gSimClock, emscripten_get_now());
+	job.alpha = simClockAlpha(&gSimClock);
+	jobsParallelFor(gScene.count, JOB_GRAIN, updateSceneRange, &job);
+}
+
+// Print how far the simulation got
+static void reportSimulation()
+{
+	if (!gSimClock.ticks)
+		return;
+	printf("Simulation: %llu ticks of %.2f ms, %.1f ms skipped\n",
+		gSimClock.ticks, gSimClock.stepMs, gSimClock.droppedMs);
+}
+
+// Culls the range chunk by chunk. Each chunk's visible objects are packed at
+// the start of the chunk's part of gVisible, cullScene closes the gaps.
+static void cullRange(void *userData, int first, int count)
+{
+	const Frustum *frustum = userData;
+	for (int chunk = first; chunk < first + count; chunk += JOB_GRAIN)
+	{
+		int n = first + count - chunk < JOB_GRAIN ? first + count - chunk : JOB_GRAIN;
+		gChunkVisible[chunk / JOB_GRAIN] = cullSpheres(frustum, gScene.position, gScene.radius, gScene.scale,
+			chunk, n, gVisible + chunk);
+	}
+}
+
+// Fill gVisible with the objects at least partly inside the frustum
+static void cullScene(const Frustum *frustum)
+{
+	jobsParallelFor(gScene.count, JOB_GRAIN, cullRange, (void *)frustum);
+
+	int visible = gChunkVisible[0];
+	for (int chunk = 1; chunk * JOB_GRAIN < gScene.count; ++chunk)
+	{
+		memmove(gVisible + visible, gVisible + chunk * JOB_GRAIN, gChunkVisible[chunk] * sizeof(int));
+		visible += gChunkVisible[chunk];
+	}
+	gVisibleCount = gScene.count ? visible : 0;
+
+	++gCullPasses;
+	gCullTested += gScene.count;
+	gCullVisible += gVisibleCount;
+}
+
+#if OCCLUSION
+// Tests the range against gOcclusion chunk by chunk, packing what is not
+// hidden at the start of each chunk's part of gVisible like cullRange
+static void occludeRange(void *userData, int first, int count)
+{
+	(void)userData;
+	for (int chunk = first; chunk < first + count; chunk += JOB_GRAIN)
+	{
+		int n = first + count - chunk < JOB_GRAIN ? first + count - chunk : JOB_GRAIN;
+		gChunkVisible[chunk / JOB_GRAIN] = occlusionCullSpheres(&gOcclusion, gScene.position, gScene.radius,
+			gScene.scale, gVisible + chunk, n);
+	}
+}
+
+// Rasterize the walls into gOcclusion, cleared for the frame's view, and
+// drop the objects of gVisible hidden behind them
+static void occludeScene()
+{
+	double start = emscripten_get_now();
+	for (int i = 0; i < WALL_COUNT; ++i)
+		occlusionRasterize(&gOcclusion, gWallWorld[i], &gWallOccluder);
+	occlusionFinish(&gOcclusion);
+	double rasterized = emscripten_get_now();
+
+	jobsParallelFor(gVisibleCount, JOB_GRAIN, occludeRange, NULL);
+	int visible = gVisibleCount ? gChunkVisible[0] : 0;
+	for (int chunk = 1; chunk * JOB_GRAIN < gVisibleCount; ++chunk)
+	{
+		memmove(gVisible + visible, gVisible + chunk * JOB_GRAIN, gChunkVisible[chunk] * sizeof(int));
+		visible += gChunkVisible[chunk];
+	}
+	gOcclusionTested += gVisibleCount;
+	gOcclusionHidden += gVisibleCount - visible;
+	gVisibleCount = visible;
+
+	gOcclusionRasterizeMs += rasterized - start;
+	gOcclusionTestMs += emscripten_get_now() - rasterized;
+}
+#endif
+
+// Print what occlusion culling removed on top of the frustum, and its cost
+static void reportOcclusion()
+{
+	unsigned long frames = gOcclusion.stats.frames;
+	if (!frames)
+		return;
+	printf("Occlusion: %.1f of %.1f objects in the frustum hidden per frame (%.1f%%), %.3f ms rasterizing %.1f occluder triangles and %.3f ms testing per frame\n",
+		(double)gOcclusionHidden / frames, (double)gOcclusionTested / frames,
+		gOcclusionTested ? 100.0 * gOcclusionHidden / gOcclusionTested : 0.0,
+		gOcclusionRasterizeMs / frames, (double)gOcclusion.stats.triangles / frames, gOcclusionTestMs / frames);
+}
+
+static void selectLevelsRange(void *userData, int first, int count)
+{
+	const LodView *view = userData;
+	for (int chunk = first; chunk < first + count; chunk += JOB_GRAIN)
+	{
+		int n = first + count - chunk < JOB_GRAIN ? first + count - chunk : JOB_GRAIN;
+		gChunkLevelChanges[chunk / JOB_GRAIN] = lodSelect(&gObjectMesh, view, gScene.position, gScene.radius,
+			gScene.scale, gVisible + chunk, n, gLevel);
+	}
+}
+
+// Pick the level of every visible object for all views of the frame, and
+// group gVisible by level
+static void selectLevels(const LodView *view)
+{
+	int levels = gObjectMesh.levelCount;
+	if (levels == 1)
+	{
+		gLevelStart[0] = 0;
+		gLevelStart[1] = gVisibleCount;
+		gLevelObjects[0] += gVisibleCount;
+		return;
+	}
+
+	jobsParallelFor(gVisibleCount, JOB_GRAIN, selectLevelsRange, (void *)view);
+	for (int chunk = 0; chunk * JOB_GRAIN < gVisibleCount; ++chunk)
+		gLevelChanges += gChunkLevelChanges[chunk];
+
+	lodGroup(gVisible, gVisibleCount, gLevel, levels, gGroupedVisible, gLevelStart);
+	int *grouped = gGroupedVisible;
+	gGroupedVisible = gVisible;
+	gVisible = grouped;
+	for (int l = 0; l < levels; ++l)
+		gLevelObjects[l] += gLevelStart[l + 1] - gLevelStart[l];
+}
+
+// Print the triangles the scene objects took, and how levels of detail cut them
+static void reportLevels()
+{
+	if (!gCullPasses || !gFullDetailTriangles)
+		return;
+	printf("Scene triangles: %.1f per frame", (double)gTrianglesDrawn / gCullPasses);
+	if (gObjectMesh.levelCount > 1)
+	{
+		printf(", %.1f%% of the %.1f at full detail, objects per level", 100.0 * gTrianglesDrawn / gFullDetailTriangles,
+			(double)gFullDetailTriangles / gCullPasses);
+		for (int l = 0; l < gObjectMesh.levelCount; ++l)
+			printf("%s%.1f", l ? "/" : " ", (double)gLevelObjects[l] / gCullPasses);
+		printf(", %.2f level changes per frame", (double)gLevelChanges / gCullPasses);
+	}
+	printf("\n");
+}
+
+// Print how much culling removed
+static void reportCulling()
+{
+	if (!gCullPasses)
+		return;
+	printf("Culling: %.1f of %d objects visible per frame (%.1f%% culled)\n",
+		(double)gCullVisible / gCullPasses, gScene.count,
+		gCullTested ? 100.0 * (gCullTested - gCullVisible) / gCullTested : 0.0);
+}
+
+// MVPs of the visible objects from gVisible[first] on in one or two views,
+// out[v][i] = viewProjection[v] * world[gVisible[first + i]]
+typedef struct MvpJob
+{
+	int views, first;
+	mat4x4 viewProjection[2];
+	mat4x4 *out[2];
+} MvpJob;
+
+static void computeMvpRange(void *userData, int first, int count)
+{
+	MvpJob *job = userData;
+	for (int v = 0; v < job->views; ++v)
+	{
+		sceneComputeMvpIndexed(&gScene, job->viewProjection[v], job->out[v] + first,
+			gVisible + job->first + first, count);
+	}
 }
 
-// Render a single view. Called once or twice depending on VR being active
-static void drawView(mat4x4 projection, mat4x4 camera)
+// Adds the triangles views draws at the current levels, and what full detail
+// would have taken
+static void countTriangles(int views)
 {
-	mat4x4 m, mv, mvp;
-	mat4x4_translate(m, 0.0f, 0.0, -1.0f);
-	mat4x4_rotate_Z(m, m, (float)emscripten_get_now() / 1000.0f);
-	mat4x4_mul(mv, camera, m);
-	mat4x4_mul(mvp, projection, mv);
-	glUseProgram(program);
-	glUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat *)mvp);
-	glDrawArrays(GL_TRIANGLES, 0, 3);
+	for (int l = 0; l < gObjectMesh.levelCount; ++l)
+	{
+		unsigned long long objects = (unsigned long long)views * (gLevelStart[l + 1] - gLevelStart[l]);
+		gTrianglesDrawn += objects * gObjectMesh.levels[l].triangles;
+		gFullDetailTriangles += objects * gObjectMesh.levels[0].triangles;
+	}
 }
 
+// Point the per-instance MVP attribute at the MVPs starting at instance first.
+// Expects mvp_buffer to be bound.
+static void bindInstanceMvps(int first)
+{
+	for (int c = 0; c < 4; ++c)
+	{
+		glStateVertexAttribPointer(IMVP_LOCATION + c, 4, GL_FLOAT, GL_FALSE,
+							  sizeof(mat4x4), (void *)(first * sizeof(mat4x4) + c * sizeof(vec4)));
+	}
+}
+
+// Render the visible objects in a single view. Called once or twice depending
+// on VR being active, eye selects which half of gMvp the view uses.
+static void drawView(mat4x4 projection, mat4x4 camera, int eye)
+{
+	int count = gVisibleCount;
+	int offset = eye * gScene.count;
+	mat4x4 *mvp = gMvp + offset;
+	MvpJob job;
+	job.views = 1;
+	job.first = 0;
+	job.out[0] = mvp;
+	mat4x4_mul_affine(job.viewProjection[0], projection, camera);
+	jobsParallelFor(count, JOB_GRAIN, computeMvpRange, &job);
+
+	if (gInstancing)
+	{
+		// All MVPs of the view go up in one upload and are drawn in one call
+		// per level
+		glStateBindBuffer(GL_ARRAY_BUFFER, mvp_buffer);
+		glCmdBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(mat4x4), count * sizeof(mat4x4), mvp);
+		glStateUseProgram(instanced_program);
+		for (int l = 0; l < gObjectMesh.levelCount; ++l)
+		{
+			const LodLevel *level = &gObjectMesh.levels[l];
+			int first = gLevelStart[l], n = gLevelStart[l + 1] - first;
+			if (!n)
+				continue;
+			bindInstanceMvps(offset + first);
+			glCmdDrawArraysInstanced(GL_TRIANGLES, level->first, level->count, n);
+		}
+	}
+	else
+	{
+		glStateUseProgram(program);
+		for (int l = 0; l < gObjectMesh.levelCount; ++l)
+		{
+			const LodLevel *level = &gObjectMesh.levels[l];
+			for (int i = gLevelStart[l]; i < gLevelStart[l + 1]; ++i)
+			{
+				glStateUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat *)mvp[i]);
+				glCmdDrawArrays(GL_TRIANGLES, level->first, level->count);
+			}
+		}
+	}
+	countTriangles(1);
+}
+
+// Render the visible objects for both eyes side by side with a single
+// instanced draw call
+static void drawStereo(mat4x4 leftProjection, mat4x4 leftCamera, mat4x4 rightProjection, mat4x4 rightCamera)
+{
+	int count = gVisibleCount;
+	if (!count)
+		return;
+	// Each level's objects are drawn by one instanced draw, so the MVPs are
+	// laid out level by level: those of the left eye, then the right eye
+	MvpJob job;
+	job.views = 2;
+	mat4x4_mul_affine(job.viewProjection[0], leftProjection, leftCamera);
+	mat4x4_mul_affine(job.viewProjection[1], rightProjection, rightCamera);
+	for (int l = 0; l < gObjectMesh.levelCount; ++l)
+	{
+		int first = gLevelStart[l], n = gLevelStart[l + 1] - first;
+		job.first = first;
+		job.out[0] = gMvp + 2 * first;
+		job.out[1] = gMvp + 2 * first + n;
+		jobsParallelFor(n, JOB_GRAIN, computeMvpRange, &job);
+	}
+
+	glStateBindBuffer(GL_ARRAY_BUFFER, mvp_buffer);
+	glCmdBufferSubData(GL_ARRAY_BUFFER, 0, 2 * count * sizeof(mat4x4), gMvp);
+	glStateUseProgram(stereo_program);
+	for (int l = 0; l < gObjectMesh.levelCount; ++l)
+	{
+		const LodLevel *level = &gObjectMesh.levels[l];
+		int first = gLevelStart[l], n = gLevelStart[l + 1] - first;
+		if (!n)
+			continue;
+		// The eye index has to advance after the level's objects of the left eye
+		glStateVertexAttribDivisor(VEYE_LOCATION, n);
+		bindInstanceMvps(2 * first);
+		glCmdDrawArraysInstanced(GL_TRIANGLES, level->first, level->count, 2 * n);
+	}
+	countTriangles(2);
+}
+
+#if STATIC_BATCHES
+// Lay out the floor tiles in a square below and in front of the viewer, and
+// the walls standing on it halfway to the objects. Needs the programs
+// created, not linked.
+static int initStaticObjects()
+{
+	int count = STATIC_OBJECTS + WALL_COUNT;
+	if (!staticBatcherInit(&gStaticBatcher, count, VPOS_LOCATION, VCOL_LOCATION))
+	{
+		fprintf(stderr, "Out of memory for %d static objects\n", count);
+		return 0;
+	}
+
+#if STATIC_OBJECTS
+	int side = (int)ceilf(sqrtf((float)STATIC_OBJECTS));
+	for (int i = 0; i < STATIC_OBJECTS; ++i)
+	{
+		int column = i % side, row = i / side;
+		mat4x4 world;
+		mat4x4_translate(world, (column - side * 0.5f) * TILE_PITCH, -1.5f, -0.5f - row * TILE_PITCH);
+		staticBatcherAdd(&gStaticBatcher, program, &gTileMeshes[(column + row) & 1], world);
+	}
+#endif
+#if OCCLUSION
+	if (!occluderMeshInit(&gWallOccluder, &gWallVertices[0].x, sizeof(BatchVertex) / sizeof(float), gWallIndices, 6))
+	{
+		fprintf(stderr, "Out of memory for the occluders\n");
+		return 0;
+	}
+	for (int i = 0; i < WALL_COUNT; ++i)
+	{
+		mat4x4_translate(gWallWorld[i], (i ? 1.f : -1.f) * (WALL_HALF_WIDTH + 0.5f), WALL_HALF_HEIGHT - 1.5f, -2.5f);
+		staticBatcherAdd(&gStaticBatcher, program, &gWallMesh, gWallWorld[i]);
+	}
+#endif
+	return 1;
+}
+
+// Draw the static objects, building the batches first if they changed, and
+// point the attributes back at the triangle
+static void drawStaticBatches(mat4x4 viewProjection)
+{
+	staticBatcherBuild(&gStaticBatcher);
+	staticBatcherDraw(&gStaticBatcher, viewProjection);
+	bindObjectVertices();
+}
+#endif
+
+// Print how many draw calls static batching saved
+static void reportStaticBatches()
+{
+	const StaticBatchStats *stats = &gStaticBatcher.stats;
+	if (!stats->views)
+		return;
+	printf("Static batches: %d objects of %d programs in %d batches, %.1f draws per view instead of %.1f (%lu rebuilds, %.1f KB uploaded)\n",
+		stats->objects, stats->programs, stats->batches, (double)stats->draws / stats->views,
+		(double)(stats->draws + stats->drawsSaved) / stats->views, stats->rebuilds, stats->bytesUploaded / 1024.0);
+}
+
+#if DEBUG_BOUNDS
+// Stream and draw the bounding circles of the visible objects, in batches of
+// what fits in one stream buffer
+static void drawDebugBounds(mat4x4 viewProjection)
+{
+	glStateUseProgram(program);
+	glStateUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat *)viewProjection);
+
+	for (int first = 0; first < gVisibleCount; first += DEBUG_BATCH_OBJECTS)
+	{
+		int count = gVisibleCount - first < (int)DEBUG_BATCH_OBJECTS ? gVisibleCount - first : (int)DEBUG_BATCH_OBJECTS;
+		DebugVertex *v = gDebugVertices;
+		for (int i = first; i < first + count; ++i)
+		{
+			int object = gVisible[i];
+			const float *center = gScene.position[object];
+			float radius = gScene.radius[object] * gScene.scale[object];
+			for (int s = 0; s < DEBUG_CIRCLE_SEGMENTS; ++s)
+			{
+				for (int end = 0; end < 2; ++end, ++v)
+				{
+					v->x = center[0] + radius * gCircle[s + end][0];
+					v->y = center[1] + radius * gCircle[s + end][1];
+					v->z = center[2];
+					v->r = v->g = 1.0f;
+					v->b = 0.0f;
+				}
+			}
+		}
+
+		int vertexCount = (int)(v - gDebugVertices);
+		int offset = vertexStreamWrite(&gStream, gDebugVertices, vertexCount * sizeof(DebugVertex), sizeof(float));
+		glStateVertexAttribPointer(VPOS_LOCATION, 3, GL_FLOAT, GL_FALSE,
+							  sizeof(DebugVertex), (void *)(intptr_t)offset);
+		glStateVertexAttribPointer(VCOL_LOCATION, 3, GL_FLOAT, GL_FALSE,
+							  sizeof(DebugVertex), (void *)(intptr_t)(offset + 3 * sizeof(float)));
+		glCmdDrawArrays(GL_LINES, 0, vertexCount);
+	}
+
+	bindObjectVertices();
+}
+#endif
+
+// Print how many state calls the GL state cache saved
+static void reportGLState()
+{
+	GLStateStats total;
+	glStateTotalStats(&total);
+	if (!total.issued)
+		return;
+	GLStateStats frame;
+	glStateFrameStats(&frame);
+	printf("GL state calls: %lu issued and %lu elided in the last frame (%lu and %lu in total)\n",
+		frame.issued, frame.elided, total.issued, total.elided);
+}
+
+#if MESH_STREAMING
+// Upload what arrived of the mesh file and keep the chunks inside the frustum
+static void updateMeshStream(const Frustum *frustum)
+{
+	static int failed;
+	int ready = meshStreamUpdate(&gMeshStream);
+	if (ready < 0 && !failed)
+	{
+		fprintf(stderr, "Mesh file %s could not be loaded, %d chunks made it\n", MESH_FILE, gMeshStream.uploaded);
+		failed = 1;
+	}
+	double now = emscripten_get_now();
+	if (ready > 0 && gMeshFirstDrawTime == 0.0)
+		gMeshFirstDrawTime = now;
+	if (ready > 0 && ready == gMeshStream.chunkCount && gMeshLoadedTime == 0.0)
+		gMeshLoadedTime = now;
+	meshStreamCull(&gMeshStream, frustum);
+}
+#endif
+
+// Print how long the mesh file took to show up and what it drew
+static void reportMeshStream()
+{
+	if (!gMeshStream.chunkCount)
+		return;
+	printf("Mesh stream: %d of %d chunks, %.1f MB uploaded, first drawn after %.1f ms, all after %.1f ms, %.1f draws and %.0f triangles per view\n",
+		gMeshStream.uploaded, gMeshStream.chunkCount, gMeshStream.bytesUploaded / 1048576.0,
+		gMeshFirstDrawTime > 0.0 ? gMeshFirstDrawTime - gMeshStreamStart : -1.0,
+		gMeshLoadedTime > 0.0 ? gMeshLoadedTime - gMeshStreamStart : -1.0,
+		gMeshStream.views ? (double)gMeshStream.draws / gMeshStream.views : 0.0,
+		gMeshStream.views ? (double)gMeshStream.trianglesDrawn / gMeshStream.views : 0.0);
+}
+
+#if VIEW_EXTRAS
+// Draw what is not part of the scene's instanced draws, for one view. Leaves
+// the attributes pointing at the triangle.
+static void drawViewExtras(mat4x4 viewProjection)
+{
+#if STATIC_BATCHES
+	drawStaticBatches(viewProjection);
+#endif
+#if MESH_STREAMING
+	meshStreamDraw(&gMeshStream, viewProjection, program, mvp_location, VPOS_LOCATION, VCOL_LOCATION);
+	bindObjectVertices();
+#endif
+#if DEBUG_BOUNDS
+	drawDebugBounds(viewProjection);
+#endif
+}
+#endif
+
+// Print how the command buffer batched the GL calls
+static void reportCommandBuffer()
+{
+#ifdef GL_COMMAND_BUFFER
+	GLCmdStats stats;
+	glCmdStats(&stats);
+	if (!stats.flushes)
+		return;
+	printf("Command buffer: %lu commands in %lu flushes (%.1f commands and %.1f KB per flush), %lu made directly\n",
+		stats.commands, stats.flushes, (double)stats.commands / stats.flushes,
+		stats.bytes / 1024.0 / stats.flushes, stats.direct);
+#endif
+}
+
+// Print how much vertex data was streamed
+static void reportStreaming()
+{
+	if (!gStream.frames || !gStream.bytesTotal)
+		return;
+	printf("Streamed %.1f KB of vertices per frame (%lu buffer orphans)\n",
+		gStream.bytesTotal / 1024.0 / gStream.frames, gStream.orphans);
+}
+
+// Head pose of the frame data as a position, the origin if it is not tracked,
+// and a normalized orientation quaternion. Returns 0 if the pose has no
+// orientation or prediction is off.
+static int framePose(const VRFrameData *data, vec3 position, quat orientation)
+{
+	const VRPose *pose = &data->pose;
+	if (!POSE_PREDICTION || !(pose->poseFlags & VR_POSE_ORIENTATION))
+		return 0;
+
+	position[0] = position[1] = position[2] = 0.f;
+	if (pose->poseFlags & VR_POSE_POSITION)
+	{
+		position[0] = pose->position.x;
+		position[1] = pose->position.y;
+		position[2] = pose->position.z;
+	}
+	orientation[0] = pose->orientation.x;
+	orientation[1] = pose->orientation.y;
+	orientation[2] = pose->orientation.z;
+	orientation[3] = pose->orientation.w;
+	quat_norm(orientation, orientation);
+	return 1;
+}
+
+// Re-derive an eye's view matrix for the head pose predicted at the expected
+// scanout time. frameDataTime is when the frame data was read. The eye
+// transform baked into the measured view is kept: view' = view * head * inverse(head').
+static void latchView(mat4x4 out, float *view, const VRFrameData *data, double frameDataTime)
+{
+	vec3 position, predictedPosition;
+	quat orientation, predictedOrientation;
+	if (!framePose(data, position, orientation))
+	{
+		mat4x4_dup(out, *(mat4x4 *)view);
+		return;
+	}
+
+	double target = data->timestamp + (emscripten_get_now() - frameDataTime) + POSE_SCANOUT_LEAD_MS;
+	posePredictorPredict(&gPosePredictor, target, predictedPosition, predictedOrientation);
+
+	// Both poses are rigid, so the correction is composed without matrices
+	Transform head, predicted, inverse, correction;
+	transformSet(&head, position, orientation, 1.f);
+	transformSet(&predicted, predictedPosition, predictedOrientation, 1.f);
+	transformInvert(&inverse, &predicted);
+	transformCompose(&correction, &head, &inverse);
+
+	mat4x4 m;
+	transformToMat4x4(m, &correction);
+	mat4x4_mul_affine(out, *(mat4x4 *)view, m);
+}
+
+// Print how far predicted and unpredicted poses were off at scanout
+static void reportPosePrediction()
+{
+	const PosePredictionStats *p = &gPosePredictor.predicted;
+	const PosePredictionStats *u = &gPosePredictor.unpredicted;
+	if (!p->samples)
+		return;
+
+	printf("Pose error at scanout over %u views (mean/max):\n", p->samples);
+	printf("  predicted:   %.3f/%.3f deg, %.2f/%.2f mm\n",
+		p->angleErrorSum / p->samples * 180.0 / M_PI, p->angleErrorMax * 180.0 / M_PI,
+		p->positionErrorSum / p->samples * 1000.0, p->positionErrorMax * 1000.0);
+	printf("  unpredicted: %.3f/%.3f deg, %.2f/%.2f mm\n",
+		u->angleErrorSum / u->samples * 180.0 / M_PI, u->angleErrorMax * 180.0 / M_PI,
+		u->positionErrorSum / u->samples * 1000.0, u->positionErrorMax * 1000.0);
+}
+
+// Size the canvas for the current render scale. Called whenever it changes.
+static void applyRenderScale()
+{
+	float scale = gResolution.scale;
+	gRenderWidth[0] = (int)(gEyeLeft.renderWidth * scale + 0.5f);
+	gRenderWidth[1] = (int)(gEyeRight.renderWidth * scale + 0.5f);
+	gRenderHeight = (int)(gEyeLeft.renderHeight * scale + 0.5f);
+	emscripten_set_canvas_element_size("#canvas", gRenderWidth[0] + gRenderWidth[1], gRenderHeight);
+
+	// Otherwise uploaded once the program is ready
+	if (gSinglePassStereo && gProgramsReady)
+		uploadEyeRect();
+}
+
+// Print where dynamic resolution left the render scale
+static void reportResolution()
+{
+	const ResolutionController *r = &gResolution;
+	if (!DYNAMIC_RESOLUTION || !r->frames)
+		return;
+	printf("Render scale: %.2f at exit, %lu drops and %lu rises over %lu VR frames (%lu missed, %lu CPU bound)\n",
+		r->scale, r->drops, r->rises, r->frames, r->missedFrames, r->cpuBoundFrames);
+}
+
+#ifdef GPU_TIMING
+// Print how the GPU timer queries fared
+static void reportGpuTimer()
+{
+	GpuTimerStats s;
+	gpuTimerStats(&s);
+	if (!s.queries)
+		return;
+	printf("GPU timing: %lu queries, %lu frames read back %.1f frames late on average, %lu not timed with the ring full, %lu dropped as disjoint\n",
+		s.queries, s.frames, s.frames ? s.latencyFrames / (double)s.frames : 0.0, s.skippedFrames, s.disjointFrames);
+}
+#endif
+
 // When VR present request is complete, start VR rendering loop
 static void requestPresentCallback(void *userData)
 {
-	if (emscripten_vr_display_presenting(gDisplay))
+	frameCapturePresentResolved(&gCapture);
+	if (displayPresenting())
 	{
 		emscripten_vr_get_eye_parameters(gDisplay, VREyeLeft, &gEyeLeft);
 		emscripten_vr_get_eye_parameters(gDisplay, VREyeRight, &gEyeRight);
+		frameCaptureEyeParameters(&gCapture, VREyeLeft, &gEyeLeft);
+		frameCaptureEyeParameters(&gCapture, VREyeRight, &gEyeRight);
 
-		emscripten_set_canvas_element_size("#canvas", gEyeLeft.renderWidth + gEyeRight.renderWidth, gEyeLeft.renderHeight);
+		// WebVR 1.1 does not report the refresh rate, assume the common 90 Hz
+		FRAME_TIMING_SET_BUDGET(1000.0 / 90.0);
+		resolutionInit(&gResolution, 1000.0 / 90.0, MIN_RENDER_SCALE, MAX_RENDER_SCALE);
+		gVrFrameStart = 0.0;
 
-		printf("Set canvas size to %lux%lu\n", gEyeLeft.renderWidth + gEyeRight.renderWidth, gEyeLeft.renderHeight);
+		applyRenderScale();
+		printf("Set canvas size to %dx%d\n", gRenderWidth[0] + gRenderWidth[1], gRenderHeight);
 
 		if (!emscripten_vr_set_display_render_loop(gDisplay, vrLoop))
 		{
@@ -167,13 +1262,16 @@ static EM_BOOL clickCallback(int eventType, const EmscriptenMouseEvent *e, void
 {
 	if (!e || eventType != EMSCRIPTEN_EVENT_CLICK)
 		return EM_FALSE;
+	frameCaptureClick(&gCapture, e);
 
-	if (emscripten_vr_display_presenting(gDisplay))
+	if (displayPresenting())
 	{
 		// Stop presenting, and revert to non-VR loop calls
+		saveCapture();
 		emscripten_vr_exit_present(gDisplay);
 		emscripten_vr_cancel_display_render_loop(gDisplay);
 		emscripten_resume_main_loop();
+		FRAME_TIMING_SET_BUDGET(1000.0 / 60.0);
 	}
 	else
 	{
@@ -198,6 +1296,12 @@ static EM_BOOL clickCallback(int eventType, const EmscriptenMouseEvent *e, void
 // Regularly called render function while VR is NOT active
 static void nonVrLoop()
 {
+	frameCaptureBeginFrame(&gCapture, emscripten_get_now(), 0);
+	FRAME_TIMING_BEGIN_FRAME();
+	GPU_TIMING_BEGIN_FRAME();
+	glStateBeginFrame();
+	FRAME_TIMING_BEGIN(FRAME_PHASE_POLL_DISPLAYS);
+
 	// Check if VR system has come online and we can look for a device
 	if (gDisplay == -1 && emscripten_vr_ready())
 	{
@@ -221,7 +1325,7 @@ static void nonVrLoop()
 				{
 					// If we like those caps, use the device
 					gDisplay = display;
-					char* devName = emscripten_vr_get_display_name(display);
+					const char* devName = emscripten_vr_get_display_name(display);
 					printf("Using VRDisplay '%s' (displayId '%d')\n", devName, display);
 
 					printf("Display Capabilities:\n"
@@ -236,58 +1340,256 @@ static void nonVrLoop()
 		}
 	}
 
+	FRAME_TIMING_END(FRAME_PHASE_POLL_DISPLAYS);
+
 	// Draw single view in non-VR mode
+	FRAME_TIMING_BEGIN(FRAME_PHASE_CLEAR);
+	GPU_TIMING_BEGIN(FRAME_PHASE_CLEAR);
 	float ratio;
 	int width, height;
 	emscripten_get_canvas_element_size("#canvas", &width, &height);
+	frameCaptureCanvasSize(&gCapture, width, height);
 	ratio = width / (float)height;
-	glViewport(0, 0, width, height);
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
+	glStateViewport(0, 0, width, height);
+	glStateClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glCmdClear(GL_COLOR_BUFFER_BIT);
+	GPU_TIMING_END(FRAME_PHASE_CLEAR);
+	FRAME_TIMING_END(FRAME_PHASE_CLEAR);
+
+	FRAME_TIMING_BEGIN(FRAME_PHASE_UPDATE_SCENE);
+	updateScene();
+	FRAME_TIMING_END(FRAME_PHASE_UPDATE_SCENE);
 
-	mat4x4 c, p;
+	FRAME_TIMING_BEGIN(FRAME_PHASE_CULL);
+	mat4x4 c, p, vp;
 	mat4x4_identity(c);
 	mat4x4_perspective(p, 1.6f, ratio, 0.01f, 100.0f);
+	mat4x4_mul_affine(vp, p, c);
+	Frustum frustum;
+	frustumFromMatrix(&frustum, vp);
+	cullScene(&frustum);
+#if OCCLUSION
+	occlusionBeginFrame(&gOcclusion, p, c);
+	occludeScene();
+#endif
+	LodView lodView;
+	lodViewInit(&lodView, LOD_PIXEL_ERROR);
+	lodViewAddEye(&lodView, p, c, width, height);
+	selectLevels(&lodView);
+#if MESH_STREAMING
+	updateMeshStream(&frustum);
+#endif
+	FRAME_TIMING_END(FRAME_PHASE_CULL);
 
-	drawView(p, c);
+	FRAME_TIMING_BEGIN(FRAME_PHASE_DRAW);
+	GPU_TIMING_BEGIN(FRAME_PHASE_DRAW);
+	vertexStreamBeginFrame(&gStream);
+	if (programsReady())
+	{
+		drawView(p, c, 0);
+#if VIEW_EXTRAS
+		drawViewExtras(vp);
+#endif
+	}
+	GPU_TIMING_END(FRAME_PHASE_DRAW);
+	glCmdFlush();
+	FRAME_TIMING_END(FRAME_PHASE_DRAW);
+
+	FRAME_TIMING_END_FRAME();
 }
 
 // Regularly called render function while VR is active
 static void vrLoop()
 {
-	if (!emscripten_vr_display_presenting(gDisplay))
+	frameCaptureBeginFrame(&gCapture, emscripten_get_now(), 1);
+	FRAME_TIMING_BEGIN_FRAME();
+	GPU_TIMING_BEGIN_FRAME();
+	glStateBeginFrame();
+
+	if (!displayPresenting())
 	{
+		saveCapture();
 		emscripten_vr_cancel_display_render_loop(gDisplay);
 		emscripten_resume_main_loop();
 		return;
 	}
 
+	// Resize the render target for last frame's timings before anything is
+	// drawn. With GPU_TIMING the GPU load is the time of the last frame read
+	// back, a few frames old; without it only missed frames tell of GPU load.
+	double frameStart = emscripten_get_now();
+	if (DYNAMIC_RESOLUTION && gVrFrameStart > 0.0
+		&& resolutionUpdate(&gResolution, gVrFrameCpuMs, GPU_TIMING_FRAME_MS(), frameStart - gVrFrameStart))
+	{
+		applyRenderScale();
+	}
+	gVrFrameStart = frameStart;
+
+	FRAME_TIMING_BEGIN(FRAME_PHASE_GET_FRAME_DATA);
 	VRFrameData data;
 	if (!emscripten_vr_get_frame_data(gDisplay, &data))
 	{
 		printf("Could not get frame data.\n");
 		return;
 	}
+	frameCaptureFrameData(&gCapture, &data);
+	double frameDataTime = emscripten_get_now();
+
+	vec3 position;
+	quat orientation;
+	if (framePose(&data, position, orientation))
+		posePredictorAddSample(&gPosePredictor, data.timestamp, position, orientation);
+	FRAME_TIMING_END(FRAME_PHASE_GET_FRAME_DATA);
 
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
+	FRAME_TIMING_BEGIN(FRAME_PHASE_CLEAR);
+	GPU_TIMING_BEGIN(FRAME_PHASE_CLEAR);
+	glStateClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glCmdClear(GL_COLOR_BUFFER_BIT);
+	GPU_TIMING_END(FRAME_PHASE_CLEAR);
+	FRAME_TIMING_END(FRAME_PHASE_CLEAR);
 
-	glViewport(0, 0, gEyeLeft.renderWidth, gEyeLeft.renderHeight);
-	drawView(*(mat4x4 *)&data.leftProjectionMatrix, *(mat4x4 *)&data.leftViewMatrix);
+	FRAME_TIMING_BEGIN(FRAME_PHASE_UPDATE_SCENE);
+	updateScene();
+	FRAME_TIMING_END(FRAME_PHASE_UPDATE_SCENE);
 
-	glViewport(gEyeLeft.renderWidth, 0, gEyeRight.renderWidth, gEyeRight.renderHeight);
-	drawView(*(mat4x4 *)&data.rightProjectionMatrix, *(mat4x4 *)&data.rightViewMatrix);
+	// Both eyes are culled together, occluded from the center eye and get the
+	// same levels of detail, against the views latched now. The right eye is
+	// latched again before it is drawn in two passes, which moves it by a
+	// fraction of a degree at the edge of the lens at most.
+	FRAME_TIMING_BEGIN(FRAME_PHASE_CULL);
+	mat4x4 leftView, rightView, leftViewProjection, rightViewProjection;
+	latchView(leftView, data.leftViewMatrix, &data, frameDataTime);
+	latchView(rightView, data.rightViewMatrix, &data, frameDataTime);
+	mat4x4_mul_affine(leftViewProjection, *(mat4x4 *)&data.leftProjectionMatrix, leftView);
+	mat4x4_mul_affine(rightViewProjection, *(mat4x4 *)&data.rightProjectionMatrix, rightView);
+	Frustum frustum;
+	frustumCombineStereo(&frustum, leftViewProjection, rightViewProjection);
+	cullScene(&frustum);
+#if OCCLUSION
+	occlusionBeginStereo(&gOcclusion, *(mat4x4 *)&data.leftProjectionMatrix, leftView,
+		*(mat4x4 *)&data.rightProjectionMatrix, rightView);
+	occludeScene();
+#endif
+	LodView lodView;
+	lodViewInit(&lodView, LOD_PIXEL_ERROR);
+	lodViewAddEye(&lodView, *(mat4x4 *)&data.leftProjectionMatrix, leftView, gRenderWidth[0], gRenderHeight);
+	lodViewAddEye(&lodView, *(mat4x4 *)&data.rightProjectionMatrix, rightView, gRenderWidth[1], gRenderHeight);
+	selectLevels(&lodView);
+#if MESH_STREAMING
+	updateMeshStream(&frustum);
+#endif
+	FRAME_TIMING_END(FRAME_PHASE_CULL);
 
+	vertexStreamBeginFrame(&gStream);
+	if (!programsReady())
+	{
+		// Nothing to draw with yet, submit the cleared frame
+	}
+	else if (gSinglePassStereo)
+	{
+		FRAME_TIMING_BEGIN(FRAME_PHASE_DRAW_STEREO);
+		GPU_TIMING_BEGIN(FRAME_PHASE_DRAW_STEREO);
+		glStateViewport(0, 0, gRenderWidth[0] + gRenderWidth[1], gRenderHeight);
+		drawStereo(*(mat4x4 *)&data.leftProjectionMatrix, leftView,
+			*(mat4x4 *)&data.rightProjectionMatrix, rightView);
+#if VIEW_EXTRAS
+		// The rest is drawn one eye at a time
+		glStateViewport(0, 0, gRenderWidth[0], gRenderHeight);
+		drawViewExtras(leftViewProjection);
+		glStateViewport(gRenderWidth[0], 0, gRenderWidth[1], gRenderHeight);
+		drawViewExtras(rightViewProjection);
+#endif
+		GPU_TIMING_END(FRAME_PHASE_DRAW_STEREO);
+		glCmdFlush();
+		FRAME_TIMING_END(FRAME_PHASE_DRAW_STEREO);
+	}
+	else
+	{
+		FRAME_TIMING_BEGIN(FRAME_PHASE_DRAW_LEFT);
+		GPU_TIMING_BEGIN(FRAME_PHASE_DRAW_LEFT);
+		glStateViewport(0, 0, gRenderWidth[0], gRenderHeight);
+		drawView(*(mat4x4 *)&data.leftProjectionMatrix, leftView, 0);
+#if VIEW_EXTRAS
+		drawViewExtras(leftViewProjection);
+#endif
+		GPU_TIMING_END(FRAME_PHASE_DRAW_LEFT);
+		glCmdFlush();
+		FRAME_TIMING_END(FRAME_PHASE_DRAW_LEFT);
+
+		FRAME_TIMING_BEGIN(FRAME_PHASE_DRAW_RIGHT);
+		GPU_TIMING_BEGIN(FRAME_PHASE_DRAW_RIGHT);
+		latchView(rightView, data.rightViewMatrix, &data, frameDataTime);
+		glStateViewport(gRenderWidth[0], 0, gRenderWidth[1], gRenderHeight);
+		drawView(*(mat4x4 *)&data.rightProjectionMatrix, rightView, 1);
+#if VIEW_EXTRAS
+		mat4x4_mul_affine(rightViewProjection, *(mat4x4 *)&data.rightProjectionMatrix, rightView);
+		drawViewExtras(rightViewProjection);
+#endif
+		GPU_TIMING_END(FRAME_PHASE_DRAW_RIGHT);
+		glCmdFlush();
+		FRAME_TIMING_END(FRAME_PHASE_DRAW_RIGHT);
+	}
+
+	FRAME_TIMING_BEGIN(FRAME_PHASE_SUBMIT);
+	glCmdFlush(); // Only the clear is left if nothing was drawn
 	if (!emscripten_vr_submit_frame(gDisplay))
 	{
 		printf("Error: Failed to submit frame to VR display %d (second iteration)\n", gDisplay);
 	}
+	FRAME_TIMING_END(FRAME_PHASE_SUBMIT);
+	gVrFrameCpuMs = emscripten_get_now() - frameStart;
+
+	FRAME_TIMING_END_FRAME();
 }
 
 int main()
 {
+	if (!initScene())
+		return 1;
+
+	// Worker threads for per-frame CPU work, one per core
+	int threads = jobsInit(0);
+	if (threads > 1)
+		printf("Splitting per-frame work across %d threads\n", threads);
+
+	simClockInit(&gSimClock, SIM_STEP_MS, SIM_MAX_TICKS);
+
+	// Only reached in builds whose main loop ends, like the native one
+	posePredictorReset(&gPosePredictor);
+	atexit(reportPosePrediction);
+	atexit(reportCulling);
+	atexit(reportOcclusion);
+	atexit(reportLevels);
+	atexit(reportStreaming);
+	atexit(reportGLState);
+	atexit(reportCommandBuffer);
+	atexit(reportResolution);
+	atexit(reportSimulation);
+	atexit(reportStaticBatches);
+	atexit(reportMeshStream);
+#ifdef GPU_TIMING
+	atexit(reportGpuTimer);
+#endif
+	if (CAPTURE_FRAMES)
+	{
+		if (!frameCaptureInit(&gCapture, CAPTURE_BYTES))
+		{
+			fprintf(stderr, "Out of memory for a %d MB capture\n", CAPTURE_BYTES >> 20);
+			return 1;
+		}
+		atexit(saveCapture);
+	}
+
 	// Start GL
 	initGL();
+#if STATIC_BATCHES
+	if (!initStaticObjects())
+		return 1;
+#endif
+#if MESH_STREAMING
+	gMeshStreamStart = emscripten_get_now();
+	meshStreamOpen(&gMeshStream, MESH_FILE);
+#endif
 
 	// Start VR system
 	if (!emscripten_vr_init())
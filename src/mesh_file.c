@@ -0,0 +1,169 @@
+#include "mesh_file.h"
+
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GLES2/gl2ext.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t alignUp(uint32_t bytes, uint32_t alignment)
+{
+	return (bytes + alignment - 1) & ~(alignment - 1);
+}
+
+// No GL_HALF_FLOAT_OES: WebGL1 has no OES_vertex_half_float to draw it with
+static int validPositionType(uint32_t type)
+{
+	return type == GL_FLOAT || type == GL_UNSIGNED_SHORT;
+}
+
+static int validColorType(uint32_t type)
+{
+	return type == GL_FLOAT || type == GL_UNSIGNED_BYTE;
+}
+
+// Where the chunk's data ends, its indices being last
+static uint32_t chunkEnd(const MeshFileChunk *chunk)
+{
+	return chunk->indexOffset + chunk->indexCount * 2;
+}
+
+int meshFileOpen(MeshFile *file, const void *data, size_t available)
+{
+	memset(file, 0, sizeof(*file));
+	if (available < sizeof(MeshFileHeader))
+		return 0;
+
+	const MeshFileHeader *header = data;
+	if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION || header->chunkCount > 0xffffff)
+		return -1;
+	uint32_t tableEnd = sizeof(MeshFileHeader) + header->chunkCount * sizeof(MeshFileChunk);
+	if (tableEnd > header->fileSize)
+		return -1;
+	if (available < tableEnd)
+		return 0;
+
+	// The table only, so this costs the same for a 1 KB and a 1 GB file
+	const MeshFileChunk *chunks = (const MeshFileChunk *)(header + 1);
+	uint32_t end = tableEnd;
+	for (uint32_t i = 0; i < header->chunkCount; ++i)
+	{
+		const MeshFileChunk *c = &chunks[i];
+		if (!validPositionType(c->positionType) || !validColorType(c->colorType)
+			|| c->positionSize < 1 || c->positionSize > 4 || c->colorSize < 1 || c->colorSize > 4
+			|| c->vertexCount == 0 || c->vertexCount > 65536 || c->indexCount > 0x7fffffff / 2)
+			return -1;
+
+		VertexFormat format;
+		vertexFormatInit(&format, c->positionType, c->positionSize, c->colorType, c->colorSize);
+		uint64_t verticesEnd = (uint64_t)c->vertexOffset + (uint64_t)c->vertexCount * format.stride;
+		// In file order, so a prefix of the file holds a prefix of the chunks
+		if (c->vertexOffset < end || c->vertexOffset % MESH_FILE_ALIGN || c->indexOffset % 4
+			|| c->indexOffset < verticesEnd || (uint64_t)c->indexOffset + c->indexCount * 2ull > header->fileSize)
+			return -1;
+		end = chunkEnd(c);
+	}
+
+	file->data = data;
+	file->header = header;
+	file->chunks = chunks;
+	return 1;
+}
+
+int meshFileChunksAvailable(const MeshFile *file, size_t available)
+{
+	// Chunk ends increase with the index, so the first one past available
+	// bounds the count
+	int lo = 0, hi = (int)file->header->chunkCount;
+	while (lo < hi)
+	{
+		int mid = lo + (hi - lo) / 2;
+		if (chunkEnd(&file->chunks[mid]) <= available)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+void meshFileChunkFormat(const MeshFileChunk *chunk, VertexFormat *format, VertexDequantization *dequantization)
+{
+	vertexFormatInit(format, chunk->positionType, chunk->positionSize, chunk->colorType, chunk->colorSize);
+	for (int k = 0; k < 3; ++k)
+	{
+		dequantization->scale[k] = chunk->dequantizationScale[k];
+		dequantization->offset[k] = chunk->dequantizationOffset[k];
+	}
+}
+
+static int writePadding(MeshFileWriter *writer, uint32_t alignment)
+{
+	static const unsigned char zeros[MESH_FILE_ALIGN];
+	uint32_t padding = alignUp(writer->position, alignment) - writer->position;
+	writer->position += padding;
+	return fwrite(zeros, 1, padding, writer->file) == padding;
+}
+
+int meshFileWriteBegin(MeshFileWriter *writer, FILE *file, int chunkCount)
+{
+	memset(writer, 0, sizeof(*writer));
+	writer->chunks = calloc(chunkCount > 0 ? chunkCount : 1, sizeof(MeshFileChunk));
+	if (!writer->chunks)
+		return 0;
+	writer->file = file;
+	writer->chunkCount = chunkCount;
+
+	// Header and table are written last, once the offsets are known
+	writer->position = sizeof(MeshFileHeader) + chunkCount * sizeof(MeshFileChunk);
+	return fseek(file, writer->position, SEEK_SET) == 0;
+}
+
+int meshFileWriteChunk(MeshFileWriter *writer, const VertexFormat *format, const VertexDequantization *dequantization,
+	const void *vertices, int vertexCount, const uint16_t *indices, int indexCount, const float *center, float radius)
+{
+	if (writer->written >= writer->chunkCount || vertexCount <= 0 || vertexCount > 65536 || indexCount < 0
+		|| !validPositionType(format->positionType) || !validColorType(format->colorType))
+		return 0;
+
+	MeshFileChunk *c = &writer->chunks[writer->written++];
+	size_t vertexBytes = (size_t)vertexCount * format->stride, indexBytes = (size_t)indexCount * 2;
+	if (!writePadding(writer, MESH_FILE_ALIGN))
+		return 0;
+	c->vertexOffset = writer->position;
+	if (fwrite(vertices, 1, vertexBytes, writer->file) != vertexBytes)
+		return 0;
+	writer->position += vertexBytes;
+	if (!writePadding(writer, 4))
+		return 0;
+	c->indexOffset = writer->position;
+	if (fwrite(indices, 1, indexBytes, writer->file) != indexBytes)
+		return 0;
+	writer->position += indexBytes;
+
+	c->vertexCount = vertexCount;
+	c->indexCount = indexCount;
+	c->positionType = format->positionType;
+	c->colorType = format->colorType;
+	c->positionSize = format->positionSize;
+	c->colorSize = format->colorSize;
+	for (int k = 0; k < 3; ++k)
+	{
+		c->dequantizationScale[k] = dequantization->scale[k];
+		c->dequantizationOffset[k] = dequantization->offset[k];
+		c->center[k] = center[k];
+	}
+	c->radius = radius;
+	return 1;
+}
+
+int meshFileWriteEnd(MeshFileWriter *writer)
+{
+	MeshFileHeader header = {MESH_FILE_MAGIC, MESH_FILE_VERSION, writer->chunkCount, writer->position, {0}};
+	int ok = writer->written == writer->chunkCount && fseek(writer->file, 0, SEEK_SET) == 0
+		&& fwrite(&header, sizeof(header), 1, writer->file) == 1
+		&& fwrite(writer->chunks, sizeof(MeshFileChunk), writer->chunkCount, writer->file) == (size_t)writer->chunkCount;
+	free(writer->chunks);
+	writer->chunks = NULL;
+	return ok;
+}
@@ -0,0 +1,106 @@
+// Binary mesh container.
+//
+// A file is a header, a table of chunks and then the chunks' data. Each chunk
+// is one mesh whose vertices are already in the GPU layout of vertex_format.h
+// and whose indices are 16-bit, so both go to glBufferData straight from the
+// file's bytes: loading validates the header and the table, and never looks
+// at or copies the data itself. Nothing in the file is a pointer, so it can
+// be used in place from an mmap, or from a buffer a download is still
+// writing into: chunks are stored in table order, and each one can be drawn
+// as soon as the bytes up to its end have arrived.
+//
+// Positions are GL_FLOAT or GL_UNSIGNED_SHORT and colors GL_FLOAT or
+// GL_UNSIGNED_BYTE; half float positions are not allowed, since WebGL1 cannot
+// draw them. All fields are little endian, as on wasm and x86. Index values
+// are not checked against the vertex count here; WebGL checks them on draw.
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include "vertex_format.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define MESH_FILE_MAGIC 0x48534d56 // "VMSH"
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_ALIGN 16 // Vertices of every chunk start on this many bytes
+
+typedef struct MeshFileHeader
+{
+	uint32_t magic, version;
+	uint32_t chunkCount;
+	uint32_t fileSize;
+	uint32_t reserved[4];
+} MeshFileHeader;
+
+typedef struct MeshFileChunk
+{
+	uint32_t vertexOffset; // From the start of the file, MESH_FILE_ALIGN aligned
+	uint32_t indexOffset;  // 4 byte aligned, after the vertices
+	uint32_t vertexCount, indexCount;
+
+	// Vertex layout, as passed to vertexFormatInit, and its dequantization
+	uint32_t positionType, colorType;
+	uint8_t positionSize, colorSize, reserved0[2];
+	float dequantizationScale[3], dequantizationOffset[3];
+
+	// Bounding sphere in model space
+	float center[3], radius;
+	uint32_t reserved1[3];
+} MeshFileChunk;
+
+_Static_assert(sizeof(MeshFileHeader) == 32 && sizeof(MeshFileChunk) == 80, "Mesh file structures must not be padded");
+
+// A file in memory, possibly still arriving
+typedef struct MeshFile
+{
+	const unsigned char *data;
+	const MeshFileHeader *header;
+	const MeshFileChunk *chunks;
+} MeshFile;
+
+// Checks the header and chunk table at the start of data, of which the first
+// available bytes are there. Returns 1 when the file is usable, 0 when the
+// table has not fully arrived yet and -1 when the file is malformed.
+int meshFileOpen(MeshFile *file, const void *data, size_t available);
+
+// Number of chunks that are complete within the first available bytes
+int meshFileChunksAvailable(const MeshFile *file, size_t available);
+
+void meshFileChunkFormat(const MeshFileChunk *chunk, VertexFormat *format, VertexDequantization *dequantization);
+
+static inline const void *meshFileVertices(const MeshFile *file, int chunk)
+{
+	return file->data + file->chunks[chunk].vertexOffset;
+}
+
+static inline const uint16_t *meshFileIndices(const MeshFile *file, int chunk)
+{
+	return (const uint16_t *)(file->data + file->chunks[chunk].indexOffset);
+}
+
+// Writes a file chunk by chunk. The chunk count is fixed up front, the table
+// is filled in as chunks are added and written by meshFileWriteEnd.
+typedef struct MeshFileWriter
+{
+	FILE *file;
+	MeshFileChunk *chunks;
+	int chunkCount, written;
+	uint32_t position;
+} MeshFileWriter;
+
+// Returns 0 when out of memory or the file cannot be written
+int meshFileWriteBegin(MeshFileWriter *writer, FILE *file, int chunkCount);
+
+// Appends a mesh of vertices already encoded in format, with the given
+// dequantization and bounding sphere. Returns 0 on a write error, or when the
+// mesh does not fit 16-bit indices or its format is not allowed in a file.
+int meshFileWriteChunk(MeshFileWriter *writer, const VertexFormat *format, const VertexDequantization *dequantization,
+	const void *vertices, int vertexCount, const uint16_t *indices, int indexCount, const float *center, float radius);
+
+// Writes the header and the table. Returns 0 on a write error, or when fewer
+// chunks than announced were written.
+int meshFileWriteEnd(MeshFileWriter *writer);
+
+#endif
@@ -0,0 +1,137 @@
+#include "mesh_stream.h"
+
+#include "gl_command.h"
+#include "gl_state.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void meshStreamOpen(MeshStream *stream, const char *url)
+{
+	memset(stream, 0, sizeof(*stream));
+	meshStreamFetch(url, &stream->progress);
+}
+
+void meshStreamFree(MeshStream *stream)
+{
+	if (stream->uploaded)
+	{
+		glStateDeleteBuffers(stream->uploaded, stream->vertexBuffers);
+		glStateDeleteBuffers(stream->uploaded, stream->indexBuffers);
+	}
+	free(stream->vertexBuffers);
+	free(stream->indexBuffers);
+	free(stream->center);
+	free(stream->radius);
+	free(stream->scale);
+	free(stream->visible);
+	memset(stream, 0, sizeof(*stream));
+}
+
+// Sizes the per chunk arrays from the table, once
+static int allocateChunks(MeshStream *stream)
+{
+	int n = (int)stream->file.header->chunkCount;
+	stream->chunkCount = n;
+	if (!n)
+		return 1;
+	stream->vertexBuffers = malloc(n * sizeof(GLuint));
+	stream->indexBuffers = malloc(n * sizeof(GLuint));
+	stream->center = malloc(n * sizeof(vec3));
+	stream->radius = malloc(n * sizeof(float));
+	stream->scale = malloc(n * sizeof(float));
+	stream->visible = malloc(n * sizeof(int));
+	if (!stream->vertexBuffers || !stream->indexBuffers || !stream->center || !stream->radius || !stream->scale || !stream->visible)
+		return 0;
+	for (int i = 0; i < n; ++i)
+	{
+		const MeshFileChunk *chunk = &stream->file.chunks[i];
+		memcpy(stream->center[i], chunk->center, sizeof(vec3));
+		stream->radius[i] = chunk->radius;
+		stream->scale[i] = 1.f;
+	}
+	return 1;
+}
+
+int meshStreamUpdate(MeshStream *stream)
+{
+	MeshStreamProgress *progress = &stream->progress;
+	if (progress->status < 0 || stream->opened < 0)
+		return -1;
+	if (!progress->data)
+		return 0;
+
+	// Reading received once, the platform may move it on in the meantime
+	uint32_t received = progress->received;
+	if (!stream->opened)
+	{
+		stream->opened = meshFileOpen(&stream->file, progress->data, received);
+		if (stream->opened > 0 && !allocateChunks(stream))
+			stream->opened = -1;
+		if (stream->opened <= 0)
+			return stream->opened;
+	}
+
+	int available = meshFileChunksAvailable(&stream->file, received);
+	for (int i = stream->uploaded; i < available; ++i)
+	{
+		const MeshFileChunk *chunk = &stream->file.chunks[i];
+		VertexFormat format;
+		VertexDequantization dequantization;
+		meshFileChunkFormat(chunk, &format, &dequantization);
+		GLsizeiptr vertexBytes = (GLsizeiptr)chunk->vertexCount * format.stride;
+		GLsizeiptr indexBytes = (GLsizeiptr)chunk->indexCount * 2;
+
+		glGenBuffers(1, &stream->vertexBuffers[i]);
+		glGenBuffers(1, &stream->indexBuffers[i]);
+		glStateBindBuffer(GL_ARRAY_BUFFER, stream->vertexBuffers[i]);
+		glCmdBufferData(GL_ARRAY_BUFFER, vertexBytes, meshFileVertices(&stream->file, i), GL_STATIC_DRAW);
+		glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream->indexBuffers[i]);
+		glCmdBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, meshFileIndices(&stream->file, i), GL_STATIC_DRAW);
+		stream->bytesUploaded += vertexBytes + indexBytes;
+	}
+	stream->uploaded = available;
+
+	// A download that ended short of its last chunk will never complete it
+	if (progress->status > 0 && stream->uploaded < stream->chunkCount)
+		return -1;
+	return stream->uploaded;
+}
+
+void meshStreamCull(MeshStream *stream, const Frustum *frustum)
+{
+	stream->visibleCount = stream->uploaded
+		? cullSpheres(frustum, stream->center, stream->radius, stream->scale, 0, stream->uploaded, stream->visible)
+		: 0;
+}
+
+void meshStreamDraw(MeshStream *stream, mat4x4 viewProjection, GLuint program, GLint mvpLocation,
+	GLuint positionLocation, GLuint colorLocation)
+{
+	++stream->views;
+	if (!stream->visibleCount)
+		return;
+
+	glStateUseProgram(program);
+	for (int v = 0; v < stream->visibleCount; ++v)
+	{
+		int i = stream->visible[v];
+		const MeshFileChunk *chunk = &stream->file.chunks[i];
+		VertexFormat format;
+		VertexDequantization dequantization;
+		meshFileChunkFormat(chunk, &format, &dequantization);
+
+		// Chunks are stored in world space, up to their dequantization
+		mat4x4 model, mvp;
+		vertexDequantizationMatrix(model, &dequantization);
+		mat4x4_mul_affine(mvp, viewProjection, model);
+		glStateUniformMatrix4fv(mvpLocation, 1, GL_FALSE, (const GLfloat *)mvp);
+
+		glStateBindBuffer(GL_ARRAY_BUFFER, stream->vertexBuffers[i]);
+		vertexFormatBind(&format, positionLocation, colorLocation, 0);
+		glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream->indexBuffers[i]);
+		glCmdDrawElements(GL_TRIANGLES, chunk->indexCount, GL_UNSIGNED_SHORT, (void *)0);
+		stream->trianglesDrawn += chunk->indexCount / 3;
+	}
+	stream->draws += stream->visibleCount;
+}
@@ -0,0 +1,72 @@
+// Streaming mesh files (mesh_file.h) onto the GPU while they download.
+//
+// The platform fetches the file straight into one block of memory and
+// publishes how much of it has arrived. Once per frame meshStreamUpdate looks
+// at that count, opens the file as soon as its chunk table is in, and uploads
+// every chunk that has completed since the last frame with glBufferData
+// directly from the downloaded bytes. Nothing is parsed or copied on the way,
+// so the first chunks are drawn while the rest of the file is still on the
+// network.
+#ifndef MESH_STREAM_H
+#define MESH_STREAM_H
+
+#include "cull.h"
+#include "mesh_file.h"
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+// Written by the platform as the download progresses, read by the frame loop.
+// Only ever grows: data and size are set once, received goes up to size.
+typedef struct MeshStreamProgress
+{
+	const unsigned char *data; // The whole file, 0 until its size is known
+	uint32_t size;
+	uint32_t received; // Bytes at the start of data that have arrived
+	int32_t status;    // 0 while downloading, 1 when complete, -1 on failure
+} MeshStreamProgress;
+
+// Starts downloading url into progress, which has to stay valid. Implemented
+// by the platform: mesh_stream.js under emscripten (a fetch whose body is read
+// chunk by chunk into the heap), the native platform maps the file.
+void meshStreamFetch(const char *url, MeshStreamProgress *progress);
+
+typedef struct MeshStream
+{
+	MeshStreamProgress progress;
+	MeshFile file;
+	int opened; // 1 once the chunk table is in, -1 if the file is malformed
+
+	// Per uploaded chunk: buffers, and the bounding sphere for cullSpheres
+	GLuint *vertexBuffers, *indexBuffers;
+	vec3 *center;
+	float *radius, *scale;
+	int chunkCount, uploaded;
+
+	// Uploaded chunks that passed the last meshStreamCull
+	int *visible;
+	int visibleCount;
+
+	unsigned long bytesUploaded, views, draws, trianglesDrawn;
+} MeshStream;
+
+// Starts streaming the file at url
+void meshStreamOpen(MeshStream *stream, const char *url);
+
+// Deletes the buffers. The downloaded data stays with the platform.
+void meshStreamFree(MeshStream *stream);
+
+// Uploads the chunks that have arrived since the last call. Returns the
+// number of chunks ready to draw, or -1 if the download or the file failed.
+int meshStreamUpdate(MeshStream *stream);
+
+// Keeps the uploaded chunks whose bounds intersect the frustum
+void meshStreamCull(MeshStream *stream, const Frustum *frustum);
+
+// Draws the chunks kept by the last meshStreamCull with program, whose MVP
+// uniform is at mvpLocation. Leaves the attributes pointing into the last
+// chunk drawn.
+void meshStreamDraw(MeshStream *stream, mat4x4 viewProjection, GLuint program, GLint mvpLocation,
+	GLuint positionLocation, GLuint colorLocation);
+
+#endif
@@ -0,0 +1,45 @@
+// JavaScript side of mesh streaming (mesh_stream.h), linked in with
+// --js-library. meshStreamFetch allocates the whole file in the wasm heap once
+// the response headers give its size, then copies each piece the body reader
+// delivers straight to its place there and bumps the received count the frame
+// loop polls. The file has to be served uncompressed, or with a
+// Content-Length that is its decoded size.
+//
+// The field offsets have to match MeshStreamProgress in mesh_stream.h.
+mergeInto(LibraryManager.library, {
+	meshStreamFetch__deps: ['malloc', '$UTF8ToString'],
+	meshStreamFetch: function(url, progress) {
+		var p = progress >> 2; // data, size, received, status
+		var name = UTF8ToString(url);
+		fetch(name).then(function(response) {
+			var size = +response.headers.get('Content-Length');
+			if (!response.ok || !size || !response.body) throw 'HTTP ' + response.status + ', ' + size + ' bytes';
+			var data = _malloc(size);
+			if (!data) throw 'out of memory for ' + size + ' bytes';
+			HEAPU32[p] = data;
+			HEAPU32[p + 1] = size;
+
+			var reader = response.body.getReader();
+			var received = 0;
+			function read() {
+				return reader.read().then(function(result) {
+					if (result.done) {
+						HEAP32[p + 3] = received == size ? 1 : -1;
+						return;
+					}
+					var bytes = result.value;
+					if (received + bytes.length > size) throw 'more than the ' + size + ' bytes announced';
+					// HEAPU8 is looked up anew, memory may have grown since the last piece
+					HEAPU8.set(bytes, data + received);
+					received += bytes.length;
+					HEAPU32[p + 2] = received;
+					return read();
+				});
+			}
+			return read();
+		}).catch(function(error) {
+			console.error('Streaming ' + name + ' failed: ' + error);
+			HEAP32[p + 3] = -1;
+		});
+	}
+});
@@ -0,0 +1,299 @@
+// Static batching against one draw per object, on the GL stub.
+//
+// Places 20k static objects, quads and cubes, each drawn with one of three
+// programs, and draws a view of them:
+//   - per object: program, MVP uniform, mesh buffers and one glDrawElements
+//     per object, through the GL state cache as the frame loop does
+//   - batched: the same objects merged by program (static_batch.h)
+// and reports the GL calls and CPU time per view of each. Then removes every
+// tenth object, moves some and adds some back, timing each rebuild.
+//
+// It fails if a build leaves an object's baked vertices or rebased indices
+// different from transforming its mesh, a batch goes over
+// STATIC_BATCH_MAX_VERTICES or mixes programs, or the batched view makes more
+// draws than there are batches.
+#include "gl_stub.h"
+#include "../gl_command.h"
+#include "../gl_state.h"
+#include "../static_batch.h"
+#include "../transform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define OBJECTS 20000
+#define PROGRAMS 3
+#define RUNS 20
+#define POSITION_LOCATION 0
+#define COLOR_LOCATION 1
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static float randomRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// Unit quad and cube, the cube with a vertex per face corner
+static BatchVertex gQuadVertices[4];
+static unsigned short gQuadIndices[6];
+static BatchVertex gCubeVertices[24];
+static unsigned short gCubeIndices[36];
+static BatchMesh gMeshes[2];
+static GLuint gMeshBuffers[2][2];
+
+static void initMeshes()
+{
+	static const float corners[4][2] = {{-1.f, -1.f}, {1.f, -1.f}, {1.f, 1.f}, {-1.f, 1.f}};
+	static const unsigned short quad[6] = {0, 1, 2, 0, 2, 3};
+	for (int v = 0; v < 4; ++v)
+		gQuadVertices[v] = (BatchVertex){corners[v][0], corners[v][1], 0.f, 1.f, v * 0.25f, 0.f};
+	for (int i = 0; i < 6; ++i)
+		gQuadIndices[i] = quad[i];
+
+	// Face f is perpendicular to axis f / 2, on its negative or positive side
+	for (int f = 0; f < 6; ++f)
+	{
+		int axis = f / 2;
+		float side = f & 1 ? 1.f : -1.f;
+		for (int v = 0; v < 4; ++v)
+		{
+			float p[3];
+			p[axis] = side;
+			p[(axis + 1) % 3] = corners[v][0];
+			p[(axis + 2) % 3] = corners[v][1];
+			gCubeVertices[f * 4 + v] = (BatchVertex){p[0], p[1], p[2], f / 6.f, 0.5f, v * 0.25f};
+		}
+		for (int i = 0; i < 6; ++i)
+			gCubeIndices[f * 6 + i] = (unsigned short)(f * 4 + quad[i]);
+	}
+
+	gMeshes[0] = (BatchMesh){gQuadVertices, gQuadIndices, 4, 6};
+	gMeshes[1] = (BatchMesh){gCubeVertices, gCubeIndices, 24, 36};
+	for (int m = 0; m < 2; ++m)
+	{
+		glGenBuffers(2, gMeshBuffers[m]);
+		glStateBindBuffer(GL_ARRAY_BUFFER, gMeshBuffers[m][0]);
+		glCmdBufferData(GL_ARRAY_BUFFER, gMeshes[m].vertexCount * sizeof(BatchVertex), gMeshes[m].vertices, GL_STATIC_DRAW);
+		glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gMeshBuffers[m][1]);
+		glCmdBufferData(GL_ELEMENT_ARRAY_BUFFER, gMeshes[m].indexCount * sizeof(unsigned short), gMeshes[m].indices, GL_STATIC_DRAW);
+	}
+}
+
+static void randomWorld(mat4x4 world)
+{
+	vec3 axis = {randomRange(-1.f, 1.f), randomRange(-1.f, 1.f), randomRange(-1.f, 1.f)};
+	vec3_norm(axis, axis);
+	quat q;
+	quat_rotate(q, randomRange(-(float)M_PI, (float)M_PI), axis);
+	Transform t;
+	vec3 p = {randomRange(-50.f, 50.f), randomRange(-5.f, 5.f), randomRange(-100.f, -1.f)};
+	transformSet(&t, p, q, randomRange(0.1f, 0.5f));
+	transformToMat4x4(world, &t);
+}
+
+// What the frame loop would do without batching
+static void drawPerObject(StaticBatcher *batcher, GLint *mvpLocations, GLuint *programs, mat4x4 viewProjection)
+{
+	for (int i = 0; i < batcher->objectCount; ++i)
+	{
+		StaticBatchObject *object = &batcher->objects[i];
+		if (!object->program)
+			continue;
+		int m = object->mesh == &gMeshes[1];
+		mat4x4 mvp;
+		mat4x4_mul_affine(mvp, viewProjection, object->world);
+		int p = 0;
+		while (programs[p] != object->program)
+			++p;
+		glStateUseProgram(object->program);
+		glStateUniformMatrix4fv(mvpLocations[p], 1, GL_FALSE, (const GLfloat *)mvp);
+		glStateBindBuffer(GL_ARRAY_BUFFER, gMeshBuffers[m][0]);
+		glStateVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void *)0);
+		glStateVertexAttribPointer(COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void *)(3 * sizeof(float)));
+		glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gMeshBuffers[m][1]);
+		glCmdDrawElements(GL_TRIANGLES, object->mesh->indexCount, GL_UNSIGNED_SHORT, (void *)0);
+	}
+	glCmdFlush();
+}
+
+static void drawBatched(StaticBatcher *batcher, mat4x4 viewProjection)
+{
+	staticBatcherDraw(batcher, viewProjection);
+	glCmdFlush();
+}
+
+// Checks the last build against the objects. Returns 0 and says why if it
+// does not match.
+static int verify(StaticBatcher *batcher)
+{
+	int live = 0;
+	for (int b = 0; b < batcher->batchCount; ++b)
+	{
+		if (batcher->batches[b].vertexCount > STATIC_BATCH_MAX_VERTICES)
+		{
+			printf("  batch %d has %d vertices\n", b, batcher->batches[b].vertexCount);
+			return 0;
+		}
+	}
+	for (int i = 0; i < batcher->objectCount; ++i)
+	{
+		StaticBatchObject *object = &batcher->objects[i];
+		if (!object->program)
+			continue;
+		++live;
+		StaticBatch *batch = &batcher->batches[object->batch];
+		if (batch->program != object->program)
+		{
+			printf("  object %d is in a batch of another program\n", i);
+			return 0;
+		}
+
+		const BatchMesh *mesh = object->mesh;
+		for (int v = 0; v < mesh->vertexCount; ++v)
+		{
+			vec4 p = {mesh->vertices[v].x, mesh->vertices[v].y, mesh->vertices[v].z, 1.f}, q;
+			mat4x4_mul_vec4(q, object->world, p);
+			const BatchVertex *baked = &batcher->vertices[object->firstVertex + v];
+			if (fabsf(baked->x - q[0]) > 1e-4f || fabsf(baked->y - q[1]) > 1e-4f || fabsf(baked->z - q[2]) > 1e-4f
+				|| baked->r != mesh->vertices[v].r || baked->g != mesh->vertices[v].g || baked->b != mesh->vertices[v].b)
+			{
+				printf("  object %d vertex %d baked wrong\n", i, v);
+				return 0;
+			}
+		}
+		int base = object->firstVertex - batch->firstVertex;
+		for (int k = 0; k < mesh->indexCount; ++k)
+		{
+			if (batcher->indices[object->firstIndex + k] != mesh->indices[k] + base)
+			{
+				printf("  object %d index %d rebased wrong\n", i, k);
+				return 0;
+			}
+		}
+	}
+	if (live != batcher->liveCount || live != batcher->stats.objects)
+	{
+		printf("  %d objects built, %d live\n", batcher->stats.objects, batcher->liveCount);
+		return 0;
+	}
+	return 1;
+}
+
+// Times a rebuild and checks it
+static int rebuild(StaticBatcher *batcher, const char *what)
+{
+	double start = now();
+	staticBatcherBuild(batcher);
+	double ms = now() - start;
+	printf("  %-28s %6d objects %4d batches %9.3f ms\n", what, batcher->stats.objects, batcher->stats.batches, ms);
+	return verify(batcher);
+}
+
+int main()
+{
+	srand(1);
+	initMeshes();
+
+	GLuint programs[PROGRAMS];
+	GLint mvpLocations[PROGRAMS];
+	for (int p = 0; p < PROGRAMS; ++p)
+	{
+		programs[p] = glCreateProgram();
+		glLinkProgram(programs[p]);
+		mvpLocations[p] = glGetUniformLocation(programs[p], "MVP");
+	}
+	glStateEnableVertexAttribArray(POSITION_LOCATION);
+	glStateEnableVertexAttribArray(COLOR_LOCATION);
+
+	StaticBatcher batcher;
+	if (!staticBatcherInit(&batcher, OBJECTS, POSITION_LOCATION, COLOR_LOCATION))
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	int handles[OBJECTS];
+	for (int i = 0; i < OBJECTS; ++i)
+	{
+		mat4x4 world;
+		randomWorld(world);
+		handles[i] = staticBatcherAdd(&batcher, programs[rand() % PROGRAMS], &gMeshes[rand() % 2], world);
+	}
+
+	printf("%d static objects, quads and cubes, %d programs\n", OBJECTS, PROGRAMS);
+	int ok = rebuild(&batcher, "initial build");
+
+	mat4x4 view, projection, viewProjection;
+	vec3 eye = {0.f, 1.7f, 0.f}, center = {0.f, 1.5f, -10.f}, up = {0.f, 1.f, 0.f};
+	mat4x4_look_at(view, eye, center, up);
+	mat4x4_perspective(projection, 1.6f, 1.f, 0.1f, 200.f);
+	mat4x4_mul_affine(viewProjection, projection, view);
+
+	// Both paths drawn alternately, so neither gets a warmer cache
+	double best[2] = {1e30, 1e30};
+	unsigned long calls[2], draws[2];
+	for (int run = 0; run < RUNS; ++run)
+	{
+		for (int path = 0; path < 2; ++path)
+		{
+			glStubBeginFrame();
+			glStateBeginFrame();
+			double start = now();
+			if (path == 0)
+				drawPerObject(&batcher, mvpLocations, programs, viewProjection);
+			else
+				drawBatched(&batcher, viewProjection);
+			best[path] = fmin(best[path], now() - start);
+			calls[path] = glStubFrameCallsAll();
+			draws[path] = glStubFrameCalls(GL_STUB_glDrawElements);
+		}
+	}
+
+	static const char *names[2] = {"per object", "batched"};
+	printf("  %-12s %10s %10s %10s\n", "view", "GL calls", "draws", "ms");
+	for (int path = 0; path < 2; ++path)
+		printf("  %-12s %10lu %10lu %10.3f\n", names[path], calls[path], draws[path], best[path]);
+	printf("  %.0fx fewer GL calls, %.0fx less CPU time per view\n", (double)calls[0] / calls[1], best[0] / best[1]);
+	ok &= draws[1] == (unsigned long)batcher.batchCount;
+
+	// Membership changes
+	for (int i = 0; i < OBJECTS; i += 10)
+	{
+		staticBatcherRemove(&batcher, handles[i]);
+		handles[i] = -1;
+	}
+	ok &= rebuild(&batcher, "every tenth removed");
+
+	for (int i = 1; i < OBJECTS; i += 100)
+	{
+		mat4x4 world;
+		randomWorld(world);
+		staticBatcherSetWorld(&batcher, handles[i], world);
+	}
+	ok &= rebuild(&batcher, "1% moved");
+
+	for (int i = 0; i < OBJECTS; i += 20)
+	{
+		mat4x4 world;
+		randomWorld(world);
+		handles[i] = staticBatcherAdd(&batcher, programs[rand() % PROGRAMS], &gMeshes[rand() % 2], world);
+		ok &= handles[i] >= 0;
+	}
+	ok &= rebuild(&batcher, "half of them added back");
+	ok &= !staticBatcherBuild(&batcher); // Nothing changed
+
+	drawBatched(&batcher, viewProjection);
+	const StaticBatchStats *stats = &batcher.stats;
+	printf("  %lu rebuilds uploaded %.1f MB, %llu draws made in place of %llu\n", stats->rebuilds,
+		stats->bytesUploaded / (1024.0 * 1024.0), stats->draws, stats->draws + stats->drawsSaved);
+
+	staticBatcherFree(&batcher);
+	printf("%s\n", ok ? "ok" : "FAILED");
+	return !ok;
+}
@@ -0,0 +1,127 @@
+// Stereo culling cost at 100k objects.
+//
+// Culls a random field of bounding spheres around a scripted HMD pose, once
+// per eye and once against the combined stereo frustum, and reports the time
+// per object and the visible counts. It also checks that the combined test
+// is conservative: every object either eye sees has to pass it.
+//
+// Built twice by make native-cull-bench, with the SIMD plane tests and with
+// -DLINMATH_NO_SIMD for the scalar ones.
+#include "../cull.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define OBJECTS 100000
+#define RUNS 50
+#define EYE_OFFSET 0.032f
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static float randomRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// View-projection of one eye of a head looking slightly left and down, with
+// lens frusta wider towards the outside like the native scripted display
+static void eyeViewProjection(mat4x4 out, float eyeOffset, float tanLeft, float tanRight)
+{
+	quat yaw, pitch, q;
+	vec3 up = {0.f, 1.f, 0.f}, right = {1.f, 0.f, 0.f};
+	quat_rotate(yaw, 0.4f, up);
+	quat_rotate(pitch, -0.1f, right);
+	quat_mul(q, yaw, pitch);
+
+	mat4x4 eye, view, projection;
+	mat4x4_from_quat(eye, q);
+	eye[3][1] = 1.6f;
+	mat4x4_translate_in_place(eye, eyeOffset, 0.f, 0.f);
+	mat4x4_invert_rigid(view, eye);
+
+	float n = 0.1f;
+	mat4x4_frustum(projection, -tanLeft * n, tanRight * n, -n, n, n, 100.f);
+	mat4x4_mul(out, projection, view);
+}
+
+int main()
+{
+	vec3 *center = malloc(OBJECTS * sizeof(vec3));
+	float *radius = malloc(OBJECTS * sizeof(float));
+	float *scale = malloc(OBJECTS * sizeof(float));
+	int *left = malloc(OBJECTS * sizeof(int));
+	int *right = malloc(OBJECTS * sizeof(int));
+	int *combined = malloc(OBJECTS * sizeof(int));
+	char *seen = calloc(OBJECTS, 1);
+	if (!center || !radius || !scale || !left || !right || !combined || !seen)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	srand(1);
+	for (int i = 0; i < OBJECTS; ++i)
+	{
+		center[i][0] = randomRange(-50.f, 50.f);
+		center[i][1] = randomRange(-5.f, 10.f);
+		center[i][2] = randomRange(-50.f, 50.f);
+		radius[i] = randomRange(0.1f, 1.f);
+		scale[i] = randomRange(0.5f, 2.f);
+	}
+
+	mat4x4 leftViewProjection, rightViewProjection;
+	eyeViewProjection(leftViewProjection, -EYE_OFFSET, 1.1f, 0.9f);
+	eyeViewProjection(rightViewProjection, EYE_OFFSET, 0.9f, 1.1f);
+
+	int leftCount = 0, rightCount = 0, combinedCount = 0;
+	double perEyeMs = 0.0, combinedMs = 0.0;
+	for (int run = 0; run < RUNS; ++run)
+	{
+		double start = now();
+		Frustum leftFrustum, rightFrustum;
+		frustumFromMatrix(&leftFrustum, leftViewProjection);
+		frustumFromMatrix(&rightFrustum, rightViewProjection);
+		leftCount = cullSpheres(&leftFrustum, center, radius, scale, 0, OBJECTS, left);
+		rightCount = cullSpheres(&rightFrustum, center, radius, scale, 0, OBJECTS, right);
+		double middle = now();
+		Frustum frustum;
+		frustumCombineStereo(&frustum, leftViewProjection, rightViewProjection);
+		combinedCount = cullSpheres(&frustum, center, radius, scale, 0, OBJECTS, combined);
+		double end = now();
+
+		perEyeMs += middle - start;
+		combinedMs += end - middle;
+	}
+
+	// Visible to either eye, and missed by the combined test
+	int either = 0, missed = 0;
+	for (int i = 0; i < leftCount; ++i)
+		seen[left[i]] = 1;
+	for (int i = 0; i < rightCount; ++i)
+		seen[right[i]] = 1;
+	for (int i = 0; i < OBJECTS; ++i)
+		either += seen[i];
+	for (int i = 0; i < combinedCount; ++i)
+		seen[combined[i]] = 0;
+	for (int i = 0; i < OBJECTS; ++i)
+		missed += seen[i];
+
+	printf("Culling %d spheres, %s plane tests, mean of %d runs\n", OBJECTS, LINMATH_SIMD ? "SIMD" : "scalar", RUNS);
+	printf("  per eye:  %.3f ms (%.2f ns/object), %d left + %d right visible, %d to either eye\n",
+		perEyeMs / RUNS, perEyeMs / RUNS * 1e6 / OBJECTS, leftCount, rightCount, either);
+	printf("  combined: %.3f ms (%.2f ns/object), %d visible (%d extra)\n",
+		combinedMs / RUNS, combinedMs / RUNS * 1e6 / OBJECTS, combinedCount, combinedCount - either);
+
+	if (missed)
+	{
+		printf("Combined frustum culled %d objects that an eye can see\n", missed);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,29 @@
+// Native stand-in for <emscripten/emscripten.h>, declaring only what the app
+// uses. Implemented by src/native/platform.c.
+#ifndef NATIVE_EMSCRIPTEN_H
+#define NATIVE_EMSCRIPTEN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EMSCRIPTEN_KEEPALIVE __attribute__((used))
+
+typedef void (*em_callback_func)(void);
+typedef void (*em_arg_callback_func)(void *);
+
+// Runs the frame loop headless for NATIVE_FRAMES frames and then returns,
+// instead of handing control to the browser
+void emscripten_set_main_loop(em_callback_func func, int fps, int simulate_infinite_loop);
+void emscripten_pause_main_loop(void);
+void emscripten_resume_main_loop(void);
+void emscripten_cancel_main_loop(void);
+
+// Milliseconds from a monotonic clock
+double emscripten_get_now(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+// Native stand-in for <emscripten/html5.h>, declaring only what the app uses.
+// Implemented by src/native/platform.c.
+#ifndef NATIVE_HTML5_H
+#define NATIVE_HTML5_H
+
+#include <emscripten/emscripten.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int EM_BOOL;
+#define EM_TRUE 1
+#define EM_FALSE 0
+
+typedef int EMSCRIPTEN_RESULT;
+#define EMSCRIPTEN_RESULT_SUCCESS 0
+#define EMSCRIPTEN_RESULT_FAILED -6
+
+#define EMSCRIPTEN_EVENT_CLICK 4
+
+typedef struct EmscriptenMouseEvent
+{
+	double timestamp;
+	long screenX;
+	long screenY;
+	long clientX;
+	long clientY;
+	EM_BOOL ctrlKey;
+	EM_BOOL shiftKey;
+	EM_BOOL altKey;
+	EM_BOOL metaKey;
+	unsigned short button;
+	unsigned short buttons;
+	long movementX;
+	long movementY;
+	long targetX;
+	long targetY;
+	long canvasX;
+	long canvasY;
+	long padding;
+} EmscriptenMouseEvent;
+
+typedef EM_BOOL (*em_mouse_callback_func)(int eventType, const EmscriptenMouseEvent *mouseEvent, void *userData);
+
+EMSCRIPTEN_RESULT emscripten_set_click_callback(const char *target, void *userData, EM_BOOL useCapture, em_mouse_callback_func callback);
+
+typedef int EMSCRIPTEN_WEBGL_CONTEXT_HANDLE;
+
+typedef struct EmscriptenWebGLContextAttributes
+{
+	EM_BOOL alpha;
+	EM_BOOL depth;
+	EM_BOOL stencil;
+	EM_BOOL antialias;
+	EM_BOOL premultipliedAlpha;
+	EM_BOOL preserveDrawingBuffer;
+	EM_BOOL preferLowPowerToHighPerformance;
+	EM_BOOL failIfMajorPerformanceCaveat;
+	int majorVersion;
+	int minorVersion;
+	EM_BOOL enableExtensionsByDefault;
+	EM_BOOL explicitSwapControl;
+} EmscriptenWebGLContextAttributes;
+
+void emscripten_webgl_init_context_attributes(EmscriptenWebGLContextAttributes *attributes);
+EMSCRIPTEN_WEBGL_CONTEXT_HANDLE emscripten_webgl_create_context(const char *target, const EmscriptenWebGLContextAttributes *attributes);
+EMSCRIPTEN_RESULT emscripten_webgl_make_context_current(EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context);
+EM_BOOL emscripten_webgl_enable_extension(EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context, const char *extension);
+
+EMSCRIPTEN_RESULT emscripten_get_canvas_element_size(const char *target, int *width, int *height);
+EMSCRIPTEN_RESULT emscripten_set_canvas_element_size(const char *target, int width, int height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
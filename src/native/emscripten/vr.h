@@ -0,0 +1,107 @@
+// Native stand-in for <emscripten/vr.h> (WebVR 1.1 as of emscripten 1.37.22).
+// The single display it reports is scripted by src/native/platform.c.
+#ifndef NATIVE_VR_H
+#define NATIVE_VR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int VRDisplayHandle;
+
+typedef struct VRVector3
+{
+	float x, y, z;
+} VRVector3;
+
+typedef struct VRQuaternion
+{
+	float x, y, z, w;
+} VRQuaternion;
+
+#define VR_POSE_POSITION 1
+#define VR_POSE_LINEAR_VELOCITY 2
+#define VR_POSE_LINEAR_ACCELERATION 4
+#define VR_POSE_ORIENTATION 8
+#define VR_POSE_ANGULAR_VELOCITY 16
+#define VR_POSE_ANGULAR_ACCELERATION 32
+
+typedef struct VRPose
+{
+	VRVector3 position;
+	VRVector3 linearVelocity;
+	VRVector3 linearAcceleration;
+	VRQuaternion orientation;
+	VRVector3 angularVelocity;
+	VRVector3 angularAcceleration;
+	int poseFlags;
+} VRPose;
+
+typedef struct VRFrameData
+{
+	double timestamp;
+	float leftProjectionMatrix[16];
+	float leftViewMatrix[16];
+	float rightProjectionMatrix[16];
+	float rightViewMatrix[16];
+	VRPose pose;
+} VRFrameData;
+
+typedef enum VREye
+{
+	VREyeLeft,
+	VREyeRight
+} VREye;
+
+typedef struct VREyeParameters
+{
+	VRVector3 offset;
+	unsigned long renderWidth;
+	unsigned long renderHeight;
+} VREyeParameters;
+
+typedef struct VRDisplayCapabilities
+{
+	int hasPosition;
+	int hasExternalDisplay;
+	int canPresent;
+	unsigned long maxLayers;
+} VRDisplayCapabilities;
+
+typedef struct VRLayerInit
+{
+	const char *source;
+	float leftBounds[4];
+	float rightBounds[4];
+} VRLayerInit;
+
+#define VR_LAYER_DEFAULT_LEFT_BOUNDS {0.0f, 0.0f, 0.5f, 1.0f}
+#define VR_LAYER_DEFAULT_RIGHT_BOUNDS {0.5f, 0.0f, 0.5f, 1.0f}
+
+typedef void (*em_vr_callback_func)(void);
+typedef void (*em_vr_arg_callback_func)(void *);
+
+int emscripten_vr_init(void);
+int emscripten_vr_ready(void);
+int emscripten_vr_version_major(void);
+int emscripten_vr_version_minor(void);
+int emscripten_vr_count_displays(void);
+VRDisplayHandle emscripten_vr_get_display_handle(int displayIndex);
+const char *emscripten_vr_get_display_name(VRDisplayHandle handle);
+int emscripten_vr_get_display_capabilities(VRDisplayHandle handle, VRDisplayCapabilities *displayCaps);
+int emscripten_vr_get_eye_parameters(VRDisplayHandle handle, VREye whichEye, VREyeParameters *eyeParams);
+int emscripten_vr_display_connected(VRDisplayHandle handle);
+int emscripten_vr_display_presenting(VRDisplayHandle handle);
+int emscripten_vr_set_display_render_loop(VRDisplayHandle handle, em_vr_callback_func callback);
+int emscripten_vr_set_display_render_loop_arg(VRDisplayHandle handle, em_vr_arg_callback_func callback, void *arg);
+int emscripten_vr_cancel_display_render_loop(VRDisplayHandle handle);
+int emscripten_vr_request_present(VRDisplayHandle handle, VRLayerInit *layerInit, int layerCount, em_vr_arg_callback_func callback, void *userData);
+int emscripten_vr_exit_present(VRDisplayHandle handle);
+int emscripten_vr_get_frame_data(VRDisplayHandle handle, VRFrameData *frameData);
+int emscripten_vr_submit_frame(VRDisplayHandle handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
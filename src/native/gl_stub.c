@@ -0,0 +1,781 @@
+#include "gl_stub.h"
+#include "../gl_command.h"
+
+#include <GLES2/gl2.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2ext.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *gCallNames[GL_STUB_CALL_COUNT] =
+{
+#define GL_STUB_NAME(name) #name,
+	GL_STUB_CALLS(GL_STUB_NAME)
+#undef GL_STUB_NAME
+};
+
+static unsigned long gFrameCalls[GL_STUB_CALL_COUNT];
+static unsigned long gTotalCalls[GL_STUB_CALL_COUNT];
+static unsigned long gFrameIndex;
+static FILE *gTrace;
+
+// Object names are handed out from one counter, like a real driver would not,
+// but it makes traces easier to follow
+static GLuint gNextName = 1;
+
+// Attribute and uniform locations, assigned in order of first query per program
+// unless bound with glBindAttribLocation
+typedef struct Location
+{
+	GLuint program;
+	int isAttrib;
+	char name[64];
+	GLint location;
+} Location;
+
+static Location gLocations[256];
+static int gLocationCount;
+
+// When each shader or program is done compiling or linking, by object name.
+// Names past the table are never waited for.
+#define MAX_COMPILE_OBJECTS 4096
+static double gReadyTime[MAX_COMPILE_OBJECTS];
+static double gCompileMs, gLinkMs;
+static double gCompilerIdleTime; // When the simulated compiler thread runs out of work
+static double gCompileWaitMs;
+
+// Current state, to spot redundant calls. Starts out as GL's defaults.
+#define MAX_ATTRIBS 16
+typedef struct AttribState
+{
+	int enabled;
+	GLuint divisor, buffer;
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	GLsizei stride;
+	const void *pointer;
+} AttribState;
+
+static struct
+{
+	GLuint program, arrayBuffer, elementBuffer;
+	GLint viewport[4];
+	GLfloat clearColor[4];
+	AttribState attribs[MAX_ATTRIBS];
+} gState;
+static unsigned long gFrameRedundant, gTotalRedundant;
+
+static unsigned long gReplays, gReplayedCalls;
+
+// Timer queries, by name. Names past the table are errors.
+#define MAX_QUERIES 256
+typedef enum QueryState
+{
+	QUERY_NONE,    // Never created or deleted
+	QUERY_CREATED, // Never begun
+	QUERY_ACTIVE,
+	QUERY_ENDED
+} QueryState;
+
+typedef struct Query
+{
+	GLuint name;
+	QueryState state;
+	unsigned long endFrame;
+	uint64_t begin, result; // Simulated GPU time in ns
+} Query;
+
+static Query gQueries[MAX_QUERIES];
+static Query *gActiveQuery;
+static int gQueryLatency = 2, gDisjointEvery;
+static int gDisjoint;
+static uint64_t gGpuTime; // Simulated GPU time of all work so far, in ns
+static GLStubQueryStats gQueryStats = {.minLatency = (unsigned long)-1};
+
+// Simulated GPU cost of each clear and draw call, and of each vertex drawn
+#define GPU_CLEAR_NS 40000
+#define GPU_DRAW_NS 2000
+#define GPU_VERTEX_NS 1
+
+// Counts the call as redundant if it does not change anything
+#define REDUNDANT(unchanged) \
+	do \
+	{ \
+		if (unchanged) \
+		{ \
+			++gFrameRedundant; \
+			++gTotalRedundant; \
+		} \
+	} while (0)
+
+#define RECORD(name, ...) \
+	do \
+	{ \
+		++gFrameCalls[GL_STUB_##name]; \
+		++gTotalCalls[GL_STUB_##name]; \
+		if (gTrace) \
+		{ \
+			fprintf(gTrace, "%lu " #name "(", gFrameIndex); \
+			fprintf(gTrace, __VA_ARGS__); \
+			fprintf(gTrace, ")\n"); \
+		} \
+	} while (0)
+
+void glStubBeginFrame(void)
+{
+	memset(gFrameCalls, 0, sizeof(gFrameCalls));
+	gFrameRedundant = 0;
+	++gFrameIndex;
+	if (gDisjointEvery > 0 && gFrameIndex % gDisjointEvery == 0)
+	{
+		gDisjoint = 1;
+		++gQueryStats.disjoints;
+	}
+}
+
+unsigned long glStubFrameCalls(GLStubCall call)
+{
+	return gFrameCalls[call];
+}
+
+unsigned long glStubTotalCalls(GLStubCall call)
+{
+	return gTotalCalls[call];
+}
+
+unsigned long glStubFrameCallsAll(void)
+{
+	unsigned long sum = 0;
+	for (int i = 0; i < GL_STUB_CALL_COUNT; ++i)
+		sum += gFrameCalls[i];
+	return sum;
+}
+
+unsigned long glStubTotalCallsAll(void)
+{
+	unsigned long sum = 0;
+	for (int i = 0; i < GL_STUB_CALL_COUNT; ++i)
+		sum += gTotalCalls[i];
+	return sum;
+}
+
+const char *glStubCallName(GLStubCall call)
+{
+	return gCallNames[call];
+}
+
+unsigned long glStubFrameRedundant(void)
+{
+	return gFrameRedundant;
+}
+
+unsigned long glStubTotalRedundant(void)
+{
+	return gTotalRedundant;
+}
+
+unsigned long glStubTotalReplays(void)
+{
+	return gReplays;
+}
+
+unsigned long glStubTotalReplayedCalls(void)
+{
+	return gReplayedCalls;
+}
+
+void glStubSetQueryLatency(int latency, int disjointEvery)
+{
+	gQueryLatency = latency;
+	gDisjointEvery = disjointEvery;
+}
+
+void glStubQueryStats(GLStubQueryStats *stats)
+{
+	*stats = gQueryStats;
+	if (!stats->results)
+		stats->minLatency = 0;
+}
+
+// Looks up a created query, counting an error for anything else
+static Query *findQuery(GLuint id, const char *call)
+{
+	for (int i = 0; i < MAX_QUERIES; ++i)
+	{
+		if (gQueries[i].state != QUERY_NONE && gQueries[i].name == id)
+			return &gQueries[i];
+	}
+	if (!gQueryStats.errors++)
+		fprintf(stderr, "%s: %u is not a query\n", call, id);
+	return NULL;
+}
+
+static void queryError(const char *call, const char *error, GLuint id)
+{
+	if (!gQueryStats.errors++)
+		fprintf(stderr, "%s: %s (query %u)\n", call, error, id);
+}
+
+void glStubSetTrace(FILE *file)
+{
+	gTrace = file;
+}
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+void glStubSetCompileCost(double compileMs, double linkMs)
+{
+	gCompileMs = compileMs;
+	gLinkMs = linkMs;
+}
+
+double glStubCompileWaitMs(void)
+{
+	return gCompileWaitMs;
+}
+
+static double readyTime(GLuint object)
+{
+	return object < MAX_COMPILE_OBJECTS ? gReadyTime[object] : 0.0;
+}
+
+// Queues work for the simulated compiler thread, starting no earlier than after
+// the given time
+static void queueCompile(GLuint object, double after, double cost)
+{
+	if (object >= MAX_COMPILE_OBJECTS || cost <= 0.0)
+		return;
+	double start = now();
+	if (gCompilerIdleTime > start)
+		start = gCompilerIdleTime;
+	if (after > start)
+		start = after;
+	gReadyTime[object] = gCompilerIdleTime = start + cost;
+}
+
+// Blocks until the object is compiled or linked, like a driver has to before
+// answering a query about it
+static void waitCompiled(GLuint object)
+{
+	double ready = readyTime(object);
+	double t = now();
+	if (ready <= t)
+		return;
+
+	gCompileWaitMs += ready - t;
+	struct timespec sleep;
+	sleep.tv_sec = (time_t)((ready - t) / 1000.0);
+	sleep.tv_nsec = (long)((ready - t - sleep.tv_sec * 1000.0) * 1000000.0);
+	nanosleep(&sleep, NULL);
+}
+
+// Returns the location of name in program, assigning it the given location, or
+// the next free one if negative, when it has none yet
+static GLint lookupLocation(GLuint program, const GLchar *name, int isAttrib, GLint assign)
+{
+	GLint next = 0;
+	for (int i = 0; i < gLocationCount; ++i)
+	{
+		Location *l = &gLocations[i];
+		if (l->program != program || l->isAttrib != isAttrib)
+			continue;
+		if (strcmp(l->name, name) == 0)
+			return l->location;
+		if (l->location >= next)
+			next = l->location + 1;
+	}
+
+	if (gLocationCount == sizeof(gLocations) / sizeof(gLocations[0]))
+		return -1;
+
+	Location *l = &gLocations[gLocationCount++];
+	l->program = program;
+	l->isAttrib = isAttrib;
+	strncpy(l->name, name, sizeof(l->name) - 1);
+	l->name[sizeof(l->name) - 1] = '\0';
+	l->location = assign >= 0 ? assign : next;
+	return l->location;
+}
+
+void glAttachShader(GLuint program, GLuint shader)
+{
+	RECORD(glAttachShader, "%u, %u", program, shader);
+	// Linking has to wait for the shader, tracked through the program's ready time
+	if (program < MAX_COMPILE_OBJECTS && readyTime(shader) > gReadyTime[program])
+		gReadyTime[program] = readyTime(shader);
+}
+
+void glBeginQueryEXT(GLenum target, GLuint id)
+{
+	RECORD(glBeginQueryEXT, "0x%x, %u", target, id);
+	Query *q = findQuery(id, "glBeginQueryEXT");
+	if (!q)
+		return;
+	if (target != GL_TIME_ELAPSED_EXT)
+		queryError("glBeginQueryEXT", "not a GL_TIME_ELAPSED_EXT query", id);
+	else if (gActiveQuery)
+		queryError("glBeginQueryEXT", "another query is running", gActiveQuery->name);
+	else
+	{
+		q->state = QUERY_ACTIVE;
+		q->begin = gGpuTime;
+		gActiveQuery = q;
+		++gQueryStats.begun;
+	}
+}
+
+void glBindAttribLocation(GLuint program, GLuint index, const GLchar *name)
+{
+	RECORD(glBindAttribLocation, "%u, %u, \"%s\"", program, index, name);
+	lookupLocation(program, name, 1, (GLint)index);
+}
+
+void glBindBuffer(GLenum target, GLuint buffer)
+{
+	RECORD(glBindBuffer, "0x%x, %u", target, buffer);
+	GLuint *bound = target == GL_ARRAY_BUFFER ? &gState.arrayBuffer : &gState.elementBuffer;
+	REDUNDANT(*bound == buffer);
+	*bound = buffer;
+}
+
+void glBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+	RECORD(glBufferData, "0x%x, %ld, %p, 0x%x", target, (long)size, data, usage);
+}
+
+void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+{
+	RECORD(glBufferSubData, "0x%x, %ld, %ld, %p", target, (long)offset, (long)size, data);
+}
+
+void glClear(GLbitfield mask)
+{
+	RECORD(glClear, "0x%x", mask);
+	gGpuTime += GPU_CLEAR_NS;
+}
+
+void glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	RECORD(glClearColor, "%g, %g, %g, %g", red, green, blue, alpha);
+	GLfloat color[4] = {red, green, blue, alpha};
+	REDUNDANT(memcmp(gState.clearColor, color, sizeof(color)) == 0);
+	memcpy(gState.clearColor, color, sizeof(color));
+}
+
+void glCompileShader(GLuint shader)
+{
+	RECORD(glCompileShader, "%u", shader);
+	queueCompile(shader, 0.0, gCompileMs);
+}
+
+GLuint glCreateProgram(void)
+{
+	RECORD(glCreateProgram, "%s", "");
+	if (gNextName < MAX_COMPILE_OBJECTS)
+		gReadyTime[gNextName] = 0.0;
+	return gNextName++;
+}
+
+GLuint glCreateShader(GLenum type)
+{
+	RECORD(glCreateShader, "0x%x", type);
+	if (gNextName < MAX_COMPILE_OBJECTS)
+		gReadyTime[gNextName] = 0.0;
+	return gNextName++;
+}
+
+void glDeleteBuffers(GLsizei n, const GLuint *buffers)
+{
+	RECORD(glDeleteBuffers, "%d", n);
+}
+
+void glDeleteProgram(GLuint program)
+{
+	RECORD(glDeleteProgram, "%u", program);
+}
+
+void glDeleteQueriesEXT(GLsizei n, const GLuint *ids)
+{
+	RECORD(glDeleteQueriesEXT, "%d", n);
+	for (GLsizei i = 0; i < n; ++i)
+	{
+		Query *q = findQuery(ids[i], "glDeleteQueriesEXT");
+		if (!q)
+			continue;
+		if (q == gActiveQuery)
+		{
+			queryError("glDeleteQueriesEXT", "the query is running", ids[i]);
+			gActiveQuery = NULL;
+		}
+		q->state = QUERY_NONE;
+		++gQueryStats.deleted;
+	}
+}
+
+void glDeleteShader(GLuint shader)
+{
+	RECORD(glDeleteShader, "%u", shader);
+}
+
+void glDisableVertexAttribArray(GLuint index)
+{
+	RECORD(glDisableVertexAttribArray, "%u", index);
+	if (index < MAX_ATTRIBS)
+	{
+		REDUNDANT(!gState.attribs[index].enabled);
+		gState.attribs[index].enabled = 0;
+	}
+}
+
+void glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	RECORD(glDrawArrays, "0x%x, %d, %d", mode, first, count);
+	gGpuTime += GPU_DRAW_NS + (uint64_t)count * GPU_VERTEX_NS;
+}
+
+void glDrawArraysInstancedANGLE(GLenum mode, GLint first, GLsizei count, GLsizei primcount)
+{
+	RECORD(glDrawArraysInstancedANGLE, "0x%x, %d, %d, %d", mode, first, count, primcount);
+	gGpuTime += GPU_DRAW_NS + (uint64_t)count * primcount * GPU_VERTEX_NS;
+}
+
+void glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+{
+	RECORD(glDrawElements, "0x%x, %d, 0x%x, %p", mode, count, type, indices);
+	gGpuTime += GPU_DRAW_NS + (uint64_t)count * GPU_VERTEX_NS;
+}
+
+void glEnableVertexAttribArray(GLuint index)
+{
+	RECORD(glEnableVertexAttribArray, "%u", index);
+	if (index < MAX_ATTRIBS)
+	{
+		REDUNDANT(gState.attribs[index].enabled);
+		gState.attribs[index].enabled = 1;
+	}
+}
+
+void glEndQueryEXT(GLenum target)
+{
+	RECORD(glEndQueryEXT, "0x%x", target);
+	if (!gActiveQuery)
+	{
+		queryError("glEndQueryEXT", "no query is running", 0);
+		return;
+	}
+	gActiveQuery->state = QUERY_ENDED;
+	gActiveQuery->endFrame = gFrameIndex;
+	gActiveQuery->result = gGpuTime - gActiveQuery->begin;
+	gActiveQuery = NULL;
+}
+
+void glGenBuffers(GLsizei n, GLuint *buffers)
+{
+	RECORD(glGenBuffers, "%d", n);
+	for (GLsizei i = 0; i < n; ++i)
+		buffers[i] = gNextName++;
+}
+
+void glGenQueriesEXT(GLsizei n, GLuint *ids)
+{
+	RECORD(glGenQueriesEXT, "%d", n);
+	for (GLsizei i = 0; i < n; ++i)
+	{
+		ids[i] = gNextName++;
+		Query *q = gQueries;
+		while (q < gQueries + MAX_QUERIES && q->state != QUERY_NONE)
+			++q;
+		if (q == gQueries + MAX_QUERIES)
+		{
+			queryError("glGenQueriesEXT", "out of simulated queries", ids[i]);
+			continue;
+		}
+		memset(q, 0, sizeof(*q));
+		q->name = ids[i];
+		q->state = QUERY_CREATED;
+		++gQueryStats.created;
+	}
+}
+
+GLint glGetAttribLocation(GLuint program, const GLchar *name)
+{
+	RECORD(glGetAttribLocation, "%u, \"%s\"", program, name);
+	waitCompiled(program);
+	return lookupLocation(program, name, 1, -1);
+}
+
+// Only answers GL_GPU_DISJOINT_EXT, which it also clears like a driver does
+void glGetIntegerv(GLenum pname, GLint *data)
+{
+	RECORD(glGetIntegerv, "0x%x", pname);
+	*data = 0;
+	if (pname == GL_GPU_DISJOINT_EXT)
+	{
+		*data = gDisjoint;
+		gDisjoint = 0;
+	}
+}
+
+void glGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog)
+{
+	RECORD(glGetProgramInfoLog, "%u, %d", program, bufSize);
+	if (length)
+		*length = 0;
+	if (bufSize > 0)
+		infoLog[0] = '\0';
+}
+
+void glGetProgramiv(GLuint program, GLenum pname, GLint *params)
+{
+	RECORD(glGetProgramiv, "%u, 0x%x", program, pname);
+	if (pname == GL_COMPLETION_STATUS_KHR)
+	{
+		*params = readyTime(program) <= now() ? GL_TRUE : GL_FALSE;
+		return;
+	}
+	waitCompiled(program);
+	*params = pname == GL_LINK_STATUS ? GL_TRUE : pname == GL_INFO_LOG_LENGTH ? 1 : 0;
+}
+
+// Returns the query if its result can be asked for
+static Query *endedQuery(GLuint id, const char *call)
+{
+	Query *q = findQuery(id, call);
+	if (q && q->state != QUERY_ENDED)
+	{
+		queryError(call, q->state == QUERY_ACTIVE ? "the query is running" : "the query never ran", id);
+		return NULL;
+	}
+	return q;
+}
+
+static int queryAvailable(const Query *q)
+{
+	return gFrameIndex >= q->endFrame + (unsigned long)gQueryLatency;
+}
+
+// Asking for the result before it is available would block until the GPU
+// gets there, which is counted as a stall
+static uint64_t queryResult(const Query *q)
+{
+	if (!queryAvailable(q))
+		++gQueryStats.stalls;
+	unsigned long latency = gFrameIndex - q->endFrame;
+	if (latency < gQueryStats.minLatency)
+		gQueryStats.minLatency = latency;
+	++gQueryStats.results;
+	return q->result;
+}
+
+void glGetQueryObjectui64vEXT(GLuint id, GLenum pname, GLuint64 *params)
+{
+	RECORD(glGetQueryObjectui64vEXT, "%u, 0x%x", id, pname);
+	Query *q = endedQuery(id, "glGetQueryObjectui64vEXT");
+	*params = 0;
+	if (!q)
+		return;
+	if (pname == GL_QUERY_RESULT_AVAILABLE_EXT)
+		*params = queryAvailable(q);
+	else if (pname == GL_QUERY_RESULT_EXT)
+		*params = queryResult(q);
+}
+
+void glGetQueryObjectuivEXT(GLuint id, GLenum pname, GLuint *params)
+{
+	RECORD(glGetQueryObjectuivEXT, "%u, 0x%x", id, pname);
+	Query *q = endedQuery(id, "glGetQueryObjectuivEXT");
+	*params = 0;
+	if (!q)
+		return;
+	if (pname == GL_QUERY_RESULT_AVAILABLE_EXT)
+		*params = queryAvailable(q);
+	else if (pname == GL_QUERY_RESULT_EXT)
+		*params = (GLuint)queryResult(q);
+}
+
+void glGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog)
+{
+	RECORD(glGetShaderInfoLog, "%u, %d", shader, bufSize);
+	if (length)
+		*length = 0;
+	if (bufSize > 0)
+		infoLog[0] = '\0';
+}
+
+void glGetShaderiv(GLuint shader, GLenum pname, GLint *params)
+{
+	RECORD(glGetShaderiv, "%u, 0x%x", shader, pname);
+	if (pname == GL_COMPLETION_STATUS_KHR)
+	{
+		*params = readyTime(shader) <= now() ? GL_TRUE : GL_FALSE;
+		return;
+	}
+	waitCompiled(shader);
+	*params = pname == GL_COMPILE_STATUS ? GL_TRUE : pname == GL_INFO_LOG_LENGTH ? 1 : 0;
+}
+
+GLint glGetUniformLocation(GLuint program, const GLchar *name)
+{
+	RECORD(glGetUniformLocation, "%u, \"%s\"", program, name);
+	waitCompiled(program);
+	return lookupLocation(program, name, 0, -1);
+}
+
+void glLinkProgram(GLuint program)
+{
+	RECORD(glLinkProgram, "%u", program);
+	queueCompile(program, readyTime(program), gLinkMs);
+}
+
+void glShaderSource(GLuint shader, GLsizei count, const GLchar *const *string, const GLint *length)
+{
+	RECORD(glShaderSource, "%u, %d", shader, count);
+}
+
+void glUniform2fv(GLint location, GLsizei count, const GLfloat *value)
+{
+	RECORD(glUniform2fv, "%d, %d, {%g, %g, ...}", location, count, value[0], value[1]);
+}
+
+void glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+	RECORD(glUniformMatrix4fv, "%d, %d, %d, {%g, %g, %g, %g, ...}", location, count, transpose, value[0], value[1], value[2], value[3]);
+}
+
+void glUseProgram(GLuint program)
+{
+	RECORD(glUseProgram, "%u", program);
+	REDUNDANT(gState.program == program);
+	gState.program = program;
+	waitCompiled(program);
+}
+
+void glVertexAttribDivisorANGLE(GLuint index, GLuint divisor)
+{
+	RECORD(glVertexAttribDivisorANGLE, "%u, %u", index, divisor);
+	if (index < MAX_ATTRIBS)
+	{
+		REDUNDANT(gState.attribs[index].divisor == divisor);
+		gState.attribs[index].divisor = divisor;
+	}
+}
+
+void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer)
+{
+	RECORD(glVertexAttribPointer, "%u, %d, 0x%x, %d, %d, %p", index, size, type, normalized, stride, pointer);
+	if (index < MAX_ATTRIBS)
+	{
+		AttribState *a = &gState.attribs[index];
+		REDUNDANT(a->buffer == gState.arrayBuffer && a->size == size && a->type == type
+			&& a->normalized == normalized && a->stride == stride && a->pointer == pointer);
+		a->buffer = gState.arrayBuffer;
+		a->size = size;
+		a->type = type;
+		a->normalized = normalized;
+		a->stride = stride;
+		a->pointer = pointer;
+	}
+}
+
+void glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	RECORD(glViewport, "%d, %d, %d, %d", x, y, width, height);
+	GLint viewport[4] = {x, y, width, height};
+	REDUNDANT(memcmp(gState.viewport, viewport, sizeof(viewport)) == 0);
+	memcpy(gState.viewport, viewport, sizeof(viewport));
+}
+
+// Native counterpart of gl_command.js. Every command is checked to be well
+// formed before it is made, a malformed stream ends the run.
+void glCmdReplay(const void *commands, int size)
+{
+	// Arguments before the inline data of each command
+	static const int args[GL_CMD_OP_COUNT] =
+	{
+		[GL_CMD_USE_PROGRAM] = 1,
+		[GL_CMD_BIND_BUFFER] = 2,
+		[GL_CMD_BUFFER_DATA] = 4,
+		[GL_CMD_BUFFER_SUB_DATA] = 3,
+		[GL_CMD_CLEAR] = 1,
+		[GL_CMD_CLEAR_COLOR] = 4,
+		[GL_CMD_VIEWPORT] = 4,
+		[GL_CMD_ENABLE_VERTEX_ATTRIB_ARRAY] = 1,
+		[GL_CMD_DISABLE_VERTEX_ATTRIB_ARRAY] = 1,
+		[GL_CMD_VERTEX_ATTRIB_POINTER] = 6,
+		[GL_CMD_VERTEX_ATTRIB_DIVISOR] = 2,
+		[GL_CMD_UNIFORM_2FV] = 2,
+		[GL_CMD_UNIFORM_MATRIX_4FV] = 3,
+		[GL_CMD_DRAW_ARRAYS] = 3,
+		[GL_CMD_DRAW_ARRAYS_INSTANCED] = 4,
+		[GL_CMD_DRAW_ELEMENTS] = 4,
+		[GL_CMD_BEGIN_QUERY] = 2,
+		[GL_CMD_END_QUERY] = 1,
+	};
+
+	++gReplays;
+	const uint32_t *c = commands;
+	const uint32_t *end = c + size / 4;
+	if (size % 4)
+		goto malformed;
+	while (c < end)
+	{
+		GLCmdOp op = GL_CMD_OP(c[0]);
+		int words = GL_CMD_WORDS(c[0]);
+		if (op <= 0 || op >= GL_CMD_OP_COUNT || words < 1 + args[op] || words > end - c)
+			goto malformed;
+
+		// Words of inline data the arguments ask for
+		long data = 0;
+		switch (op)
+		{
+		case GL_CMD_BUFFER_DATA: data = c[4] ? ((long)c[2] + 3) / 4 : 0; break;
+		case GL_CMD_BUFFER_SUB_DATA: data = ((long)c[3] + 3) / 4; break;
+		case GL_CMD_UNIFORM_2FV: data = 2L * (GLsizei)c[2]; break;
+		case GL_CMD_UNIFORM_MATRIX_4FV: data = 16L * (GLsizei)c[2]; break;
+		default: break;
+		}
+		if (words != 1 + args[op] + data)
+			goto malformed;
+
+		const float *f = (const float *)c;
+		switch (op)
+		{
+		case GL_CMD_USE_PROGRAM: glUseProgram(c[1]); break;
+		case GL_CMD_BIND_BUFFER: glBindBuffer(c[1], c[2]); break;
+		case GL_CMD_BUFFER_DATA: glBufferData(c[1], c[2], c[4] ? c + 5 : NULL, c[3]); break;
+		case GL_CMD_BUFFER_SUB_DATA: glBufferSubData(c[1], c[2], c[3], c + 4); break;
+		case GL_CMD_CLEAR: glClear(c[1]); break;
+		case GL_CMD_CLEAR_COLOR: glClearColor(f[1], f[2], f[3], f[4]); break;
+		case GL_CMD_VIEWPORT: glViewport(c[1], c[2], c[3], c[4]); break;
+		case GL_CMD_ENABLE_VERTEX_ATTRIB_ARRAY: glEnableVertexAttribArray(c[1]); break;
+		case GL_CMD_DISABLE_VERTEX_ATTRIB_ARRAY: glDisableVertexAttribArray(c[1]); break;
+		case GL_CMD_VERTEX_ATTRIB_POINTER:
+			glVertexAttribPointer(c[1], c[2], c[3], c[4], c[5], (const void *)(uintptr_t)c[6]);
+			break;
+		case GL_CMD_VERTEX_ATTRIB_DIVISOR: glVertexAttribDivisorANGLE(c[1], c[2]); break;
+		case GL_CMD_UNIFORM_2FV: glUniform2fv(c[1], c[2], f + 3); break;
+		case GL_CMD_UNIFORM_MATRIX_4FV: glUniformMatrix4fv(c[1], c[2], c[3], f + 4); break;
+		case GL_CMD_DRAW_ARRAYS: glDrawArrays(c[1], c[2], c[3]); break;
+		case GL_CMD_DRAW_ARRAYS_INSTANCED: glDrawArraysInstancedANGLE(c[1], c[2], c[3], c[4]); break;
+		case GL_CMD_DRAW_ELEMENTS: glDrawElements(c[1], c[2], c[3], (const void *)(uintptr_t)c[4]); break;
+		case GL_CMD_BEGIN_QUERY: glBeginQueryEXT(c[1], c[2]); break;
+		case GL_CMD_END_QUERY: glEndQueryEXT(c[1]); break;
+		default: break;
+		}
+		++gReplayedCalls;
+		c += words;
+	}
+	return;
+
+malformed:
+	fprintf(stderr, "Malformed GL command buffer at byte %ld of %d\n", (long)((const char *)c - (const char *)commands), size);
+	exit(1);
+}
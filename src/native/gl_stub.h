@@ -0,0 +1,115 @@
+// Recording GLES2 (plus the extensions the app uses) stub for the native build. Every GL entry point used by the
+// app is implemented here without a GPU: calls are counted per entry point and
+// per frame, and optionally traced as text to a file.
+#ifndef GL_STUB_H
+#define GL_STUB_H
+
+#include <stdio.h>
+
+// Every GL entry point the stub implements
+#define GL_STUB_CALLS(X) \
+	X(glAttachShader) \
+	X(glBeginQueryEXT) \
+	X(glBindAttribLocation) \
+	X(glBindBuffer) \
+	X(glBufferData) \
+	X(glBufferSubData) \
+	X(glClear) \
+	X(glClearColor) \
+	X(glCompileShader) \
+	X(glCreateProgram) \
+	X(glCreateShader) \
+	X(glDeleteBuffers) \
+	X(glDeleteProgram) \
+	X(glDeleteQueriesEXT) \
+	X(glDeleteShader) \
+	X(glDisableVertexAttribArray) \
+	X(glDrawArrays) \
+	X(glDrawArraysInstancedANGLE) \
+	X(glDrawElements) \
+	X(glEnableVertexAttribArray) \
+	X(glEndQueryEXT) \
+	X(glGenBuffers) \
+	X(glGenQueriesEXT) \
+	X(glGetAttribLocation) \
+	X(glGetIntegerv) \
+	X(glGetProgramInfoLog) \
+	X(glGetProgramiv) \
+	X(glGetQueryObjectui64vEXT) \
+	X(glGetQueryObjectuivEXT) \
+	X(glGetShaderInfoLog) \
+	X(glGetShaderiv) \
+	X(glGetUniformLocation) \
+	X(glLinkProgram) \
+	X(glShaderSource) \
+	X(glUniform2fv) \
+	X(glUniformMatrix4fv) \
+	X(glUseProgram) \
+	X(glVertexAttribDivisorANGLE) \
+	X(glVertexAttribPointer) \
+	X(glViewport)
+
+typedef enum GLStubCall
+{
+#define GL_STUB_ENUM(name) GL_STUB_##name,
+	GL_STUB_CALLS(GL_STUB_ENUM)
+#undef GL_STUB_ENUM
+	GL_STUB_CALL_COUNT
+} GLStubCall;
+
+// Starts a new frame for the per-frame counters
+void glStubBeginFrame(void);
+
+// Number of calls to an entry point in the current frame, or since startup
+unsigned long glStubFrameCalls(GLStubCall call);
+unsigned long glStubTotalCalls(GLStubCall call);
+
+// Sum over all entry points in the current frame, or since startup
+unsigned long glStubFrameCallsAll(void);
+unsigned long glStubTotalCallsAll(void);
+
+const char *glStubCallName(GLStubCall call);
+
+// Calls that set state to the value it already had (program, buffer binding,
+// viewport, clear color, vertex attribute setup), in the current frame or
+// since startup
+unsigned long glStubFrameRedundant(void);
+unsigned long glStubTotalRedundant(void);
+
+// Command buffer replays (glCmdReplay, gl_command.h) and the GL calls they
+// made, since startup. Each replay stands for a single call from wasm into
+// JavaScript, where every direct GL call is one.
+unsigned long glStubTotalReplays(void);
+unsigned long glStubTotalReplayedCalls(void);
+
+// Writes one line per GL call to the file, or stops tracing when NULL
+void glStubSetTrace(FILE *file);
+
+// Simulated driver compiler: every glCompileShader and glLinkProgram takes the
+// given time on a single background compiler thread. Queries that need the
+// result (compile and link status, locations, glUseProgram) wait for it, while
+// GL_COMPLETION_STATUS_KHR only reports whether it is done. Both default to 0.
+void glStubSetCompileCost(double compileMs, double linkMs);
+
+// Total time the calling thread waited for the simulated compiler
+double glStubCompileWaitMs(void);
+
+// Simulated timer queries (EXT_disjoint_timer_query). A GL_TIME_ELAPSED_EXT
+// query measures the simulated GPU cost of the clears and draws between its
+// begin and end, and its result becomes available latency frames after the
+// frame it ended in. Every disjointEvery frames (0 for never) GL_GPU_DISJOINT_EXT
+// reports the timer as disturbed. Defaults to 2 frames and never.
+void glStubSetQueryLatency(int latency, int disjointEvery);
+
+typedef struct GLStubQueryStats
+{
+	unsigned long created, deleted, begun, results;
+	unsigned long stalls;     // Results read before they were available, a real driver blocks on those
+	unsigned long errors;     // Lifecycle errors, e.g. a begin while another query runs or an end without one
+	unsigned long disjoints;  // Frames that raised the disjoint flag
+	unsigned long minLatency; // Fewest frames from a query's end to reading its result
+} GLStubQueryStats;
+
+void glStubQueryStats(GLStubQueryStats *stats);
+
+#endif
@@ -0,0 +1,208 @@
+// Scaling of the per-frame parallel-for phases with the thread count.
+//
+// Runs the frame loop's CPU work on 100k objects with the job pool (jobs.h)
+// started with 1 thread, then 2, and so on up to 8 (or the count given as
+// the first argument):
+//   - update: one simulation tick of spin and the interpolated world matrices
+//   - cull: the combined stereo frustum test, chunk by chunk, then the
+//     compaction of the chunks' visible lists on the calling thread
+//   - mvp: both eyes' MVPs of the visible objects
+// in chunks of 1024 objects like the app. Reports each phase's time per frame
+// and its speedup over a single thread, next to the number of cores online.
+// Threads beyond the cores only show the cost of sharing them.
+//
+// It fails if a thread count gives different visible objects or MVPs than a
+// single thread.
+#include "../cull.h"
+#include "../jobs.h"
+#include "../scene.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define OBJECTS 100000
+#define FRAMES 200
+#define JOB_GRAIN 1024
+#define MAX_THREADS 8
+#define EYE_OFFSET 0.032f
+
+enum
+{
+	PHASE_UPDATE,
+	PHASE_CULL,
+	PHASE_MVP,
+	PHASE_COUNT
+};
+
+static const char *gPhaseNames[PHASE_COUNT] = {"update", "cull", "mvp"};
+
+static Scene gScene;
+static Frustum gFrustum;
+static mat4x4 gViewProjection[2];
+static int *gVisible, gVisibleCount;
+static int gChunkVisible[(OBJECTS + JOB_GRAIN - 1) / JOB_GRAIN];
+static mat4x4 *gMvp[2];
+static double gTime;
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static float randomRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// View-projection of one eye of a head looking down the -Z axis
+static void eyeViewProjection(mat4x4 out, float eyeOffset)
+{
+	mat4x4 eye, view, projection;
+	mat4x4_translate(eye, eyeOffset, 1.6f, 0.f);
+	mat4x4_invert_rigid(view, eye);
+	mat4x4_perspective(projection, 1.6f, 0.9f, 0.1f, 100.f);
+	mat4x4_mul_affine(out, projection, view);
+}
+
+static void initScene()
+{
+	srand(1);
+	for (int i = 0; i < OBJECTS; ++i)
+	{
+		vec3 p = {randomRange(-50.f, 50.f), randomRange(-5.f, 10.f), randomRange(-100.f, 0.f)};
+		quat q;
+		quat_identity(q);
+		sceneAdd(&gScene, p, q, randomRange(0.5f, 2.f), randomRange(0.1f, 1.f));
+	}
+}
+
+static void updateRange(void *userData, int first, int count)
+{
+	(void)userData;
+	vec3 axis = {0.f, 0.f, 1.f};
+	for (int i = first; i < first + count; ++i)
+	{
+		memcpy(gScene.previousRotation[i], gScene.rotation[i], sizeof(quat));
+		quat_rotate(gScene.rotation[i], (float)fmod(gTime * (1.0 + 0.1 * (i % 8)), 2.0 * M_PI), axis);
+	}
+	sceneUpdateWorldInterpolated(&gScene, 0.5f, first, count);
+}
+
+static void cullRange(void *userData, int first, int count)
+{
+	(void)userData;
+	for (int chunk = first; chunk < first + count; chunk += JOB_GRAIN)
+	{
+		int n = first + count - chunk < JOB_GRAIN ? first + count - chunk : JOB_GRAIN;
+		gChunkVisible[chunk / JOB_GRAIN] = cullSpheres(&gFrustum, gScene.position, gScene.radius, gScene.scale,
+			chunk, n, gVisible + chunk);
+	}
+}
+
+static void mvpRange(void *userData, int first, int count)
+{
+	(void)userData;
+	for (int v = 0; v < 2; ++v)
+		sceneComputeMvpIndexed(&gScene, gViewProjection[v], gMvp[v] + first, gVisible + first, count);
+}
+
+// One frame's phases, each timed on its own
+static void frame(int index, double *ms)
+{
+	gTime = index / 90.0;
+	double start = now();
+	jobsParallelFor(gScene.count, JOB_GRAIN, updateRange, NULL);
+	double end = now();
+	ms[PHASE_UPDATE] += end - start;
+
+	start = end;
+	jobsParallelFor(gScene.count, JOB_GRAIN, cullRange, NULL);
+	int visible = gChunkVisible[0];
+	for (int chunk = 1; chunk * JOB_GRAIN < gScene.count; ++chunk)
+	{
+		memmove(gVisible + visible, gVisible + chunk * JOB_GRAIN, gChunkVisible[chunk] * sizeof(int));
+		visible += gChunkVisible[chunk];
+	}
+	gVisibleCount = visible;
+	end = now();
+	ms[PHASE_CULL] += end - start;
+
+	start = end;
+	jobsParallelFor(gVisibleCount, JOB_GRAIN, mvpRange, NULL);
+	ms[PHASE_MVP] += now() - start;
+}
+
+int main(int argc, char **argv)
+{
+	int maxThreads = argc > 1 ? atoi(argv[1]) : MAX_THREADS;
+	gVisible = malloc(OBJECTS * sizeof(int));
+	int *referenceVisible = malloc(OBJECTS * sizeof(int));
+	for (int v = 0; v < 2; ++v)
+		gMvp[v] = malloc(OBJECTS * sizeof(mat4x4));
+	mat4x4 *referenceMvp = malloc(2 * OBJECTS * sizeof(mat4x4));
+	if (!sceneInit(&gScene, OBJECTS) || !gVisible || !referenceVisible || !gMvp[0] || !gMvp[1] || !referenceMvp)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	initScene();
+	eyeViewProjection(gViewProjection[0], -EYE_OFFSET);
+	eyeViewProjection(gViewProjection[1], EYE_OFFSET);
+	frustumCombineStereo(&gFrustum, gViewProjection[0], gViewProjection[1]);
+
+	printf("%d objects, %d frames, %ld cores online, ms per frame (speedup over 1 thread)\n", OBJECTS, FRAMES,
+		sysconf(_SC_NPROCESSORS_ONLN));
+	printf("  %7s", "threads");
+	for (int p = 0; p < PHASE_COUNT; ++p)
+		printf(" %17s", gPhaseNames[p]);
+	printf(" %17s\n", "total");
+
+	int ok = 1, referenceCount = 0;
+	double single[PHASE_COUNT + 1];
+	for (int threads = 1; threads <= maxThreads; ++threads)
+	{
+		int started = jobsInit(threads);
+		double ms[PHASE_COUNT + 1] = {0};
+		frame(0, ms); // Warms the caches and wakes the workers once
+		memset(ms, 0, sizeof(ms));
+		for (int f = 1; f <= FRAMES; ++f)
+			frame(f, ms);
+		jobsShutdown();
+
+		// Every run ends on the same frame, so the results have to match
+		if (threads == 1)
+		{
+			referenceCount = gVisibleCount;
+			memcpy(referenceVisible, gVisible, gVisibleCount * sizeof(int));
+			memcpy(referenceMvp, gMvp[0], gVisibleCount * sizeof(mat4x4));
+			memcpy(referenceMvp + OBJECTS, gMvp[1], gVisibleCount * sizeof(mat4x4));
+		}
+		else if (gVisibleCount != referenceCount || memcmp(gVisible, referenceVisible, gVisibleCount * sizeof(int))
+			|| memcmp(gMvp[0], referenceMvp, gVisibleCount * sizeof(mat4x4))
+			|| memcmp(gMvp[1], referenceMvp + OBJECTS, gVisibleCount * sizeof(mat4x4)))
+		{
+			printf("  %d threads gave different results than 1\n", threads);
+			ok = 0;
+		}
+
+		for (int p = 0; p < PHASE_COUNT; ++p)
+			ms[PHASE_COUNT] += ms[p];
+		if (threads == 1)
+			memcpy(single, ms, sizeof(ms));
+		printf("  %7d", started);
+		for (int p = 0; p <= PHASE_COUNT; ++p)
+			printf(" %9.3f (%4.2fx)", ms[p] / FRAMES, single[p] / ms[p]);
+		printf("\n");
+	}
+
+	printf("%d of %d objects visible\n", referenceCount, OBJECTS);
+	sceneFree(&gScene);
+	printf("%s\n", ok ? "ok" : "FAILED");
+	return !ok;
+}
@@ -0,0 +1,811 @@
+// Time per call and accuracy of every function in linmath.h.
+//
+// Each function runs over a pool of varied inputs, so the time per call is
+// throughput, loop and loads included, rather than the latency of a chain.
+// Every output is then compared against a double precision reference on the
+// same float inputs, and the worst difference is reported in units of
+// FLT_EPSILON relative to the magnitude of the output (at least 1, so that
+// results cancelling to near zero are held to an absolute bound).
+//
+// make native-linmath-bench builds it at -O2 and -O3 and a scalar
+// -DLINMATH_NO_SIMD one at -O2. Options:
+//   --csv FILE       writes the results as CSV
+//   --json FILE      writes them as JSON
+//   --baseline FILE  compares against the CSV of an earlier run
+//
+// It fails if a function is out of tolerance, or less accurate than in the
+// baseline, which has to be refreshed when that is intended.
+#include "../linmath.h"
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef BENCH_OPT_LEVEL
+#define BENCH_OPT_LEVEL 2 // Set by the Makefile to match -O
+#endif
+
+#define POOL 1024        // Inputs per function, a power of two
+#define MIN_PASS_MS 2.0  // Calls per pass are doubled until a pass takes this long
+#define PASSES 5         // Timed passes, the fastest counts
+#define MAX_BASELINE 128
+
+#define M_OUT ((vec4 *)out)
+#define D(m) ((float *)(m))
+
+typedef struct Benchmark
+{
+	const char *name;
+	double toleranceEps;
+	void (*run)(int calls);
+	double (*check)();
+} Benchmark;
+
+typedef struct Result
+{
+	double nsPerOp, errorEps;
+	int ok;
+} Result;
+
+typedef struct Baseline
+{
+	char name[64];
+	double nsPerOp, errorEps;
+} Baseline;
+
+// Inputs, every one in the pool different
+static vec4 gA[POOL], gB[POOL];   // Components in [-1, 1], length over 0.1
+static vec4 gUnit[POOL];          // Unit vec3, w 0, never close to the y axis
+static vec4 gCenter[POOL];        // A point a few units from gA along gUnit
+static float gScalar[POOL];       // In [-2, 2]
+static float gAngle[POOL];        // Radians in [-pi, pi]
+static mat4x4 gMa[POOL], gMb[POOL]; // Elements in [-1, 1]
+static mat4x4 gAffine[POOL];      // Rotation, scale in [0.5, 2] and translation
+static mat4x4 gRotation[POOL];
+static mat4x4 gRigid[POOL];        // gRotation with a translation
+static mat4x4 gSkewed[POOL];      // gRotation with up to 0.2 added to each element
+static quat gQa[POOL], gQb[POOL]; // Unit
+static float gFrustum[POOL][6];   // l, r, b, t, n, f
+static float gOrtho[POOL][6];
+static float gPerspective[POOL][4]; // y_fov, aspect, n, f
+
+// Outputs of the timed runs, kept so the calls cannot be optimized away
+static float gOut[POOL][16];
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+// Deterministic, so errors are comparable between runs
+static unsigned gRandom = 1;
+static float randomRange(float lo, float hi)
+{
+	gRandom = gRandom * 1664525u + 1013904223u;
+	return lo + (hi - lo) * (float)((gRandom >> 8) / (double)(1u << 24));
+}
+
+static void toDouble(double *d, const float *f, int n)
+{
+	for (int i = 0; i < n; ++i)
+		d[i] = f[i];
+}
+
+static double refDot(const float *a, const float *b, int n)
+{
+	double p = 0.0;
+	for (int i = 0; i < n; ++i)
+		p += (double)a[i] * b[i];
+	return p;
+}
+
+static void refAdd(double *r, const float *a, const float *b, int n)
+{
+	for (int i = 0; i < n; ++i)
+		r[i] = (double)a[i] + b[i];
+}
+
+static void refSub(double *r, const float *a, const float *b, int n)
+{
+	for (int i = 0; i < n; ++i)
+		r[i] = (double)a[i] - b[i];
+}
+
+static void refScale(double *r, const float *v, double s, int n)
+{
+	for (int i = 0; i < n; ++i)
+		r[i] = v[i] * s;
+}
+
+static void refNorm(double *r, const float *v, int n)
+{
+	refScale(r, v, 1.0 / sqrt(refDot(v, v, n)), n);
+}
+
+static void refCross(double *r, const double *a, const double *b)
+{
+	r[0] = a[1] * b[2] - a[2] * b[1];
+	r[1] = a[2] * b[0] - a[0] * b[2];
+	r[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void refCrossFloat(double *r, const float *a, const float *b)
+{
+	double da[3], db[3];
+	toDouble(da, a, 3);
+	toDouble(db, b, 3);
+	refCross(r, da, db);
+}
+
+static void refReflect(double *r, const float *v, const float *n, int count)
+{
+	double p = 2.0 * refDot(v, n, count);
+	for (int i = 0; i < count; ++i)
+		r[i] = v[i] - p * n[i];
+}
+
+static void refIdentity(double *m)
+{
+	for (int i = 0; i < 16; ++i)
+		m[i] = i % 5 == 0 ? 1.0 : 0.0;
+}
+
+// Matrices are column major like mat4x4: m[column * 4 + row]
+static void refMul(double *r, const double *a, const double *b)
+{
+	for (int c = 0; c < 4; ++c)
+		for (int row = 0; row < 4; ++row)
+		{
+			double sum = 0.0;
+			for (int k = 0; k < 4; ++k)
+				sum += a[k * 4 + row] * b[c * 4 + k];
+			r[c * 4 + row] = sum;
+		}
+}
+
+static void refMulVec4(double *r, const float *m, const float *v)
+{
+	for (int row = 0; row < 4; ++row)
+	{
+		double sum = 0.0;
+		for (int k = 0; k < 4; ++k)
+			sum += (double)m[k * 4 + row] * v[k];
+		r[row] = sum;
+	}
+}
+
+static void refRow(double *r, const float *m, int i)
+{
+	for (int k = 0; k < 4; ++k)
+		r[k] = m[k * 4 + i];
+}
+
+static void refTranspose(double *r, const float *m)
+{
+	for (int c = 0; c < 4; ++c)
+		for (int row = 0; row < 4; ++row)
+			r[c * 4 + row] = m[row * 4 + c];
+}
+
+static void refScaleAniso(double *r, const float *m, double x, double y, double z)
+{
+	refScale(r, m, x, 4);
+	refScale(r + 4, m + 4, y, 4);
+	refScale(r + 8, m + 8, z, 4);
+	toDouble(r + 12, m + 12, 4);
+}
+
+static void refTranslate(double *r, double x, double y, double z)
+{
+	refIdentity(r);
+	r[12] = x;
+	r[13] = y;
+	r[14] = z;
+}
+
+static void refTranslateInPlace(double *r, const float *m, double x, double y, double z)
+{
+	double d[16], t[16];
+	toDouble(d, m, 16);
+	refTranslate(t, x, y, z);
+	refMul(r, d, t);
+}
+
+static void refOuter(double *r, const float *a, const float *b)
+{
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+			r[i * 4 + j] = i < 3 && j < 3 ? (double)a[i] * b[j] : 0.0;
+}
+
+// m times the rotation about the axis by the angle, counterclockwise looking
+// down the axis
+static void refRotate(double *r, const float *m, double x, double y, double z, double angle)
+{
+	double d[16];
+	toDouble(d, m, 16);
+	double len = sqrt(x * x + y * y + z * z);
+	if (len <= 1e-4)
+	{
+		memcpy(r, d, sizeof(d));
+		return;
+	}
+	double u[3] = {x / len, y / len, z / len};
+	double s = sin(angle), c = cos(angle);
+	double rotation[16];
+	refIdentity(rotation);
+	for (int col = 0; col < 3; ++col)
+		for (int row = 0; row < 3; ++row)
+			rotation[col * 4 + row] = (1.0 - c) * u[row] * u[col] + (row == col ? c : 0.0);
+	rotation[1 * 4 + 2] += s * u[0];
+	rotation[2 * 4 + 1] -= s * u[0];
+	rotation[2 * 4 + 0] += s * u[1];
+	rotation[0 * 4 + 2] -= s * u[1];
+	rotation[0 * 4 + 1] += s * u[2];
+	rotation[1 * 4 + 0] -= s * u[2];
+	refMul(r, d, rotation);
+}
+
+// Gauss-Jordan elimination with partial pivoting
+static void refInvert(double *r, const float *m)
+{
+	double a[4][8];
+	for (int row = 0; row < 4; ++row)
+		for (int c = 0; c < 4; ++c)
+		{
+			a[row][c] = m[c * 4 + row];
+			a[row][c + 4] = row == c ? 1.0 : 0.0;
+		}
+	for (int c = 0; c < 4; ++c)
+	{
+		int pivot = c;
+		for (int row = c + 1; row < 4; ++row)
+			if (fabs(a[row][c]) > fabs(a[pivot][c]))
+				pivot = row;
+		for (int k = 0; k < 8; ++k)
+		{
+			double t = a[c][k];
+			a[c][k] = a[pivot][k];
+			a[pivot][k] = t;
+		}
+		double p = a[c][c];
+		for (int k = 0; k < 8; ++k)
+			a[c][k] /= p;
+		for (int row = 0; row < 4; ++row)
+		{
+			if (row == c)
+				continue;
+			double f = a[row][c];
+			for (int k = 0; k < 8; ++k)
+				a[row][k] -= f * a[c][k];
+		}
+	}
+	for (int row = 0; row < 4; ++row)
+		for (int c = 0; c < 4; ++c)
+			r[c * 4 + row] = a[row][c + 4];
+}
+
+static void refNorm3(double *v)
+{
+	double len = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	for (int i = 0; i < 3; ++i)
+		v[i] /= len;
+}
+
+static void refSubProjection(double *v, const double *unit)
+{
+	double p = v[0] * unit[0] + v[1] * unit[1] + v[2] * unit[2];
+	for (int i = 0; i < 3; ++i)
+		v[i] -= p * unit[i];
+}
+
+// Gram-Schmidt from the z column to the x column, w elements left alone
+static void refOrthonormalize(double *r, const float *m)
+{
+	toDouble(r, m, 16);
+	refNorm3(r + 8);
+	refSubProjection(r + 4, r + 8);
+	refNorm3(r + 4);
+	refSubProjection(r, r + 8);
+	refSubProjection(r, r + 4);
+	refNorm3(r);
+}
+
+static void refFrustum(double *r, const float *p)
+{
+	double l = p[0], right = p[1], b = p[2], t = p[3], n = p[4], f = p[5];
+	memset(r, 0, 16 * sizeof(double));
+	r[0] = 2.0 * n / (right - l);
+	r[5] = 2.0 * n / (t - b);
+	r[8] = (right + l) / (right - l);
+	r[9] = (t + b) / (t - b);
+	r[10] = -(f + n) / (f - n);
+	r[11] = -1.0;
+	r[14] = -2.0 * f * n / (f - n);
+}
+
+static void refOrtho(double *r, const float *p)
+{
+	double l = p[0], right = p[1], b = p[2], t = p[3], n = p[4], f = p[5];
+	memset(r, 0, 16 * sizeof(double));
+	r[0] = 2.0 / (right - l);
+	r[5] = 2.0 / (t - b);
+	r[10] = -2.0 / (f - n);
+	r[12] = -(right + l) / (right - l);
+	r[13] = -(t + b) / (t - b);
+	r[14] = -(f + n) / (f - n);
+	r[15] = 1.0;
+}
+
+static void refPerspective(double *r, const float *p)
+{
+	double a = 1.0 / tan(p[0] / 2.0), n = p[2], f = p[3];
+	memset(r, 0, 16 * sizeof(double));
+	r[0] = a / p[1];
+	r[5] = a;
+	r[10] = -(f + n) / (f - n);
+	r[11] = -1.0;
+	r[14] = -2.0 * f * n / (f - n);
+}
+
+static void refLookAt(double *r, const float *eye, const float *center, const float *up)
+{
+	double e[3], f[3], u[3], s[3], t[3];
+	toDouble(e, eye, 3);
+	toDouble(u, up, 3);
+	for (int i = 0; i < 3; ++i)
+		f[i] = (double)center[i] - eye[i];
+	refNorm3(f);
+	refCross(s, f, u);
+	refNorm3(s);
+	refCross(t, s, f);
+	memset(r, 0, 16 * sizeof(double));
+	for (int i = 0; i < 3; ++i)
+	{
+		r[i * 4 + 0] = s[i];
+		r[i * 4 + 1] = t[i];
+		r[i * 4 + 2] = -f[i];
+		r[12] -= s[i] * e[i];
+		r[13] -= t[i] * e[i];
+		r[14] += f[i] * e[i];
+	}
+	r[15] = 1.0;
+}
+
+// Quaternions are (x, y, z, w) like quat
+static void refQuatMul(double *r, const float *p, const float *q)
+{
+	double px = p[0], py = p[1], pz = p[2], pw = p[3];
+	double qx = q[0], qy = q[1], qz = q[2], qw = q[3];
+	r[0] = pw * qx + px * qw + py * qz - pz * qy;
+	r[1] = pw * qy - px * qz + py * qw + pz * qx;
+	r[2] = pw * qz + px * qy - py * qx + pz * qw;
+	r[3] = pw * qw - px * qx - py * qy - pz * qz;
+}
+
+static void refQuatConj(double *r, const float *q)
+{
+	r[0] = -(double)q[0];
+	r[1] = -(double)q[1];
+	r[2] = -(double)q[2];
+	r[3] = q[3];
+}
+
+static void refQuatRotate(double *r, double angle, const float *axis)
+{
+	refScale(r, axis, sin(angle / 2.0), 3);
+	r[3] = cos(angle / 2.0);
+}
+
+// Rotation matrix of a unit quaternion, as the images of the basis vectors
+static void refFromQuat(double *r, const float *q)
+{
+	double x = q[0], y = q[1], z = q[2], w = q[3];
+	refIdentity(r);
+	r[0] = 1.0 - 2.0 * (y * y + z * z);
+	r[1] = 2.0 * (x * y + w * z);
+	r[2] = 2.0 * (x * z - w * y);
+	r[4] = 2.0 * (x * y - w * z);
+	r[5] = 1.0 - 2.0 * (x * x + z * z);
+	r[6] = 2.0 * (y * z + w * x);
+	r[8] = 2.0 * (x * z + w * y);
+	r[9] = 2.0 * (y * z - w * x);
+	r[10] = 1.0 - 2.0 * (x * x + y * y);
+}
+
+static void refQuatMulVec3(double *r, const float *q, const float *v)
+{
+	double m[16];
+	refFromQuat(m, q);
+	for (int row = 0; row < 3; ++row)
+		r[row] = m[row] * v[0] + m[4 + row] * v[1] + m[8 + row] * v[2];
+}
+
+static void refMat4oMulQuat(double *r, const float *m, const float *q)
+{
+	for (int c = 0; c < 3; ++c)
+	{
+		refQuatMulVec3(r + c * 4, q, m + c * 4);
+		r[c * 4 + 3] = m[c * 4 + 3];
+	}
+	r[12] = r[13] = r[14] = 0.0;
+	r[15] = m[15];
+}
+
+// From the rotation matrix, with the sign of q taken from the result
+// being checked: q and -q are the same rotation
+static void refQuatFromMat(double *r, const float *m, const float *result)
+{
+	double d[16];
+	toDouble(d, m, 16);
+	double trace = d[0] + d[5] + d[10];
+	if (trace > 0.0)
+	{
+		double s = 2.0 * sqrt(1.0 + trace);
+		r[3] = s / 4.0;
+		r[0] = (d[6] - d[9]) / s;
+		r[1] = (d[8] - d[2]) / s;
+		r[2] = (d[1] - d[4]) / s;
+	}
+	else
+	{
+		int i = d[5] > d[0] ? 1 : 0;
+		if (d[10] > d[i * 5])
+			i = 2;
+		int j = (i + 1) % 3, k = (i + 2) % 3;
+		double s = 2.0 * sqrt(1.0 + d[i * 5] - d[j * 5] - d[k * 5]);
+		r[i] = s / 4.0;
+		r[3] = (d[j * 4 + k] - d[k * 4 + j]) / s;
+		r[j] = (d[i * 4 + j] + d[j * 4 + i]) / s;
+		r[k] = (d[i * 4 + k] + d[k * 4 + i]) / s;
+	}
+	if (r[0] * result[0] + r[1] * result[1] + r[2] * result[2] + r[3] * result[3] < 0.0)
+		for (int i = 0; i < 4; ++i)
+			r[i] = -r[i];
+}
+
+static double relativeError(const float *out, const double *ref, int n)
+{
+	double scale = 1.0, worst = 0.0;
+	for (int i = 0; i < n; ++i)
+		scale = fmax(scale, fabs(ref[i]));
+	for (int i = 0; i < n; ++i)
+		worst = fmax(worst, fabs(out[i] - ref[i]));
+	return worst / scale / FLT_EPSILON;
+}
+
+// name, tolerance in FLT_EPSILON, output floats, the call writing to out,
+// the reference writing to ref. In-place functions work on a copy, which is
+// part of their time.
+#define LINMATH_BENCHMARKS(X) \
+	X(vec2_add, 1, 2, vec2_add(out, gA[k], gB[k]), refAdd(ref, gA[k], gB[k], 2)) \
+	X(vec2_sub, 1, 2, vec2_sub(out, gA[k], gB[k]), refSub(ref, gA[k], gB[k], 2)) \
+	X(vec2_scale, 1, 2, vec2_scale(out, gA[k], gScalar[k]), refScale(ref, gA[k], gScalar[k], 2)) \
+	X(vec2_mul_inner, 4, 1, out[0] = vec2_mul_inner(gA[k], gB[k]), ref[0] = refDot(gA[k], gB[k], 2)) \
+	X(vec2_len, 4, 1, out[0] = vec2_len(gA[k]), ref[0] = sqrt(refDot(gA[k], gA[k], 2))) \
+	X(vec2_norm, 4, 2, vec2_norm(out, gA[k]), refNorm(ref, gA[k], 2)) \
+	X(vec3_add, 1, 3, vec3_add(out, gA[k], gB[k]), refAdd(ref, gA[k], gB[k], 3)) \
+	X(vec3_sub, 1, 3, vec3_sub(out, gA[k], gB[k]), refSub(ref, gA[k], gB[k], 3)) \
+	X(vec3_scale, 1, 3, vec3_scale(out, gA[k], gScalar[k]), refScale(ref, gA[k], gScalar[k], 3)) \
+	X(vec3_mul_inner, 4, 1, out[0] = vec3_mul_inner(gA[k], gB[k]), ref[0] = refDot(gA[k], gB[k], 3)) \
+	X(vec3_len, 4, 1, out[0] = vec3_len(gA[k]), ref[0] = sqrt(refDot(gA[k], gA[k], 3))) \
+	X(vec3_norm, 4, 3, vec3_norm(out, gA[k]), refNorm(ref, gA[k], 3)) \
+	X(vec3_mul_cross, 4, 3, vec3_mul_cross(out, gA[k], gB[k]), refCrossFloat(ref, gA[k], gB[k])) \
+	X(vec3_reflect, 8, 3, vec3_reflect(out, gA[k], gUnit[k]), refReflect(ref, gA[k], gUnit[k], 3)) \
+	X(vec4_add, 1, 4, vec4_add(out, gA[k], gB[k]), refAdd(ref, gA[k], gB[k], 4)) \
+	X(vec4_sub, 1, 4, vec4_sub(out, gA[k], gB[k]), refSub(ref, gA[k], gB[k], 4)) \
+	X(vec4_scale, 1, 4, vec4_scale(out, gA[k], gScalar[k]), refScale(ref, gA[k], gScalar[k], 4)) \
+	X(vec4_mul_inner, 4, 1, out[0] = vec4_mul_inner(gA[k], gB[k]), ref[0] = refDot(gA[k], gB[k], 4)) \
+	X(vec4_len, 4, 1, out[0] = vec4_len(gA[k]), ref[0] = sqrt(refDot(gA[k], gA[k], 4))) \
+	X(vec4_norm, 4, 4, vec4_norm(out, gA[k]), refNorm(ref, gA[k], 4)) \
+	X(vec4_mul_cross, 4, 4, vec4_mul_cross(out, gA[k], gB[k]), (refCrossFloat(ref, gA[k], gB[k]), ref[3] = 1.0)) \
+	X(vec4_reflect, 8, 4, vec4_reflect(out, gA[k], gUnit[k]), refReflect(ref, gA[k], gUnit[k], 4)) \
+	X(mat4x4_identity, 0, 16, mat4x4_identity(M_OUT), refIdentity(ref)) \
+	X(mat4x4_dup, 0, 16, mat4x4_dup(M_OUT, gMa[k]), toDouble(ref, D(gMa[k]), 16)) \
+	X(mat4x4_row, 0, 4, mat4x4_row(out, gMa[k], k & 3), refRow(ref, D(gMa[k]), k & 3)) \
+	X(mat4x4_col, 0, 4, mat4x4_col(out, gMa[k], k & 3), toDouble(ref, gMa[k][k & 3], 4)) \
+	X(mat4x4_transpose, 0, 16, mat4x4_transpose(M_OUT, gMa[k]), refTranspose(ref, D(gMa[k]))) \
+	X(mat4x4_add, 1, 16, mat4x4_add(M_OUT, gMa[k], gMb[k]), refAdd(ref, D(gMa[k]), D(gMb[k]), 16)) \
+	X(mat4x4_sub, 1, 16, mat4x4_sub(M_OUT, gMa[k], gMb[k]), refSub(ref, D(gMa[k]), D(gMb[k]), 16)) \
+	X(mat4x4_scale, 1, 16, mat4x4_scale(M_OUT, gMa[k], gScalar[k]), refScale(ref, D(gMa[k]), gScalar[k], 16)) \
+	X(mat4x4_scale_aniso, 1, 16, mat4x4_scale_aniso(M_OUT, gMa[k], gB[k][0], gB[k][1], gB[k][2]), \
+		refScaleAniso(ref, D(gMa[k]), gB[k][0], gB[k][1], gB[k][2])) \
+	X(mat4x4_mul, 4, 16, mat4x4_mul(M_OUT, gMa[k], gMb[k]), refMulFloat(ref, gMa[k], gMb[k])) \
+	X(mat4x4_is_affine, 0, 1, out[0] = (float)mat4x4_is_affine(k & 1 ? gAffine[k] : gMa[k]), ref[0] = k & 1) \
+	X(mat4x4_is_rigid, 0, 1, out[0] = (float)mat4x4_is_rigid(k & 1 ? gRigid[k] : gAffine[k]), ref[0] = k & 1) \
+	X(mat4x4_mul_affine, 4, 16, mat4x4_mul_affine(M_OUT, gMa[k], gAffine[k]), refMulFloat(ref, gMa[k], gAffine[k])) \
+	X(mat4x4_mul_vec4, 4, 4, mat4x4_mul_vec4(out, gMa[k], gA[k]), refMulVec4(ref, D(gMa[k]), gA[k])) \
+	X(mat4x4_translate, 0, 16, mat4x4_translate(M_OUT, gA[k][0], gA[k][1], gA[k][2]), \
+		refTranslate(ref, gA[k][0], gA[k][1], gA[k][2])) \
+	X(mat4x4_translate_in_place, 4, 16, (mat4x4_dup(M_OUT, gMa[k]), mat4x4_translate_in_place(M_OUT, gA[k][0], gA[k][1], gA[k][2])), \
+		refTranslateInPlace(ref, D(gMa[k]), gA[k][0], gA[k][1], gA[k][2])) \
+	X(mat4x4_from_vec3_mul_outer, 1, 16, mat4x4_from_vec3_mul_outer(M_OUT, gA[k], gB[k]), refOuter(ref, gA[k], gB[k])) \
+	X(mat4x4_rotate, 16, 16, mat4x4_rotate(M_OUT, gMa[k], gB[k][0], gB[k][1], gB[k][2], gAngle[k]), \
+		refRotate(ref, D(gMa[k]), gB[k][0], gB[k][1], gB[k][2], gAngle[k])) \
+	X(mat4x4_rotate_X, 8, 16, mat4x4_rotate_X(M_OUT, gMa[k], gAngle[k]), refRotate(ref, D(gMa[k]), 1.0, 0.0, 0.0, gAngle[k])) \
+	X(mat4x4_rotate_Y, 8, 16, mat4x4_rotate_Y(M_OUT, gMa[k], gAngle[k]), refRotate(ref, D(gMa[k]), 0.0, 1.0, 0.0, gAngle[k])) \
+	X(mat4x4_rotate_Z, 8, 16, mat4x4_rotate_Z(M_OUT, gMa[k], gAngle[k]), refRotate(ref, D(gMa[k]), 0.0, 0.0, 1.0, gAngle[k])) \
+	X(mat4x4_invert, 32, 16, mat4x4_invert(M_OUT, gAffine[k]), refInvert(ref, D(gAffine[k]))) \
+	X(mat4x4_invert_affine, 32, 16, mat4x4_invert_affine(M_OUT, gAffine[k]), refInvert(ref, D(gAffine[k]))) \
+	X(mat4x4_invert_rigid, 16, 16, mat4x4_invert_rigid(M_OUT, gRigid[k]), refInvert(ref, D(gRigid[k]))) \
+	X(mat4x4_orthonormalize, 16, 16, mat4x4_orthonormalize(M_OUT, gSkewed[k]), refOrthonormalize(ref, D(gSkewed[k]))) \
+	X(mat4x4_frustum, 4, 16, mat4x4_frustum(M_OUT, gFrustum[k][0], gFrustum[k][1], gFrustum[k][2], gFrustum[k][3], gFrustum[k][4], gFrustum[k][5]), \
+		refFrustum(ref, gFrustum[k])) \
+	X(mat4x4_ortho, 4, 16, mat4x4_ortho(M_OUT, gOrtho[k][0], gOrtho[k][1], gOrtho[k][2], gOrtho[k][3], gOrtho[k][4], gOrtho[k][5]), \
+		refOrtho(ref, gOrtho[k])) \
+	X(mat4x4_perspective, 8, 16, mat4x4_perspective(M_OUT, gPerspective[k][0], gPerspective[k][1], gPerspective[k][2], gPerspective[k][3]), \
+		refPerspective(ref, gPerspective[k])) \
+	X(mat4x4_look_at, 16, 16, mat4x4_look_at(M_OUT, gA[k], gCenter[k], gUp), refLookAt(ref, gA[k], gCenter[k], gUp)) \
+	X(quat_identity, 0, 4, quat_identity(out), (ref[0] = ref[1] = ref[2] = 0.0, ref[3] = 1.0)) \
+	X(quat_add, 1, 4, quat_add(out, gQa[k], gQb[k]), refAdd(ref, gQa[k], gQb[k], 4)) \
+	X(quat_sub, 1, 4, quat_sub(out, gQa[k], gQb[k]), refSub(ref, gQa[k], gQb[k], 4)) \
+	X(quat_mul, 4, 4, quat_mul(out, gQa[k], gQb[k]), refQuatMul(ref, gQa[k], gQb[k])) \
+	X(quat_scale, 1, 4, quat_scale(out, gQa[k], gScalar[k]), refScale(ref, gQa[k], gScalar[k], 4)) \
+	X(quat_inner_product, 4, 1, out[0] = quat_inner_product(gQa[k], gQb[k]), ref[0] = refDot(gQa[k], gQb[k], 4)) \
+	X(quat_conj, 0, 4, quat_conj(out, gQa[k]), refQuatConj(ref, gQa[k])) \
+	X(quat_rotate, 4, 4, quat_rotate(out, gAngle[k], gUnit[k]), refQuatRotate(ref, gAngle[k], gUnit[k])) \
+	X(quat_norm, 4, 4, quat_norm(out, gA[k]), refNorm(ref, gA[k], 4)) \
+	X(quat_mul_vec3, 8, 3, quat_mul_vec3(out, gQa[k], gA[k]), refQuatMulVec3(ref, gQa[k], gA[k])) \
+	X(mat4x4_from_quat, 4, 16, mat4x4_from_quat(M_OUT, gQa[k]), refFromQuat(ref, gQa[k])) \
+	X(mat4x4o_mul_quat, 8, 16, mat4x4o_mul_quat(M_OUT, gRotation[k], gQb[k]), refMat4oMulQuat(ref, D(gRotation[k]), gQb[k])) \
+	X(quat_from_mat4x4, 4, 4, quat_from_mat4x4(out, gRotation[k]), refQuatFromMat(ref, D(gRotation[k]), out))
+
+static vec3 gUp = {0.f, 1.f, 0.f};
+
+static void refMulFloat(double *r, mat4x4 a, mat4x4 b)
+{
+	double da[16], db[16];
+	toDouble(da, D(a), 16);
+	toDouble(db, D(b), 16);
+	refMul(r, da, db);
+}
+
+#define DEFINE_BENCHMARK(name, tolerance, count, call, reference) \
+static void run_##name(int calls) \
+{ \
+	for (int i = 0; i < calls; ++i) \
+	{ \
+		int k = i & (POOL - 1); \
+		float *out = gOut[k]; \
+		call; \
+	} \
+} \
+static double check_##name() \
+{ \
+	double worst = 0.0; \
+	for (int k = 0; k < POOL; ++k) \
+	{ \
+		float out[16]; \
+		double ref[16]; \
+		call; \
+		reference; \
+		worst = fmax(worst, relativeError(out, ref, count)); \
+	} \
+	return worst; \
+}
+LINMATH_BENCHMARKS(DEFINE_BENCHMARK)
+
+#define BENCHMARK_ENTRY(name, tolerance, count, call, reference) {#name, tolerance, run_##name, check_##name},
+static const Benchmark gBenchmarks[] = {LINMATH_BENCHMARKS(BENCHMARK_ENTRY)};
+#define BENCHMARK_COUNT (int)(sizeof(gBenchmarks) / sizeof(gBenchmarks[0]))
+
+static void randomVec(float *v, int n, float lo, float hi)
+{
+	for (int i = 0; i < n; ++i)
+		v[i] = randomRange(lo, hi);
+}
+
+static void initInputs()
+{
+	for (int k = 0; k < POOL; ++k)
+	{
+		do
+			randomVec(gA[k], 4, -1.f, 1.f);
+		while (vec2_len(gA[k]) < 0.1f);
+		do
+			randomVec(gB[k], 4, -1.f, 1.f);
+		while (vec2_len(gB[k]) < 0.1f);
+		do
+		{
+			randomVec(gUnit[k], 3, -1.f, 1.f);
+			gUnit[k][3] = 0.f;
+		}
+		while (vec3_len(gUnit[k]) < 0.1f || fabsf(gUnit[k][1]) > 0.9f * vec3_len(gUnit[k]));
+		vec3_norm(gUnit[k], gUnit[k]);
+		vec3_scale(gCenter[k], gUnit[k], randomRange(1.f, 10.f));
+		vec3_add(gCenter[k], gCenter[k], gA[k]);
+
+		gScalar[k] = randomRange(-2.f, 2.f);
+		gAngle[k] = randomRange(-(float)M_PI, (float)M_PI);
+		randomVec(D(gMa[k]), 16, -1.f, 1.f);
+		randomVec(D(gMb[k]), 16, -1.f, 1.f);
+
+		do
+			randomVec(gQa[k], 4, -1.f, 1.f);
+		while (vec4_len(gQa[k]) < 0.1f);
+		quat_norm(gQa[k], gQa[k]);
+		do
+			randomVec(gQb[k], 4, -1.f, 1.f);
+		while (vec4_len(gQb[k]) < 0.1f);
+		quat_norm(gQb[k], gQb[k]);
+
+		mat4x4_from_quat(gRotation[k], gQb[k]);
+		mat4x4_dup(gRigid[k], gRotation[k]);
+		randomVec(gRigid[k][3], 3, -1.f, 1.f);
+		for (int i = 0; i < 16; ++i)
+			D(gSkewed[k])[i] = D(gRotation[k])[i] + randomRange(-0.2f, 0.2f);
+		mat4x4_from_quat(gAffine[k], gQa[k]);
+		mat4x4_scale_aniso(gAffine[k], gAffine[k], randomRange(0.5f, 2.f), randomRange(0.5f, 2.f), randomRange(0.5f, 2.f));
+		randomVec(gAffine[k][3], 3, -1.f, 1.f);
+
+		float n = randomRange(0.05f, 0.5f);
+		gFrustum[k][0] = -n * randomRange(0.5f, 1.5f);
+		gFrustum[k][1] = n * randomRange(0.5f, 1.5f);
+		gFrustum[k][2] = -n * randomRange(0.5f, 1.5f);
+		gFrustum[k][3] = n * randomRange(0.5f, 1.5f);
+		gFrustum[k][4] = n;
+		gFrustum[k][5] = randomRange(10.f, 1000.f);
+
+		gOrtho[k][0] = randomRange(-2.f, -0.5f);
+		gOrtho[k][1] = randomRange(0.5f, 2.f);
+		gOrtho[k][2] = randomRange(-2.f, -0.5f);
+		gOrtho[k][3] = randomRange(0.5f, 2.f);
+		gOrtho[k][4] = randomRange(0.1f, 1.f);
+		gOrtho[k][5] = randomRange(10.f, 100.f);
+
+		gPerspective[k][0] = randomRange(0.5f, 2.f);
+		gPerspective[k][1] = randomRange(0.5f, 2.f);
+		gPerspective[k][2] = n;
+		gPerspective[k][3] = randomRange(10.f, 1000.f);
+	}
+}
+
+static double timeBenchmark(const Benchmark *b)
+{
+	int calls = POOL;
+	for (;;)
+	{
+		double start = now();
+		b->run(calls);
+		if (now() - start >= MIN_PASS_MS || calls >= 1 << 30)
+			break;
+		calls *= 2;
+	}
+
+	double best = 1e30;
+	for (int pass = 0; pass < PASSES; ++pass)
+	{
+		double start = now();
+		b->run(calls);
+		best = fmin(best, (now() - start) * 1e6 / calls);
+	}
+	return best;
+}
+
+static int loadBaseline(const char *path, Baseline *baseline)
+{
+	FILE *file = fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Cannot read %s\n", path);
+		return -1;
+	}
+
+	// Only rows of the same build compare
+	char line[256], build[16];
+	int simd, count = 0;
+	Baseline row;
+	while (count < MAX_BASELINE && fgets(line, sizeof(line), file))
+		if (sscanf(line, "%15[^,],%d,%63[^,],%lf,%lf", build, &simd, row.name, &row.nsPerOp, &row.errorEps) == 5
+			&& atoi(build + 1) == BENCH_OPT_LEVEL && simd == LINMATH_SIMD)
+			baseline[count++] = row;
+	fclose(file);
+	return count;
+}
+
+static const Baseline *findBaseline(const Baseline *baseline, int count, const char *name)
+{
+	for (int i = 0; i < count; ++i)
+		if (!strcmp(baseline[i].name, name))
+			return &baseline[i];
+	return 0;
+}
+
+static int writeCsv(const char *path, const Result *results)
+{
+	FILE *file = fopen(path, "w");
+	if (!file)
+		return 0;
+	fprintf(file, "build,simd,function,ns_per_op,max_error_eps,tolerance_eps,ok\n");
+	for (int i = 0; i < BENCHMARK_COUNT; ++i)
+		fprintf(file, "O%d,%d,%s,%.3f,%.3f,%g,%d\n", BENCH_OPT_LEVEL, LINMATH_SIMD, gBenchmarks[i].name,
+			results[i].nsPerOp, results[i].errorEps, gBenchmarks[i].toleranceEps, results[i].ok);
+	return fclose(file) == 0;
+}
+
+static int writeJson(const char *path, const Result *results)
+{
+	FILE *file = fopen(path, "w");
+	if (!file)
+		return 0;
+	fprintf(file, "{\n  \"build\": \"O%d\",\n  \"simd\": %s,\n  \"results\": [\n", BENCH_OPT_LEVEL, LINMATH_SIMD ? "true" : "false");
+	for (int i = 0; i < BENCHMARK_COUNT; ++i)
+		fprintf(file, "    {\"function\": \"%s\", \"ns_per_op\": %.3f, \"max_error_eps\": %.3f, \"tolerance_eps\": %g, \"ok\": %s}%s\n",
+			gBenchmarks[i].name, results[i].nsPerOp, results[i].errorEps, gBenchmarks[i].toleranceEps,
+			results[i].ok ? "true" : "false", i + 1 < BENCHMARK_COUNT ? "," : "");
+	fprintf(file, "  ]\n}\n");
+	return fclose(file) == 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *csvPath = 0, *jsonPath = 0, *baselinePath = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 < argc && !strcmp(argv[i], "--csv"))
+			csvPath = argv[++i];
+		else if (i + 1 < argc && !strcmp(argv[i], "--json"))
+			jsonPath = argv[++i];
+		else if (i + 1 < argc && !strcmp(argv[i], "--baseline"))
+			baselinePath = argv[++i];
+		else
+		{
+			fprintf(stderr, "Usage: %s [--csv FILE] [--json FILE] [--baseline FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	static Baseline baseline[MAX_BASELINE];
+	int baselineCount = 0;
+	if (baselinePath && (baselineCount = loadBaseline(baselinePath, baseline)) < 0)
+		return 1;
+
+	initInputs();
+	static Result results[BENCHMARK_COUNT];
+	int failed = 0;
+
+	printf("linmath.h at -O%d, %s, %d inputs per function\n", BENCH_OPT_LEVEL, LINMATH_SIMD ? "SIMD" : "scalar", POOL);
+	printf("  %-28s %8s %10s %10s%s\n", "function", "ns/op", "error eps", "tolerance", baselineCount ? "   vs baseline" : "");
+	for (int i = 0; i < BENCHMARK_COUNT; ++i)
+	{
+		const Benchmark *b = &gBenchmarks[i];
+		Result *r = &results[i];
+		r->errorEps = b->check();
+		r->nsPerOp = timeBenchmark(b);
+		r->ok = r->errorEps <= b->toleranceEps;
+		printf("  %-28s %8.2f %10.2f %10g", b->name, r->nsPerOp, r->errorEps, b->toleranceEps);
+
+		const Baseline *base = findBaseline(baseline, baselineCount, b->name);
+		if (base)
+		{
+			printf("   %+6.1f%%", (r->nsPerOp / base->nsPerOp - 1.0) * 100.0);
+			if (r->errorEps > base->errorEps + 1e-3)
+			{
+				printf(" LESS ACCURATE (was %.2f)", base->errorEps);
+				failed = 1;
+			}
+		}
+		if (!r->ok)
+		{
+			printf(" OUT OF TOLERANCE");
+			failed = 1;
+		}
+		printf("\n");
+	}
+
+	if (csvPath && !writeCsv(csvPath, results))
+	{
+		fprintf(stderr, "Cannot write %s\n", csvPath);
+		failed = 1;
+	}
+	if (jsonPath && !writeJson(jsonPath, results))
+	{
+		fprintf(stderr, "Cannot write %s\n", jsonPath);
+		failed = 1;
+	}
+	return failed;
+}
@@ -0,0 +1,215 @@
+// Level of detail on a large synthetic scene.
+//
+// 100k spheres of random size spread over a 400 m square, each with the four
+// levels of a subdivided icosahedron, are seen by a head in the middle of the
+// field for 20 s at 90 Hz. It creeps forward at 10 cm/s and sways back and
+// forth by a few centimeters, which is what makes objects at a switching
+// distance pop without hysteresis. Every frame culls against the combined
+// stereo frustum, picks the levels from the center eye (lod.h) and groups the
+// visible objects by level, like the app.
+//
+// Reports the triangles both eyes submit per frame against full detail, the
+// selection time per visible object, and the level changes per frame with and
+// without hysteresis. Fails if a visible object is drawn coarser than the
+// pixel error allows, seen from its center eye or by more than 10% from
+// either real eye.
+#include "../cull.h"
+#include "../lod.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define OBJECTS 100000
+#define FRAMES 1800
+#define FRAME_MS (1000.0 / 90.0)
+#define EYE_OFFSET 0.032f
+#define EYE_WIDTH 1440
+#define EYE_HEIGHT 1600
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static float randomRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// Levels of a unit sphere subdivided 4 to 1 times from an icosahedron. Each
+// subdivision halves the angle an edge spans, the error is about the
+// distance from the sphere to the centers of the faces.
+static void initSphereMesh(LodMesh *mesh)
+{
+	mesh->levelCount = LOD_MAX_LEVELS;
+	for (int l = 0; l < LOD_MAX_LEVELS; ++l)
+	{
+		int subdivisions = LOD_MAX_LEVELS - l;
+		float edgeAngle = 1.1071487f / (float)(1 << subdivisions); // atan(2), the icosahedron's
+		LodLevel *level = &mesh->levels[l];
+		level->triangles = 20 << (2 * subdivisions);
+		level->first = 0;
+		level->count = 3 * level->triangles;
+		level->error = 1.0f - cosf(edgeAngle / sqrtf(3.0f));
+	}
+}
+
+// World to eye and projection of an eye of the head at time t, in seconds
+static void eyeMatrices(mat4x4 view, mat4x4 projection, double t, float eyeOffset)
+{
+	quat q;
+	vec3 right = {1.f, 0.f, 0.f};
+	quat_rotate(q, -0.05f, right);
+
+	mat4x4 eye;
+	mat4x4_from_quat(eye, q);
+	eye[3][0] = 0.02f * (float)sin(2.0 * M_PI * 0.9 * t);
+	eye[3][1] = 1.7f + 0.01f * (float)sin(2.0 * M_PI * 1.8 * t);
+	eye[3][2] = 1.0f - 0.1f * (float)t + 0.04f * (float)sin(2.0 * M_PI * 1.8 * t);
+	mat4x4_translate_in_place(eye, eyeOffset, 0.f, 0.f);
+	mat4x4_invert_rigid(view, eye);
+
+	float n = 0.1f;
+	mat4x4_frustum(projection, -n, n, -n, n, n, 1000.f);
+}
+
+// Error on screen of an object's level seen from a point with the view's density
+static float pixelError(const LodMesh *mesh, const LodView *view, const float *eye, const float *center,
+	float radius, int level)
+{
+	vec3 d;
+	vec3_sub(d, center, eye);
+	float distance = fmaxf(vec3_len(d) - radius, LOD_MIN_DISTANCE);
+	return mesh->levels[level].error * radius * view->pixelsPerUnit / distance;
+}
+
+typedef struct Result
+{
+	double selectMs;
+	unsigned long long visible, triangles, fullTriangles, changes;
+	unsigned long violations;
+	float worstCenter, worstEye; // Highest error in pixels of a level above 0
+} Result;
+
+static int run(const LodMesh *mesh, vec3 *center, float *radius, float *scale, int *visible, int *grouped,
+	unsigned char *level, float hysteresis, Result *result)
+{
+	memset(result, 0, sizeof(*result));
+	memset(level, LOD_NO_LEVEL, OBJECTS);
+
+	for (int frame = 0; frame < FRAMES; ++frame)
+	{
+		double t = frame * FRAME_MS / 1000.0;
+		mat4x4 view[2], projection[2], viewProjection[2], eye[2];
+		for (int e = 0; e < 2; ++e)
+		{
+			eyeMatrices(view[e], projection[e], t, e ? EYE_OFFSET : -EYE_OFFSET);
+			mat4x4_mul(viewProjection[e], projection[e], view[e]);
+			mat4x4_invert_rigid(eye[e], view[e]);
+		}
+		Frustum frustum;
+		frustumCombineStereo(&frustum, viewProjection[0], viewProjection[1]);
+		int count = cullSpheres(&frustum, center, radius, scale, 0, OBJECTS, visible);
+
+		double start = now();
+		LodView lodView;
+		lodViewInit(&lodView, LOD_PIXEL_ERROR);
+		lodView.hysteresis = hysteresis;
+		for (int e = 0; e < 2; ++e)
+			lodViewAddEye(&lodView, projection[e], view[e], EYE_WIDTH, EYE_HEIGHT);
+		int changes = lodSelect(mesh, &lodView, center, radius, scale, visible, count, level);
+		int first[LOD_MAX_LEVELS + 1];
+		lodGroup(visible, count, level, mesh->levelCount, grouped, first);
+		result->selectMs += now() - start;
+
+		result->visible += count;
+		result->changes += frame ? changes : 0;
+		for (int l = 0; l < mesh->levelCount; ++l)
+		{
+			unsigned long long n = first[l + 1] - first[l];
+			result->triangles += 2 * n * mesh->levels[l].triangles;
+			result->fullTriangles += 2 * n * mesh->levels[0].triangles;
+		}
+
+		// Level 0 is the best there is, however close the object
+		for (int v = first[1]; v < count; ++v)
+		{
+			int i = grouped[v];
+			float error = pixelError(mesh, &lodView, lodView.eye, center[i], radius[i] * scale[i], level[i]);
+			if (error > result->worstCenter)
+				result->worstCenter = error;
+			int violation = error > LOD_PIXEL_ERROR * 1.0001f;
+			for (int e = 0; e < 2; ++e)
+			{
+				error = pixelError(mesh, &lodView, eye[e][3], center[i], radius[i] * scale[i], level[i]);
+				if (error > result->worstEye)
+					result->worstEye = error;
+				violation |= error > LOD_PIXEL_ERROR * 1.1f;
+			}
+			result->violations += violation;
+		}
+	}
+	return !result->violations;
+}
+
+static void print(const char *name, const Result *r)
+{
+	printf("  %-18s %9.0f triangles/frame (%5.2f%% of full detail), %7.3f ms/frame select (%5.2f ns/object),"
+		" %7.2f level changes/frame, worst %.2f px center eye, %.2f px per eye\n",
+		name, (double)r->triangles / FRAMES, 100.0 * r->triangles / r->fullTriangles, r->selectMs / FRAMES,
+		r->selectMs * 1e6 / r->visible, (double)r->changes / (FRAMES - 1), r->worstCenter, r->worstEye);
+}
+
+int main()
+{
+	vec3 *center = malloc(OBJECTS * sizeof(vec3));
+	float *radius = malloc(OBJECTS * sizeof(float));
+	float *scale = malloc(OBJECTS * sizeof(float));
+	int *visible = malloc(OBJECTS * sizeof(int));
+	int *grouped = malloc(OBJECTS * sizeof(int));
+	unsigned char *level = malloc(OBJECTS);
+	if (!center || !radius || !scale || !visible || !grouped || !level)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	srand(1);
+	for (int i = 0; i < OBJECTS; ++i)
+	{
+		center[i][0] = randomRange(-200.f, 200.f);
+		center[i][1] = randomRange(0.f, 10.f);
+		center[i][2] = randomRange(-200.f, 200.f);
+		radius[i] = 1.f;
+		scale[i] = randomRange(0.3f, 2.f);
+	}
+	LodMesh mesh;
+	initSphereMesh(&mesh);
+
+	Result full, hysteresis, none;
+	LodMesh single = mesh;
+	single.levelCount = 1;
+	run(&single, center, radius, scale, visible, grouped, level, LOD_HYSTERESIS, &full);
+	int ok = run(&mesh, center, radius, scale, visible, grouped, level, LOD_HYSTERESIS, &hysteresis);
+	ok &= run(&mesh, center, radius, scale, visible, grouped, level, 0.f, &none);
+
+	printf("%d spheres of %d/%d/%d/%d triangles, %d frames of a %dx%d per eye view, %.1f visible per frame, %.1f px error\n",
+		OBJECTS, mesh.levels[0].triangles, mesh.levels[1].triangles, mesh.levels[2].triangles, mesh.levels[3].triangles,
+		FRAMES, EYE_WIDTH, EYE_HEIGHT, (double)full.visible / FRAMES, LOD_PIXEL_ERROR);
+	print("full detail", &full);
+	print("lod", &hysteresis);
+	print("lod, no hysteresis", &none);
+
+	if (!ok)
+	{
+		printf("%lu times a visible object was drawn coarser than %.1f px allow\n",
+			hysteresis.violations + none.violations, LOD_PIXEL_ERROR);
+		return 1;
+	}
+	return 0;
+}
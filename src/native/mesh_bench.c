@@ -0,0 +1,382 @@
+// Load speed of the binary mesh format, and time to first draw.
+//
+// Writes a terrain of 128x128 vertex patches (16-bit positions, byte colors,
+// 32k triangles each) as a mesh file of about MESH_BENCH_MB megabytes
+// (default 100), then loads it three ways, each starting with the file
+// dropped from the page cache where the OS allows:
+//   - read: the whole file into memory, then every chunk is uploaded
+//   - incremental: 1 MB reads into the final buffer, uploading each chunk as
+//     soon as its bytes are in, as the browser does with a streaming fetch
+//   - mmap: the file mapped, every chunk uploaded from the mapping
+// An upload is a copy of the chunk's vertex and index bytes into a scratch
+// buffer, standing in for glBufferData. Reported are throughput and the time
+// until the first chunk could be drawn.
+//
+// The file is left at the path given as the first argument (default
+// build/scene.mesh) for the app to stream, see MESH_FILE in the Makefile.
+//
+// It fails if a loader's chunks do not hold the bytes that were written, or
+// truncated or corrupted files are not recognized as such.
+#define _GNU_SOURCE
+#include "../mesh_file.h"
+
+#include <GLES2/gl2ext.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PATCH_SIDE 128 // Vertices along a patch edge
+#define PATCH_SIZE 4.f // Meters along a patch edge
+#define READ_BYTES (1 << 20)
+#define FLOATS 6 // Position and color per source vertex
+
+typedef struct LoadResult
+{
+	double totalMs, firstDrawMs;
+	int ok;
+} LoadResult;
+
+static uint64_t *gChecksums; // Per chunk, of what was written
+static unsigned char *gScratch; // Stands in for the GPU buffer
+static int gChunkCount;
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static uint64_t checksum(const void *data, size_t bytes, uint64_t h)
+{
+	const unsigned char *p = data;
+	for (size_t i = 0; i < bytes; ++i)
+		h = (h ^ p[i]) * 0x100000001b3ull;
+	return h;
+}
+
+static uint64_t chunkChecksum(const void *vertices, size_t vertexBytes, const void *indices, size_t indexBytes)
+{
+	return checksum(indices, indexBytes, checksum(vertices, vertexBytes, 0xcbf29ce484222325ull));
+}
+
+static float terrainHeight(float x, float z)
+{
+	return -2.f + 0.4f * sinf(x * 0.31f) * cosf(z * 0.23f) + 0.1f * sinf(x * 1.7f + z * 1.3f);
+}
+
+// Writes the terrain, patch by patch. Returns the file size, 0 on failure.
+static size_t writeScene(const char *path, int chunkCount)
+{
+	FILE *f = fopen(path, "wb");
+	if (!f)
+		return 0;
+
+	int vertexCount = PATCH_SIDE * PATCH_SIDE, indexCount = (PATCH_SIDE - 1) * (PATCH_SIDE - 1) * 6;
+	float *source = malloc(vertexCount * FLOATS * sizeof(float));
+	unsigned char *encoded = malloc(vertexCount * FLOATS * sizeof(float));
+	uint16_t *indices = malloc(indexCount * sizeof(uint16_t));
+	if (!source || !encoded || !indices)
+		return 0;
+
+	int n = 0;
+	for (int row = 0; row < PATCH_SIDE - 1; ++row)
+	{
+		for (int column = 0; column < PATCH_SIDE - 1; ++column)
+		{
+			uint16_t a = (uint16_t)(row * PATCH_SIDE + column), b = a + 1, c = a + PATCH_SIDE, d = c + 1;
+			uint16_t quad[6] = {a, c, b, b, c, d};
+			memcpy(indices + n, quad, sizeof(quad));
+			n += 6;
+		}
+	}
+
+	VertexFormat format;
+	vertexFormatInit(&format, GL_UNSIGNED_SHORT, 3, GL_UNSIGNED_BYTE, 3);
+	MeshFileWriter writer;
+	int ok = meshFileWriteBegin(&writer, f, chunkCount);
+	int side = (int)ceilf(sqrtf((float)chunkCount));
+	for (int i = 0; i < chunkCount && ok; ++i)
+	{
+		// Patches in a square around the origin, where the viewer stands
+		float x0 = (i % side - side * 0.5f) * PATCH_SIZE, z0 = (i / side - side * 0.5f) * PATCH_SIZE;
+		for (int v = 0; v < vertexCount; ++v)
+		{
+			float *s = source + v * FLOATS;
+			s[0] = x0 + (v % PATCH_SIDE) * PATCH_SIZE / (PATCH_SIDE - 1);
+			s[2] = z0 + (v / PATCH_SIDE) * PATCH_SIZE / (PATCH_SIDE - 1);
+			s[1] = terrainHeight(s[0], s[2]);
+			float t = (s[1] + 2.5f) * 1.25f;
+			s[3] = 0.2f + 0.3f * t;
+			s[4] = 0.4f + 0.4f * t;
+			s[5] = 0.2f;
+		}
+
+		VertexDequantization dequantization;
+		vertexDequantizationFromBounds(&dequantization, &format, source, FLOATS, vertexCount);
+		vertexFormatEncode(&format, &dequantization, encoded, source, FLOATS, vertexCount);
+		float center[3], radius = 0.f;
+		for (int k = 0; k < 3; ++k)
+		{
+			center[k] = dequantization.offset[k] + 0.5f * dequantization.scale[k];
+			radius += 0.25f * dequantization.scale[k] * dequantization.scale[k];
+		}
+		ok = meshFileWriteChunk(&writer, &format, &dequantization, encoded, vertexCount, indices, indexCount, center, sqrtf(radius));
+		gChecksums[i] = chunkChecksum(encoded, (size_t)vertexCount * format.stride, indices, indexCount * sizeof(uint16_t));
+	}
+	ok = meshFileWriteEnd(&writer) && ok;
+	size_t size = writer.position;
+
+	// On disk before the cache is dropped, or there is nothing to drop
+	ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+	ok = fclose(f) == 0 && ok;
+	free(source);
+	free(encoded);
+	free(indices);
+	return ok ? size : 0;
+}
+
+static int openCold(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	return fd;
+}
+
+// Copies chunks [first, last) to the scratch buffer, as glBufferData would
+static void upload(const MeshFile *file, int first, int last)
+{
+	for (int i = first; i < last; ++i)
+	{
+		const MeshFileChunk *chunk = &file->chunks[i];
+		VertexFormat format;
+		VertexDequantization dequantization;
+		meshFileChunkFormat(chunk, &format, &dequantization);
+		memcpy(gScratch, meshFileVertices(file, i), (size_t)chunk->vertexCount * format.stride);
+		memcpy(gScratch, meshFileIndices(file, i), chunk->indexCount * sizeof(uint16_t));
+	}
+}
+
+// The loaded chunks hold what was written, outside of the timing
+static int verify(const MeshFile *file)
+{
+	if ((int)file->header->chunkCount != gChunkCount)
+		return 0;
+	for (int i = 0; i < gChunkCount; ++i)
+	{
+		const MeshFileChunk *chunk = &file->chunks[i];
+		VertexFormat format;
+		VertexDequantization dequantization;
+		meshFileChunkFormat(chunk, &format, &dequantization);
+		if (chunkChecksum(meshFileVertices(file, i), (size_t)chunk->vertexCount * format.stride,
+			meshFileIndices(file, i), chunk->indexCount * sizeof(uint16_t)) != gChecksums[i])
+			return 0;
+	}
+	return 1;
+}
+
+static LoadResult loadRead(const char *path, size_t size)
+{
+	LoadResult result = {0.0, 0.0, 0};
+	double start = now();
+	int fd = openCold(path);
+	unsigned char *data = malloc(size);
+	size_t got = 0;
+	while (fd >= 0 && data && got < size)
+	{
+		ssize_t n = read(fd, data + got, size - got);
+		if (n <= 0)
+			break;
+		got += n;
+	}
+	MeshFile file;
+	if (got == size && meshFileOpen(&file, data, size) > 0)
+	{
+		upload(&file, 0, 1);
+		result.firstDrawMs = now() - start;
+		upload(&file, 1, file.header->chunkCount);
+		result.totalMs = now() - start;
+		result.ok = verify(&file);
+	}
+	if (fd >= 0)
+		close(fd);
+	free(data);
+	return result;
+}
+
+static LoadResult loadIncremental(const char *path, size_t size)
+{
+	LoadResult result = {0.0, 0.0, 0};
+	double start = now();
+	int fd = openCold(path);
+	unsigned char *data = malloc(size);
+	size_t got = 0;
+	MeshFile file;
+	int opened = 0, uploaded = 0, monotonic = 1;
+	while (fd >= 0 && data && got < size)
+	{
+		ssize_t n = read(fd, data + got, size - got < READ_BYTES ? size - got : READ_BYTES);
+		if (n <= 0)
+			break;
+		got += n;
+
+		if (!opened)
+			opened = meshFileOpen(&file, data, got);
+		if (opened < 0)
+			break;
+		if (opened)
+		{
+			int available = meshFileChunksAvailable(&file, got);
+			monotonic &= available >= uploaded;
+			upload(&file, uploaded, available);
+			if (!uploaded && available)
+				result.firstDrawMs = now() - start;
+			uploaded = available;
+		}
+	}
+	result.totalMs = now() - start;
+	result.ok = got == size && opened > 0 && uploaded == gChunkCount && monotonic && verify(&file);
+	if (fd >= 0)
+		close(fd);
+	free(data);
+	return result;
+}
+
+static LoadResult loadMapped(const char *path, size_t size)
+{
+	LoadResult result = {0.0, 0.0, 0};
+	double start = now();
+	int fd = openCold(path);
+	void *data = fd >= 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	MeshFile file;
+	if (data != MAP_FAILED && meshFileOpen(&file, data, size) > 0)
+	{
+		upload(&file, 0, 1);
+		result.firstDrawMs = now() - start;
+		upload(&file, 1, file.header->chunkCount);
+		result.totalMs = now() - start;
+		result.ok = verify(&file);
+	}
+	if (data != MAP_FAILED)
+		munmap(data, size);
+	if (fd >= 0)
+		close(fd);
+	return result;
+}
+
+// Truncated, corrupted and reordered files are told apart from good ones
+// without reading past the table
+static int checkValidation(const char *path, size_t size)
+{
+	size_t tableEnd = sizeof(MeshFileHeader) + gChunkCount * sizeof(MeshFileChunk);
+	unsigned char *data = malloc(tableEnd);
+	FILE *f = fopen(path, "rb");
+	int ok = data && f && fread(data, 1, tableEnd, f) == tableEnd;
+	if (f)
+		fclose(f);
+	if (!ok)
+	{
+		free(data);
+		return 0;
+	}
+
+	MeshFile file;
+	MeshFileHeader *header = (MeshFileHeader *)data;
+	MeshFileChunk *chunks = (MeshFileChunk *)(header + 1);
+	ok &= meshFileOpen(&file, data, sizeof(MeshFileHeader) - 1) == 0;
+	ok &= meshFileOpen(&file, data, tableEnd - 1) == 0;
+	ok &= meshFileOpen(&file, data, tableEnd) == 1;
+	ok &= meshFileChunksAvailable(&file, tableEnd) == 0;
+	ok &= meshFileChunksAvailable(&file, chunks[0].indexOffset + chunks[0].indexCount * 2) == 1;
+	ok &= meshFileChunksAvailable(&file, size) == gChunkCount;
+
+	header->magic ^= 1;
+	ok &= meshFileOpen(&file, data, tableEnd) == -1;
+	header->magic ^= 1;
+	header->fileSize -= 2;
+	ok &= meshFileOpen(&file, data, tableEnd) == -1;
+	header->fileSize += 2;
+	if (gChunkCount > 1)
+	{
+		MeshFileChunk swap = chunks[0];
+		chunks[0] = chunks[1];
+		chunks[1] = swap;
+		ok &= meshFileOpen(&file, data, tableEnd) == -1;
+		chunks[1] = chunks[0];
+		chunks[0] = swap;
+	}
+	chunks[0].vertexOffset += 4;
+	ok &= meshFileOpen(&file, data, tableEnd) == -1;
+	chunks[0].vertexOffset -= 4;
+	chunks[0].positionType = GL_HALF_FLOAT_OES;
+	ok &= meshFileOpen(&file, data, tableEnd) == -1;
+	chunks[0].positionType = GL_UNSIGNED_SHORT;
+	ok &= meshFileOpen(&file, data, tableEnd) == 1;
+	free(data);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = argc > 1 ? argv[1] : "build/scene.mesh";
+	const char *mb = getenv("MESH_BENCH_MB");
+	double targetBytes = (mb && *mb ? atof(mb) : 100.0) * 1048576.0;
+
+	int vertexCount = PATCH_SIDE * PATCH_SIDE, indexCount = (PATCH_SIDE - 1) * (PATCH_SIDE - 1) * 6;
+	double chunkBytes = vertexCount * 12.0 + indexCount * 2.0;
+	gChunkCount = (int)ceil(targetBytes / chunkBytes);
+	if (gChunkCount < 1)
+		gChunkCount = 1;
+	gChecksums = malloc(gChunkCount * sizeof(uint64_t));
+	gScratch = malloc((size_t)chunkBytes);
+	if (!gChecksums || !gScratch)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	double start = now();
+	size_t size = writeScene(path, gChunkCount);
+	if (!size)
+	{
+		fprintf(stderr, "Could not write %s\n", path);
+		return 1;
+	}
+	printf("Wrote %s: %d chunks, %.1f MB, %.1f M triangles in %.0f ms\n", path, gChunkCount, size / 1048576.0,
+		gChunkCount * (indexCount / 3) / 1e6, now() - start);
+
+	int ok = checkValidation(path, size);
+	printf("Header and table validation: %s\n", ok ? "truncated and corrupted files rejected" : "FAILED");
+
+	static const struct
+	{
+		const char *name;
+		LoadResult (*load)(const char *path, size_t size);
+	} loaders[] =
+	{
+		{"read", loadRead},
+		{"incremental", loadIncremental},
+		{"mmap", loadMapped},
+	};
+	printf("  %-12s %10s %10s %16s\n", "loader", "total ms", "MB/s", "first draw ms");
+	for (size_t i = 0; i < sizeof(loaders) / sizeof(loaders[0]); ++i)
+	{
+		LoadResult r = loaders[i].load(path, size);
+		printf("  %-12s %10.1f %10.0f %16.2f%s\n", loaders[i].name, r.totalMs, size / 1048576.0 / (r.totalMs / 1000.0),
+			r.firstDrawMs, r.ok ? "" : ", CHUNKS DO NOT MATCH");
+		ok &= r.ok;
+	}
+	printf("  (files dropped from the page cache before each load where the OS allows)\n");
+
+	free(gChecksums);
+	free(gScratch);
+	printf("%s\n", ok ? "ok" : "FAILED");
+	return !ok;
+}
@@ -0,0 +1,274 @@
+// Occlusion culling in a dense indoor scene.
+//
+// A floor of 8 x 8 rooms, 6 m on a side and 3 m high, with a doorway in the
+// middle of every inner wall, is filled with 20k pieces of furniture. A head
+// walks through a row of rooms, from door to door, for 20 s at 90 Hz while
+// looking left and right. Every frame culls against the combined stereo
+// frustum, then rasterizes the walls into the center eye buffer (occlusion.h)
+// and tests what is left against it, like the app.
+//
+// Reports the time to rasterize the occluders and to test the objects, and
+// the fraction of the objects in the frustum that were culled. As a
+// reference, each eye also gets a buffer of its own at twice the density,
+// which sees what that eye sees with no parallax to allow for. Fails if an
+// object visible in either reference buffer, and still visible there at twice
+// its density, was culled. The same check runs without pulling in the outer
+// edges of the walls for the eyes' parallax, to show what that prevents.
+#include "../cull.h"
+#include "../occlusion.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ROOMS 8
+#define ROOM_SIZE 6.0f
+#define ROOM_HEIGHT 3.0f
+#define DOOR_WIDTH 1.0f
+#define DOOR_HEIGHT 2.1f
+#define OBJECTS 20000
+#define FRAMES 1800
+#define FRAME_MS (1000.0 / 90.0)
+#define EYE_OFFSET 0.032f
+// Per eye reference buffers, twice the pixels per unit of tangent of the
+// center one, over a frustum wider than both eyes' so that what is at the edge
+// of an eye's view is tested too, not visible by being out of the buffer
+#define REFERENCE_TANGENT_X 1.2f
+#define REFERENCE_TANGENT_Y 1.1f
+#define REFERENCE_WIDTH 560
+#define REFERENCE_HEIGHT 424
+#define FINE_SCALE 4 // Density of the buffers a miss is confirmed with, against the reference's
+
+// Both sides of every wall, 3 panels (either side of the door and above it)
+// per inner wall, 1 per outer wall
+#define MAX_QUADS (2 * (ROOMS + 1) * ROOMS * 3)
+
+static float gVertices[MAX_QUADS * 4][3];
+static unsigned short gIndices[MAX_QUADS * 6];
+static int gQuads;
+static OccluderMesh gWalls;
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static float randomRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// A vertical panel from (x0, y0, z0) to (x1, y1, z1), x0 == x1 or z0 == z1
+static void addPanel(float x0, float y0, float z0, float x1, float y1, float z1)
+{
+	float (*v)[3] = gVertices + 4 * gQuads;
+	float corners[4][3] = {{x0, y0, z0}, {x1, y0, z1}, {x1, y1, z1}, {x0, y1, z0}};
+	memcpy(v, corners, sizeof(corners));
+	static const unsigned short quad[6] = {0, 1, 2, 0, 2, 3};
+	for (int i = 0; i < 6; ++i)
+		gIndices[6 * gQuads + i] = (unsigned short)(4 * gQuads + quad[i]);
+	++gQuads;
+}
+
+// Wall along x at z (along z at x when alongZ) over room index `room`, with a
+// doorway unless it is an outer wall
+static void addWall(int alongZ, float at, int room, int outer)
+{
+	float a = room * ROOM_SIZE, b = a + ROOM_SIZE;
+	float doorA = a + 0.5f * (ROOM_SIZE - DOOR_WIDTH), doorB = doorA + DOOR_WIDTH;
+	float spans[3][4] = {{a, b, 0.f, ROOM_HEIGHT}, {doorB, b, 0.f, ROOM_HEIGHT}, {doorA, doorB, DOOR_HEIGHT, ROOM_HEIGHT}};
+	if (!outer)
+		spans[0][1] = doorA;
+	for (int i = 0; i < (outer ? 1 : 3); ++i)
+	{
+		if (alongZ)
+			addPanel(at, spans[i][2], spans[i][0], at, spans[i][3], spans[i][1]);
+		else
+			addPanel(spans[i][0], spans[i][2], at, spans[i][1], spans[i][3], at);
+	}
+}
+
+static void initWalls()
+{
+	for (int line = 0; line <= ROOMS; ++line)
+	{
+		for (int room = 0; room < ROOMS; ++room)
+		{
+			int outer = line == 0 || line == ROOMS;
+			addWall(0, line * ROOM_SIZE, room, outer);
+			addWall(1, line * ROOM_SIZE, room, outer);
+		}
+	}
+}
+
+// World to eye and projection of an eye of the head at time t, in seconds.
+// The head walks along x through the middle of the fourth row of rooms.
+static void eyeMatrices(mat4x4 view, mat4x4 projection, double t, float eyeOffset)
+{
+	quat yaw, pitch, q;
+	vec3 up = {0.f, 1.f, 0.f}, right = {1.f, 0.f, 0.f};
+	quat_rotate(yaw, (float)(-0.5 * M_PI + 0.9 * sin(2.0 * M_PI * 0.1 * t)), up);
+	quat_rotate(pitch, -0.1f, right);
+	quat_mul(q, yaw, pitch);
+
+	mat4x4 eye;
+	mat4x4_from_quat(eye, q);
+	eye[3][0] = 0.5f * ROOM_SIZE + 1.4f * (float)t;
+	eye[3][1] = 1.7f + 0.02f * (float)sin(2.0 * M_PI * 1.8 * t);
+	eye[3][2] = 3.5f * ROOM_SIZE + 0.05f * (float)sin(2.0 * M_PI * 0.9 * t);
+	mat4x4_translate_in_place(eye, eyeOffset, 0.f, 0.f);
+	mat4x4_invert_rigid(view, eye);
+
+	// Asymmetric like a lens, wider towards the outside
+	float n = 0.1f;
+	float outside = 1.1f * n, inside = 0.9f * n;
+	if (eyeOffset < 0.f)
+		mat4x4_frustum(projection, -outside, inside, -n, n, n, 100.f);
+	else
+		mat4x4_frustum(projection, -inside, outside, -n, n, n, 100.f);
+}
+
+typedef struct Result
+{
+	double rasterizeMs, testMs;
+	unsigned long long inFrustum, visible, referenceVisible;
+	unsigned long violations;
+} Result;
+
+static int run(OcclusionBuffer *buffer, OcclusionBuffer reference[2], OcclusionBuffer fine[2], vec3 *center,
+	float *radius, float *scale, int *visible, int *tested, int parallax, Result *result)
+{
+	memset(result, 0, sizeof(*result));
+	mat4x4 identity;
+	mat4x4_identity(identity);
+
+	for (int frame = 0; frame < FRAMES; ++frame)
+	{
+		double t = frame * FRAME_MS / 1000.0;
+		mat4x4 view[2], projection[2], viewProjection[2];
+		for (int e = 0; e < 2; ++e)
+		{
+			eyeMatrices(view[e], projection[e], t, e ? EYE_OFFSET : -EYE_OFFSET);
+			mat4x4_mul(viewProjection[e], projection[e], view[e]);
+		}
+		Frustum frustum;
+		frustumCombineStereo(&frustum, viewProjection[0], viewProjection[1]);
+		int count = cullSpheres(&frustum, center, radius, scale, 0, OBJECTS, visible);
+		memcpy(tested, visible, count * sizeof(int));
+
+		double start = now();
+		occlusionBeginStereo(buffer, projection[0], view[0], projection[1], view[1]);
+		if (!parallax)
+			buffer->parallax[0] = buffer->parallax[1] = 0.0f;
+		occlusionRasterize(buffer, identity, &gWalls);
+		occlusionFinish(buffer);
+		double rasterized = now();
+		int kept = occlusionCullSpheres(buffer, center, radius, scale, visible, count);
+		result->rasterizeMs += rasterized - start;
+		result->testMs += now() - rasterized;
+
+		mat4x4 wide;
+		mat4x4_frustum(wide, -REFERENCE_TANGENT_X, REFERENCE_TANGENT_X, -REFERENCE_TANGENT_Y, REFERENCE_TANGENT_Y, 1.f, 100.f);
+		for (int e = 0; e < 2; ++e)
+		{
+			occlusionBeginFrame(&reference[e], wide, view[e]);
+			occlusionRasterize(&reference[e], identity, &gWalls);
+			occlusionFinish(&reference[e]);
+		}
+		// Both lists are in index order
+		int fineReady = 0;
+		for (int v = 0, k = 0; v < count; ++v)
+		{
+			int i = tested[v];
+			int drawn = k < kept && visible[k] == i;
+			k += drawn;
+			float r = radius[i] * scale[i];
+			vec3 lo = {center[i][0] - r, center[i][1] - r, center[i][2] - r};
+			vec3 hi = {center[i][0] + r, center[i][1] + r, center[i][2] + r};
+			int seen = occlusionTestBox(&reference[0], lo, hi) || occlusionTestBox(&reference[1], lo, hi);
+			result->referenceVisible += seen;
+			if (!seen || drawn)
+				continue;
+
+			// The reference buffers widen boxes by a pixel of theirs too, a
+			// miss has to be visible at a finer density as well
+			for (int e = 0; e < 2 && !fineReady; ++e)
+			{
+				occlusionBeginFrame(&fine[e], wide, view[e]);
+				occlusionRasterize(&fine[e], identity, &gWalls);
+				occlusionFinish(&fine[e]);
+			}
+			fineReady = 1;
+			result->violations += occlusionTestBox(&fine[0], lo, hi) || occlusionTestBox(&fine[1], lo, hi);
+		}
+		result->inFrustum += count;
+		result->visible += kept;
+	}
+	return !result->violations;
+}
+
+static void print(const char *name, const Result *r)
+{
+	printf("  %-22s %6.3f ms/frame rasterize, %6.3f ms/frame test (%5.1f ns/object), %6.1f of %6.1f in frustum drawn,"
+		" %5.1f%% occluded (per eye reference %5.1f%%), %lu visible objects culled\n",
+		name, r->rasterizeMs / FRAMES, r->testMs / FRAMES, r->testMs * 1e6 / r->inFrustum,
+		(double)r->visible / FRAMES, (double)r->inFrustum / FRAMES,
+		100.0 * (r->inFrustum - r->visible) / r->inFrustum,
+		100.0 * (r->inFrustum - r->referenceVisible) / r->inFrustum, r->violations);
+}
+
+int main()
+{
+	vec3 *center = malloc(OBJECTS * sizeof(vec3));
+	float *radius = malloc(OBJECTS * sizeof(float));
+	float *scale = malloc(OBJECTS * sizeof(float));
+	int *visible = malloc(OBJECTS * sizeof(int));
+	int *tested = malloc(OBJECTS * sizeof(int));
+	OcclusionBuffer buffer, reference[2], fine[2];
+	if (!center || !radius || !scale || !visible || !tested
+		|| !occlusionInit(&buffer, OCCLUSION_WIDTH, OCCLUSION_HEIGHT)
+		|| !occlusionInit(&reference[0], REFERENCE_WIDTH, REFERENCE_HEIGHT)
+		|| !occlusionInit(&reference[1], REFERENCE_WIDTH, REFERENCE_HEIGHT)
+		|| !occlusionInit(&fine[0], FINE_SCALE * REFERENCE_WIDTH / 2, FINE_SCALE * REFERENCE_HEIGHT / 2)
+		|| !occlusionInit(&fine[1], FINE_SCALE * REFERENCE_WIDTH / 2, FINE_SCALE * REFERENCE_HEIGHT / 2))
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	initWalls();
+	if (!occluderMeshInit(&gWalls, gVertices[0], 3, gIndices, 6 * gQuads))
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	srand(1);
+	for (int i = 0; i < OBJECTS; ++i)
+	{
+		center[i][0] = randomRange(0.3f, ROOMS * ROOM_SIZE - 0.3f);
+		center[i][1] = randomRange(0.2f, 2.0f);
+		center[i][2] = randomRange(0.3f, ROOMS * ROOM_SIZE - 0.3f);
+		radius[i] = 1.f;
+		scale[i] = randomRange(0.1f, 0.3f);
+	}
+
+	Result stereo, plain;
+	int ok = run(&buffer, reference, fine, center, radius, scale, visible, tested, 1, &stereo);
+	run(&buffer, reference, fine, center, radius, scale, visible, tested, 0, &plain);
+
+	printf("%d objects in %d x %d rooms, %d occluder triangles, %d frames of a %dx%d center eye buffer (%s)\n",
+		OBJECTS, ROOMS, ROOMS, 2 * gQuads, FRAMES, OCCLUSION_WIDTH, OCCLUSION_HEIGHT, LINMATH_SIMD ? "SIMD" : "scalar");
+	print("occlusion", &stereo);
+	print("no parallax", &plain);
+
+	if (!ok)
+	{
+		printf("%lu times an object visible from an eye was culled\n", stereo.violations);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,836 @@
+// Headless native platform layer: implements the emscripten main loop, canvas,
+// input and WebVR APIs used by main.c on top of a scripted VR display, so the
+// frame loop can run under perf/valgrind without a browser.
+//
+// Environment variables:
+//   NATIVE_FRAMES    number of frames to run (default 1000)
+//   NATIVE_VR        1 to click into VR presentation as soon as possible (default), 0 to stay in the non-VR loop
+//   NATIVE_GL_TRACE  file to write a text trace of all GL calls to
+//   NATIVE_NO_EXTENSIONS  comma separated WebGL extensions to report as unsupported, or "all"
+//   NATIVE_CAPTURE   file to write the app's frame capture to (CAPTURE_FRAMES=1 builds, default session.vrcap)
+//   NATIVE_REPLAY    frame capture to replay instead of the scripted display and input
+//   NATIVE_REPLAY_PACING  1 to replay at the recorded frame times, 0 as fast as possible (default)
+//   NATIVE_REPLAY_CLOCK   "recorded" to give the app each frame's recorded time (default), "real" for the real clock
+//   NATIVE_STREAM_KB_PER_FRAME  how much of a streamed mesh file arrives between two frames (default 0, all at once)
+#include "gl_stub.h"
+#include "../frame_capture.h"
+#include "../frame_timing.h"
+#include "../linmath.h"
+#include "../mesh_stream.h"
+
+#include <emscripten/emscripten.h>
+#include <emscripten/html5.h>
+#include <emscripten/vr.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DISPLAY_HANDLE 1
+#define DISPLAY_REFRESH_HZ 90.0
+#define EYE_WIDTH 1080
+#define EYE_HEIGHT 1200
+#define EYE_OFFSET 0.032f
+#define DEPTH_NEAR 0.1f
+#define DEPTH_FAR 1000.0f
+
+static int gCanvasWidth = 1280, gCanvasHeight = 720;
+
+static int gMainLoopPaused;
+static em_vr_callback_func gVrLoop;
+static int gPresenting;
+
+static em_mouse_callback_func gClickCallback;
+static void *gClickUserData;
+static int gClicked;
+
+static em_vr_arg_callback_func gPresentCallback;
+static void *gPresentUserData;
+static int gPresentPending;
+
+static unsigned long gFrame;
+
+// Replay of a frame capture: every input call takes the next record. While
+// replaying the app's clock stands still at the recorded time of the frame,
+// so its timing driven decisions come out as they did when captured.
+static FrameCaptureReader gReplay;
+static void *gReplayData;
+static int gReplaying, gReplayRealClock, gReplayEnded, gReplayTruncated;
+static double gReplayNow;
+static unsigned long gReplayFrames, gReplayIdle;
+static unsigned long gVrFrames, gSubmittedFrames;
+
+// Mesh files being "downloaded": mapped whole, and revealed a piece per frame
+#define MAX_MESH_STREAMS 8
+static MeshStreamProgress *gMeshStreams[MAX_MESH_STREAMS];
+static int gMeshStreamCount;
+
+// Recorded head motion, one "timestamp px py pz qx qy qz qw" line per sample
+// with timestamps in milliseconds. Lines starting with '#' are comments.
+typedef struct PoseTraceSample
+{
+	double timestamp;
+	float position[3];
+	float orientation[4];
+} PoseTraceSample;
+
+static PoseTraceSample *gPoseTrace;
+static size_t gPoseTraceCount;
+static int gPoseTraceLoaded;
+static FILE *gPoseRecord;
+
+static int envInt(const char *name, int fallback)
+{
+	const char *value = getenv(name);
+	return value && *value ? atoi(value) : fallback;
+}
+
+static double realNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void loadReplay()
+{
+	const char *path = getenv("NATIVE_REPLAY");
+	if (!path || !*path)
+		return;
+
+	FILE *f = fopen(path, "rb");
+	long size = -1;
+	if (f && fseek(f, 0, SEEK_END) == 0)
+		size = ftell(f);
+	gReplayData = size > 0 ? malloc(size) : NULL;
+	int ok = gReplayData && fseek(f, 0, SEEK_SET) == 0 && fread(gReplayData, 1, size, f) == (size_t)size
+		&& frameCaptureReaderInit(&gReplay, gReplayData, size);
+	if (f)
+		fclose(f);
+	if (!ok)
+	{
+		fprintf(stderr, "Could not load frame capture '%s'\n", path);
+		exit(1);
+	}
+
+	const char *clock = getenv("NATIVE_REPLAY_CLOCK");
+	gReplayRealClock = clock && !strcmp(clock, "real");
+	gReplaying = 1;
+	printf("Replaying %s (%.1f KB)\n", path, size / 1024.0);
+}
+
+// Ends the replay at the first input the app asks for that the capture does
+// not have next, the app has taken a different path than when captured.
+// A capture cut off in the middle of a frame just ends there.
+static void replayDiverged(const char *expected)
+{
+	if (gReplayEnded)
+		return;
+	gReplayEnded = 1;
+	size_t left = gReplay.count - gReplay.position;
+	if (!left || FRAME_CAPTURE_WORDS(gReplay.words[gReplay.position]) > left)
+	{
+		gReplayTruncated = 1;
+		return;
+	}
+	FrameCaptureRecord next = frameCapturePeek(&gReplay);
+	fprintf(stderr, "Replay diverged after %lu frames: the app asked for %s, the capture has record type %d next\n",
+		gReplayFrames, expected, (int)next);
+}
+
+// Delivers the clicks and present completions recorded before the next frame
+static void replayEvents()
+{
+	int consumed = 0;
+	EmscriptenMouseEvent e;
+	for (;;)
+	{
+		if (frameCaptureReadClick(&gReplay, &e))
+		{
+			if (gClickCallback)
+				gClickCallback(EMSCRIPTEN_EVENT_CLICK, &e, gClickUserData);
+		}
+		else if (gPresentPending && frameCaptureReadPresentResolved(&gReplay))
+		{
+			gPresentPending = 0;
+			if (gPresentCallback)
+				gPresentCallback(gPresentUserData);
+		}
+		else
+		{
+			break;
+		}
+		consumed = 1;
+	}
+	gReplayIdle = consumed ? 0 : gReplayIdle + 1;
+}
+
+// Starts the next recorded frame, if a loop is going to run, pacing it like
+// the capture when asked to. Returns 0 when the replay is over.
+static int replayFrame(int vr, double wallStart)
+{
+	static double firstNow;
+	if (gReplayEnded)
+		return 0;
+	if (!vr && gMainLoopPaused)
+	{
+		// Waiting for an event, as the browser does between a click and the
+		// display presenting
+		if (gReplayIdle > 100)
+			replayDiverged("an event");
+		return !gReplayEnded;
+	}
+
+	double now;
+	int recordedVr;
+	if (!frameCapturePeek(&gReplay))
+		return 0; // The end of the capture
+	if (!frameCaptureReadFrame(&gReplay, &now, &recordedVr))
+	{
+		replayDiverged("a frame");
+		return 0;
+	}
+	if (recordedVr != vr)
+	{
+		replayDiverged(vr ? "a VR frame" : "a non-VR frame");
+		return 0;
+	}
+
+	if (!gReplayFrames)
+		firstNow = now;
+	gReplayNow = now;
+	++gReplayFrames;
+
+	if (envInt("NATIVE_REPLAY_PACING", 0))
+	{
+		double wait = wallStart + (now - firstNow) - realNow();
+		if (wait > 0.0)
+		{
+			struct timespec t = {(time_t)(wait / 1000.0), (long)(fmod(wait, 1000.0) * 1000000.0)};
+			nanosleep(&t, NULL);
+		}
+	}
+	return 1;
+}
+
+#ifdef NATIVE_COUNT_ALLOCS
+// Linked with -Wl,--wrap for these, the app's heap allocations come here
+// first and are counted (allocations inside the C library are not)
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+static unsigned long gAllocs;
+
+void *__wrap_malloc(size_t size)
+{
+	__atomic_add_fetch(&gAllocs, 1, __ATOMIC_RELAXED);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+	__atomic_add_fetch(&gAllocs, 1, __ATOMIC_RELAXED);
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+	__atomic_add_fetch(&gAllocs, 1, __ATOMIC_RELAXED);
+	return __real_realloc(p, size);
+}
+#endif
+
+static double envDouble(const char *name, double fallback)
+{
+	const char *value = getenv(name);
+	return value && *value ? atof(value) : fallback;
+}
+
+// Move the mesh downloads on by what the network would have delivered
+static void advanceMeshStreams()
+{
+	uint32_t step = (uint32_t)envInt("NATIVE_STREAM_KB_PER_FRAME", 0) * 1024u;
+	for (int i = 0; i < gMeshStreamCount; ++i)
+	{
+		MeshStreamProgress *progress = gMeshStreams[i];
+		if (progress->status)
+			continue;
+		uint32_t left = progress->size - progress->received;
+		progress->received += step && step < left ? step : left;
+		if (progress->received == progress->size)
+			progress->status = 1;
+	}
+}
+
+// Deliver the events a browser would have queued between two frames
+static void dispatchEvents()
+{
+	advanceMeshStreams();
+	if (gReplaying)
+	{
+		replayEvents();
+		return;
+	}
+
+	if (gPresentPending)
+	{
+		gPresentPending = 0;
+		gPresenting = 1;
+		if (gPresentCallback)
+			gPresentCallback(gPresentUserData);
+	}
+
+	if (gClickCallback && !gClicked && envInt("NATIVE_VR", 1))
+	{
+		EmscriptenMouseEvent e;
+		memset(&e, 0, sizeof(e));
+		e.timestamp = emscripten_get_now();
+		e.canvasX = e.targetX = e.clientX = gCanvasWidth / 2;
+		e.canvasY = e.targetY = e.clientY = gCanvasHeight / 2;
+		gClicked = 1;
+		gClickCallback(EMSCRIPTEN_EVENT_CLICK, &e, gClickUserData);
+	}
+}
+
+static void report(double elapsed)
+{
+	unsigned long frames = gFrame ? gFrame : 1;
+	printf("Ran %lu frames (%lu VR, %lu submitted) in %.1f ms: %.4f ms/frame\n",
+		gFrame, gVrFrames, gSubmittedFrames, elapsed, elapsed / frames);
+	if (gReplaying)
+		printf("Replayed %lu captured frames%s\n", gReplayFrames,
+			gReplayTruncated ? ", the capture ends within the last one" : gReplayEnded ? ", diverged before the end"
+			: frameCapturePeek(&gReplay) ? ", stopped before the end" : "");
+	printf("GL calls: %lu total, %.1f per frame\n", glStubTotalCallsAll(), glStubTotalCallsAll() / (double)frames);
+	for (int i = 0; i < GL_STUB_CALL_COUNT; ++i)
+	{
+		unsigned long calls = glStubTotalCalls((GLStubCall)i);
+		if (calls)
+			printf("  %-28s %10lu  %8.2f/frame\n", glStubCallName((GLStubCall)i), calls, calls / (double)frames);
+	}
+	unsigned long replayed = glStubTotalReplayedCalls();
+	unsigned long crossings = glStubTotalCallsAll() - replayed + glStubTotalReplays();
+	printf("GL calls from wasm into JavaScript: %.1f per frame", crossings / (double)frames);
+	if (glStubTotalReplays())
+		printf(" (%lu command buffer replays made %lu of the GL calls)", glStubTotalReplays(), replayed);
+	printf("\n");
+
+#ifdef FRAME_TIMING
+	printf("%s", frameTimingReport());
+#endif
+}
+
+void emscripten_set_main_loop(em_callback_func func, int fps, int simulate_infinite_loop)
+{
+	loadReplay();
+	int frames = envInt("NATIVE_FRAMES", gReplaying ? 0x7fffffff : 1000);
+
+	FILE *trace = NULL;
+	const char *tracePath = getenv("NATIVE_GL_TRACE");
+	if (tracePath && *tracePath)
+	{
+		trace = fopen(tracePath, "w");
+		if (!trace)
+			fprintf(stderr, "Could not open GL trace file '%s'\n", tracePath);
+		glStubSetTrace(trace);
+	}
+
+	// Frames before this one set things up (entering VR, waiting for shaders)
+	unsigned long warmup = (unsigned long)envInt("NATIVE_WARMUP_FRAMES", 10);
+	unsigned long warmupRedundant = 0;
+#ifdef NATIVE_COUNT_ALLOCS
+	unsigned long startupAllocs = gAllocs, warmupAllocs = 0;
+#endif
+
+	double start = realNow();
+	for (gFrame = 0; gFrame < (unsigned long)frames; ++gFrame)
+	{
+		if (gFrame == warmup)
+		{
+			warmupRedundant = glStubTotalRedundant();
+#ifdef NATIVE_COUNT_ALLOCS
+			warmupAllocs = gAllocs;
+#endif
+		}
+		glStubBeginFrame();
+		dispatchEvents();
+
+		if (gReplaying && !replayFrame(gPresenting && gVrLoop, start))
+			break;
+		if (gPresenting && gVrLoop)
+		{
+			++gVrFrames;
+			gVrLoop();
+		}
+		else if (!gMainLoopPaused)
+		{
+			func();
+		}
+	}
+	double elapsed = realNow() - start;
+
+	unsigned long steadyFrames = gFrame > warmup ? gFrame - warmup : 0;
+	unsigned long steadyRedundant = steadyFrames ? glStubTotalRedundant() - warmupRedundant : 0;
+#ifdef NATIVE_COUNT_ALLOCS
+	unsigned long steadyAllocs = steadyFrames ? gAllocs - warmupAllocs : 0;
+#endif
+
+	if (trace)
+	{
+		glStubSetTrace(NULL);
+		fclose(trace);
+	}
+	if (gPoseRecord)
+	{
+		fclose(gPoseRecord);
+		gPoseRecord = NULL;
+	}
+
+	report(elapsed);
+
+	printf("Redundant GL state calls: %lu in total, %lu in %lu steady frames\n",
+		glStubTotalRedundant(), steadyRedundant, steadyFrames);
+	if (steadyRedundant && envInt("NATIVE_CHECK_REDUNDANT", 0))
+	{
+		fprintf(stderr, "Steady frames made redundant GL state calls\n");
+		exit(1);
+	}
+
+	// Results must only be read once available, and read at all
+	GLStubQueryStats queries;
+	glStubQueryStats(&queries);
+	if (queries.created)
+	{
+		printf("GPU timer queries: %lu created, %lu deleted, %lu begun, %lu results read at least %lu frames after their end,"
+			" %lu read before available, %lu lifecycle errors, %lu disjoints\n",
+			queries.created, queries.deleted, queries.begun, queries.results, queries.minLatency,
+			queries.stalls, queries.errors, queries.disjoints);
+	}
+	if (envInt("NATIVE_CHECK_QUERIES", 0) && (queries.stalls || queries.errors || (queries.begun && !queries.results)))
+	{
+		fprintf(stderr, "GPU timer queries were misused or stalled on\n");
+		exit(1);
+	}
+
+#ifdef NATIVE_COUNT_ALLOCS
+	printf("Heap allocations: %lu at startup, %lu in %lu warmup frames, %lu in %lu steady frames\n",
+		startupAllocs, (steadyFrames ? warmupAllocs : gAllocs) - startupAllocs, gFrame - steadyFrames,
+		steadyAllocs, steadyFrames);
+	if (steadyAllocs && envInt("NATIVE_CHECK_ALLOCS", 0))
+	{
+		fprintf(stderr, "Steady frames allocated from the heap\n");
+		exit(1);
+	}
+#endif
+}
+
+void emscripten_pause_main_loop(void)
+{
+	gMainLoopPaused = 1;
+}
+
+void emscripten_resume_main_loop(void)
+{
+	gMainLoopPaused = 0;
+}
+
+void emscripten_cancel_main_loop(void)
+{
+	gMainLoopPaused = 1;
+}
+
+double emscripten_get_now(void)
+{
+	return gReplaying && !gReplayRealClock ? gReplayNow : realNow();
+}
+
+EMSCRIPTEN_RESULT emscripten_set_click_callback(const char *target, void *userData, EM_BOOL useCapture, em_mouse_callback_func callback)
+{
+	gClickCallback = callback;
+	gClickUserData = userData;
+	return EMSCRIPTEN_RESULT_SUCCESS;
+}
+
+void emscripten_webgl_init_context_attributes(EmscriptenWebGLContextAttributes *attributes)
+{
+	memset(attributes, 0, sizeof(*attributes));
+	attributes->alpha = attributes->depth = attributes->antialias = EM_TRUE;
+	attributes->premultipliedAlpha = EM_TRUE;
+	attributes->majorVersion = 1;
+	attributes->enableExtensionsByDefault = EM_TRUE;
+}
+
+EMSCRIPTEN_WEBGL_CONTEXT_HANDLE emscripten_webgl_create_context(const char *target, const EmscriptenWebGLContextAttributes *attributes)
+{
+	glStubSetCompileCost(envDouble("NATIVE_COMPILE_MS", 0.0), envDouble("NATIVE_LINK_MS", 0.0));
+	glStubSetQueryLatency(envInt("NATIVE_GPU_QUERY_LATENCY", 2), envInt("NATIVE_GPU_DISJOINT_EVERY", 0));
+	return 1;
+}
+
+EMSCRIPTEN_RESULT emscripten_webgl_make_context_current(EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context)
+{
+	return EMSCRIPTEN_RESULT_SUCCESS;
+}
+
+EM_BOOL emscripten_webgl_enable_extension(EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context, const char *extension)
+{
+	const char *disabled = getenv("NATIVE_NO_EXTENSIONS");
+	if (!disabled)
+		return EM_TRUE;
+	if (strcmp(disabled, "all") == 0)
+		return EM_FALSE;
+
+	size_t len = strlen(extension);
+	for (const char *p = strstr(disabled, extension); p; p = strstr(p + 1, extension))
+	{
+		if ((p == disabled || p[-1] == ',') && (p[len] == '\0' || p[len] == ','))
+			return EM_FALSE;
+	}
+	return EM_TRUE;
+}
+
+EMSCRIPTEN_RESULT emscripten_get_canvas_element_size(const char *target, int *width, int *height)
+{
+	if (gReplaying)
+		frameCaptureReadCanvasSize(&gReplay, &gCanvasWidth, &gCanvasHeight);
+	*width = gCanvasWidth;
+	*height = gCanvasHeight;
+	return EMSCRIPTEN_RESULT_SUCCESS;
+}
+
+EMSCRIPTEN_RESULT emscripten_set_canvas_element_size(const char *target, int width, int height)
+{
+	gCanvasWidth = width;
+	gCanvasHeight = height;
+	return EMSCRIPTEN_RESULT_SUCCESS;
+}
+
+int emscripten_vr_init(void)
+{
+	return 1;
+}
+
+int emscripten_vr_ready(void)
+{
+	return 1;
+}
+
+int emscripten_vr_version_major(void)
+{
+	return 1;
+}
+
+int emscripten_vr_version_minor(void)
+{
+	return 1;
+}
+
+int emscripten_vr_count_displays(void)
+{
+	return 1;
+}
+
+VRDisplayHandle emscripten_vr_get_display_handle(int displayIndex)
+{
+	return displayIndex == 0 ? DISPLAY_HANDLE : -1;
+}
+
+const char *emscripten_vr_get_display_name(VRDisplayHandle handle)
+{
+	return handle == DISPLAY_HANDLE ? "Native Scripted HMD" : NULL;
+}
+
+int emscripten_vr_get_display_capabilities(VRDisplayHandle handle, VRDisplayCapabilities *displayCaps)
+{
+	if (handle != DISPLAY_HANDLE)
+		return 0;
+	displayCaps->hasPosition = 1;
+	displayCaps->hasExternalDisplay = 0;
+	displayCaps->canPresent = 1;
+	displayCaps->maxLayers = 1;
+	return 1;
+}
+
+int emscripten_vr_get_eye_parameters(VRDisplayHandle handle, VREye whichEye, VREyeParameters *eyeParams)
+{
+	if (handle != DISPLAY_HANDLE)
+		return 0;
+	VREye eye;
+	if (gReplaying && frameCaptureReadEyeParameters(&gReplay, &eye, eyeParams))
+	{
+		if (eye != whichEye)
+			replayDiverged(whichEye == VREyeLeft ? "the left eye" : "the right eye");
+		return 1;
+	}
+	eyeParams->offset.x = whichEye == VREyeLeft ? -EYE_OFFSET : EYE_OFFSET;
+	eyeParams->offset.y = 0.0f;
+	eyeParams->offset.z = 0.0f;
+	eyeParams->renderWidth = EYE_WIDTH;
+	eyeParams->renderHeight = EYE_HEIGHT;
+	return 1;
+}
+
+int emscripten_vr_display_connected(VRDisplayHandle handle)
+{
+	return handle == DISPLAY_HANDLE;
+}
+
+int emscripten_vr_display_presenting(VRDisplayHandle handle)
+{
+	if (gReplaying)
+		frameCaptureReadPresenting(&gReplay, &gPresenting);
+	return handle == DISPLAY_HANDLE && gPresenting;
+}
+
+int emscripten_vr_set_display_render_loop(VRDisplayHandle handle, em_vr_callback_func callback)
+{
+	if (handle != DISPLAY_HANDLE)
+		return 0;
+	gVrLoop = callback;
+	return 1;
+}
+
+int emscripten_vr_set_display_render_loop_arg(VRDisplayHandle handle, em_vr_arg_callback_func callback, void *arg)
+{
+	// Not used by the app
+	return 0;
+}
+
+int emscripten_vr_cancel_display_render_loop(VRDisplayHandle handle)
+{
+	if (handle != DISPLAY_HANDLE)
+		return 0;
+	gVrLoop = NULL;
+	return 1;
+}
+
+int emscripten_vr_request_present(VRDisplayHandle handle, VRLayerInit *layerInit, int layerCount, em_vr_arg_callback_func callback, void *userData)
+{
+	if (handle != DISPLAY_HANDLE)
+		return 0;
+	gPresentCallback = callback;
+	gPresentUserData = userData;
+	gPresentPending = 1;
+	return 1;
+}
+
+int emscripten_vr_exit_present(VRDisplayHandle handle)
+{
+	if (handle != DISPLAY_HANDLE)
+		return 0;
+	gPresenting = 0;
+	return 1;
+}
+
+// Scripted head motion: a slow yaw/pitch sweep with some sideways sway,
+// sampled on a fixed 90 Hz clock so every run sees the same poses
+static void scriptedPose(double timestamp, VRPose *pose)
+{
+	float t = (float)(timestamp / 1000.0);
+	float yaw = 0.6f * sinf(0.5f * t);
+	float pitch = 0.1f * sinf(0.9f * t);
+
+	quat qYaw, qPitch, q;
+	vec3 up = {0.f, 1.f, 0.f};
+	vec3 right = {1.f, 0.f, 0.f};
+	quat_rotate(qYaw, yaw, up);
+	quat_rotate(qPitch, pitch, right);
+	quat_mul(q, qYaw, qPitch);
+
+	memset(pose, 0, sizeof(*pose));
+	pose->position.x = 0.05f * sinf(0.3f * t);
+	pose->orientation.x = q[0];
+	pose->orientation.y = q[1];
+	pose->orientation.z = q[2];
+	pose->orientation.w = q[3];
+	pose->poseFlags = VR_POSE_POSITION | VR_POSE_ORIENTATION;
+}
+
+static void loadPoseTrace()
+{
+	gPoseTraceLoaded = 1;
+
+	const char *recordPath = getenv("NATIVE_POSE_RECORD");
+	if (recordPath && *recordPath)
+	{
+		gPoseRecord = fopen(recordPath, "w");
+		if (!gPoseRecord)
+			fprintf(stderr, "Could not open pose record file '%s'\n", recordPath);
+	}
+
+	const char *tracePath = getenv("NATIVE_POSE_TRACE");
+	if (!tracePath || !*tracePath)
+		return;
+	FILE *file = fopen(tracePath, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Could not open pose trace file '%s'\n", tracePath);
+		return;
+	}
+
+	size_t capacity = 0;
+	char line[256];
+	while (fgets(line, sizeof(line), file))
+	{
+		PoseTraceSample s;
+		if (line[0] == '#' || sscanf(line, "%lf %f %f %f %f %f %f %f", &s.timestamp,
+				&s.position[0], &s.position[1], &s.position[2],
+				&s.orientation[0], &s.orientation[1], &s.orientation[2], &s.orientation[3]) != 8)
+			continue;
+		if (gPoseTraceCount && s.timestamp <= gPoseTrace[gPoseTraceCount - 1].timestamp)
+			continue;
+		if (gPoseTraceCount == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 1024;
+			gPoseTrace = realloc(gPoseTrace, capacity * sizeof(*gPoseTrace));
+		}
+		gPoseTrace[gPoseTraceCount++] = s;
+	}
+	fclose(file);
+
+	if (gPoseTraceCount < 2)
+	{
+		fprintf(stderr, "Pose trace '%s' needs at least two samples, using scripted motion\n", tracePath);
+		gPoseTraceCount = 0;
+	}
+	else
+	{
+		printf("Replaying %zu head poses from '%s'\n", gPoseTraceCount, tracePath);
+	}
+}
+
+// Trace pose at a display timestamp. When the run outlasts the trace it plays
+// backwards and forwards again, so the head never jumps between two poses.
+static void tracePose(double timestamp, VRPose *pose)
+{
+	double first = gPoseTrace[0].timestamp;
+	double length = gPoseTrace[gPoseTraceCount - 1].timestamp - first;
+	double phase = fmod(timestamp, 2.0 * length);
+	double t = first + (phase > length ? 2.0 * length - phase : phase);
+
+	size_t i = 1;
+	while (i < gPoseTraceCount - 1 && gPoseTrace[i].timestamp < t)
+		++i;
+	const PoseTraceSample *a = &gPoseTrace[i - 1], *b = &gPoseTrace[i];
+	float f = (float)((t - a->timestamp) / (b->timestamp - a->timestamp));
+
+	// Normalized lerp is close enough between samples a few ms apart
+	quat qa = {a->orientation[0], a->orientation[1], a->orientation[2], a->orientation[3]};
+	quat qb = {b->orientation[0], b->orientation[1], b->orientation[2], b->orientation[3]};
+	if (quat_inner_product(qa, qb) < 0.f)
+		quat_scale(qb, qb, -1.f);
+	quat q;
+	for (int k = 0; k < 4; ++k)
+		q[k] = qa[k] + (qb[k] - qa[k]) * f;
+	quat_norm(q, q);
+
+	memset(pose, 0, sizeof(*pose));
+	pose->position.x = a->position[0] + (b->position[0] - a->position[0]) * f;
+	pose->position.y = a->position[1] + (b->position[1] - a->position[1]) * f;
+	pose->position.z = a->position[2] + (b->position[2] - a->position[2]) * f;
+	pose->orientation.x = q[0];
+	pose->orientation.y = q[1];
+	pose->orientation.z = q[2];
+	pose->orientation.w = q[3];
+	pose->poseFlags = VR_POSE_POSITION | VR_POSE_ORIENTATION;
+}
+
+// Eye matrices for a head pose. The frusta are slightly asymmetric, wider
+// towards the outside of each eye, like real HMD lenses.
+static void eyeMatrices(const VRPose *pose, float eyeOffset, float tanLeft, float tanRight, float projection[16], float view[16])
+{
+	quat q = {pose->orientation.x, pose->orientation.y, pose->orientation.z, pose->orientation.w};
+	mat4x4 eye, p, v;
+	mat4x4_from_quat(eye, q);
+	eye[3][0] = pose->position.x;
+	eye[3][1] = pose->position.y;
+	eye[3][2] = pose->position.z;
+	mat4x4_translate_in_place(eye, eyeOffset, 0.f, 0.f);
+	mat4x4_invert(v, eye);
+
+	float n = DEPTH_NEAR;
+	mat4x4_frustum(p, -tanLeft * n, tanRight * n, -n, n, n, DEPTH_FAR);
+
+	memcpy(projection, p, sizeof(p));
+	memcpy(view, v, sizeof(v));
+}
+
+int emscripten_vr_get_frame_data(VRDisplayHandle handle, VRFrameData *frameData)
+{
+	if (handle != DISPLAY_HANDLE)
+		return 0;
+	if (gReplaying)
+	{
+		if (frameCaptureReadFrameData(&gReplay, frameData))
+			return 1;
+		replayDiverged("frame data");
+	}
+
+	if (!gPoseTraceLoaded)
+		loadPoseTrace();
+
+	frameData->timestamp = gVrFrames * 1000.0 / DISPLAY_REFRESH_HZ;
+	if (gPoseTraceCount)
+		tracePose(frameData->timestamp, &frameData->pose);
+	else
+		scriptedPose(frameData->timestamp, &frameData->pose);
+
+	if (gPoseRecord)
+	{
+		const VRPose *pose = &frameData->pose;
+		fprintf(gPoseRecord, "%.3f %f %f %f %f %f %f %f\n", frameData->timestamp,
+			pose->position.x, pose->position.y, pose->position.z,
+			pose->orientation.x, pose->orientation.y, pose->orientation.z, pose->orientation.w);
+	}
+	eyeMatrices(&frameData->pose, -EYE_OFFSET, 1.1f, 0.9f, frameData->leftProjectionMatrix, frameData->leftViewMatrix);
+	eyeMatrices(&frameData->pose, EYE_OFFSET, 0.9f, 1.1f, frameData->rightProjectionMatrix, frameData->rightViewMatrix);
+	return 1;
+}
+
+int emscripten_vr_submit_frame(VRDisplayHandle handle)
+{
+	if (handle != DISPLAY_HANDLE || !gPresenting)
+		return 0;
+	++gSubmittedFrames;
+	return 1;
+}
+
+void meshStreamFetch(const char *url, MeshStreamProgress *progress)
+{
+	memset(progress, 0, sizeof(*progress));
+	struct stat st;
+	int fd = open(url, O_RDONLY);
+	void *data = MAP_FAILED;
+	if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size <= 0xffffffff)
+		data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (fd >= 0)
+		close(fd);
+	if (data == MAP_FAILED || gMeshStreamCount == MAX_MESH_STREAMS)
+	{
+		fprintf(stderr, "Streaming %s failed\n", url);
+		progress->status = -1;
+		return;
+	}
+
+	// Mapped for the rest of the run, like the heap block the browser fills
+	progress->data = data;
+	progress->size = (uint32_t)st.st_size;
+	gMeshStreams[gMeshStreamCount++] = progress;
+}
+
+void frameCaptureSave(const void *data, size_t size)
+{
+	const char *path = getenv("NATIVE_CAPTURE");
+	if (!path || !*path)
+		path = "session.vrcap";
+	FILE *f = fopen(path, "wb");
+	if (!f || fwrite(data, 1, size, f) != size)
+		fprintf(stderr, "Could not write frame capture '%s'\n", path);
+	if (f)
+		fclose(f);
+}
@@ -0,0 +1,176 @@
+// Simulation of the dynamic resolution controller against synthetic frame
+// time traces.
+//
+// Every trace gives the CPU time and the GPU time at full resolution of each
+// frame. The simulated GPU time scales with the rendered pixels, plus a fixed
+// part that does not, and a frame takes as many 90 Hz refresh intervals as the
+// slower of the two needs. Each trace runs twice: with the GPU time known, as
+// from a timer query, and with only the frame intervals to go by.
+//
+// A trace file can be given instead of the built in traces, one "cpuMs gpuMs"
+// line per frame. The run fails if a built in trace breaks its expectations.
+#include "../resolution.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define REFRESH_HZ 90.0
+#define FRAMES 9000 // 100 seconds
+#define MIN_SCALE 0.5f
+#define GPU_FIXED_MS 1.0 // GPU time that does not depend on the resolution
+
+typedef struct Frame
+{
+	double cpuMs, gpuMs; // gpuMs at full resolution
+} Frame;
+
+typedef struct Result
+{
+	double meanScale;
+	float minScale, finalScale;
+	unsigned long changes;
+	unsigned long missed, missedLate; // Over the whole run and its second half
+} Result;
+
+static double randomRange(double lo, double hi)
+{
+	return lo + (hi - lo) * (double)rand() / (double)RAND_MAX;
+}
+
+static Result simulate(const Frame *frames, int count, int gpuTimer)
+{
+	double budget = 1000.0 / REFRESH_HZ;
+	ResolutionController controller;
+	resolutionInit(&controller, budget, MIN_SCALE, 1.0f);
+
+	Result result = {0.0, 1.0f, 1.0f, 0, 0, 0};
+	double cpuMs = 0.0, gpuMs = -1.0, intervalMs = budget;
+	for (int i = 0; i < count; ++i)
+	{
+		// The controller sees the previous frame's measurements before the
+		// frame renders, as in the frame loop
+		if (i && resolutionUpdate(&controller, cpuMs, gpuTimer ? gpuMs : -1.0, intervalMs))
+			++result.changes;
+
+		float scale = controller.scale;
+		cpuMs = frames[i].cpuMs;
+		gpuMs = GPU_FIXED_MS + (frames[i].gpuMs - GPU_FIXED_MS) * scale * scale;
+		double work = fmax(cpuMs, gpuMs);
+		intervalMs = ceil(work / budget - 1e-9) * budget;
+
+		if (intervalMs > budget)
+		{
+			++result.missed;
+			if (i >= count / 2)
+				++result.missedLate;
+		}
+		result.meanScale += scale;
+		result.minScale = fminf(result.minScale, scale);
+	}
+	result.meanScale /= count;
+	result.finalScale = controller.scale;
+	return result;
+}
+
+static void printResult(const char *name, const char *mode, Result r, int count)
+{
+	printf("  %-14s %-9s %6.3f %6.3f %6.3f %8lu %7.2f%% %7.2f%%\n", name, mode, r.meanScale, r.minScale, r.finalScale,
+		r.changes, 100.0 * r.missed / count, 200.0 * r.missedLate / count);
+}
+
+static void printHeader()
+{
+	printf("  %-14s %-9s %6s %6s %6s %8s %8s %8s\n", "trace", "gpu time", "mean", "min", "final", "changes", "missed", "late");
+}
+
+// Runs a file trace, returns 0 if it could not be read
+static int runFile(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Cannot open %s\n", path);
+		return 0;
+	}
+
+	int count = 0, capacity = 1024;
+	Frame *frames = malloc(capacity * sizeof(Frame));
+	while (frames && fscanf(file, "%lf %lf", &frames[count].cpuMs, &frames[count].gpuMs) == 2)
+	{
+		if (++count == capacity)
+		{
+			capacity *= 2;
+			Frame *grown = realloc(frames, capacity * sizeof(Frame));
+			if (!grown)
+				free(frames);
+			frames = grown;
+		}
+	}
+	fclose(file);
+	if (!frames || !count)
+	{
+		fprintf(stderr, "No frames in %s\n", path);
+		free(frames);
+		return 0;
+	}
+
+	printHeader();
+	printResult(path, "known", simulate(frames, count, 1), count);
+	printResult(path, "unknown", simulate(frames, count, 0), count);
+	free(frames);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1)
+		return runFile(argv[1]) ? 0 : 1;
+
+	static Frame frames[FRAMES];
+	const char *names[] = {"light", "heavy", "step", "ramp", "noisy", "cpu bound"};
+	int failed = 0;
+
+	printf("Dynamic resolution over %d frames at %.0f Hz, scale %.2f to 1\n", FRAMES, REFRESH_HZ, MIN_SCALE);
+	printHeader();
+	for (int trace = 0; trace < 6; ++trace)
+	{
+		srand(1);
+		for (int i = 0; i < FRAMES; ++i)
+		{
+			Frame *f = &frames[i];
+			f->cpuMs = 4.0;
+			switch (trace)
+			{
+			case 0: f->gpuMs = 8.0; break;
+			case 1: f->gpuMs = 16.0; break;
+			case 2: f->gpuMs = i >= FRAMES / 3 && i < 2 * FRAMES / 3 ? 18.0 : 7.0; break;
+			case 3: f->gpuMs = 6.0 + 14.0 * i / FRAMES; break;
+			case 4: f->gpuMs = randomRange(10.0, 14.0); break;
+			case 5: f->cpuMs = 13.0; f->gpuMs = 5.0; break;
+			}
+		}
+
+		for (int gpuTimer = 1; gpuTimer >= 0; --gpuTimer)
+		{
+			Result r = simulate(frames, FRAMES, gpuTimer);
+			printResult(names[trace], gpuTimer ? "known" : "unknown", r, FRAMES);
+
+			// Light and CPU bound frames must keep full resolution, the
+			// others must settle without missing frames or oscillating
+			int ok = 1;
+			if (trace == 0 || trace == 5)
+				ok = r.changes == 0 && r.finalScale == 1.0f;
+			else if (trace == 2)
+				ok = r.finalScale == 1.0f && r.missedLate < FRAMES / 200;
+			else
+				ok = r.missedLate < FRAMES / 200 && r.changes < FRAMES / 100;
+			if (!ok)
+			{
+				printf("    expectation failed\n");
+				failed = 1;
+			}
+		}
+	}
+	return failed;
+}
@@ -0,0 +1,205 @@
+// Batched scene transforms at 1k, 10k and 100k objects, on the GL stub.
+//
+// Fills a scene with spinning objects and times, per object:
+//   - update: one simulation tick of spin, then the interpolated world
+//     matrices (sceneUpdateWorldInterpolated), as the frame loop does once
+//     per frame
+//   - instanced draw: both eyes' MVPs computed in one pass each
+//     (sceneComputeMvp), uploaded with one glBufferSubData per eye and drawn
+//     with one instanced draw per eye
+//   - per object draw: both eyes' MVPs, then a uniform upload and a draw per
+//     object and eye, the path without ANGLE_instanced_arrays
+// The draws go through the GL state cache to the recording stub, so they
+// measure the app's side of the calls, not the driver's. Each phase keeps the
+// best of several runs.
+//
+// It fails if a world matrix differs from translate * rotate * scale built
+// with the plain linmath.h calls, or a draw path made the wrong number of
+// draws.
+#include "gl_stub.h"
+#include "../gl_command.h"
+#include "../gl_state.h"
+#include "../scene.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_OBJECTS 100000
+#define TIMED_OBJECTS 2000000 // Objects each phase runs over per size, split into runs
+#define EYE_OFFSET 0.032f
+#define MVP_LOCATION 0
+#define IMVP_LOCATION 2
+
+static const int gSizes[] = {1000, 10000, 100000};
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static float randomRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// View-projection of one eye of a head looking down the -Z axis
+static void eyeViewProjection(mat4x4 out, float eyeOffset)
+{
+	mat4x4 eye, view, projection;
+	mat4x4_translate(eye, eyeOffset, 1.6f, 0.f);
+	mat4x4_invert_rigid(view, eye);
+	mat4x4_perspective(projection, 1.6f, 0.9f, 0.1f, 100.f);
+	mat4x4_mul_affine(out, projection, view);
+}
+
+static void initScene(Scene *scene, int count)
+{
+	scene->count = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		vec3 p = {randomRange(-50.f, 50.f), randomRange(-5.f, 5.f), randomRange(-100.f, -1.f)};
+		vec3 axis = {randomRange(-1.f, 1.f), randomRange(-1.f, 1.f), randomRange(-1.f, 1.f)};
+		vec3_norm(axis, axis);
+		quat q;
+		quat_rotate(q, randomRange(-(float)M_PI, (float)M_PI), axis);
+		sceneAdd(scene, p, q, randomRange(0.1f, 2.f), 1.f);
+	}
+}
+
+// One tick spinning every object around its Z axis, like the frame loop
+static void update(Scene *scene, double t)
+{
+	vec3 axis = {0.f, 0.f, 1.f};
+	for (int i = 0; i < scene->count; ++i)
+	{
+		memcpy(scene->previousRotation[i], scene->rotation[i], sizeof(quat));
+		quat_rotate(scene->rotation[i], (float)fmod(t * (1.0 + 0.1 * (i % 8)), 2.0 * M_PI), axis);
+	}
+	sceneUpdateWorldInterpolated(scene, 0.5f, 0, scene->count);
+}
+
+static void drawInstanced(const Scene *scene, mat4x4 *viewProjection, mat4x4 *mvp, GLuint buffer)
+{
+	for (int eye = 0; eye < 2; ++eye)
+	{
+		int offset = eye * scene->count;
+		sceneComputeMvp(scene, viewProjection[eye], mvp + offset, 0, scene->count);
+		glStateBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glCmdBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(mat4x4), scene->count * sizeof(mat4x4), mvp + offset);
+		for (int c = 0; c < 4; ++c)
+		{
+			glStateVertexAttribPointer(IMVP_LOCATION + c, 4, GL_FLOAT, GL_FALSE, sizeof(mat4x4),
+				(void *)(offset * sizeof(mat4x4) + c * sizeof(vec4)));
+		}
+		glCmdDrawArraysInstanced(GL_TRIANGLES, 0, 3, scene->count);
+		glCmdFlush();
+	}
+}
+
+static void drawPerObject(const Scene *scene, mat4x4 *viewProjection, mat4x4 *mvp)
+{
+	for (int eye = 0; eye < 2; ++eye)
+	{
+		sceneComputeMvp(scene, viewProjection[eye], mvp, 0, scene->count);
+		for (int i = 0; i < scene->count; ++i)
+		{
+			glStateUniformMatrix4fv(MVP_LOCATION, 1, GL_FALSE, (const GLfloat *)mvp[i]);
+			glCmdDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+		glCmdFlush();
+	}
+}
+
+// Checks the batched world matrices against the plain linmath.h chain
+static int verify(const Scene *scene)
+{
+	for (int i = 0; i < scene->count; ++i)
+	{
+		mat4x4 translate, rotate, world;
+		mat4x4_translate(translate, scene->position[i][0], scene->position[i][1], scene->position[i][2]);
+		mat4x4_from_quat(rotate, (float *)scene->rotation[i]);
+		mat4x4_mul(world, translate, rotate);
+		mat4x4_scale_aniso(world, world, scene->scale[i], scene->scale[i], scene->scale[i]);
+		for (int c = 0; c < 4; ++c)
+		{
+			for (int r = 0; r < 4; ++r)
+			{
+				if (fabsf(world[c][r] - scene->world[i][c][r]) > 1e-5f * (1.f + fabsf(world[c][r])))
+				{
+					printf("  object %d world matrix [%d][%d] is %g, not %g\n", i, c, r, scene->world[i][c][r], world[c][r]);
+					return 0;
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+int main()
+{
+	Scene scene;
+	mat4x4 *mvp = malloc(2 * MAX_OBJECTS * sizeof(mat4x4));
+	if (!sceneInit(&scene, MAX_OBJECTS) || !mvp)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	mat4x4 viewProjection[2];
+	eyeViewProjection(viewProjection[0], -EYE_OFFSET);
+	eyeViewProjection(viewProjection[1], EYE_OFFSET);
+
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glStateBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glCmdBufferData(GL_ARRAY_BUFFER, 2 * MAX_OBJECTS * sizeof(mat4x4), NULL, GL_DYNAMIC_DRAW);
+	glCmdFlush();
+
+	srand(1);
+	int ok = 1;
+	printf("Scene update and draw of both eyes, ns per object\n");
+	printf("  %8s %10s %16s %16s\n", "objects", "update", "instanced draw", "per object draw");
+	for (size_t s = 0; s < sizeof(gSizes) / sizeof(gSizes[0]); ++s)
+	{
+		int count = gSizes[s], runs = TIMED_OBJECTS / count;
+		initScene(&scene, count);
+
+		// The phases run alternately, so none gets a warmer cache
+		double best[3] = {1e30, 1e30, 1e30};
+		for (int run = 0; run < runs; ++run)
+		{
+			double start = now();
+			update(&scene, run / 60.0);
+			best[0] = fmin(best[0], now() - start);
+
+			glStubBeginFrame();
+			start = now();
+			drawInstanced(&scene, viewProjection, mvp, buffer);
+			best[1] = fmin(best[1], now() - start);
+			ok &= glStubFrameCalls(GL_STUB_glDrawArraysInstancedANGLE) == 2;
+
+			glStubBeginFrame();
+			start = now();
+			drawPerObject(&scene, viewProjection, mvp);
+			best[2] = fmin(best[2], now() - start);
+			ok &= glStubFrameCalls(GL_STUB_glDrawArrays) == 2ul * count;
+		}
+
+		// Without interpolation, so the result is the current rotation's
+		sceneUpdateWorld(&scene, 0, count);
+		ok &= verify(&scene);
+
+		printf("  %8d %10.2f %16.2f %16.2f\n", count, best[0] * 1e6 / count, best[1] * 1e6 / count,
+			best[2] * 1e6 / count);
+	}
+
+	sceneFree(&scene);
+	free(mvp);
+	printf("%s\n", ok ? "ok" : "FAILED");
+	return !ok;
+}
@@ -0,0 +1,122 @@
+// Incremental scene graph updates at 100k nodes.
+//
+// Builds trees of up to 64 nodes, like the transform bench, and changes the
+// local transforms of 1%, 10% and 100% of the nodes, picked at random, every
+// frame before updating the world matrices, and none at all. Each rate is
+// compared against recomputing every node, as without dirty flags. A change
+// recomputes the node's whole subtree, so more nodes are recomputed than
+// changed.
+//
+// It fails if an incremental update ever ends with world matrices different
+// from a full recompute.
+#include "../scene_graph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NODES 100000
+#define CHAIN 64
+#define FRAMES 50
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static float randomRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static void randomTransform(Transform *t)
+{
+	vec3 axis = {randomRange(-1.f, 1.f), randomRange(-1.f, 1.f), randomRange(-1.f, 1.f)};
+	vec3 position = {randomRange(-1.f, 1.f), randomRange(-1.f, 1.f), randomRange(-1.f, 1.f)};
+	quat q;
+	vec3_norm(axis, axis);
+	quat_rotate(q, randomRange(-(float)M_PI, (float)M_PI), axis);
+	transformSet(t, position, q, randomRange(0.9f, 1.1f));
+}
+
+// Marks every node dirty, as a graph without dirty flags would have to treat it
+static void markAll(SceneGraph *graph)
+{
+	memset(graph->dirty, 1, graph->count);
+	graph->firstDirty = 0;
+}
+
+int main()
+{
+	SceneGraph graph;
+	mat4x4 *full = malloc(NODES * sizeof(mat4x4));
+	Transform *changes = malloc(NODES * sizeof(Transform));
+	int *changed = malloc(NODES * sizeof(int));
+	if (!sceneGraphInit(&graph, NODES) || !full || !changes || !changed)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	srand(1);
+	for (int i = 0; i < NODES; ++i)
+	{
+		Transform t;
+		int depth = i % CHAIN;
+		randomTransform(&t);
+		sceneGraphAdd(&graph, depth ? i - 1 - rand() % (depth < 8 ? depth : 8) : -1, &t);
+	}
+	sceneGraphUpdate(&graph);
+
+	// Precomputed so only the graph is timed
+	for (int i = 0; i < NODES; ++i)
+		randomTransform(&changes[i]);
+
+	static const double rates[] = {0.0, 0.01, 0.1, 1.0};
+	int failed = 0;
+	printf("%d nodes in trees of %d, %d frames each\n", NODES, CHAIN, FRAMES);
+	printf("  %-10s %12s %10s %12s %10s %8s\n", "changed", "recomputed", "ms/frame", "full ms", "speedup", "worlds");
+	for (int r = 0; r < 4; ++r)
+	{
+		double rate = rates[r];
+		int changesPerFrame = (int)(NODES * rate);
+		double incrementalMs = 0.0, fullMs = 0.0;
+		unsigned long recomputed = 0;
+		int same = 1;
+
+		for (int frame = 0; frame < FRAMES; ++frame)
+		{
+			for (int c = 0; c < changesPerFrame; ++c)
+				changed[c] = rate < 1.0 ? rand() % NODES : c;
+
+			double start = now();
+			for (int c = 0; c < changesPerFrame; ++c)
+				sceneGraphSetLocal(&graph, changed[c], &changes[(changed[c] + frame) % NODES]);
+			recomputed += sceneGraphUpdate(&graph);
+			incrementalMs += now() - start;
+
+			// The same frame recomputed from scratch
+			memcpy(full, graph.world, NODES * sizeof(mat4x4));
+			start = now();
+			markAll(&graph);
+			sceneGraphUpdate(&graph);
+			fullMs += now() - start;
+			same &= memcmp(full, graph.world, NODES * sizeof(mat4x4)) == 0;
+		}
+
+		char label[16];
+		snprintf(label, sizeof(label), "%g%%", rate * 100.0);
+		char speedup[16] = "-";
+		if (recomputed)
+			snprintf(speedup, sizeof(speedup), "%.1fx", fullMs / incrementalMs);
+		printf("  %-10s %12lu %10.3f %12.3f %10s %8s\n", label, recomputed / FRAMES, incrementalMs / FRAMES,
+			fullMs / FRAMES, speedup, same ? "same" : "DIFFERENT");
+		failed |= !same;
+	}
+
+	sceneGraphFree(&graph);
+	return failed;
+}
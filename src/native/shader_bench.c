@@ -0,0 +1,127 @@
+// Startup cost of shader variants against the GL stub's simulated compiler.
+//
+// For a growing number of variants, each requested by two materials, compares
+// checking every program right after creating it (blocking on the compiler
+// for each one in turn) with creating all of them up front and polling
+// GL_COMPLETION_STATUS_KHR between frames. Reported are the shaders actually
+// compiled, the time the main thread was blocked and the time until every
+// program was usable.
+//
+// NATIVE_COMPILE_MS and NATIVE_LINK_MS set the simulated cost per shader
+// compile and program link (default 2 and 3 ms).
+#include "gl_stub.h"
+#include "../shader_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MATERIALS_PER_VARIANT 2
+#define FRAME_MS 1.0 // Other startup work done between readiness polls
+
+static const char *vertex_text =
+	"#version 100\n"
+	"uniform mat4 MVP;\n"
+	"attribute vec2 vPos;\n"
+	"void main()\n"
+	"{\n"
+	"    gl_Position = MVP * vec4(vPos * float(VARIANT + 1), 0.0, 1.0);\n"
+	"}\n";
+static const char *fragment_text =
+	"#version 100\n"
+	"void main()\n"
+	"{\n"
+	"    gl_FragColor = vec4(1.0);\n"
+	"}\n";
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static void busy(double ms)
+{
+	double end = now() + ms;
+	while (now() < end)
+		;
+}
+
+static double envDouble(const char *name, double fallback)
+{
+	const char *value = getenv(name);
+	return value && *value ? atof(value) : fallback;
+}
+
+// Requests every material's program. Blocking checks each one right away.
+static void createVariants(GLuint *programs, int variants, int blocking)
+{
+	for (int m = 0; m < MATERIALS_PER_VARIANT; ++m)
+	{
+		for (int v = 0; v < variants; ++v)
+		{
+			char defines[32];
+			snprintf(defines, sizeof(defines), "#define VARIANT %d\n", v);
+			programs[v] = shaderCacheProgram(vertex_text, defines, fragment_text, NULL);
+			if (blocking)
+				shaderCacheCheckProgram(programs[v]);
+		}
+	}
+}
+
+// Returns {main thread blocked, time until all programs are usable} in ms
+static void run(int variants, int blocking, double result[2], ShaderCacheStats *stats)
+{
+	GLuint programs[variants];
+	shaderCacheInit(!blocking);
+	shaderCacheBindAttrib(0, "vPos");
+
+	double waitBefore = glStubCompileWaitMs();
+	double start = now();
+	createVariants(programs, variants, blocking);
+
+	int pending = variants;
+	while (pending)
+	{
+		pending = 0;
+		for (int v = 0; v < variants; ++v)
+		{
+			if (!shaderCacheProgramReady(programs[v]))
+				++pending;
+			else
+				shaderCacheCheckProgram(programs[v]);
+		}
+		if (pending)
+			busy(FRAME_MS);
+	}
+
+	result[0] = glStubCompileWaitMs() - waitBefore;
+	result[1] = now() - start;
+	shaderCacheGetStats(stats);
+	shaderCacheFree();
+}
+
+int main()
+{
+	double compileMs = envDouble("NATIVE_COMPILE_MS", 2.0);
+	double linkMs = envDouble("NATIVE_LINK_MS", 3.0);
+	glStubSetCompileCost(compileMs, linkMs);
+
+	printf("Simulated compile %.1f ms, link %.1f ms, %d materials per variant\n", compileMs, linkMs, MATERIALS_PER_VARIANT);
+	printf("%8s %9s %7s %12s %12s %12s %12s\n", "variants", "compiled", "reused",
+		"block:stall", "block:ready", "async:stall", "async:ready");
+
+	for (int variants = 1; variants <= 64; variants *= 2)
+	{
+		double blocking[2], deferred[2];
+		ShaderCacheStats stats;
+		run(variants, 1, blocking, &stats);
+		run(variants, 0, deferred, &stats);
+		printf("%8d %9u %7u %9.1f ms %9.1f ms %9.1f ms %9.1f ms\n", variants,
+			stats.shadersCompiled, stats.shaderHits,
+			blocking[0], blocking[1], deferred[0], deferred[1]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,175 @@
+// Fixed timestep simulation over 1M ticks.
+//
+// Drives the simulation clock with deterministic frame time sequences at
+// different frame rates (steady 60 Hz, jittered 90 Hz, steady 144 Hz and one
+// with stalls) and steps a small scene once per tick, integrating each
+// object's spin, then interpolates the world matrices once per frame. Reports
+// the tick throughput of each run, per frame interpolation included, and of
+// the clock alone.
+//
+// It fails unless every run ends in exactly the same state after 1M ticks,
+// however the ticks were spread over frames, the same run repeated gives the
+// same state, and the clock accounts for all real time it was given.
+#include "../scene.h"
+#include "../sim_clock.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TICKS 1000000ULL
+#define OBJECTS 16
+#define STEP_MS (1000.0 / 60.0)
+#define MAX_TICKS 8
+
+typedef struct Run
+{
+	const char *name;
+	double frameMs;
+	int jitter; // Frame times vary by up to +-25%
+	int stalls; // Every 1000th frame takes 200 ms
+} Run;
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+// Deterministic, so runs can be repeated exactly
+static unsigned gRandom;
+static double nextRandom()
+{
+	gRandom = gRandom * 1664525u + 1013904223u;
+	return (gRandom >> 8) / (double)(1u << 24);
+}
+
+static void initScene(Scene *scene, quat *spin)
+{
+	vec3 axis = {0.3f, 1.0f, 0.2f};
+	vec3_norm(axis, axis);
+	for (int i = 0; i < OBJECTS; ++i)
+	{
+		vec3 p = {(float)i, 0.0f, -4.0f};
+		quat q;
+		quat_identity(q);
+		sceneAdd(scene, p, q, 1.0f, 1.0f);
+
+		// Radians per tick, a different rate per object
+		quat_rotate(spin[i], (float)(STEP_MS / 1000.0) * (1.0f + 0.1f * i), axis);
+	}
+}
+
+// Steps the scene tick by tick until the clock has done TICKS. Returns
+// wall milliseconds spent.
+static double simulate(const Run *run, Scene *scene, quat *spin, SimClock *clock, unsigned long *frames, double *realMs)
+{
+	simClockInit(clock, STEP_MS, MAX_TICKS);
+	gRandom = 1;
+	double t = 0.0;
+	simClockAdvance(clock, t);
+	unsigned long long done = 0;
+	*frames = 0;
+
+	double start = now();
+	while (done < TICKS)
+	{
+		double frameMs = run->frameMs;
+		if (run->jitter)
+			frameMs *= 0.75 + 0.5 * nextRandom();
+		if (run->stalls && *frames % 1000 == 999)
+			frameMs = 200.0;
+		t += frameMs;
+		++*frames;
+
+		int ticks = simClockAdvance(clock, t);
+		if (done + ticks > TICKS)
+			ticks = (int)(TICKS - done);
+		for (int tick = 0; tick < ticks; ++tick)
+		{
+			for (int i = 0; i < OBJECTS; ++i)
+			{
+				// quat_mul does not allow its output to alias an input
+				memcpy(scene->previousRotation[i], scene->rotation[i], sizeof(quat));
+				quat_mul(scene->rotation[i], spin[i], scene->previousRotation[i]);
+				quat_norm(scene->rotation[i], scene->rotation[i]);
+			}
+		}
+		done += ticks;
+		sceneUpdateWorldInterpolated(scene, simClockAlpha(clock), 0, OBJECTS);
+	}
+	*realMs = t;
+	return now() - start;
+}
+
+int main()
+{
+	static const Run runs[] =
+	{
+		{"60 Hz", 1000.0 / 60.0, 0, 0},
+		{"90 Hz jittered", 1000.0 / 90.0, 1, 0},
+		{"144 Hz", 1000.0 / 144.0, 0, 0},
+		{"90 Hz stalls", 1000.0 / 90.0, 1, 1},
+		{"90 Hz jittered", 1000.0 / 90.0, 1, 0}, // Repeated, must match the first
+	};
+	int runCount = sizeof(runs) / sizeof(runs[0]);
+	int failed = 0;
+	quat spin[OBJECTS];
+	quat reference[OBJECTS];
+
+	printf("%llu ticks of %.2f ms, %d objects\n", TICKS, STEP_MS, OBJECTS);
+	printf("  %-16s %9s %10s %10s %12s %s\n", "run", "frames", "wall ms", "Mticks/s", "ns/obj tick", "state");
+	for (int r = 0; r < runCount; ++r)
+	{
+		Scene scene;
+		if (!sceneInit(&scene, OBJECTS))
+		{
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+		initScene(&scene, spin);
+
+		SimClock clock;
+		unsigned long frames;
+		double realMs;
+		double ms = simulate(&runs[r], &scene, spin, &clock, &frames, &realMs);
+
+		// Every millisecond handed to the clock is simulated, skipped or
+		// still in the accumulator
+		double accounted = clock.ticks * STEP_MS + clock.droppedMs + clock.accumulatorMs;
+		int timeOk = fabs(accounted - realMs) < 1e-6 * realMs;
+
+		int same = 1;
+		if (r == 0)
+			memcpy(reference, scene.rotation, sizeof(reference));
+		else
+			same = memcmp(reference, scene.rotation, sizeof(reference)) == 0;
+
+		printf("  %-16s %9lu %10.1f %10.2f %12.2f %s%s\n", runs[r].name, frames, ms, TICKS / ms / 1000.0,
+			ms * 1e6 / ((double)TICKS * OBJECTS), same ? "identical" : "DIFFERENT",
+			timeOk ? "" : ", time lost");
+		if (clock.droppedMs > 0.0)
+			printf("    %.0f ms of stalls skipped\n", clock.droppedMs);
+		failed |= !same || !timeOk;
+		sceneFree(&scene);
+	}
+
+	// The clock on its own, one tick per frame
+	SimClock clock;
+	simClockInit(&clock, STEP_MS, MAX_TICKS);
+	simClockAdvance(&clock, 0.0);
+	double start = now();
+	volatile float sink = 0.0f;
+	for (unsigned long long i = 1; i <= TICKS; ++i)
+	{
+		simClockAdvance(&clock, i * STEP_MS);
+		sink += simClockAlpha(&clock);
+	}
+	double ms = now() - start;
+	printf("  clock only: %.2f ns per advance, %llu ticks\n", ms * 1e6 / TICKS, clock.ticks);
+	failed |= clock.ticks != TICKS;
+
+	return failed;
+}
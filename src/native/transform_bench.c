@@ -0,0 +1,177 @@
+// Hierarchical transform update with matrices and with rigid transforms.
+//
+// Builds 100k nodes in chains of up to 64, each node with a local translation,
+// rotation and uniform scale relative to its parent, and computes every world
+// transform parent first, the way a scene graph update does:
+//   - matrix, rotate: local from mat4x4_translate and the general
+//     mat4x4_rotate, times the parent world with mat4x4_mul
+//   - matrix, quat: local built from the quaternion directly, then mat4x4_mul
+//   - transform: transformCompose with the parent, converted to a mat4x4
+//     per node as for upload
+//   - transform, no upload: transformCompose only, for nodes such as joints
+//     whose world matrix is never drawn
+//
+// It fails if the paths disagree on any world matrix.
+#include "../transform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NODES 100000
+#define CHAIN 64 // Nodes per tree, so scales do not compound without bound
+#define RUNS 20
+
+typedef struct Node
+{
+	int parent; // -1 for roots, otherwise a lower index
+	vec3 position;
+	vec3 axis;
+	float angle;
+	float scale;
+	Transform local;
+} Node;
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static float randomRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static void matrixRotate(Node *nodes, mat4x4 *world)
+{
+	for (int i = 0; i < NODES; ++i)
+	{
+		Node *n = &nodes[i];
+		mat4x4 local;
+		mat4x4_translate(local, n->position[0], n->position[1], n->position[2]);
+		mat4x4_rotate(local, local, n->axis[0], n->axis[1], n->axis[2], n->angle);
+		mat4x4_scale_aniso(local, local, n->scale, n->scale, n->scale);
+		if (n->parent < 0)
+			mat4x4_dup(world[i], local);
+		else
+			mat4x4_mul(world[i], world[n->parent], local);
+	}
+}
+
+static void matrixQuat(Node *nodes, mat4x4 *world)
+{
+	for (int i = 0; i < NODES; ++i)
+	{
+		Node *n = &nodes[i];
+		mat4x4 local;
+		transformToMat4x4(local, &n->local);
+		if (n->parent < 0)
+			mat4x4_dup(world[i], local);
+		else
+			mat4x4_mul(world[i], world[n->parent], local);
+	}
+}
+
+static void composeOnly(Node *nodes, Transform *world)
+{
+	for (int i = 0; i < NODES; ++i)
+	{
+		Node *n = &nodes[i];
+		if (n->parent < 0)
+			world[i] = n->local;
+		else
+			transformCompose(&world[i], &world[n->parent], &n->local);
+	}
+}
+
+static void composeUpload(Node *nodes, Transform *world, mat4x4 *matrices)
+{
+	composeOnly(nodes, world);
+	for (int i = 0; i < NODES; ++i)
+		transformToMat4x4(matrices[i], &world[i]);
+}
+
+// Largest element difference relative to the largest element of a
+static float maxDifference(mat4x4 *a, mat4x4 *b)
+{
+	float worst = 0.f;
+	for (int i = 0; i < NODES; ++i)
+	{
+		float scale = 1.f, diff = 0.f;
+		for (int c = 0; c < 4; ++c)
+			for (int r = 0; r < 4; ++r)
+			{
+				scale = fmaxf(scale, fabsf(a[i][c][r]));
+				diff = fmaxf(diff, fabsf(a[i][c][r] - b[i][c][r]));
+			}
+		worst = fmaxf(worst, diff / scale);
+	}
+	return worst;
+}
+
+int main()
+{
+	Node *nodes = malloc(NODES * sizeof(Node));
+	mat4x4 *byRotate = malloc(NODES * sizeof(mat4x4));
+	mat4x4 *byQuat = malloc(NODES * sizeof(mat4x4));
+	mat4x4 *byTransform = malloc(NODES * sizeof(mat4x4));
+	Transform *world = malloc(NODES * sizeof(Transform));
+	if (!nodes || !byRotate || !byQuat || !byTransform || !world)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	srand(1);
+	for (int i = 0; i < NODES; ++i)
+	{
+		Node *n = &nodes[i];
+		int depth = i % CHAIN;
+		n->parent = depth ? i - 1 - rand() % (depth < 8 ? depth : 8) : -1;
+		for (int k = 0; k < 3; ++k)
+		{
+			n->position[k] = randomRange(-1.f, 1.f);
+			n->axis[k] = randomRange(-1.f, 1.f);
+		}
+		vec3_norm(n->axis, n->axis);
+		n->angle = randomRange(-(float)M_PI, (float)M_PI);
+		n->scale = randomRange(0.9f, 1.1f);
+
+		quat q;
+		quat_rotate(q, n->angle, n->axis);
+		transformSet(&n->local, n->position, q, n->scale);
+	}
+
+	double best[4] = {1e30, 1e30, 1e30, 1e30};
+	for (int run = 0; run < RUNS; ++run)
+	{
+		double t0 = now();
+		matrixRotate(nodes, byRotate);
+		double t1 = now();
+		matrixQuat(nodes, byQuat);
+		double t2 = now();
+		composeUpload(nodes, world, byTransform);
+		double t3 = now();
+		composeOnly(nodes, world);
+		double t4 = now();
+		best[0] = fmin(best[0], t1 - t0);
+		best[1] = fmin(best[1], t2 - t1);
+		best[2] = fmin(best[2], t3 - t2);
+		best[3] = fmin(best[3], t4 - t3);
+	}
+
+	static const char *names[] = {"matrix, rotate", "matrix, quat", "transform", "transform, no upload"};
+	printf("World transforms of %d nodes in chains of %d, best of %d runs\n", NODES, CHAIN, RUNS);
+	printf("  %-22s %10s %10s %8s\n", "path", "ms", "ns/node", "speedup");
+	for (int p = 0; p < 4; ++p)
+		printf("  %-22s %10.3f %10.2f %7.2fx\n", names[p], best[p], best[p] * 1e6 / NODES, best[0] / best[p]);
+
+	float rotateDiff = maxDifference(byTransform, byRotate);
+	float quatDiff = maxDifference(byTransform, byQuat);
+	int ok = rotateDiff < 1e-4f && quatDiff < 1e-4f;
+	printf("  largest relative difference to the transform path: %.2g (rotate), %.2g (quat)%s\n",
+		rotateDiff, quatDiff, ok ? "" : ", MISMATCH");
+	return !ok;
+}
@@ -0,0 +1,218 @@
+// Round trip precision and encode speed of the compact vertex formats.
+//
+// Encodes 100k random vertices (3D position, RGB color) in boxes from 1 cm to
+// 1 km across, some far from the origin, into each format of vertex_format.h,
+// decodes them again and reports bytes per vertex, encode throughput and the
+// worst position and color error. Half floats are also checked exhaustively:
+// every half must survive decode and encode unchanged, and random floats
+// must round to the nearest half.
+//
+// It fails if a layout is not 4 byte aligned, a 16-bit position is off by
+// more than half a step of its box, a half float by more than half an ulp of
+// its position relative to the box, a color by more than half a step of 255,
+// or the dequantization matrix does not give the decoded position.
+#include "../vertex_format.h"
+
+#include <GLES2/gl2ext.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define VERTICES 100000
+#define FLOATS 6 // Position and color per source vertex
+#define RUNS 10
+
+typedef struct Box
+{
+	const char *name;
+	float center, extent;
+} Box;
+
+typedef struct Format
+{
+	const char *name;
+	GLenum positionType, colorType;
+} Format;
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static float randomRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// Distance from f to the closest float that is a half
+static double halfError(float f, uint16_t h)
+{
+	return fabs((double)vertexFloatFromHalf(h) - f);
+}
+
+// Every half round trips, and floats round to the nearest half, ties to even
+static int checkHalves()
+{
+	for (uint32_t h = 0; h < 0x10000; ++h)
+	{
+		float f = vertexFloatFromHalf((uint16_t)h);
+		uint16_t back = vertexHalfFromFloat(f);
+		int nan = (h & 0x7c00) == 0x7c00 && (h & 0x3ff);
+		if (nan ? (back & 0x7c00) != 0x7c00 || !(back & 0x3ff) : back != h)
+		{
+			printf("  half 0x%04x came back as 0x%04x\n", (unsigned)h, back);
+			return 0;
+		}
+	}
+
+	srand(2);
+	for (int i = 0; i < 1000000; ++i)
+	{
+		float f = ldexpf(randomRange(-1.f, 1.f), rand() % 44 - 28);
+		uint16_t h = vertexHalfFromFloat(f);
+		double e = halfError(f, h);
+		// Neither neighbor of the same sign is closer; 0x7bff is the largest finite half
+		uint16_t magnitude = h & 0x7fff;
+		if ((magnitude > 0 && halfError(f, h - 1) < e) || (magnitude < 0x7bff && halfError(f, h + 1) < e))
+		{
+			printf("  %.9g rounded to half 0x%04x, not the nearest\n", f, h);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main()
+{
+	static const Box boxes[] =
+	{
+		{"1 cm", 0.f, 0.01f},
+		{"2 m", 0.f, 2.f},
+		{"2 m at 100 m", 100.f, 2.f},
+		{"100 m", 0.f, 100.f},
+		{"1 km", 0.f, 1000.f},
+	};
+	static const Format formats[] =
+	{
+		{"float, float", GL_FLOAT, GL_FLOAT},
+		{"ushort, ubyte", GL_UNSIGNED_SHORT, GL_UNSIGNED_BYTE},
+		{"half, ubyte", GL_HALF_FLOAT_OES, GL_UNSIGNED_BYTE},
+	};
+	int boxCount = sizeof(boxes) / sizeof(boxes[0]);
+	int formatCount = sizeof(formats) / sizeof(formats[0]);
+
+	float *source = malloc(VERTICES * FLOATS * sizeof(float));
+	float *decoded = malloc(VERTICES * FLOATS * sizeof(float));
+	unsigned char *encoded = malloc(VERTICES * FLOATS * sizeof(float));
+	if (!source || !decoded || !encoded)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	int ok = checkHalves();
+	printf("Half float conversion: %s\n", ok ? "exact round trip, nearest rounding" : "FAILED");
+
+	// The triangle's layout in the app
+	VertexFormat triangle;
+	vertexFormatInit(&triangle, GL_UNSIGNED_SHORT, 2, GL_UNSIGNED_BYTE, 3);
+	printf("2D position and RGB color: %d bytes per vertex, 20 as floats\n", triangle.stride);
+	ok &= triangle.stride == 8;
+
+	printf("%d vertices, 3D position and RGB color\n", VERTICES);
+	printf("  %-14s %-14s %6s %8s %12s %14s %10s\n", "box", "format", "bytes", "ratio", "Mvert/s", "position err", "color err");
+	for (int b = 0; b < boxCount; ++b)
+	{
+		srand(1);
+		for (int i = 0; i < VERTICES; ++i)
+		{
+			float *v = source + i * FLOATS;
+			for (int k = 0; k < 3; ++k)
+			{
+				v[k] = boxes[b].center + randomRange(-0.5f, 0.5f) * boxes[b].extent;
+				v[3 + k] = randomRange(0.f, 1.f);
+			}
+		}
+
+		for (int f = 0; f < formatCount; ++f)
+		{
+			VertexFormat format;
+			VertexDequantization dequantization;
+			vertexFormatInit(&format, formats[f].positionType, 3, formats[f].colorType, 3);
+			vertexDequantizationFromBounds(&dequantization, &format, source, FLOATS, VERTICES);
+			int aligned = format.stride % 4 == 0 && format.positionOffset % 4 == 0 && format.colorOffset % 4 == 0;
+
+			double best = 1e30;
+			for (int run = 0; run < RUNS; ++run)
+			{
+				double start = now();
+				vertexFormatEncode(&format, &dequantization, encoded, source, FLOATS, VERTICES);
+				best = fmin(best, now() - start);
+			}
+			vertexFormatDecode(&format, &dequantization, decoded, FLOATS, encoded, VERTICES);
+
+			// Worst error against what the format promises
+			double positionError = 0.0, colorError = 0.0;
+			int withinBound = 1;
+			for (int i = 0; i < VERTICES * FLOATS; ++i)
+			{
+				int k = i % FLOATS;
+				double e = fabs((double)decoded[i] - source[i]);
+				if (k >= 3)
+				{
+					colorError = fmax(colorError, e);
+					withinBound &= e <= 0.5 / 255.0 + 1e-6;
+					continue;
+				}
+				positionError = fmax(positionError, e);
+				double bound;
+				if (format.positionType == GL_UNSIGNED_SHORT)
+					bound = 0.5 * dequantization.scale[k] / 65535.0
+						+ 4.0 * FLT_EPSILON * (fabs(dequantization.offset[k]) + dequantization.scale[k]);
+				else if (format.positionType == GL_HALF_FLOAT_OES)
+					bound = dequantization.scale[k]
+						* fmax(fabs((source[i] - dequantization.offset[k]) / dequantization.scale[k]) * 0x1p-11, 0x1p-25)
+						+ 4.0 * FLT_EPSILON * (fabs(dequantization.offset[k]) + dequantization.scale[k]);
+				else
+					bound = 0.0;
+				withinBound &= e <= bound;
+			}
+
+			// The dequantization matrix applied to the normalized attribute,
+			// as the vertex shader sees it through the world matrix
+			int matrixOk = 1;
+			if (format.positionType != GL_FLOAT)
+			{
+				mat4x4 M;
+				vertexDequantizationMatrix(M, &dequantization);
+				for (int i = 0; i < VERTICES; i += 97)
+				{
+					uint16_t c[3];
+					memcpy(c, encoded + i * format.stride + format.positionOffset, sizeof(c));
+					vec4 n = {1.f, 1.f, 1.f, 1.f}, p;
+					for (int k = 0; k < 3; ++k)
+						n[k] = format.positionType == GL_HALF_FLOAT_OES ? vertexFloatFromHalf(c[k]) : c[k] / 65535.f;
+					mat4x4_mul_vec4(p, M, n);
+					for (int k = 0; k < 3; ++k)
+						matrixOk &= fabsf(p[k] - decoded[i * FLOATS + k]) <= 4.f * FLT_EPSILON * fmaxf(fabsf(p[k]), 1.f);
+				}
+			}
+
+			printf("  %-14s %-14s %6d %7.2fx %12.1f %14.3g %10.3g%s%s%s\n", boxes[b].name, formats[f].name, format.stride,
+				FLOATS * 4.0 / format.stride, VERTICES / best / 1000.0, positionError, colorError * 255.0,
+				aligned ? "" : ", MISALIGNED", withinBound ? "" : ", OUT OF BOUND", matrixOk ? "" : ", MATRIX MISMATCH");
+			ok &= aligned && withinBound && matrixOk;
+		}
+	}
+	printf("  (color error in steps of 1/255)\n");
+
+	free(source);
+	free(decoded);
+	free(encoded);
+	printf("%s\n", ok ? "ok" : "FAILED");
+	return !ok;
+}
@@ -0,0 +1,492 @@
+#include "occlusion.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+int occlusionInit(OcclusionBuffer *buffer, int width, int height)
+{
+	memset(buffer, 0, sizeof(*buffer));
+	buffer->width = width;
+	buffer->height = height;
+	buffer->tilesX = width / OCCLUSION_TILE;
+	buffer->tilesY = height / OCCLUSION_TILE;
+	int tiles = buffer->tilesX * buffer->tilesY;
+	buffer->depth = malloc(width * height * sizeof(float));
+	buffer->tileNear = malloc(tiles * sizeof(float));
+	buffer->tileFar = malloc(tiles * sizeof(float));
+	if (!buffer->depth || !buffer->tileNear || !buffer->tileFar)
+	{
+		occlusionFree(buffer);
+		return 0;
+	}
+	return 1;
+}
+
+void occlusionFree(OcclusionBuffer *buffer)
+{
+	free(buffer->depth);
+	free(buffer->tileNear);
+	free(buffer->tileFar);
+	buffer->depth = buffer->tileNear = buffer->tileFar = NULL;
+}
+
+static void clear(OcclusionBuffer *buffer)
+{
+	// All zero bits are 0.f, nothing in the way
+	memset(buffer->depth, 0, buffer->width * buffer->height * sizeof(float));
+	++buffer->stats.frames;
+}
+
+void occlusionBeginFrame(OcclusionBuffer *buffer, mat4x4 projection, mat4x4 view)
+{
+	mat4x4_mul(buffer->viewProjection, projection, view);
+	buffer->parallax[0] = buffer->parallax[1] = 0.0f;
+	clear(buffer);
+}
+
+void occlusionBeginStereo(OcclusionBuffer *buffer, mat4x4 leftProjection, mat4x4 leftView,
+	mat4x4 rightProjection, mat4x4 rightView)
+{
+	mat4x4 left, right, center, view;
+	mat4x4_invert_rigid(left, leftView);
+	mat4x4_invert_rigid(right, rightView);
+	mat4x4_dup(center, left);
+	vec3 offset;
+	for (int i = 0; i < 3; ++i)
+	{
+		center[3][i] = 0.5f * (left[3][i] + right[3][i]);
+		offset[i] = 0.5f * (right[3][i] - left[3][i]);
+	}
+	mat4x4_invert_rigid(view, center);
+
+	// Tangents of the frustum sides of a glFrustum style projection, the
+	// widest of both eyes
+	float tangents[4] = {0.0f, 0.0f, 0.0f, 0.0f}; // Left, right, bottom, top
+	mat4x4 *projections[2] = {(mat4x4 *)leftProjection, (mat4x4 *)rightProjection};
+	for (int e = 0; e < 2; ++e)
+	{
+		mat4x4 *P = projections[e];
+		tangents[0] = fminf(tangents[0], ((*P)[2][0] - 1.0f) / (*P)[0][0]);
+		tangents[1] = fmaxf(tangents[1], ((*P)[2][0] + 1.0f) / (*P)[0][0]);
+		tangents[2] = fminf(tangents[2], ((*P)[2][1] - 1.0f) / (*P)[1][1]);
+		tangents[3] = fmaxf(tangents[3], ((*P)[2][1] + 1.0f) / (*P)[1][1]);
+	}
+	// Only x, y and w are used, the far plane does not matter
+	mat4x4 projection;
+	float n = OCCLUSION_NEAR;
+	mat4x4_frustum(projection, tangents[0] * n, tangents[1] * n, tangents[2] * n, tangents[3] * n, n, 1000.0f * n);
+	mat4x4_mul(buffer->viewProjection, projection, view);
+
+	// The eyes are offset from the center eye along its own axes
+	buffer->parallax[0] = fabsf(vec3_mul_inner(center[0], offset)) * projection[0][0] * 0.5f * buffer->width;
+	buffer->parallax[1] = fabsf(vec3_mul_inner(center[1], offset)) * projection[1][1] * 0.5f * buffer->height;
+	clear(buffer);
+}
+
+// x, y and w in clip space
+typedef float ClipVertex[3];
+
+// Fills the pixels whose center is inside the triangle with the farthest
+// depth of its plane over the pixel, where that is nearer than what they have.
+// Bit k of outer pulls in the edge opposite vertex k by the parallax.
+static void drawTriangle(OcclusionBuffer *buffer, const ClipVertex *clip, int outer)
+{
+	float x[3], y[3], z[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		z[i] = 1.0f / clip[i][2];
+		x[i] = (clip[i][0] * z[i] * 0.5f + 0.5f) * buffer->width;
+		y[i] = (clip[i][1] * z[i] * 0.5f + 0.5f) * buffer->height;
+	}
+
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(fabsf(area) > 0.0f))
+		return;
+	if (area < 0.0f)
+	{
+		float t;
+		t = x[1], x[1] = x[2], x[2] = t;
+		t = y[1], y[1] = y[2], y[2] = t;
+		t = z[1], z[1] = z[2], z[2] = t;
+		area = -area;
+		outer = (outer & 1) | (outer & 2) << 1 | (outer & 4) >> 1;
+	}
+
+	float minX = fmaxf(fminf(fminf(x[0], x[1]), x[2]), 0.0f);
+	float maxX = fminf(fmaxf(fmaxf(x[0], x[1]), x[2]), (float)buffer->width);
+	float minY = fmaxf(fminf(fminf(y[0], y[1]), y[2]), 0.0f);
+	float maxY = fminf(fmaxf(fmaxf(y[0], y[1]), y[2]), (float)buffer->height);
+	if (!(minX < maxX && minY < maxY))
+		return;
+	// Whole blocks of four pixels, the width is a multiple of four
+	int x0 = (int)minX & ~3, x1 = (int)ceilf(maxX);
+	int y0 = (int)minY, y1 = (int)ceilf(maxY);
+
+	// Edge k, from vertex k + 1 to k + 2, is area times the barycentric
+	// weight of vertex k: positive inside
+	float a[3], b[3], c[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		int i = (k + 1) % 3, j = (k + 2) % 3;
+		a[k] = y[i] - y[j];
+		b[k] = x[j] - x[i];
+		c[k] = x[i] * y[j] - y[i] * x[j];
+	}
+	float za = (a[0] * z[0] + a[1] * z[1] + a[2] * z[2]) / area;
+	float zb = (b[0] * z[0] + b[1] * z[1] + b[2] * z[2]) / area;
+	float zc = (c[0] * z[0] + c[1] * z[1] + c[2] * z[2]) / area;
+	// From the center of a pixel to its farthest corner
+	zc -= 0.5f * (fabsf(za) + fabsf(zb));
+
+	// Edges move on screen by at most the parallax of the nearest vertex
+	float nearest = fmaxf(fmaxf(z[0], z[1]), z[2]);
+	float shiftX = buffer->parallax[0] * nearest + 0.5f, shiftY = buffer->parallax[1] * nearest + 0.5f;
+	for (int k = 0; k < 3; ++k)
+	{
+		if (outer & 1 << k)
+			c[k] -= fabsf(a[k]) * shiftX + fabsf(b[k]) * shiftY;
+	}
+
+	for (int py = y0; py < y1; ++py)
+	{
+		float *row = buffer->depth + py * buffer->width;
+		float cy = py + 0.5f;
+#if LINMATH_SIMD
+		lm4 zero = LM4_SPLAT(0.0f);
+		lm4 cx = LM4_ADD(LM4_SPLAT(x0 + 0.5f), LM4_SET(0.0f, 1.0f, 2.0f, 3.0f));
+		lm4 e0 = LM4_ADD(LM4_MUL(LM4_SPLAT(a[0]), cx), LM4_SPLAT(b[0] * cy + c[0]));
+		lm4 e1 = LM4_ADD(LM4_MUL(LM4_SPLAT(a[1]), cx), LM4_SPLAT(b[1] * cy + c[1]));
+		lm4 e2 = LM4_ADD(LM4_MUL(LM4_SPLAT(a[2]), cx), LM4_SPLAT(b[2] * cy + c[2]));
+		lm4 d = LM4_ADD(LM4_MUL(LM4_SPLAT(za), cx), LM4_SPLAT(zb * cy + zc));
+		lm4 step0 = LM4_SPLAT(4.0f * a[0]), step1 = LM4_SPLAT(4.0f * a[1]), step2 = LM4_SPLAT(4.0f * a[2]);
+		lm4 stepD = LM4_SPLAT(4.0f * za);
+		for (int px = x0; px < x1; px += 4)
+		{
+			lm4 outside = LM4_OR(LM4_OR(LM4_CMPLT(e0, zero), LM4_CMPLT(e1, zero)), LM4_CMPLT(e2, zero));
+			LM4_STORE(row + px, LM4_MAX(LM4_LOAD(row + px), LM4_ANDNOT(outside, d)));
+			e0 = LM4_ADD(e0, step0);
+			e1 = LM4_ADD(e1, step1);
+			e2 = LM4_ADD(e2, step2);
+			d = LM4_ADD(d, stepD);
+		}
+#else
+		for (int px = x0; px < x1; ++px)
+		{
+			float cx = px + 0.5f;
+			if (a[0] * cx + b[0] * cy + c[0] < 0.0f || a[1] * cx + b[1] * cy + c[1] < 0.0f
+				|| a[2] * cx + b[2] * cy + c[2] < 0.0f)
+			{
+				continue;
+			}
+			float d = za * cx + zb * cy + zc;
+			if (d > row[px])
+				row[px] = d;
+		}
+#endif
+	}
+	++buffer->stats.rasterized;
+}
+
+// Clips the triangle to w >= OCCLUSION_NEAR, which leaves up to two. Their
+// edges are all outer ones, what they shared is not known anymore.
+static void clipTriangle(OcclusionBuffer *buffer, const ClipVertex *triangle, int outer)
+{
+	int inside = (triangle[0][2] >= OCCLUSION_NEAR) + (triangle[1][2] >= OCCLUSION_NEAR)
+		+ (triangle[2][2] >= OCCLUSION_NEAR);
+	if (inside == 3)
+	{
+		drawTriangle(buffer, triangle, outer);
+		return;
+	}
+	if (!inside)
+		return;
+
+	ClipVertex polygon[4];
+	int n = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		const float *p = triangle[i], *q = triangle[(i + 1) % 3];
+		if (p[2] >= OCCLUSION_NEAR)
+			memcpy(polygon[n++], p, sizeof(ClipVertex));
+		if ((p[2] >= OCCLUSION_NEAR) != (q[2] >= OCCLUSION_NEAR))
+		{
+			float t = (OCCLUSION_NEAR - p[2]) / (q[2] - p[2]);
+			polygon[n][0] = p[0] + (q[0] - p[0]) * t;
+			polygon[n][1] = p[1] + (q[1] - p[1]) * t;
+			polygon[n][2] = OCCLUSION_NEAR;
+			++n;
+		}
+	}
+	drawTriangle(buffer, polygon, 7);
+	if (n == 4)
+	{
+		ClipVertex second[3];
+		memcpy(second[0], polygon[0], sizeof(ClipVertex));
+		memcpy(second[1], polygon[2], sizeof(ClipVertex));
+		memcpy(second[2], polygon[3], sizeof(ClipVertex));
+		drawTriangle(buffer, second, 7);
+	}
+}
+
+static int compareEdges(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+	return x < y ? -1 : x > y;
+}
+
+int occluderMeshInit(OccluderMesh *mesh, const float *positions, int stride, const unsigned short *indices,
+	int indexCount)
+{
+	int triangles = indexCount > 0 ? indexCount / 3 : 0;
+	mesh->positions = positions;
+	mesh->stride = stride;
+	mesh->indices = indices;
+	mesh->indexCount = 3 * triangles;
+	mesh->outerEdges = malloc(triangles + 1);
+	// Edges as their lower and higher vertex index, then where they are
+	unsigned long long *edges = malloc((3 * triangles + 1) * sizeof(unsigned long long));
+	if (!mesh->outerEdges || !edges)
+	{
+		free(edges);
+		occluderMeshFree(mesh);
+		return 0;
+	}
+
+	for (int e = 0; e < 3 * triangles; ++e)
+	{
+		int t = e / 3, k = e % 3;
+		unsigned long long i = indices[3 * t + (k + 1) % 3], j = indices[3 * t + (k + 2) % 3];
+		edges[e] = (i < j ? i << 48 | j << 32 : j << 48 | i << 32) | (unsigned long long)e;
+	}
+	qsort(edges, 3 * triangles, sizeof(unsigned long long), compareEdges);
+
+	memset(mesh->outerEdges, 7, triangles);
+	for (int e = 0; e < 3 * triangles; ++e)
+	{
+		int shared = (e > 0 && edges[e - 1] >> 32 == edges[e] >> 32)
+			|| (e + 1 < 3 * triangles && edges[e + 1] >> 32 == edges[e] >> 32);
+		if (shared)
+		{
+			int where = (int)(edges[e] & 0xffffffffu);
+			mesh->outerEdges[where / 3] &= ~(1 << where % 3);
+		}
+	}
+	free(edges);
+	return 1;
+}
+
+void occluderMeshFree(OccluderMesh *mesh)
+{
+	free(mesh->outerEdges);
+	mesh->outerEdges = NULL;
+}
+
+void occlusionRasterize(OcclusionBuffer *buffer, mat4x4 world, const OccluderMesh *mesh)
+{
+	mat4x4 M;
+	mat4x4_mul(M, buffer->viewProjection, world);
+	for (int i = 0; i < mesh->indexCount; i += 3)
+	{
+		ClipVertex triangle[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			const float *p = mesh->positions + mesh->indices[i + k] * mesh->stride;
+			triangle[k][0] = M[0][0] * p[0] + M[1][0] * p[1] + M[2][0] * p[2] + M[3][0];
+			triangle[k][1] = M[0][1] * p[0] + M[1][1] * p[1] + M[2][1] * p[2] + M[3][1];
+			triangle[k][2] = M[0][3] * p[0] + M[1][3] * p[1] + M[2][3] * p[2] + M[3][3];
+		}
+		clipTriangle(buffer, triangle, mesh->outerEdges[i / 3]);
+		++buffer->stats.triangles;
+	}
+}
+
+void occlusionFinish(OcclusionBuffer *buffer)
+{
+	float nearest = 0.0f;
+	for (int ty = 0; ty < buffer->tilesY; ++ty)
+	{
+		for (int tx = 0; tx < buffer->tilesX; ++tx)
+		{
+			const float *tile = buffer->depth + ty * OCCLUSION_TILE * buffer->width + tx * OCCLUSION_TILE;
+			float tileNear, tileFar;
+#if LINMATH_SIMD
+			lm4 n = LM4_LOAD(tile), f = n;
+			for (int y = 0; y < OCCLUSION_TILE; ++y)
+			{
+				for (int x = 0; x < OCCLUSION_TILE; x += 4)
+				{
+					lm4 d = LM4_LOAD(tile + y * buffer->width + x);
+					n = LM4_MAX(n, d);
+					f = LM4_MIN(f, d);
+				}
+			}
+			float ns[4], fs[4];
+			LM4_STORE(ns, n);
+			LM4_STORE(fs, f);
+			tileNear = fmaxf(fmaxf(ns[0], ns[1]), fmaxf(ns[2], ns[3]));
+			tileFar = fminf(fminf(fs[0], fs[1]), fminf(fs[2], fs[3]));
+#else
+			tileNear = tileFar = tile[0];
+			for (int y = 0; y < OCCLUSION_TILE; ++y)
+			{
+				for (int x = 0; x < OCCLUSION_TILE; ++x)
+				{
+					float d = tile[y * buffer->width + x];
+					tileNear = fmaxf(tileNear, d);
+					tileFar = fminf(tileFar, d);
+				}
+			}
+#endif
+			buffer->tileNear[ty * buffer->tilesX + tx] = tileNear;
+			buffer->tileFar[ty * buffer->tilesX + tx] = tileFar;
+			nearest = fmaxf(nearest, tileNear);
+		}
+	}
+	buffer->nearest = nearest;
+}
+
+#if LINMATH_SIMD
+// Clip space x, y and 1 / w of four corners of a box sharing their z
+typedef struct BoxFace
+{
+	lm4 x, y, iw;
+} BoxFace;
+
+static int projectFace(mat4x4 const M, lm4 x, lm4 y, float z, BoxFace *face)
+{
+	lm4 w = LM4_ADD(LM4_ADD(LM4_MUL(LM4_SPLAT(M[0][3]), x), LM4_MUL(LM4_SPLAT(M[1][3]), y)),
+		LM4_SPLAT(M[2][3] * z + M[3][3]));
+	if (LM4_ANY(LM4_CMPLT(w, LM4_SPLAT(OCCLUSION_NEAR))))
+		return 0;
+	face->iw = LM4_DIV(LM4_SPLAT(1.0f), w);
+	face->x = LM4_MUL(LM4_ADD(LM4_ADD(LM4_MUL(LM4_SPLAT(M[0][0]), x), LM4_MUL(LM4_SPLAT(M[1][0]), y)),
+		LM4_SPLAT(M[2][0] * z + M[3][0])), face->iw);
+	face->y = LM4_MUL(LM4_ADD(LM4_ADD(LM4_MUL(LM4_SPLAT(M[0][1]), x), LM4_MUL(LM4_SPLAT(M[1][1]), y)),
+		LM4_SPLAT(M[2][1] * z + M[3][1])), face->iw);
+	return 1;
+}
+
+static float lowest(lm4 v)
+{
+	float f[4];
+	LM4_STORE(f, v);
+	return fminf(fminf(f[0], f[1]), fminf(f[2], f[3]));
+}
+
+static float highest(lm4 v)
+{
+	float f[4];
+	LM4_STORE(f, v);
+	return fmaxf(fmaxf(f[0], f[1]), fmaxf(f[2], f[3]));
+}
+#endif
+
+// Screen rectangle in pixels (min x, min y, max x, max y) and the largest
+// 1 / w of the box's corners. Returns 0 if a corner is behind the near plane.
+static int projectBox(const OcclusionBuffer *buffer, const vec3 lo, const vec3 hi, float rect[4], float *boxNear)
+{
+	mat4x4 const *M = (mat4x4 const *)buffer->viewProjection;
+	float ndc[4];
+#if LINMATH_SIMD
+	// Four corners at a time, the face at lo[2] and the one at hi[2]
+	lm4 x = LM4_SET(lo[0], hi[0], lo[0], hi[0]);
+	lm4 y = LM4_SET(lo[1], lo[1], hi[1], hi[1]);
+	BoxFace a, b;
+	if (!projectFace(*M, x, y, lo[2], &a) || !projectFace(*M, x, y, hi[2], &b))
+		return 0;
+	ndc[0] = lowest(LM4_MIN(a.x, b.x));
+	ndc[1] = lowest(LM4_MIN(a.y, b.y));
+	ndc[2] = highest(LM4_MAX(a.x, b.x));
+	ndc[3] = highest(LM4_MAX(a.y, b.y));
+	*boxNear = highest(LM4_MAX(a.iw, b.iw));
+#else
+	ndc[0] = ndc[1] = INFINITY;
+	ndc[2] = ndc[3] = -INFINITY;
+	*boxNear = 0.0f;
+	for (int i = 0; i < 8; ++i)
+	{
+		float x = i & 1 ? hi[0] : lo[0], y = i & 2 ? hi[1] : lo[1], z = i & 4 ? hi[2] : lo[2];
+		float w = (*M)[0][3] * x + (*M)[1][3] * y + (*M)[2][3] * z + (*M)[3][3];
+		if (w < OCCLUSION_NEAR)
+			return 0;
+		float iw = 1.0f / w;
+		for (int k = 0; k < 2; ++k)
+		{
+			float s = ((*M)[0][k] * x + (*M)[1][k] * y + (*M)[2][k] * z + (*M)[3][k]) * iw;
+			ndc[k] = fminf(ndc[k], s);
+			ndc[k + 2] = fmaxf(ndc[k + 2], s);
+		}
+		*boxNear = fmaxf(*boxNear, iw);
+	}
+#endif
+	rect[0] = (ndc[0] * 0.5f + 0.5f) * buffer->width;
+	rect[1] = (ndc[1] * 0.5f + 0.5f) * buffer->height;
+	rect[2] = (ndc[2] * 0.5f + 0.5f) * buffer->width;
+	rect[3] = (ndc[3] * 0.5f + 0.5f) * buffer->height;
+	return 1;
+}
+
+int occlusionTestBox(const OcclusionBuffer *buffer, const vec3 lo, const vec3 hi)
+{
+	float rect[4], boxNear;
+	if (!projectBox(buffer, lo, hi, rect, &boxNear))
+		return 1;
+	// Nothing in front of the box at all
+	if (boxNear >= buffer->nearest)
+		return 1;
+
+	// Widened by a pixel
+	if (!(rect[0] >= 1.0f && rect[1] >= 1.0f && rect[2] + 1.0f <= buffer->width && rect[3] + 1.0f <= buffer->height))
+		return 1;
+	int x0 = (int)(rect[0] - 1.0f), y0 = (int)(rect[1] - 1.0f);
+	int x1 = (int)ceilf(rect[2] + 1.0f), y1 = (int)ceilf(rect[3] + 1.0f);
+	if (x1 > buffer->width)
+		x1 = buffer->width;
+	if (y1 > buffer->height)
+		y1 = buffer->height;
+
+	for (int ty = y0 / OCCLUSION_TILE; ty <= (y1 - 1) / OCCLUSION_TILE; ++ty)
+	{
+		for (int tx = x0 / OCCLUSION_TILE; tx <= (x1 - 1) / OCCLUSION_TILE; ++tx)
+		{
+			int tile = ty * buffer->tilesX + tx;
+			if (buffer->tileFar[tile] > boxNear)
+				continue;
+			if (buffer->tileNear[tile] <= boxNear)
+				return 1;
+
+			// Partly in front, the pixels of the rectangle decide
+			int px0 = tx * OCCLUSION_TILE > x0 ? tx * OCCLUSION_TILE : x0;
+			int px1 = (tx + 1) * OCCLUSION_TILE < x1 ? (tx + 1) * OCCLUSION_TILE : x1;
+			int py0 = ty * OCCLUSION_TILE > y0 ? ty * OCCLUSION_TILE : y0;
+			int py1 = (ty + 1) * OCCLUSION_TILE < y1 ? (ty + 1) * OCCLUSION_TILE : y1;
+			for (int py = py0; py < py1; ++py)
+			{
+				const float *row = buffer->depth + py * buffer->width;
+				for (int px = px0; px < px1; ++px)
+				{
+					if (row[px] <= boxNear)
+						return 1;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+int occlusionCullSpheres(const OcclusionBuffer *buffer, const vec3 *position, const float *radius,
+	const float *scale, int *visible, int count)
+{
+	int n = 0;
+	for (int v = 0; v < count; ++v)
+	{
+		int i = visible[v];
+		float r = radius[i] * scale[i];
+		vec3 lo = {position[i][0] - r, position[i][1] - r, position[i][2] - r};
+		vec3 hi = {position[i][0] + r, position[i][1] + r, position[i][2] + r};
+		visible[n] = i;
+		n += occlusionTestBox(buffer, lo, hi);
+	}
+	return n;
+}
@@ -0,0 +1,112 @@
+// Occlusion culling against a low resolution depth buffer rasterized on the CPU.
+//
+// Once per frame the designated occluders (walls, large static geometry) are
+// rasterized into a small buffer holding, per pixel, the inverse view depth
+// 1 / w of the nearest occluder, 0 where there is none. The inverse depth is
+// linear in screen space, so the rasterizer interpolates it directly, and no
+// far plane is needed. Rows are filled four pixels at a time with the lm4
+// vectors of linmath.h (scalar with LINMATH_NO_SIMD). Each pixel takes the
+// farthest depth of its triangle's plane over the pixel, not its center's, so
+// slanted occluders do not hide what is just behind them.
+//
+// occlusionFinish then builds the hierarchical level: the nearest and farthest
+// depth of every OCCLUSION_TILE square tile. Objects are tested by the screen
+// rectangle and nearest depth of their world space bounding box. A tile whose
+// farthest occluder is nearer than the box hides its part of the rectangle at
+// once, a tile with no occluder as near as the box shows it at once, and only
+// tiles in between are looked at pixel by pixel. Boxes reaching behind the
+// near plane or out of the buffer are visible.
+//
+// In VR the buffer is rendered once for both eyes, from a center eye halfway
+// between them that looks where they look, through a frustum covering both of
+// theirs (occlusionBeginStereo). Seen from an eye, an occluder at inverse
+// depth 1 / o moves by offset / o on screen against what is far behind it,
+// offset being the eye's distance to the center eye. So the outer edges of
+// every occluder mesh, those no other triangle of the mesh shares, are pulled
+// in by that much: what is left covers a pixel for both eyes, and an object
+// behind it is hidden from anywhere between them. Edges two triangles share
+// by their vertex indices stay, so a wall made of many triangles does not
+// crack along its inner edges, but edges that only meet in space open a gap
+// between them. Boxes are also widened by a pixel, for the edges of occluders
+// that cover pixel centers but not whole pixels.
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include "linmath.h"
+
+#define OCCLUSION_WIDTH 256 // Default buffer size, in pixels
+#define OCCLUSION_HEIGHT 192
+#define OCCLUSION_TILE 8 // Pixels on the side of a tile of the hierarchical level
+#define OCCLUSION_NEAR 0.05f // Near plane occluders are clipped to, in world units
+
+typedef struct OcclusionStats
+{
+	unsigned long frames;
+	unsigned long long triangles; // Occluder triangles submitted
+	unsigned long long rasterized; // Triangles left after clipping that covered the buffer
+} OcclusionStats;
+
+// Occluder geometry, an indexed triangle list. Positions are the x, y, z of
+// each vertex every stride floats, in model space. Both windings occlude.
+typedef struct OccluderMesh
+{
+	const float *positions;
+	int stride;
+	const unsigned short *indices;
+	int indexCount;
+	unsigned char *outerEdges; // Per triangle, bit k set if the edge opposite its vertex k is not shared
+} OccluderMesh;
+
+typedef struct OcclusionBuffer
+{
+	int width, height; // Multiples of OCCLUSION_TILE
+	int tilesX, tilesY;
+	float *depth; // 1 / w of the nearest occluder per pixel, rows from the bottom
+	float *tileNear, *tileFar; // Largest and smallest depth of every tile
+	float nearest; // Largest depth of the buffer
+
+	mat4x4 viewProjection; // World to the buffer's clip space
+	float parallax[2]; // Pixels outer edges are pulled in by per unit of 1 / w, in x and y
+
+	OcclusionStats stats;
+} OcclusionBuffer;
+
+// Allocates a width x height buffer, both multiples of OCCLUSION_TILE.
+// Returns 0 when out of memory.
+int occlusionInit(OcclusionBuffer *buffer, int width, int height);
+void occlusionFree(OcclusionBuffer *buffer);
+
+// Clears the buffer for a frame seen from a single eye, with a perspective
+// projection and a world to eye view matrix
+void occlusionBeginFrame(OcclusionBuffer *buffer, mat4x4 projection, mat4x4 view);
+
+// Clears the buffer for a frame seen from both eyes, from the center eye.
+// The view matrices have to be rigid and turned the same way, as WebVR's are.
+void occlusionBeginStereo(OcclusionBuffer *buffer, mat4x4 leftProjection, mat4x4 leftView,
+	mat4x4 rightProjection, mat4x4 rightView);
+
+// Finds the outer edges of a mesh, edges being shared when two triangles use
+// the same two vertex indices. The mesh keeps the pointers, which have to
+// stay valid while it is in use. Returns 0 when out of memory.
+int occluderMeshInit(OccluderMesh *mesh, const float *positions, int stride, const unsigned short *indices,
+	int indexCount);
+void occluderMeshFree(OccluderMesh *mesh);
+
+// Rasterizes the mesh placed in the world with a model to world matrix
+void occlusionRasterize(OcclusionBuffer *buffer, mat4x4 world, const OccluderMesh *mesh);
+
+// Builds the tiles, after the occluders and before the tests
+void occlusionFinish(OcclusionBuffer *buffer);
+
+// Returns 0 if the world space box [lo, hi] is hidden behind the occluders
+int occlusionTestBox(const OcclusionBuffer *buffer, const vec3 lo, const vec3 hi);
+
+// Keeps the objects visible[0 .. count) whose bounding box is not hidden, an
+// object's box being the cube around its bounding sphere, centered at
+// position[i] with radius radius[i] * scale[i]. They are packed into visible
+// in the same order and their number returned. Only reads the buffer, so
+// ranges of objects can be tested on several threads at once.
+int occlusionCullSpheres(const OcclusionBuffer *buffer, const vec3 *position, const float *radius,
+	const float *scale, int *visible, int count);
+
+#endif
@@ -0,0 +1,180 @@
+#include "pose_predict.h"
+
+#include <string.h>
+
+static PoseSample *sampleAt(PosePredictor *predictor, int age)
+{
+	return &predictor->history[(predictor->next - 1 - age + POSE_HISTORY) % POSE_HISTORY];
+}
+
+// Rotation taking a to b as a vector along the axis with the angle as length
+static void rotationBetween(vec3 r, quat a, quat b)
+{
+	quat inv, d;
+	quat_conj(inv, a);
+	quat_mul(d, b, inv);
+	if (d[3] < 0.f)
+		quat_scale(d, d, -1.f); // Shortest way round
+
+	float s = vec3_len(d);
+	if (s < 1e-7f)
+	{
+		r[0] = r[1] = r[2] = 0.f;
+		return;
+	}
+
+	float angle = 2.f * atan2f(s, d[3]);
+	vec3_scale(r, d, angle / s);
+}
+
+// Applies a rotation vector (see rotationBetween) to q
+static void rotateBy(quat r, quat q, vec3 rotation)
+{
+	float angle = vec3_len(rotation);
+	if (angle < 1e-7f)
+	{
+		memcpy(r, q, sizeof(quat));
+		return;
+	}
+
+	quat d;
+	vec3 axis;
+	vec3_scale(axis, rotation, 1.f / angle);
+	quat_rotate(d, angle, axis);
+	quat_mul(r, d, q);
+	quat_norm(r, r);
+}
+
+// Pose at time t between two samples, t clamped to their span
+static void interpolate(PoseSample *out, const PoseSample *a, const PoseSample *b, double t)
+{
+	float f = b->timestamp > a->timestamp ? (float)((t - a->timestamp) / (b->timestamp - a->timestamp)) : 1.f;
+	f = f < 0.f ? 0.f : f > 1.f ? 1.f : f;
+
+	vec3 d;
+	vec3_sub(d, (float *)b->position, (float *)a->position);
+	vec3_scale(d, d, f);
+	vec3_add(out->position, (float *)a->position, d);
+
+	vec3 rotation;
+	rotationBetween(rotation, (float *)a->orientation, (float *)b->orientation);
+	vec3_scale(rotation, rotation, f);
+	rotateBy(out->orientation, (float *)a->orientation, rotation);
+	out->timestamp = t;
+}
+
+static void accumulateError(PosePredictionStats *stats, const PoseSample *guess, const PoseSample *actual)
+{
+	vec3 d, rotation;
+	vec3_sub(d, (float *)guess->position, (float *)actual->position);
+	rotationBetween(rotation, (float *)guess->orientation, (float *)actual->orientation);
+
+	double positionError = vec3_len(d);
+	double angleError = vec3_len(rotation);
+	++stats->samples;
+	stats->positionErrorSum += positionError;
+	stats->angleErrorSum += angleError;
+	if (positionError > stats->positionErrorMax)
+		stats->positionErrorMax = positionError;
+	if (angleError > stats->angleErrorMax)
+		stats->angleErrorMax = angleError;
+}
+
+// Scores the pending predictions whose target time now lies between the two
+// newest samples
+static void scorePending(PosePredictor *predictor)
+{
+	PoseSample *newest = sampleAt(predictor, 0);
+	PoseSample *previous = sampleAt(predictor, 1);
+	int kept = 0;
+
+	for (int i = 0; i < predictor->pendingCount; ++i)
+	{
+		PoseSample *guess = &predictor->pending[i];
+		if (guess->timestamp > newest->timestamp)
+		{
+			predictor->pending[kept] = *guess;
+			predictor->pendingUnpredicted[kept] = predictor->pendingUnpredicted[i];
+			++kept;
+			continue;
+		}
+		if (guess->timestamp < previous->timestamp)
+			continue; // Too old to score
+
+		PoseSample actual;
+		interpolate(&actual, previous, newest, guess->timestamp);
+		accumulateError(&predictor->predicted, guess, &actual);
+		accumulateError(&predictor->unpredicted, &predictor->pendingUnpredicted[i], &actual);
+	}
+
+	predictor->pendingCount = kept;
+}
+
+void posePredictorReset(PosePredictor *predictor)
+{
+	memset(predictor, 0, sizeof(*predictor));
+}
+
+void posePredictorAddSample(PosePredictor *predictor, double timestamp, vec3 position, quat orientation)
+{
+	PoseSample *sample = &predictor->history[predictor->next];
+	sample->timestamp = timestamp;
+	memcpy(sample->position, position, sizeof(vec3));
+	memcpy(sample->orientation, orientation, sizeof(quat));
+	quat_norm(sample->orientation, sample->orientation);
+	predictor->next = (predictor->next + 1) % POSE_HISTORY;
+	if (predictor->count < POSE_HISTORY)
+		++predictor->count;
+
+	if (predictor->count < 2)
+		return;
+
+	scorePending(predictor);
+
+	int span = predictor->count <= POSE_VELOCITY_SPAN ? predictor->count - 1 : POSE_VELOCITY_SPAN;
+	PoseSample *newest = sampleAt(predictor, 0);
+	PoseSample *oldest = sampleAt(predictor, span);
+	double dt = newest->timestamp - oldest->timestamp;
+	if (dt <= 0.0)
+		return;
+
+	vec3_sub(predictor->linearVelocity, newest->position, oldest->position);
+	vec3_scale(predictor->linearVelocity, predictor->linearVelocity, (float)(1.0 / dt));
+	rotationBetween(predictor->angularVelocity, oldest->orientation, newest->orientation);
+	vec3_scale(predictor->angularVelocity, predictor->angularVelocity, (float)(1.0 / dt));
+}
+
+void posePredictorPredict(PosePredictor *predictor, double targetTime, vec3 position, quat orientation)
+{
+	if (predictor->count == 0)
+	{
+		position[0] = position[1] = position[2] = 0.f;
+		quat_identity(orientation);
+		return;
+	}
+
+	PoseSample *newest = sampleAt(predictor, 0);
+	float dt = predictor->count < 2 ? 0.f : (float)(targetTime - newest->timestamp);
+
+	vec3 d;
+	vec3_scale(d, predictor->linearVelocity, dt);
+	vec3_add(position, newest->position, d);
+
+	vec3 rotation;
+	vec3_scale(rotation, predictor->angularVelocity, dt);
+	rotateBy(orientation, newest->orientation, rotation);
+
+	// Remember the guess, and the pose that would have been used without
+	// prediction, to score them against the real pose later
+	if (predictor->pendingCount < POSE_PENDING && dt > 0.f)
+	{
+		PoseSample *guess = &predictor->pending[predictor->pendingCount];
+		PoseSample *plain = &predictor->pendingUnpredicted[predictor->pendingCount];
+		guess->timestamp = targetTime;
+		memcpy(guess->position, position, sizeof(vec3));
+		memcpy(guess->orientation, orientation, sizeof(quat));
+		*plain = *newest;
+		plain->timestamp = targetTime;
+		++predictor->pendingCount;
+	}
+}
@@ -0,0 +1,64 @@
+// Head pose prediction for late latching.
+//
+// The predictor keeps a short history of head poses with their timestamps,
+// estimates linear and angular velocity from it and extrapolates the pose to a
+// later time, such as the expected scanout of the frame being rendered. The
+// render loop uses it to re-derive the eye view matrices right before drawing
+// instead of rendering the whole frame with the pose read at frame start.
+//
+// To measure how well it works, every prediction is remembered and compared
+// against the real pose once samples past its target time arrive. The same is
+// done for the unpredicted pose, so the two errors can be compared on a
+// replayed pose trace.
+#ifndef POSE_PREDICT_H
+#define POSE_PREDICT_H
+
+#include "linmath.h"
+
+// Samples kept for velocity estimation; velocities are taken over the span of
+// the most recent POSE_VELOCITY_SPAN samples to smooth out tracking noise
+#define POSE_HISTORY 8
+#define POSE_VELOCITY_SPAN 3
+#define POSE_PENDING 8
+
+typedef struct PoseSample
+{
+	double timestamp; // Milliseconds
+	vec3 position;
+	quat orientation;
+} PoseSample;
+
+typedef struct PosePredictionStats
+{
+	unsigned samples;
+	double angleErrorSum, angleErrorMax;       // Radians
+	double positionErrorSum, positionErrorMax; // Meters
+} PosePredictionStats;
+
+typedef struct PosePredictor
+{
+	PoseSample history[POSE_HISTORY];
+	int count; // Valid samples in history, the newest at history[(next - 1) % POSE_HISTORY]
+	int next;
+
+	vec3 linearVelocity;  // Meters per millisecond
+	vec3 angularVelocity; // Axis times radians per millisecond, in world space
+
+	// Predictions waiting for the real pose at their target time
+	PoseSample pending[POSE_PENDING];
+	PoseSample pendingUnpredicted[POSE_PENDING];
+	int pendingCount;
+
+	PosePredictionStats predicted, unpredicted;
+} PosePredictor;
+
+void posePredictorReset(PosePredictor *predictor);
+
+// Adds the tracked pose at timestamp (milliseconds, increasing)
+void posePredictorAddSample(PosePredictor *predictor, double timestamp, vec3 position, quat orientation);
+
+// Extrapolates the newest sample to targetTime. With fewer than two samples the
+// newest pose is returned as is.
+void posePredictorPredict(PosePredictor *predictor, double targetTime, vec3 position, quat orientation);
+
+#endif
@@ -0,0 +1,134 @@
+#include "resolution.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SMOOTHING 0.3 // Weight of the newest GPU time in loadMs
+
+void resolutionInit(ResolutionController *controller, double budgetMs, float minScale, float maxScale)
+{
+	memset(controller, 0, sizeof(*controller));
+	controller->scale = controller->maxScale = maxScale;
+	controller->minScale = minScale;
+	controller->budgetMs = budgetMs;
+	controller->upFrames = RESOLUTION_UP_FRAMES;
+	controller->framesSinceRise = -1;
+}
+
+// Returns 1 if the clamped scale differs from the current one
+static int setScale(ResolutionController *controller, float scale)
+{
+	scale = fminf(fmaxf(scale, controller->minScale), controller->maxScale);
+	if (scale == controller->scale)
+		return 0;
+
+	// GPU time goes with the pixel count, so carry the load over to the new scale
+	controller->loadMs *= (double)(scale * scale) / (controller->scale * controller->scale);
+	controller->scale = scale;
+	controller->overFrames = controller->underFrames = 0;
+	return 1;
+}
+
+int resolutionUpdate(ResolutionController *controller, double cpuMs, double gpuMs, double intervalMs)
+{
+	double budget = controller->budgetMs;
+	++controller->frames;
+	if (controller->framesSinceRise >= 0 && ++controller->framesSinceRise == RESOLUTION_PROBE_FRAMES + 1)
+	{
+		// The last rise held, so the next one can come sooner again
+		controller->upFrames /= 2;
+		if (controller->upFrames < RESOLUTION_UP_FRAMES)
+			controller->upFrames = RESOLUTION_UP_FRAMES;
+	}
+
+	// A single miss can be a hiccup elsewhere, misses close together are not
+	int missed = intervalMs > budget * RESOLUTION_MISSED;
+	int repeatedMiss = 0;
+	if (missed)
+	{
+		++controller->missedFrames;
+		repeatedMiss = controller->lastMiss && controller->frames - controller->lastMiss <= RESOLUTION_MISS_WINDOW;
+		controller->lastMiss = controller->frames;
+	}
+
+	// Fewer pixels do not make the CPU any faster
+	if (cpuMs > budget * RESOLUTION_HIGH_WATER)
+	{
+		++controller->cpuBoundFrames;
+		controller->overFrames = controller->underFrames = 0;
+		return 0;
+	}
+
+	int over, under;
+	if (gpuMs >= 0.0)
+	{
+		controller->loadMs = controller->loadMs > 0.0 ? controller->loadMs + (gpuMs - controller->loadMs) * SMOOTHING : gpuMs;
+		over = controller->loadMs > budget * RESOLUTION_HIGH_WATER;
+		under = !missed && controller->loadMs < budget * RESOLUTION_LOW_WATER;
+	}
+	else
+	{
+		// Without a GPU time there is no way to tell the headroom, only misses
+		over = 0;
+		under = !missed;
+	}
+
+	if (over || repeatedMiss)
+	{
+		controller->underFrames = 0;
+		if (!repeatedMiss && ++controller->overFrames < RESOLUTION_DOWN_FRAMES)
+			return 0;
+
+		// Aim for the target load, or assume the load is just over budget
+		// when all that is known is that frames are missed
+		float factor = gpuMs >= 0.0 && controller->loadMs > 0.0
+			? (float)sqrt(budget * RESOLUTION_TARGET / controller->loadMs)
+			: sqrtf((float)RESOLUTION_TARGET);
+		float scale = fminf(controller->scale * factor, controller->scale - RESOLUTION_STEP);
+
+		// A drop right after a rise means the rise overshot, probe more
+		// carefully next time. Otherwise the load itself went up.
+		if (controller->framesSinceRise >= 0 && controller->framesSinceRise <= RESOLUTION_PROBE_FRAMES)
+		{
+			controller->upFrames *= 2;
+			if (controller->upFrames > RESOLUTION_MAX_UP_FRAMES)
+				controller->upFrames = RESOLUTION_MAX_UP_FRAMES;
+		}
+		else
+		{
+			controller->upFrames = RESOLUTION_UP_FRAMES;
+		}
+		controller->framesSinceRise = -1;
+
+		if (!setScale(controller, scale))
+		{
+			controller->overFrames = 0;
+			return 0;
+		}
+		++controller->drops;
+		return 1;
+	}
+
+	if (under)
+	{
+		controller->overFrames = 0;
+		if (++controller->underFrames < controller->upFrames)
+			return 0;
+		controller->underFrames = 0;
+
+		// With a GPU time a step that would land over the high watermark is
+		// known to fail, so it is not taken
+		float scale = controller->scale + RESOLUTION_STEP;
+		if (gpuMs >= 0.0 && controller->loadMs * (scale * scale) / (controller->scale * controller->scale) > budget * RESOLUTION_HIGH_WATER)
+			return 0;
+
+		if (!setScale(controller, scale))
+			return 0;
+		++controller->rises;
+		controller->framesSinceRise = 0;
+		return 1;
+	}
+
+	controller->overFrames = controller->underFrames = 0;
+	return 0;
+}
@@ -0,0 +1,50 @@
+// Dynamic resolution for the VR render target.
+//
+// The controller picks a scale for the eye render size once per frame from
+// measured frame times against the display's refresh budget. Fewer pixels only
+// help a frame limited by the GPU, so a frame whose CPU work alone blows the
+// budget leaves the scale alone. GPU time is taken from a timer query where
+// there is one; otherwise the only GPU signal is a missed frame, visible as a
+// frame interval well over the budget.
+//
+// Hysteresis keeps the scale from oscillating: it drops after a couple of
+// frames over the high watermark or a second missed frame within a second,
+// but rises one step at a time and only after a stretch of frames under the
+// low watermark. Each rise that is followed by a drop shortly after doubles
+// the stretch needed for the next one, each rise that holds halves it again.
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#define RESOLUTION_HIGH_WATER 0.9  // Of the budget, load above this lowers the scale
+#define RESOLUTION_LOW_WATER 0.75  // Load below this raises it
+#define RESOLUTION_TARGET 0.8      // Load a drop aims for, assuming GPU time proportional to pixels
+#define RESOLUTION_MISSED 1.5      // Frame intervals above this many budgets are missed frames
+#define RESOLUTION_MISS_WINDOW 90  // A miss within this many frames of the last one lowers the scale
+#define RESOLUTION_STEP 0.05f      // Scale added by one rise
+#define RESOLUTION_DOWN_FRAMES 2   // Frames over the high watermark before a drop
+#define RESOLUTION_UP_FRAMES 30    // Frames under the low watermark before a rise, at first
+#define RESOLUTION_MAX_UP_FRAMES 960
+#define RESOLUTION_PROBE_FRAMES 90 // A drop within this many frames of a rise means the rise overshot
+
+typedef struct ResolutionController
+{
+	float scale, minScale, maxScale;
+	double budgetMs;
+	double loadMs; // Smoothed GPU time, 0 until measured
+
+	unsigned long frames, lastMiss;
+	int overFrames, underFrames;
+	int upFrames;            // Frames under the low watermark needed for the next rise
+	int framesSinceRise;     // -1 if the last change was a drop
+	unsigned long rises, drops, cpuBoundFrames, missedFrames;
+} ResolutionController;
+
+// Starts at maxScale. budgetMs is the display's frame interval.
+void resolutionInit(ResolutionController *controller, double budgetMs, float minScale, float maxScale);
+
+// Feeds the measurements of one frame: CPU time of the frame, GPU time or a
+// negative value if unknown, and time since the previous frame started.
+// Returns 1 if the scale changed.
+int resolutionUpdate(ResolutionController *controller, double cpuMs, double gpuMs, double intervalMs);
+
+#endif
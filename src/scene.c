@@ -0,0 +1,122 @@
+#include "scene.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int sceneInit(Scene *scene, int capacity)
+{
+	memset(scene, 0, sizeof(*scene));
+	scene->position = malloc(sizeof(vec3) * capacity);
+	scene->rotation = malloc(sizeof(quat) * capacity);
+	scene->previousRotation = malloc(sizeof(quat) * capacity);
+	scene->scale = malloc(sizeof(float) * capacity);
+	scene->radius = malloc(sizeof(float) * capacity);
+	scene->world = malloc(sizeof(mat4x4) * capacity);
+	if (!scene->position || !scene->rotation || !scene->previousRotation || !scene->scale || !scene->radius || !scene->world)
+	{
+		sceneFree(scene);
+		return 0;
+	}
+
+	scene->capacity = capacity;
+	for (int k = 0; k < 3; ++k)
+		scene->meshScale[k] = 1.0f;
+	return 1;
+}
+
+void sceneFree(Scene *scene)
+{
+	free(scene->position);
+	free(scene->rotation);
+	free(scene->previousRotation);
+	free(scene->scale);
+	free(scene->radius);
+	free(scene->world);
+	memset(scene, 0, sizeof(*scene));
+}
+
+int sceneAdd(Scene *scene, vec3 position, quat rotation, float scale, float radius)
+{
+	if (scene->count == scene->capacity)
+		return -1;
+
+	int i = scene->count++;
+	memcpy(scene->position[i], position, sizeof(vec3));
+	memcpy(scene->rotation[i], rotation, sizeof(quat));
+	memcpy(scene->previousRotation[i], rotation, sizeof(quat));
+	scene->scale[i] = scale;
+	scene->radius[i] = radius;
+	mat4x4_identity(scene->world[i]);
+	return i;
+}
+
+void sceneSetMeshDequantization(Scene *scene, vec3 scale, vec3 offset)
+{
+	memcpy(scene->meshScale, scale, sizeof(vec3));
+	memcpy(scene->meshOffset, offset, sizeof(vec3));
+}
+
+// Rotation and scale only touch the upper 3x3, so the matrix is built
+// directly instead of multiplying translate * rotate * scale and the mesh
+// dequantization. Without dequantization the result is unchanged.
+static inline void buildWorld(mat4x4 world, const float *position, quat rotation, float scale,
+	const float *meshScale, const float *meshOffset)
+{
+	mat4x4_from_quat(world, rotation);
+	for (int k = 0; k < 3; ++k)
+		world[3][k] = position[k] + scale * (world[0][k] * meshOffset[0] + world[1][k] * meshOffset[1] + world[2][k] * meshOffset[2]);
+	vec3_scale(world[0], world[0], scale * meshScale[0]);
+	vec3_scale(world[1], world[1], scale * meshScale[1]);
+	vec3_scale(world[2], world[2], scale * meshScale[2]);
+}
+
+void sceneUpdateWorld(Scene *scene, int first, int count)
+{
+	const vec3 *position = scene->position + first;
+	quat *rotation = scene->rotation + first;
+	const float *scale = scene->scale + first;
+	mat4x4 *world = scene->world + first;
+	vec3 meshScale, meshOffset; // Copied so the stores to world cannot alias them
+	memcpy(meshScale, scene->meshScale, sizeof(vec3));
+	memcpy(meshOffset, scene->meshOffset, sizeof(vec3));
+
+	for (int i = 0; i < count; ++i)
+		buildWorld(world[i], position[i], rotation[i], scale[i], meshScale, meshOffset);
+}
+
+void sceneUpdateWorldInterpolated(Scene *scene, float alpha, int first, int count)
+{
+	const vec3 *position = scene->position + first;
+	quat *rotation = scene->rotation + first;
+	quat *previous = scene->previousRotation + first;
+	const float *scale = scene->scale + first;
+	mat4x4 *world = scene->world + first;
+	vec3 meshScale, meshOffset;
+	memcpy(meshScale, scene->meshScale, sizeof(vec3));
+	memcpy(meshOffset, scene->meshOffset, sizeof(vec3));
+
+	// Normalized lerp, close enough to slerp for the small angle of one tick
+	for (int i = 0; i < count; ++i)
+	{
+		quat q;
+		float b = vec4_mul_inner(previous[i], rotation[i]) < 0.0f ? -alpha : alpha;
+		for (int k = 0; k < 4; ++k)
+			q[k] = previous[i][k] * (1.0f - alpha) + rotation[i][k] * b;
+		quat_norm(q, q);
+		buildWorld(world[i], position[i], q, scale[i], meshScale, meshOffset);
+	}
+}
+
+void sceneComputeMvp(const Scene *scene, mat4x4 viewProjection, mat4x4 *out, int first, int count)
+{
+	mat4x4 *world = scene->world + first;
+
+	for (int i = 0; i < count; ++i)
+		mat4x4_mul_affine(out[i], viewProjection, world[i]);
+}
+
+void sceneComputeMvpIndexed(const Scene *scene, mat4x4 viewProjection, mat4x4 *out, const int *index, int count)
+{
+	for (int i = 0; i < count; ++i)
+		mat4x4_mul_affine(out[i], viewProjection, scene->world[index[i]]);
+}
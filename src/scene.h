@@ -0,0 +1,59 @@
+// Data-oriented scene: object transforms are kept in separate tightly packed
+// arrays (structure of arrays) and turned into world and MVP matrices in
+// batched passes over index ranges, so the per-object work is a straight
+// loop over memory and ranges can be handed to different threads.
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "linmath.h"
+
+typedef struct Scene
+{
+	int count, capacity;
+
+	// Local transform: translation, rotation and uniform scale
+	vec3 *position;
+	quat *rotation;
+	float *scale;
+
+	// Rotation as of the previous simulation tick, to interpolate from
+	quat *previousRotation;
+
+	// Bounding sphere radius around the local origin, before scale
+	float *radius;
+
+	// Applied to the mesh all objects share before their own transform, to
+	// undo the quantization of its vertex positions (vertex_format.h):
+	// model position = meshOffset + meshScale * vertex position
+	vec3 meshScale, meshOffset;
+
+	// Output of sceneUpdateWorld
+	mat4x4 *world;
+} Scene;
+
+// Allocates room for capacity objects. Returns 0 when out of memory.
+int sceneInit(Scene *scene, int capacity);
+void sceneFree(Scene *scene);
+
+// Appends an object and returns its index, or -1 when the scene is full
+int sceneAdd(Scene *scene, vec3 position, quat rotation, float scale, float radius);
+
+// Sets meshScale and meshOffset, identity by default
+void sceneSetMeshDequantization(Scene *scene, vec3 scale, vec3 offset);
+
+// world[i] = translate(position[i]) * rotate(rotation[i]) * scale(scale[i])
+// * translate(meshOffset) * scale(meshScale) for i in [first, first + count)
+void sceneUpdateWorld(Scene *scene, int first, int count);
+
+// Like sceneUpdateWorld, with the rotation interpolated from previousRotation
+// (alpha 0) to rotation (alpha 1)
+void sceneUpdateWorldInterpolated(Scene *scene, float alpha, int first, int count);
+
+// out[i - first] = viewProjection * world[i] for i in [first, first + count)
+void sceneComputeMvp(const Scene *scene, mat4x4 viewProjection, mat4x4 *out, int first, int count);
+
+// out[i] = viewProjection * world[index[i]] for i in [0, count), for the
+// objects left after culling
+void sceneComputeMvpIndexed(const Scene *scene, mat4x4 viewProjection, mat4x4 *out, const int *index, int count);
+
+#endif
@@ -0,0 +1,88 @@
+#include "scene_graph.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int sceneGraphInit(SceneGraph *graph, int capacity)
+{
+	memset(graph, 0, sizeof(*graph));
+	graph->parent = malloc(sizeof(int) * capacity);
+	graph->local = malloc(sizeof(Transform) * capacity);
+	graph->dirty = malloc(capacity);
+	graph->world = malloc(sizeof(mat4x4) * capacity);
+	if (!graph->parent || !graph->local || !graph->dirty || !graph->world)
+	{
+		sceneGraphFree(graph);
+		return 0;
+	}
+
+	graph->capacity = capacity;
+	return 1;
+}
+
+void sceneGraphFree(SceneGraph *graph)
+{
+	free(graph->parent);
+	free(graph->local);
+	free(graph->dirty);
+	free(graph->world);
+	memset(graph, 0, sizeof(*graph));
+}
+
+int sceneGraphAdd(SceneGraph *graph, int parent, Transform *local)
+{
+	if (graph->count == graph->capacity || parent >= graph->count)
+		return -1;
+
+	int i = graph->count++;
+	graph->parent[i] = parent < 0 ? -1 : parent;
+	graph->local[i] = *local;
+	graph->dirty[i] = 1;
+	if (i < graph->firstDirty)
+		graph->firstDirty = i;
+	return i;
+}
+
+void sceneGraphSetLocal(SceneGraph *graph, int node, Transform *local)
+{
+	graph->local[node] = *local;
+	graph->dirty[node] = 1;
+	if (node < graph->firstDirty)
+		graph->firstDirty = node;
+}
+
+int sceneGraphUpdate(SceneGraph *graph)
+{
+	const int *parent = graph->parent;
+	unsigned char *dirty = graph->dirty;
+	mat4x4 *world = graph->world;
+	int updated = 0;
+
+	// Parents come first, so a parent's flag already includes its own
+	// ancestors' by the time a child looks at it
+	for (int i = graph->firstDirty; i < graph->count; ++i)
+	{
+		int p = parent[i];
+		if (!dirty[i] && (p < 0 || !dirty[p]))
+			continue;
+		dirty[i] = 1;
+		++updated;
+
+		if (p < 0)
+		{
+			transformToMat4x4(world[i], &graph->local[i]);
+		}
+		else
+		{
+			mat4x4 local;
+			transformToMat4x4(local, &graph->local[i]);
+			mat4x4_mul_affine(world[i], world[p], local);
+		}
+	}
+
+	// Flags are only cleared once the pass is done, children look at them
+	if (updated)
+		memset(dirty + graph->firstDirty, 0, graph->count - graph->firstDirty);
+	graph->firstDirty = graph->count;
+	return updated;
+}
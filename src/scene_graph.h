@@ -0,0 +1,43 @@
+// Transform hierarchy with incremental world matrix updates.
+//
+// Nodes live in flat arrays in topological order: a node is always added
+// after its parent, so a single forward pass sees every parent's world matrix
+// before its children need it. Setting a node's local transform marks it
+// dirty, and the update pass carries the flag down to the descendants as it
+// goes, so only changed subtrees are recomputed. Nothing before the first
+// dirty node is looked at, and a graph without changes costs nothing.
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include "transform.h"
+
+typedef struct SceneGraph
+{
+	int count, capacity;
+	int firstDirty; // Lowest dirty node, count when there is none
+
+	int *parent; // -1 for roots, otherwise a lower index
+	Transform *local;
+	unsigned char *dirty;
+
+	// Output of sceneGraphUpdate, world = world[parent] * local
+	mat4x4 *world;
+} SceneGraph;
+
+// Allocates room for capacity nodes. Returns 0 when out of memory.
+int sceneGraphInit(SceneGraph *graph, int capacity);
+void sceneGraphFree(SceneGraph *graph);
+
+// Appends a node under parent (-1 for a root, otherwise an existing node) and
+// returns its index, or -1 when the graph is full
+int sceneGraphAdd(SceneGraph *graph, int parent, Transform *local);
+
+// Replaces a node's local transform; its subtree is updated by the next
+// sceneGraphUpdate
+void sceneGraphSetLocal(SceneGraph *graph, int node, Transform *local);
+
+// Recomputes the world matrices of the dirty nodes and their descendants.
+// Returns how many were recomputed.
+int sceneGraphUpdate(SceneGraph *graph);
+
+#endif
@@ -0,0 +1,289 @@
+#include "shader_cache.h"
+
+#include "gl_state.h"
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLES2/gl2ext.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#define MAX_ATTRIB_BINDINGS 16
+
+typedef struct CachedShader
+{
+	uint64_t hash;
+	GLenum type;
+	char *defines, *text;
+	GLuint shader;
+	int checked, compiled;
+} CachedShader;
+
+typedef struct CachedProgram
+{
+	GLuint vertex, fragment; // Indices into gShaders
+	GLuint program;
+	int checked, linked;
+} CachedProgram;
+
+static int gParallelCompile;
+
+static CachedShader *gShaders;
+static int gShaderCount, gShaderCapacity;
+static CachedProgram *gPrograms;
+static int gProgramCount, gProgramCapacity;
+
+static struct
+{
+	GLuint location;
+	char name[32];
+} gAttribBindings[MAX_ATTRIB_BINDINGS];
+static int gAttribBindingCount;
+
+static ShaderCacheStats gStats;
+
+// FNV-1a, continued from hash
+static uint64_t hashString(uint64_t hash, const char *s)
+{
+	for (; *s; ++s)
+		hash = (hash ^ (unsigned char)*s) * 0x100000001b3ull;
+	return (hash ^ 0xff) * 0x100000001b3ull; // Separates consecutive strings
+}
+
+static char *copyString(const char *s)
+{
+	size_t size = strlen(s) + 1;
+	char *copy = malloc(size);
+	if (copy)
+		memcpy(copy, s, size);
+	return copy;
+}
+
+static int grow(void **array, int *capacity, int count, size_t size)
+{
+	if (count < *capacity)
+		return 1;
+	int newCapacity = *capacity ? *capacity * 2 : 16;
+	void *grown = realloc(*array, newCapacity * size);
+	if (!grown)
+		return 0;
+	*array = grown;
+	*capacity = newCapacity;
+	return 1;
+}
+
+static int checkShaderCompiled(GLuint shader)
+{
+	GLint success = 0;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+
+	if (success == GL_FALSE)
+	{
+		GLint max_len = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &max_len);
+
+		GLchar err_log[max_len + 1];
+		glGetShaderInfoLog(shader, max_len + 1, &max_len, &err_log[0]);
+
+		fprintf(stderr, "Shader compilation failed: %s\n", err_log);
+	}
+
+	return success;
+}
+
+static int checkShaderProgramLinked(GLuint program)
+{
+	GLint success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+	if (success == GL_FALSE)
+	{
+		GLint max_len = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &max_len);
+
+		GLchar err_log[max_len + 1];
+		glGetProgramInfoLog(program, max_len + 1, &max_len, &err_log[0]);
+
+		fprintf(stderr, "Program linking failed: %s\n", err_log);
+	}
+
+	return success;
+}
+
+// Returns the index of the cached shader, compiling it on a miss, or -1 when
+// out of memory
+static int getShader(GLenum type, const char *text, const char *defines)
+{
+	uint64_t hash = hashString(hashString(0xcbf29ce484222325ull ^ type, defines), text);
+	for (int i = 0; i < gShaderCount; ++i)
+	{
+		CachedShader *s = &gShaders[i];
+		if (s->hash == hash && s->type == type && strcmp(s->defines, defines) == 0 && strcmp(s->text, text) == 0)
+		{
+			++gStats.shaderHits;
+			return i;
+		}
+	}
+
+	if (!grow((void **)&gShaders, &gShaderCapacity, gShaderCount, sizeof(*gShaders)))
+		return -1;
+	CachedShader *s = &gShaders[gShaderCount];
+	s->defines = copyString(defines);
+	s->text = copyString(text);
+	if (!s->defines || !s->text)
+	{
+		free(s->defines);
+		free(s->text);
+		return -1;
+	}
+	s->hash = hash;
+	s->type = type;
+	s->checked = s->compiled = 0;
+
+	// The defines have to follow the #version line
+	const char *body = text;
+	if (strncmp(text, "#version", 8) == 0)
+	{
+		body = strchr(text, '\n');
+		body = body ? body + 1 : text + strlen(text);
+	}
+	const GLchar *parts[3] = {text, defines, body};
+	GLint lengths[3] = {(GLint)(body - text), (GLint)strlen(defines), (GLint)strlen(body)};
+
+	s->shader = glCreateShader(type);
+	glShaderSource(s->shader, 3, parts, lengths);
+	glCompileShader(s->shader);
+	++gStats.shadersCompiled;
+	return gShaderCount++;
+}
+
+static CachedProgram *findProgram(GLuint program)
+{
+	for (int i = 0; i < gProgramCount; ++i)
+	{
+		if (gPrograms[i].program == program)
+			return &gPrograms[i];
+	}
+	return NULL;
+}
+
+void shaderCacheInit(int parallelCompile)
+{
+	gParallelCompile = parallelCompile;
+}
+
+void shaderCacheFree(void)
+{
+	for (int i = 0; i < gProgramCount; ++i)
+		glStateDeleteProgram(gPrograms[i].program);
+	for (int i = 0; i < gShaderCount; ++i)
+	{
+		glDeleteShader(gShaders[i].shader);
+		free(gShaders[i].defines);
+		free(gShaders[i].text);
+	}
+	free(gShaders);
+	free(gPrograms);
+	gShaders = NULL;
+	gPrograms = NULL;
+	gShaderCount = gShaderCapacity = gProgramCount = gProgramCapacity = 0;
+	gAttribBindingCount = 0;
+	memset(&gStats, 0, sizeof(gStats));
+}
+
+void shaderCacheBindAttrib(GLuint location, const char *name)
+{
+	if (gAttribBindingCount == MAX_ATTRIB_BINDINGS)
+	{
+		fprintf(stderr, "Too many shader attribute bindings, ignoring '%s'\n", name);
+		return;
+	}
+	gAttribBindings[gAttribBindingCount].location = location;
+	strncpy(gAttribBindings[gAttribBindingCount].name, name, sizeof(gAttribBindings[0].name) - 1);
+	++gAttribBindingCount;
+}
+
+GLuint shaderCacheProgram(const char *vertexText, const char *vertexDefines, const char *fragmentText, const char *fragmentDefines)
+{
+	int vertex = getShader(GL_VERTEX_SHADER, vertexText, vertexDefines ? vertexDefines : "");
+	int fragment = getShader(GL_FRAGMENT_SHADER, fragmentText, fragmentDefines ? fragmentDefines : "");
+	if (vertex < 0 || fragment < 0)
+	{
+		fprintf(stderr, "Out of memory for shader cache\n");
+		return 0;
+	}
+
+	for (int i = 0; i < gProgramCount; ++i)
+	{
+		if (gPrograms[i].vertex == (GLuint)vertex && gPrograms[i].fragment == (GLuint)fragment)
+		{
+			++gStats.programHits;
+			return gPrograms[i].program;
+		}
+	}
+
+	if (!grow((void **)&gPrograms, &gProgramCapacity, gProgramCount, sizeof(*gPrograms)))
+	{
+		fprintf(stderr, "Out of memory for shader cache\n");
+		return 0;
+	}
+	CachedProgram *p = &gPrograms[gProgramCount++];
+	p->vertex = vertex;
+	p->fragment = fragment;
+	p->checked = p->linked = 0;
+
+	p->program = glCreateProgram();
+	glAttachShader(p->program, gShaders[vertex].shader);
+	glAttachShader(p->program, gShaders[fragment].shader);
+	for (int i = 0; i < gAttribBindingCount; ++i)
+		glBindAttribLocation(p->program, gAttribBindings[i].location, gAttribBindings[i].name);
+	glLinkProgram(p->program);
+	++gStats.programsLinked;
+	return p->program;
+}
+
+int shaderCacheProgramReady(GLuint program)
+{
+	CachedProgram *p = findProgram(program);
+	if (!gParallelCompile || !p || p->checked)
+		return 1;
+
+	GLint done = GL_FALSE;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+int shaderCacheCheckProgram(GLuint program)
+{
+	CachedProgram *p = findProgram(program);
+	if (!p)
+		return 0;
+	if (p->checked)
+		return p->linked;
+
+	// Shaders shared between programs only report their errors once
+	GLuint shaders[2] = {p->vertex, p->fragment};
+	for (int i = 0; i < 2; ++i)
+	{
+		CachedShader *s = &gShaders[shaders[i]];
+		if (!s->checked)
+		{
+			s->compiled = checkShaderCompiled(s->shader);
+			s->checked = 1;
+		}
+	}
+
+	p->linked = checkShaderProgramLinked(program);
+	p->checked = 1;
+	return p->linked;
+}
+
+void shaderCacheGetStats(ShaderCacheStats *stats)
+{
+	*stats = gStats;
+}
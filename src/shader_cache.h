@@ -0,0 +1,51 @@
+// Shader program cache.
+//
+// Shaders are compiled once per distinct source: a shader is keyed by its type,
+// its #define block and its source text (looked up by hash, confirmed by
+// comparing the text), and a program by its pair of shaders. Variants of one
+// source are made by passing a different block of #define lines, which is
+// injected after the #version line.
+//
+// Creating a program never waits for the compiler. Compile and link status are
+// only queried when shaderCacheCheckProgram is called, and with
+// KHR_parallel_shader_compile shaderCacheProgramReady asks whether that would
+// block, so the render loop can keep running (and loading) until every program
+// it needs is done instead of stalling at startup.
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <GLES2/gl2.h>
+
+typedef struct ShaderCacheStats
+{
+	unsigned shadersCompiled, shaderHits;
+	unsigned programsLinked, programHits;
+} ShaderCacheStats;
+
+// parallelCompile tells whether KHR_parallel_shader_compile is enabled on the
+// current context
+void shaderCacheInit(int parallelCompile);
+
+// Deletes every cached shader and program
+void shaderCacheFree(void);
+
+// Binds the attribute to location in every program created afterwards
+void shaderCacheBindAttrib(GLuint location, const char *name);
+
+// Returns the program for the shaders, compiling and linking whatever is not
+// cached yet. The defines are "#define NAME VALUE\n" lines and may be NULL;
+// they are separate per stage so a stage that does not depend on them can be
+// shared between variants.
+GLuint shaderCacheProgram(const char *vertexText, const char *vertexDefines, const char *fragmentText, const char *fragmentDefines);
+
+// Returns 1 once querying the program will not block. Always 1 without
+// KHR_parallel_shader_compile.
+int shaderCacheProgramReady(GLuint program);
+
+// Waits for the program, logs compile and link errors the first time it is
+// checked and returns whether it linked
+int shaderCacheCheckProgram(GLuint program);
+
+void shaderCacheGetStats(ShaderCacheStats *stats);
+
+#endif
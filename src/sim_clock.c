@@ -0,0 +1,56 @@
+#include "sim_clock.h"
+
+#include <string.h>
+
+#define EPSILON_MS 1e-6
+
+void simClockInit(SimClock *clock, double stepMs, int maxTicks)
+{
+	memset(clock, 0, sizeof(*clock));
+	clock->stepMs = stepMs;
+	clock->maxTicks = maxTicks;
+	clock->lastMs = -1.0;
+}
+
+int simClockAdvance(SimClock *clock, double nowMs)
+{
+	if (clock->lastMs < 0.0)
+	{
+		clock->lastMs = nowMs;
+		return 0;
+	}
+
+	double elapsed = nowMs - clock->lastMs;
+	clock->lastMs = nowMs;
+	if (elapsed > 0.0)
+		clock->accumulatorMs += elapsed;
+
+	// Frames exactly one step long must not come out a hair short through
+	// rounding, alternating between zero and two ticks
+	int ticks = (int)((clock->accumulatorMs + EPSILON_MS) / clock->stepMs);
+	if (ticks > clock->maxTicks)
+	{
+		// Catching up would only make the next frame late too
+		double dropped = (ticks - clock->maxTicks) * clock->stepMs;
+		clock->droppedMs += dropped;
+		clock->accumulatorMs -= dropped;
+		ticks = clock->maxTicks;
+	}
+	clock->accumulatorMs -= ticks * clock->stepMs;
+	if (clock->accumulatorMs < 0.0)
+		clock->accumulatorMs = 0.0; // Rounding
+	clock->ticks += ticks;
+	return ticks;
+}
+
+double simClockTickTime(const SimClock *clock, unsigned long long tick)
+{
+	// Multiplied rather than summed, so it does not drift over long runs
+	return tick * clock->stepMs / 1000.0;
+}
+
+float simClockAlpha(const SimClock *clock)
+{
+	float alpha = (float)(clock->accumulatorMs / clock->stepMs);
+	return alpha < 1.0f ? alpha : 1.0f;
+}
@@ -0,0 +1,40 @@
+// Fixed timestep simulation clock.
+//
+// The simulation advances in ticks of a fixed length, independent of how
+// often frames are rendered: every frame the real time since the last frame
+// goes into an accumulator and whole ticks are taken out of it. Rendering
+// then interpolates between the states of the last two ticks by the fraction
+// of a tick left over, so motion is smooth at any frame rate while the
+// simulation only ever sees the same step and stays deterministic.
+//
+// One sample of the real time is taken per frame, so every view of the frame
+// sees the same simulation state.
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+typedef struct SimClock
+{
+	double stepMs;
+	int maxTicks;         // Per frame, time beyond that is dropped
+	double lastMs;        // Real time of the last advance, negative before the first
+	double accumulatorMs; // Real time not yet simulated, less than stepMs after an advance
+	unsigned long long ticks;
+	double droppedMs;     // Real time never simulated because of maxTicks
+} SimClock;
+
+// maxTicks bounds the work of a frame after a stall, such as a hidden tab
+void simClockInit(SimClock *clock, double stepMs, int maxTicks);
+
+// Takes the real time of a frame (milliseconds, not decreasing) and returns
+// how many ticks to simulate for it. The first call starts the clock and
+// returns 0.
+int simClockAdvance(SimClock *clock, double nowMs);
+
+// Simulated time after the given tick, in seconds
+double simClockTickTime(const SimClock *clock, unsigned long long tick);
+
+// How far rendering is between the previous tick's state (0) and the last
+// tick's (1)
+float simClockAlpha(const SimClock *clock);
+
+#endif
@@ -0,0 +1,248 @@
+#include "static_batch.h"
+
+#include "gl_command.h"
+#include "gl_state.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int staticBatcherInit(StaticBatcher *batcher, int capacity, GLuint positionLocation, GLuint colorLocation)
+{
+	memset(batcher, 0, sizeof(*batcher));
+	batcher->objects = malloc(sizeof(StaticBatchObject) * capacity);
+	batcher->order = malloc(sizeof(unsigned long long) * capacity);
+	if (!batcher->objects || !batcher->order)
+	{
+		staticBatcherFree(batcher);
+		return 0;
+	}
+
+	batcher->capacity = capacity;
+	batcher->positionLocation = positionLocation;
+	batcher->colorLocation = colorLocation;
+	return 1;
+}
+
+void staticBatcherFree(StaticBatcher *batcher)
+{
+	for (int i = 0; i < batcher->batchCapacity; ++i)
+	{
+		StaticBatch *batch = &batcher->batches[i];
+		if (batch->vertexBuffer)
+		{
+			GLuint buffers[2] = {batch->vertexBuffer, batch->indexBuffer};
+			glStateDeleteBuffers(2, buffers);
+		}
+	}
+	free(batcher->objects);
+	free(batcher->order);
+	free(batcher->batches);
+	free(batcher->vertices);
+	free(batcher->indices);
+	memset(batcher, 0, sizeof(*batcher));
+}
+
+int staticBatcherAdd(StaticBatcher *batcher, GLuint program, const BatchMesh *mesh, mat4x4 world)
+{
+	assert(program);
+	assert(mat4x4_is_affine(world));
+	if (batcher->liveCount == batcher->capacity || mesh->vertexCount > STATIC_BATCH_MAX_VERTICES)
+		return -1;
+
+	int i = batcher->firstFree;
+	while (i < batcher->objectCount && batcher->objects[i].program)
+		++i;
+	batcher->firstFree = i + 1;
+	if (i == batcher->objectCount)
+		++batcher->objectCount;
+
+	StaticBatchObject *object = &batcher->objects[i];
+	object->program = program;
+	object->mesh = mesh;
+	mat4x4_dup(object->world, world);
+	object->batch = -1;
+	++batcher->liveCount;
+	batcher->dirty = 1;
+	return i;
+}
+
+void staticBatcherRemove(StaticBatcher *batcher, int object)
+{
+	assert(object >= 0 && object < batcher->objectCount && batcher->objects[object].program);
+	batcher->objects[object].program = 0;
+	--batcher->liveCount;
+	if (object < batcher->firstFree)
+		batcher->firstFree = object;
+	while (batcher->objectCount && !batcher->objects[batcher->objectCount - 1].program)
+		--batcher->objectCount;
+	if (batcher->firstFree > batcher->objectCount)
+		batcher->firstFree = batcher->objectCount;
+	batcher->dirty = 1;
+}
+
+void staticBatcherSetWorld(StaticBatcher *batcher, int object, mat4x4 world)
+{
+	assert(mat4x4_is_affine(world));
+	mat4x4_dup(batcher->objects[object].world, world);
+	batcher->dirty = 1;
+}
+
+static int compareKeys(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+	return x < y ? -1 : x > y;
+}
+
+// Makes room for count elements of size bytes, keeping the contents
+static int reserve(void **array, int *capacity, int count, size_t size)
+{
+	if (count <= *capacity)
+		return 1;
+	int grown = *capacity * 2 > count ? *capacity * 2 : count;
+	void *p = realloc(*array, grown * size);
+	if (!p)
+		return 0;
+	*array = p;
+	*capacity = grown;
+	return 1;
+}
+
+// Appends the object's vertices in world space and its indices rebased to
+// the batch
+static void bake(StaticBatcher *batcher, StaticBatchObject *object, StaticBatch *batch)
+{
+	const BatchMesh *mesh = object->mesh;
+	BatchVertex *out = batcher->vertices + batch->firstVertex + batch->vertexCount;
+	for (int v = 0; v < mesh->vertexCount; ++v)
+	{
+		const BatchVertex *in = &mesh->vertices[v];
+		vec4 p = {in->x, in->y, in->z, 1.f}, q;
+		mat4x4_mul_vec4(q, object->world, p);
+		out[v].x = q[0];
+		out[v].y = q[1];
+		out[v].z = q[2];
+		out[v].r = in->r;
+		out[v].g = in->g;
+		out[v].b = in->b;
+	}
+
+	unsigned short *indices = batcher->indices + batch->firstIndex + batch->indexCount;
+	for (int i = 0; i < mesh->indexCount; ++i)
+		indices[i] = (unsigned short)(mesh->indices[i] + batch->vertexCount);
+
+	object->firstVertex = batch->firstVertex + batch->vertexCount;
+	object->firstIndex = batch->firstIndex + batch->indexCount;
+	batch->vertexCount += mesh->vertexCount;
+	batch->indexCount += mesh->indexCount;
+}
+
+int staticBatcherBuild(StaticBatcher *batcher)
+{
+	if (!batcher->dirty)
+		return 0;
+	batcher->dirty = 0;
+
+	// Group the objects by program, in order of handle within a program so
+	// rebuilds of the same objects give the same batches
+	int count = 0, vertexCount = 0, indexCount = 0;
+	for (int i = 0; i < batcher->objectCount; ++i)
+	{
+		StaticBatchObject *object = &batcher->objects[i];
+		if (!object->program)
+			continue;
+		batcher->order[count++] = (unsigned long long)object->program << 32 | (unsigned)i;
+		vertexCount += object->mesh->vertexCount;
+		indexCount += object->mesh->indexCount;
+	}
+	qsort(batcher->order, count, sizeof(unsigned long long), compareKeys);
+
+	if (!reserve((void **)&batcher->vertices, &batcher->vertexCapacity, vertexCount, sizeof(BatchVertex))
+		|| !reserve((void **)&batcher->indices, &batcher->indexCapacity, indexCount, sizeof(unsigned short)))
+	{
+		fprintf(stderr, "Out of memory for %d static batch vertices\n", vertexCount);
+		return 0;
+	}
+
+	StaticBatch *batch = NULL;
+	int programs = 0;
+	batcher->batchCount = 0;
+	for (int k = 0; k < count; ++k)
+	{
+		StaticBatchObject *object = &batcher->objects[batcher->order[k] & 0xffffffffu];
+		int newProgram = !batch || batch->program != object->program;
+		if (newProgram || batch->vertexCount + object->mesh->vertexCount > STATIC_BATCH_MAX_VERTICES)
+		{
+			int oldCapacity = batcher->batchCapacity;
+			int previousIndex = batch ? (int)(batch - batcher->batches) : -1;
+			if (!reserve((void **)&batcher->batches, &batcher->batchCapacity, batcher->batchCount + 1, sizeof(StaticBatch)))
+			{
+				fprintf(stderr, "Out of memory for %d static batches\n", batcher->batchCount + 1);
+				batcher->batchCount = 0;
+				return 0;
+			}
+			// New slots have no buffers yet
+			memset(batcher->batches + oldCapacity, 0, (batcher->batchCapacity - oldCapacity) * sizeof(StaticBatch));
+			StaticBatch *previous = previousIndex >= 0 ? &batcher->batches[previousIndex] : NULL;
+			batch = &batcher->batches[batcher->batchCount++];
+			batch->program = object->program;
+			batch->firstVertex = previous ? previous->firstVertex + previous->vertexCount : 0;
+			batch->firstIndex = previous ? previous->firstIndex + previous->indexCount : 0;
+			batch->vertexCount = batch->indexCount = 0;
+			programs += newProgram;
+		}
+		object->batch = batcher->batchCount - 1;
+		bake(batcher, object, batch);
+	}
+
+	for (int i = 0; i < batcher->batchCount; ++i)
+	{
+		batch = &batcher->batches[i];
+		if (!batch->vertexBuffer)
+		{
+			GLuint buffers[2];
+			glGenBuffers(2, buffers);
+			batch->vertexBuffer = buffers[0];
+			batch->indexBuffer = buffers[1];
+		}
+		glStateBindBuffer(GL_ARRAY_BUFFER, batch->vertexBuffer);
+		glCmdBufferData(GL_ARRAY_BUFFER, batch->vertexCount * sizeof(BatchVertex),
+			batcher->vertices + batch->firstVertex, GL_STATIC_DRAW);
+		glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->indexBuffer);
+		glCmdBufferData(GL_ELEMENT_ARRAY_BUFFER, batch->indexCount * sizeof(unsigned short),
+			batcher->indices + batch->firstIndex, GL_STATIC_DRAW);
+		batch->mvpLocation = glGetUniformLocation(batch->program, "MVP");
+	}
+
+	StaticBatchStats *stats = &batcher->stats;
+	stats->objects = count;
+	stats->batches = batcher->batchCount;
+	stats->programs = programs;
+	stats->vertices = vertexCount;
+	stats->indices = indexCount;
+	stats->bytesUploaded += (unsigned long long)vertexCount * sizeof(BatchVertex) + indexCount * sizeof(unsigned short);
+	++stats->rebuilds;
+	return 1;
+}
+
+void staticBatcherDraw(StaticBatcher *batcher, mat4x4 viewProjection)
+{
+	for (int i = 0; i < batcher->batchCount; ++i)
+	{
+		StaticBatch *batch = &batcher->batches[i];
+		glStateUseProgram(batch->program);
+		glStateUniformMatrix4fv(batch->mvpLocation, 1, GL_FALSE, (const GLfloat *)viewProjection);
+		glStateBindBuffer(GL_ARRAY_BUFFER, batch->vertexBuffer);
+		glStateVertexAttribPointer(batcher->positionLocation, 3, GL_FLOAT, GL_FALSE,
+			sizeof(BatchVertex), (void *)0);
+		glStateVertexAttribPointer(batcher->colorLocation, 3, GL_FLOAT, GL_FALSE,
+			sizeof(BatchVertex), (void *)(3 * sizeof(float)));
+		glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->indexBuffer);
+		glCmdDrawElements(GL_TRIANGLES, batch->indexCount, GL_UNSIGNED_SHORT, (void *)0);
+	}
+
+	++batcher->stats.views;
+	batcher->stats.draws += batcher->batchCount;
+	batcher->stats.drawsSaved += batcher->stats.objects - batcher->batchCount;
+}
@@ -0,0 +1,118 @@
+// Static geometry batching.
+//
+// Meshes that never move relative to the world are merged ahead of time:
+// every object's vertices are transformed to world space once and appended to
+// a shared vertex buffer per program, with their indices rebased to match, so
+// a whole group draws with one glDrawElements per view instead of one draw
+// (and a uniform upload, and attribute setup) per object. Under emscripten
+// each of those is a call into JavaScript and through WebGL validation.
+//
+// Indices are GL_UNSIGNED_SHORT, which WebGL1 supports without
+// OES_element_index_uint, so a batch holds at most STATIC_BATCH_MAX_VERTICES
+// vertices and a group that needs more is split into several batches.
+//
+// Adding, removing or moving an object only marks the batches stale; they are
+// rebuilt as a whole by the next staticBatcherBuild. Rebuilds cost a pass
+// over every vertex and a full upload, so they suit scene loads and rare
+// edits, not per-frame animation. Batches are drawn whole, objects in them
+// are not culled one by one.
+#ifndef STATIC_BATCH_H
+#define STATIC_BATCH_H
+
+#include "linmath.h"
+
+#include <GLES2/gl2.h>
+
+#define STATIC_BATCH_MAX_VERTICES 65536
+
+// Vertex layout of meshes and batches, matching the vPos and vCol attributes
+typedef struct BatchVertex
+{
+	float x, y, z;
+	float r, g, b;
+} BatchVertex;
+
+// Indexed triangle list in model space. It has to stay valid while an object
+// uses it, the batcher only keeps the pointers.
+typedef struct BatchMesh
+{
+	const BatchVertex *vertices;
+	const unsigned short *indices;
+	int vertexCount, indexCount;
+} BatchMesh;
+
+typedef struct StaticBatchObject
+{
+	GLuint program; // 0 for a free slot
+	const BatchMesh *mesh;
+	mat4x4 world;
+
+	// Where the last build put the object
+	int batch, firstVertex, firstIndex;
+} StaticBatchObject;
+
+typedef struct StaticBatch
+{
+	GLuint program;
+	GLint mvpLocation;
+	GLuint vertexBuffer, indexBuffer;
+	int firstVertex, vertexCount; // Range of the batcher's vertices
+	int firstIndex, indexCount;   // Range of the batcher's indices
+} StaticBatch;
+
+typedef struct StaticBatchStats
+{
+	int objects, batches, programs;
+	int vertices, indices;
+	unsigned long rebuilds;
+	unsigned long long bytesUploaded;
+	unsigned long views;
+	unsigned long long draws, drawsSaved; // Batched draws made, and per-object draws they replaced
+} StaticBatchStats;
+
+typedef struct StaticBatcher
+{
+	StaticBatchObject *objects;
+	int objectCount, capacity; // Slots in use, including freed ones below the last live object
+	int liveCount;
+	int firstFree; // No free slot below it
+	int dirty;
+
+	// Attribute locations the batches are drawn with
+	GLuint positionLocation, colorLocation;
+
+	// Output of the last build, in world space. Batches keep their GL
+	// buffers across rebuilds and are only created when more are needed.
+	StaticBatch *batches;
+	int batchCount, batchCapacity;
+	BatchVertex *vertices;
+	unsigned short *indices;
+	int vertexCapacity, indexCapacity;
+	unsigned long long *order; // Live objects as program << 32 | object, sorted while building
+
+	StaticBatchStats stats;
+} StaticBatcher;
+
+// Allocates room for capacity objects. Returns 0 when out of memory.
+int staticBatcherInit(StaticBatcher *batcher, int capacity, GLuint positionLocation, GLuint colorLocation);
+// Frees the memory and deletes the GL buffers
+void staticBatcherFree(StaticBatcher *batcher);
+
+// Adds an object drawn with program, whose "MVP" uniform is set to the view
+// projection, and returns its handle. Returns -1 when the batcher is full or
+// the mesh does not fit in a batch.
+int staticBatcherAdd(StaticBatcher *batcher, GLuint program, const BatchMesh *mesh, mat4x4 world);
+// The handle has to be live, and may be reused by a later add
+void staticBatcherRemove(StaticBatcher *batcher, int object);
+void staticBatcherSetWorld(StaticBatcher *batcher, int object, mat4x4 world);
+
+// Rebuilds and uploads the batches if objects were added, removed or moved
+// since the last build, and returns whether it did. The programs have to be
+// linked, their uniforms are looked up here.
+int staticBatcherBuild(StaticBatcher *batcher);
+
+// Draws every batch with the given view projection. Leaves the last batch's
+// buffers bound and its attribute pointers set.
+void staticBatcherDraw(StaticBatcher *batcher, mat4x4 viewProjection);
+
+#endif
@@ -0,0 +1,80 @@
+// Rigid transform with uniform scale, kept as a rotation quaternion, a
+// translation and a scale instead of a 4x4 matrix.
+//
+// A transform maps p to translation + rotation * (scale * p). Composing two
+// of them takes a quaternion product and one rotated vector, about half the
+// multiplies of mat4x4_mul, inverting one needs no cofactors, and the result
+// stays rigid instead of drifting through rounding. Convert to a mat4x4 only
+// where a matrix is needed, such as for upload.
+//
+// Like linmath.h, everything is static inline and outputs may not alias
+// inputs unless stated.
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "linmath.h"
+
+typedef struct Transform
+{
+	quat rotation; // Unit
+	vec3 translation;
+	float scale;
+} Transform;
+
+static inline void transformIdentity(Transform *t)
+{
+	quat_identity(t->rotation);
+	t->translation[0] = t->translation[1] = t->translation[2] = 0.f;
+	t->scale = 1.f;
+}
+
+static inline void transformSet(Transform *t, vec3 translation, quat rotation, float scale)
+{
+	int i;
+	for(i = 0; i < 4; ++i)
+		t->rotation[i] = rotation[i];
+	for(i = 0; i < 3; ++i)
+		t->translation[i] = translation[i];
+	t->scale = scale;
+}
+
+// r = t applied to the point p. r may alias p.
+static inline void transformPoint(vec3 r, Transform *t, vec3 p)
+{
+	vec3 s;
+	vec3_scale(s, p, t->scale);
+	quat_mul_vec3(r, t->rotation, s);
+	vec3_add(r, r, t->translation);
+}
+
+// r = a * b, the transform applying b and then a
+static inline void transformCompose(Transform *r, Transform *a, Transform *b)
+{
+	quat_mul(r->rotation, a->rotation, b->rotation);
+	transformPoint(r->translation, a, b->translation);
+	r->scale = a->scale * b->scale;
+}
+
+// r = inverse of t, which maps p to rotation^-1 * (p - translation) / scale
+static inline void transformInvert(Transform *r, Transform *t)
+{
+	vec3 p;
+	r->scale = 1.f / t->scale;
+	quat_conj(r->rotation, t->rotation);
+	quat_mul_vec3(p, r->rotation, t->translation);
+	vec3_scale(r->translation, p, -r->scale);
+}
+
+// M = translate(translation) * rotate(rotation) * scale(scale)
+static inline void transformToMat4x4(mat4x4 M, Transform *t)
+{
+	mat4x4_from_quat(M, t->rotation);
+	vec3_scale(M[0], M[0], t->scale);
+	vec3_scale(M[1], M[1], t->scale);
+	vec3_scale(M[2], M[2], t->scale);
+	M[3][0] = t->translation[0];
+	M[3][1] = t->translation[1];
+	M[3][2] = t->translation[2];
+}
+
+#endif
@@ -0,0 +1,230 @@
+#include "vertex_format.h"
+
+#include "gl_state.h"
+
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GLES2/gl2ext.h>
+#include <string.h>
+
+static int typeSize(GLenum type)
+{
+	switch (type)
+	{
+	case GL_UNSIGNED_BYTE: return 1;
+	case GL_UNSIGNED_SHORT:
+	case GL_HALF_FLOAT_OES: return 2;
+	default: return 4;
+	}
+}
+
+static int align4(int bytes)
+{
+	return (bytes + 3) & ~3;
+}
+
+void vertexFormatInit(VertexFormat *format, GLenum positionType, int positionSize, GLenum colorType, int colorSize)
+{
+	format->positionType = positionType;
+	format->colorType = colorType;
+	format->positionSize = positionSize;
+	format->colorSize = colorSize;
+	format->positionOffset = 0;
+	format->colorOffset = align4(positionSize * typeSize(positionType));
+	format->stride = align4(format->colorOffset + colorSize * typeSize(colorType));
+}
+
+void vertexDequantizationFromBounds(VertexDequantization *dequantization, const VertexFormat *format,
+	const float *vertices, int floatStride, int count)
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		dequantization->scale[k] = 1.f;
+		dequantization->offset[k] = 0.f;
+	}
+	int half = format->positionType == GL_HALF_FLOAT_OES;
+	if ((format->positionType != GL_UNSIGNED_SHORT && !half) || count <= 0)
+		return;
+
+	for (int k = 0; k < format->positionSize && k < 3; ++k)
+	{
+		float lo = vertices[k], hi = vertices[k];
+		for (int i = 1; i < count; ++i)
+		{
+			float p = vertices[i * floatStride + k];
+			lo = fminf(lo, p);
+			hi = fmaxf(hi, p);
+		}
+		// Halves are signed, so they are centered, which also keeps the
+		// finest steps near zero in the middle of the mesh
+		dequantization->offset[k] = half ? 0.5f * (lo + hi) : lo;
+		if (hi > lo)
+			dequantization->scale[k] = half ? 0.5f * (hi - lo) : hi - lo;
+	}
+}
+
+void vertexDequantizationMatrix(mat4x4 M, const VertexDequantization *dequantization)
+{
+	mat4x4_identity(M);
+	for (int k = 0; k < 3; ++k)
+	{
+		M[k][k] = dequantization->scale[k];
+		M[3][k] = dequantization->offset[k];
+	}
+}
+
+static float clamp01(float f)
+{
+	return f < 0.f ? 0.f : f > 1.f ? 1.f : f;
+}
+
+void vertexFormatEncode(const VertexFormat *format, const VertexDequantization *dequantization,
+	void *out, const float *vertices, int floatStride, int count)
+{
+	unsigned char *v = out;
+	memset(v, 0, (size_t)count * format->stride);
+	for (int i = 0; i < count; ++i, v += format->stride, vertices += floatStride)
+	{
+		unsigned char *p = v + format->positionOffset;
+		for (int k = 0; k < format->positionSize; ++k)
+		{
+			float f = vertices[k];
+			if (format->positionType == GL_UNSIGNED_SHORT)
+			{
+				float n = clamp01((f - dequantization->offset[k]) / dequantization->scale[k]);
+				uint16_t c = (uint16_t)(n * 65535.f + 0.5f);
+				memcpy(p + 2 * k, &c, 2);
+			}
+			else if (format->positionType == GL_HALF_FLOAT_OES)
+			{
+				uint16_t c = vertexHalfFromFloat((f - dequantization->offset[k]) / dequantization->scale[k]);
+				memcpy(p + 2 * k, &c, 2);
+			}
+			else
+			{
+				memcpy(p + 4 * k, &f, 4);
+			}
+		}
+
+		unsigned char *c = v + format->colorOffset;
+		const float *color = vertices + format->positionSize;
+		for (int k = 0; k < format->colorSize; ++k)
+		{
+			if (format->colorType == GL_UNSIGNED_BYTE)
+				c[k] = (unsigned char)(clamp01(color[k]) * 255.f + 0.5f);
+			else
+				memcpy(c + 4 * k, &color[k], 4);
+		}
+	}
+}
+
+void vertexFormatDecode(const VertexFormat *format, const VertexDequantization *dequantization,
+	float *vertices, int floatStride, const void *in, int count)
+{
+	const unsigned char *v = in;
+	for (int i = 0; i < count; ++i, v += format->stride, vertices += floatStride)
+	{
+		const unsigned char *p = v + format->positionOffset;
+		for (int k = 0; k < format->positionSize; ++k)
+		{
+			uint16_t c;
+			if (format->positionType == GL_UNSIGNED_SHORT)
+			{
+				memcpy(&c, p + 2 * k, 2);
+				vertices[k] = dequantization->offset[k] + dequantization->scale[k] * (c / 65535.f);
+			}
+			else if (format->positionType == GL_HALF_FLOAT_OES)
+			{
+				memcpy(&c, p + 2 * k, 2);
+				vertices[k] = dequantization->offset[k] + dequantization->scale[k] * vertexFloatFromHalf(c);
+			}
+			else
+			{
+				memcpy(&vertices[k], p + 4 * k, 4);
+			}
+		}
+
+		const unsigned char *c = v + format->colorOffset;
+		float *color = vertices + format->positionSize;
+		for (int k = 0; k < format->colorSize; ++k)
+		{
+			if (format->colorType == GL_UNSIGNED_BYTE)
+				color[k] = c[k] / 255.f;
+			else
+				memcpy(&color[k], c + 4 * k, 4);
+		}
+	}
+}
+
+void vertexFormatBind(const VertexFormat *format, GLuint positionLocation, GLuint colorLocation, int offset)
+{
+	glStateVertexAttribPointer(positionLocation, format->positionSize, format->positionType,
+		format->positionType == GL_UNSIGNED_SHORT, format->stride, (void *)(intptr_t)(offset + format->positionOffset));
+	glStateVertexAttribPointer(colorLocation, format->colorSize, format->colorType,
+		format->colorType == GL_UNSIGNED_BYTE, format->stride, (void *)(intptr_t)(offset + format->colorOffset));
+}
+
+uint16_t vertexHalfFromFloat(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, 4);
+	uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+	uint32_t a = x & 0x7fffffff;
+
+	if (a >= 0x7f800000) // Infinity stays infinity, NaN stays a quiet NaN
+		return sign | 0x7c00 | (a > 0x7f800000 ? 0x200 : 0);
+	if (a >= 0x477ff000) // Rounds past 65504, the largest half
+		return sign | 0x7c00;
+	if (a <= 0x33000000) // At most half the smallest denormal, 2^-25
+		return sign;
+
+	uint32_t mantissa, rest, halfway;
+	uint16_t h;
+	if (a < 0x38800000)
+	{
+		// Denormal half: the float's mantissa with its implicit bit, shifted
+		// down to units of 2^-24
+		int shift = 126 - (int)(a >> 23);
+		mantissa = (a & 0x7fffff) | 0x800000;
+		h = (uint16_t)(mantissa >> shift);
+		rest = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	}
+	else
+	{
+		// Rebias the exponent from 127 to 15. A mantissa rounding up carries
+		// into the exponent, which is what it should do.
+		h = (uint16_t)((a - 0x38000000) >> 13);
+		rest = a & 0x1fff;
+		halfway = 0x1000;
+	}
+	if (rest > halfway || (rest == halfway && (h & 1)))
+		++h;
+	return sign | h;
+}
+
+float vertexFloatFromHalf(uint16_t h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1f, mantissa = h & 0x3ff;
+	uint32_t x;
+	if (exponent == 0)
+	{
+		// Zero or denormal, exact in float
+		float f = mantissa * (1.f / 16777216.f);
+		memcpy(&x, &f, 4);
+	}
+	else if (exponent == 31)
+	{
+		x = 0x7f800000 | mantissa << 13;
+	}
+	else
+	{
+		x = (exponent + 112) << 23 | mantissa << 13;
+	}
+	x |= sign;
+	float f;
+	memcpy(&f, &x, 4);
+	return f;
+}
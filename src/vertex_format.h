@@ -0,0 +1,74 @@
+// Compact vertex formats.
+//
+// Vertices are authored as interleaved floats, position then color, and
+// encoded once for upload into a smaller layout:
+//   - positions as GL_UNSIGNED_SHORT normalized, quantized to the mesh's
+//     bounding box and dequantized by a per-mesh scale and offset, which the
+//     caller folds into the model matrix so the shaders stay the same
+//   - or as GL_HALF_FLOAT_OES (OES_vertex_half_float), in [-1, 1] around the
+//     center of the bounding box, dequantized the same way so the precision
+//     does not depend on how far the mesh is from the origin. Only exposed
+//     by native GLES2 drivers, not WebGL1
+//   - colors as GL_UNSIGNED_BYTE normalized
+// Every attribute starts on a 4 byte boundary and the stride is a multiple
+// of 4, as some mobile GPUs fetch misaligned attributes slowly or not at all.
+// A 2D position and an RGB color take 8 bytes instead of 20 as floats.
+//
+// GL_UNSIGNED_SHORT rather than GL_SHORT, because GLES2 and GLES3 convert
+// normalized signed integers differently (ES2 cannot represent 0), while the
+// unsigned conversion c / 65535 is the same everywhere.
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include "linmath.h"
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+typedef struct VertexFormat
+{
+	GLenum positionType; // GL_FLOAT, GL_UNSIGNED_SHORT or GL_HALF_FLOAT_OES
+	GLenum colorType;    // GL_FLOAT or GL_UNSIGNED_BYTE
+	int positionSize, colorSize; // Components, 1 to 4
+
+	// Bytes, multiples of 4
+	int positionOffset, colorOffset, stride;
+} VertexFormat;
+
+// Model space position = offset + scale * attribute value
+typedef struct VertexDequantization
+{
+	vec3 scale, offset;
+} VertexDequantization;
+
+// Lays out a format, positions first
+void vertexFormatInit(VertexFormat *format, GLenum positionType, int positionSize, GLenum colorType, int colorSize);
+
+// Fits the dequantization to the bounds of count vertices, floatStride
+// floats apart: the box's corner and size for GL_UNSIGNED_SHORT, its center
+// and half size for GL_HALF_FLOAT_OES, identity for GL_FLOAT.
+void vertexDequantizationFromBounds(VertexDequantization *dequantization, const VertexFormat *format,
+	const float *vertices, int floatStride, int count);
+
+// M = translate(offset) * scale(scale), to multiply the model matrix by
+void vertexDequantizationMatrix(mat4x4 M, const VertexDequantization *dequantization);
+
+// Encodes count vertices of interleaved floats, floatStride floats apart,
+// into count * format->stride bytes at out. Padding bytes are zeroed.
+void vertexFormatEncode(const VertexFormat *format, const VertexDequantization *dequantization,
+	void *out, const float *vertices, int floatStride, int count);
+
+// Decodes back to interleaved floats in model space, as the GPU would see them
+void vertexFormatDecode(const VertexFormat *format, const VertexDequantization *dequantization,
+	float *vertices, int floatStride, const void *in, int count);
+
+// Points the two attributes at vertices starting offset bytes into the bound
+// array buffer, through the GL state cache
+void vertexFormatBind(const VertexFormat *format, GLuint positionLocation, GLuint colorLocation, int offset);
+
+// IEEE 754 binary16 conversion, rounding to nearest even. Values beyond the
+// half range become infinity.
+uint16_t vertexHalfFromFloat(float f);
+float vertexFloatFromHalf(uint16_t h);
+
+#endif
@@ -0,0 +1,58 @@
+#include "vertex_stream.h"
+
+#include "gl_command.h"
+#include "gl_state.h"
+
+#include <string.h>
+
+void vertexStreamInit(VertexStream *stream, int size)
+{
+	memset(stream, 0, sizeof(*stream));
+	stream->size = size;
+
+	glGenBuffers(VERTEX_STREAM_BUFFERS, stream->buffers);
+	for (int i = 0; i < VERTEX_STREAM_BUFFERS; ++i)
+	{
+		glStateBindBuffer(GL_ARRAY_BUFFER, stream->buffers[i]);
+		glCmdBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+	}
+	stream->current = VERTEX_STREAM_BUFFERS - 1;
+}
+
+void vertexStreamFree(VertexStream *stream)
+{
+	glStateDeleteBuffers(VERTEX_STREAM_BUFFERS, stream->buffers);
+	memset(stream, 0, sizeof(*stream));
+}
+
+void vertexStreamBeginFrame(VertexStream *stream)
+{
+	if (stream->frames)
+		stream->bytesLastFrame = stream->bytesThisFrame;
+	++stream->frames;
+	stream->bytesThisFrame = 0;
+	stream->current = (stream->current + 1) % VERTEX_STREAM_BUFFERS;
+	stream->offset = 0;
+}
+
+int vertexStreamWrite(VertexStream *stream, const void *data, int size, int align)
+{
+	if (size > stream->size)
+		return -1;
+
+	glStateBindBuffer(GL_ARRAY_BUFFER, stream->buffers[stream->current]);
+
+	int offset = align > 1 ? (stream->offset + align - 1) / align * align : stream->offset;
+	if (offset + size > stream->size)
+	{
+		glCmdBufferData(GL_ARRAY_BUFFER, stream->size, NULL, GL_STREAM_DRAW);
+		++stream->orphans;
+		offset = 0;
+	}
+
+	glCmdBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+	stream->offset = offset + size;
+	stream->bytesThisFrame += size;
+	stream->bytesTotal += size;
+	return offset;
+}
@@ -0,0 +1,47 @@
+// Streaming of per-frame vertex data (debug lines, particles, UI).
+//
+// A few large vertex buffers are created once and reused round robin, one per
+// frame, so the GPU can still be reading the last frames' data while the
+// current frame writes into another buffer. Writes are suballocated from the
+// current buffer with glBufferSubData. If a frame needs more than a buffer
+// holds, the buffer is orphaned (its storage respecified with glBufferData and
+// no data) and filled again from the start; draws already issued keep reading
+// the old storage.
+//
+// The streamer never allocates memory or creates buffers after init. Buffers
+// are bound through the GL state cache (gl_state.h).
+#ifndef VERTEX_STREAM_H
+#define VERTEX_STREAM_H
+
+#include <GLES2/gl2.h>
+
+// WebGL1 has no fences, so enough buffers are kept for the GPU to be at most
+// two frames behind
+#define VERTEX_STREAM_BUFFERS 3
+
+typedef struct VertexStream
+{
+	GLuint buffers[VERTEX_STREAM_BUFFERS];
+	int size;    // Bytes per buffer
+	int current; // Buffer of the current frame
+	int offset;  // Next free byte in it
+
+	unsigned long frames;
+	unsigned long bytesThisFrame, bytesLastFrame;
+	unsigned long long bytesTotal;
+	unsigned long orphans; // Times a frame overflowed its buffer
+} VertexStream;
+
+// Creates the buffers, each size bytes
+void vertexStreamInit(VertexStream *stream, int size);
+void vertexStreamFree(VertexStream *stream);
+
+// Moves on to the next buffer. Called once per frame before any write.
+void vertexStreamBeginFrame(VertexStream *stream);
+
+// Copies size bytes into the current buffer, aligned to align bytes, and
+// leaves the buffer bound to GL_ARRAY_BUFFER. Returns the byte offset of the
+// data in the buffer, or -1 if size is larger than a whole buffer.
+int vertexStreamWrite(VertexStream *stream, const void *data, int size, int align);
+
+#endif